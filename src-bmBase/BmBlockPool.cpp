@@ -0,0 +1,288 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+#include <stdlib.h>
+
+#include <new>
+
+#include <OS.h>
+#include <TLS.h>
+
+#include "BmBlockPool.h"
+
+/********************************************************************************\
+	BmBlockPool
+\********************************************************************************/
+
+const uint32 BmBlockPool::nMinBlockSize = 4096;
+const uint32 BmBlockPool::nMaxBlockSize = 1024*1024;
+const int32 BmBlockPool::nMaxIdleBlocks = 4;
+
+static const int32 nSizeClassCount = 9;
+							// 4K, 8K, ... 1M
+
+// every free block holds a pointer to the next free block of its class:
+struct FreeBlock {
+	FreeBlock* next;
+};
+
+struct BmBlockPool::ThreadCache {
+	FreeBlock* freeList[nSizeClassCount];
+	int32 freeCount[nSizeClassCount];
+	int32 arenaDepth;
+	int32 freeCountAtArenaOpen[nSizeClassCount];
+							// the cache is trimmed back to this when the 
+							// (outermost) arena is closed
+
+	ThreadCache()
+		:	arenaDepth( 0)
+	{
+		for( int32 i=0; i<nSizeClassCount; ++i) {
+			freeList[i] = NULL;
+			freeCount[i] = 0;
+			freeCountAtArenaOpen[i] = 0;
+		}
+	}
+};
+
+static int32 sTlsIndex = tls_allocate();
+
+static vint32 sHeapAllocs = 0;
+static vint32 sCacheHits = 0;
+static vint32 sHeapFrees = 0;
+static vint32 sCachedBlocks = 0;
+static vint32 sCachedBytes = 0;
+static vint32 sPeakCachedBytes = 0;
+static vint32 sArenasClosed = 0;
+
+/*------------------------------------------------------------------------------*\
+	SizeClassFor( size)
+		-	returns the index of the smallest size class that fits the given
+			size (or -1 if the size is too large for any class)
+\*------------------------------------------------------------------------------*/
+static inline int32 SizeClassFor( uint32 size) {
+	int32 sizeClass = 0;
+	for( uint32 classSize = BmBlockPool::nMinBlockSize;
+		  sizeClass < nSizeClassCount; classSize <<= 1, ++sizeClass) {
+		if (size <= classSize)
+			return sizeClass;
+	}
+	return -1;
+}
+
+static inline uint32 ClassSize( int32 sizeClass) {
+	return BmBlockPool::nMinBlockSize << sizeClass;
+}
+
+/*------------------------------------------------------------------------------*\
+	CurrentCache( create)
+		-	returns the block cache of the current thread, which is created
+			on demand (and deleted when the thread exits)
+\*------------------------------------------------------------------------------*/
+BmBlockPool::ThreadCache* BmBlockPool::CurrentCache( bool create) {
+	ThreadCache* cache = static_cast<ThreadCache*>( tls_get( sTlsIndex));
+	if (!cache && create) {
+		cache = new (std::nothrow) ThreadCache;
+		if (cache) {
+			tls_set( sTlsIndex, cache);
+			on_exit_thread( &DeleteCache, cache);
+		}
+	}
+	return cache;
+}
+
+/*------------------------------------------------------------------------------*\
+	DeleteCache( cache)
+		-	frees all blocks of the given cache and the cache itself
+\*------------------------------------------------------------------------------*/
+void BmBlockPool::DeleteCache( void* data) {
+	ThreadCache* cache = static_cast<ThreadCache*>( data);
+	TrimCache( cache, 0);
+	if (tls_get( sTlsIndex) == cache)
+		tls_set( sTlsIndex, NULL);
+	delete cache;
+}
+
+/*------------------------------------------------------------------------------*\
+	TrimCache( cache, maxBlocks)
+		-	returns cached blocks to the heap until no more than maxBlocks
+			are left in each size class
+\*------------------------------------------------------------------------------*/
+void BmBlockPool::TrimCache( ThreadCache* cache, int32 maxBlocks) {
+	for( int32 i=0; i<nSizeClassCount; ++i)
+		TrimSizeClass( cache, i, maxBlocks);
+}
+
+/*------------------------------------------------------------------------------*\
+	TrimSizeClass( cache, sizeClass, maxBlocks)
+		-	returns cached blocks of the given size class to the heap until no 
+			more than maxBlocks are left
+\*------------------------------------------------------------------------------*/
+void BmBlockPool::TrimSizeClass( ThreadCache* cache, int32 sizeClass, 
+											int32 maxBlocks) {
+	while( cache->freeCount[sizeClass] > maxBlocks) {
+		FreeBlock* block = cache->freeList[sizeClass];
+		cache->freeList[sizeClass] = block->next;
+		cache->freeCount[sizeClass]--;
+		free( block);
+		atomic_add( &sHeapFrees, 1);
+		atomic_add( &sCachedBlocks, -1);
+		atomic_add( &sCachedBytes, -(int32)ClassSize( sizeClass));
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	Allocate( size)
+		-	returns a block of (at least) the given size, preferably one from
+			the cache of the current thread
+		-	returns NULL if no memory is available
+\*------------------------------------------------------------------------------*/
+char* BmBlockPool::Allocate( uint32 size) {
+	int32 sizeClass = SizeClassFor( size);
+	if (sizeClass < 0) {
+		atomic_add( &sHeapAllocs, 1);
+		return static_cast<char*>( malloc( size));
+	}
+	ThreadCache* cache = CurrentCache( true);
+	if (cache && cache->freeList[sizeClass]) {
+		FreeBlock* block = cache->freeList[sizeClass];
+		cache->freeList[sizeClass] = block->next;
+		cache->freeCount[sizeClass]--;
+		atomic_add( &sCacheHits, 1);
+		atomic_add( &sCachedBlocks, -1);
+		atomic_add( &sCachedBytes, -(int32)ClassSize( sizeClass));
+		return reinterpret_cast<char*>( block);
+	}
+	atomic_add( &sHeapAllocs, 1);
+	return static_cast<char*>( malloc( ClassSize( sizeClass)));
+}
+
+/*------------------------------------------------------------------------------*\
+	Free( block, size)
+		-	puts the given block into the cache of the current thread (if there
+			is room), otherwise returns it to the heap
+\*------------------------------------------------------------------------------*/
+void BmBlockPool::Free( char* block, uint32 size) {
+	if (!block)
+		return;
+	int32 sizeClass = SizeClassFor( size);
+	ThreadCache* cache = sizeClass < 0 ? NULL : CurrentCache( true);
+	if (!cache
+	|| (!cache->arenaDepth && cache->freeCount[sizeClass] >= nMaxIdleBlocks)) {
+		free( block);
+		atomic_add( &sHeapFrees, 1);
+		return;
+	}
+	FreeBlock* freeBlock = reinterpret_cast<FreeBlock*>( block);
+	freeBlock->next = cache->freeList[sizeClass];
+	cache->freeList[sizeClass] = freeBlock;
+	cache->freeCount[sizeClass]++;
+	atomic_add( &sCachedBlocks, 1);
+	int32 cachedBytes
+		= atomic_add( &sCachedBytes, ClassSize( sizeClass))
+			+ ClassSize( sizeClass);
+	if (cachedBytes > sPeakCachedBytes)
+		sPeakCachedBytes = cachedBytes;
+							// not exact in case of a race, but good enough
+}
+
+/*------------------------------------------------------------------------------*\
+	BlockSizeFor( size)
+		-	returns the size of the block that Allocate() hands out for the 
+			given size, or 0 if blocks of that size bypass the pool
+\*------------------------------------------------------------------------------*/
+uint32 BmBlockPool::BlockSizeFor( uint32 size) {
+	int32 sizeClass = SizeClassFor( size);
+	return sizeClass < 0 ? 0 : ClassSize( sizeClass);
+}
+
+/*------------------------------------------------------------------------------*\
+	ReleaseCachedBlocks()
+		-	frees all blocks cached by the current thread
+\*------------------------------------------------------------------------------*/
+void BmBlockPool::ReleaseCachedBlocks() {
+	ThreadCache* cache = CurrentCache( false);
+	if (cache)
+		TrimCache( cache, 0);
+}
+
+/*------------------------------------------------------------------------------*\
+	GetStats( stats)
+		-	fills the given stats with the current counters
+\*------------------------------------------------------------------------------*/
+void BmBlockPool::GetStats( Stats& stats) {
+	stats.heapAllocs = sHeapAllocs;
+	stats.cacheHits = sCacheHits;
+	stats.heapFrees = sHeapFrees;
+	stats.cachedBlocks = sCachedBlocks;
+	stats.cachedBytes = sCachedBytes;
+	stats.peakCachedBytes = sPeakCachedBytes;
+	stats.arenasClosed = sArenasClosed;
+}
+
+/*------------------------------------------------------------------------------*\
+	ResetStats()
+		-	resets the counters (the number of currently cached blocks/bytes
+			is left alone, of course)
+\*------------------------------------------------------------------------------*/
+void BmBlockPool::ResetStats() {
+	sHeapAllocs = 0;
+	sCacheHits = 0;
+	sHeapFrees = 0;
+	sPeakCachedBytes = sCachedBytes;
+	sArenasClosed = 0;
+}
+
+
+
+/********************************************************************************\
+	BmParseArena
+\********************************************************************************/
+
+/*------------------------------------------------------------------------------*\
+	BmParseArena()
+		-	constructor, opens the arena for the current thread
+\*------------------------------------------------------------------------------*/
+BmParseArena::BmParseArena()
+	:	mCache( BmBlockPool::CurrentCache( true))
+	,	mIsOutermost( false)
+{
+	if (!mCache)
+		return;
+	if (mCache->arenaDepth++ == 0) {
+		mIsOutermost = true;
+		for( int32 i=0; i<nSizeClassCount; ++i)
+			mCache->freeCountAtArenaOpen[i] = mCache->freeCount[i];
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	~BmParseArena()
+		-	destructor, closes the arena; if this was the outermost arena, all
+			blocks that have piled up in the cache since it was opened are 
+			returned to the heap
+\*------------------------------------------------------------------------------*/
+BmParseArena::~BmParseArena() {
+	if (!mCache)
+		return;
+	mCache->arenaDepth--;
+	if (mIsOutermost) {
+		for( int32 i=0; i<nSizeClassCount; ++i)
+			BmBlockPool::TrimSizeClass( mCache, i, 
+												 mCache->freeCountAtArenaOpen[i]);
+		atomic_add( &sArenasClosed, 1);
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	IsOpen()
+		-	returns whether an arena is open in the current thread
+\*------------------------------------------------------------------------------*/
+bool BmParseArena::IsOpen() {
+	BmBlockPool::ThreadCache* cache = BmBlockPool::CurrentCache( false);
+	return cache && cache->arenaDepth > 0;
+}
@@ -0,0 +1,102 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+
+#ifndef _BmBlockPool_h
+#define _BmBlockPool_h
+
+#include <SupportDefs.h>
+
+#include "BmBase.h"
+
+/*------------------------------------------------------------------------------*\
+	class BmBlockPool
+		-	a per-thread cache of (large) memory blocks, used for the buffers
+			of memory-filters and other short-lived buffers.
+		-	block sizes are rounded up to a power of two (size classes), freed
+			blocks are kept in a free-list of the current thread, such that
+			the next filter chain can reuse them without going to the heap.
+		-	outside of a BmParseArena, only a few blocks per size class are
+			kept, inside of an arena all freed blocks are kept until the
+			(outermost) arena is closed, which returns them to the heap.
+\*------------------------------------------------------------------------------*/
+class IMPEXPBMBASE BmBlockPool {
+
+public:
+	static char* Allocate( uint32 size);
+	static void Free( char* block, uint32 size);
+							// size must be the same as the one given to Allocate()
+	static uint32 BlockSizeFor( uint32 size);
+							// returns the size of the block that Allocate() hands
+							// out for the given size (0 if it bypasses the pool)
+
+	static void ReleaseCachedBlocks();
+							// frees all blocks cached by the current thread
+
+	// statistics (for all threads):
+	struct Stats {
+		int32 heapAllocs;
+							// number of blocks that had to be fetched from heap
+		int32 cacheHits;
+							// number of blocks that were taken from a cache
+		int32 heapFrees;
+							// number of blocks that have been returned to heap
+		int32 cachedBlocks;
+		int32 cachedBytes;
+							// current amount of cached (unused) blocks
+		int32 peakCachedBytes;
+		int32 arenasClosed;
+	};
+	static void GetStats( Stats& stats);
+	static void ResetStats();
+
+	static const uint32 nMinBlockSize;
+	static const uint32 nMaxBlockSize;
+							// bigger blocks go straight to the heap
+	static const int32 nMaxIdleBlocks;
+							// max number of blocks cached per size class
+							// (outside of an arena)
+
+private:
+	friend class BmParseArena;
+	struct ThreadCache;
+	static ThreadCache* CurrentCache( bool create);
+	static void TrimCache( ThreadCache* cache, int32 maxBlocks);
+	static void TrimSizeClass( ThreadCache* cache, int32 sizeClass, 
+										int32 maxBlocks);
+	static void DeleteCache( void* cache);
+};
+
+/*------------------------------------------------------------------------------*\
+	class BmParseArena
+		-	scope for parsing a mail: all blocks used by the current thread while
+			an arena is open are recycled within the arena and released in one
+			go when the (outermost) arena is closed (the cache is left with
+			the blocks it had when the arena was opened).
+		-	while an arena is open, the buffers of larger strings are taken
+			from the pool, too (see BmString::_Alloc()).
+		-	arenas can be nested, only the outermost one has any effect.
+\*------------------------------------------------------------------------------*/
+class IMPEXPBMBASE BmParseArena {
+
+public:
+	BmParseArena();
+	~BmParseArena();
+
+	static bool IsOpen();
+							// returns whether an arena is open in the current thread
+
+private:
+	BmBlockPool::ThreadCache* mCache;
+	bool mIsOutermost;
+
+	// Hide copy-constructor and assignment:
+	BmParseArena( const BmParseArena&);
+	BmParseArena operator=( const BmParseArena&);
+};
+
+#endif
@@ -0,0 +1,976 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+#include <string.h>
+
+#include "BmByteKernels.h"
+#include "BmStringSearch.h"
+
+// see BmStringSearch.cpp, the byte kernels only come in a SSE2-flavour, since
+// they are memory-bound anyway (AVX2 gains next to nothing here).
+// The base64 kernels are the exception, they need pshufb (SSSE3) and do
+// profit from AVX2:
+#if defined(__GNUC__) \
+	&& (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)) \
+	&& (defined(__i386__) || defined(__x86_64__))
+#	define BM_HAVE_X86_KERNELS 1
+#	include <immintrin.h>
+#endif
+
+namespace BmByteKernels {
+
+// the char sets passed to FindAnyByte() and SpanPrintable() are handled by
+// the vectorized kernels if they are not larger than this:
+static const int32 nMaxVectorSetSize = 16;
+
+/*------------------------------------------------------------------------------*\
+	UseVectorKernels()
+		-	follows the kernel selection of BmStringSearch (such that tests can
+			switch back to the scalar kernels)
+\*------------------------------------------------------------------------------*/
+static inline bool UseVectorKernels() {
+#ifdef BM_HAVE_X86_KERNELS
+	return BmStringSearch::ActiveKernel() != BmStringSearch::KERNEL_SCALAR;
+#else
+	return false;
+#endif
+}
+
+/*------------------------------------------------------------------------------*\
+	Scalar...()
+		-	the plain kernels, used for the tails of the vectorized kernels, too
+\*------------------------------------------------------------------------------*/
+static const char* ScalarFindEitherByte( const char* data, int32 len,
+													  char c1, char c2) {
+	for( const char* end = data + len; data < end; ++data) {
+		if (*data == c1 || *data == c2)
+			return data;
+	}
+	return NULL;
+}
+
+static int32 ScalarCountByte( const char* data, int32 len, char c) {
+	int32 count = 0;
+	for( int32 i=0; i<len; ++i)
+		count += data[i] == c;
+	return count;
+}
+
+static int32 ScalarReplaceByte( char* data, int32 len, char replaceThis,
+										  char withThis) {
+	int32 count = 0;
+	for( int32 i=0; i<len; ++i) {
+		if (data[i] == replaceThis) {
+			data[i] = withThis;
+			count++;
+		}
+	}
+	return count;
+}
+
+static void ScalarCountLinebreaks( const char* data, int32 len, bool prevWasCR,
+											  int32& bareLFs, int32& crlfs) {
+	for( int32 i=0; i<len; ++i) {
+		if (data[i] == '\n') {
+			if (prevWasCR)
+				crlfs++;
+			else
+				bareLFs++;
+		}
+		prevWasCR = data[i] == '\r';
+	}
+}
+
+static const char* ScalarFindAnyByte( const char* data, int32 len,
+												  const char* chars) {
+	for( const char* end = data + len; data < end; ++data) {
+		if (*data && strchr( chars, *data))
+			return data;
+	}
+	return NULL;
+}
+
+static int32 ScalarSpanPrintable( const char* data, int32 len,
+											 const char* except) {
+	int32 i = 0;
+	for( ; i<len; ++i) {
+		unsigned char c = data[i];
+		if (c < ' ' || c >= 0x7F || strchr( except, c))
+			break;
+	}
+	return i;
+}
+
+static int32 ScalarSpanAscii( const char* data, int32 len) {
+	int32 i = 0;
+	while( i<len && !(data[i] & 0x80))
+		i++;
+	return i;
+}
+
+static int32 ScalarSpanValidUtf8( const char* data, int32 len) {
+	const unsigned char* start = reinterpret_cast<const unsigned char*>( data);
+	const unsigned char* s = start;
+	const unsigned char* end = s + len;
+	while( s < end) {
+		unsigned char c = *s;
+		if (c < 0x80) {
+			s++;
+			continue;
+		}
+		int32 seqLen;
+		uint32 minCode;
+		uint32 code;
+		if ((c & 0xE0) == 0xC0) {
+			seqLen = 2;
+			minCode = 0x80;
+			code = c & 0x1F;
+		} else if ((c & 0xF0) == 0xE0) {
+			seqLen = 3;
+			minCode = 0x800;
+			code = c & 0x0F;
+		} else if ((c & 0xF8) == 0xF0) {
+			seqLen = 4;
+			minCode = 0x10000;
+			code = c & 0x07;
+		} else
+			break;
+		if (end - s < seqLen)
+			break;
+		int32 i = 1;
+		for( ; i<seqLen && (s[i] & 0xC0) == 0x80; ++i)
+			code = (code << 6) | (s[i] & 0x3F);
+		if (i < seqLen || code < minCode || code > 0x10FFFF 
+		|| (code >= 0xD800 && code <= 0xDFFF))
+			break;
+		s += seqLen;
+	}
+	return s - start;
+}
+
+/*------------------------------------------------------------------------------*\
+	nBase64Values, nBase64Chars
+		-	the base64 alphabet, in both directions (-1 marks chars that are
+			not part of the alphabet, including the padding char '=')
+\*------------------------------------------------------------------------------*/
+static const int8 nBase64Values[256] = {
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 62, -1, -1, -1, 63,
+	52, 53, 54, 55, 56, 57, 58, 59, 60, 61, -1, -1, -1, -1, -1, -1,
+	-1,  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14,
+	15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, -1, -1, -1, -1, -1,
+	-1, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
+	41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
+};
+
+static const char nBase64Chars[65]
+	= "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static int32 ScalarDecodeBase64( const unsigned char* src, int32 srcLen,
+											char* dest, int32 destLen, int32& srcUsed) {
+	int32 i = 0;
+	int32 o = 0;
+	for( ; i + 4 <= srcLen && o + 3 <= destLen; i += 4, o += 3) {
+		int32 a = nBase64Values[src[i]];
+		int32 b = nBase64Values[src[i+1]];
+		int32 c = nBase64Values[src[i+2]];
+		int32 d = nBase64Values[src[i+3]];
+		if ((a | b | c | d) < 0)
+			break;
+		uint32 group = (a << 18) | (b << 12) | (c << 6) | d;
+		dest[o] = char(group >> 16);
+		dest[o+1] = char(group >> 8);
+		dest[o+2] = char(group);
+	}
+	srcUsed = i;
+	return o;
+}
+
+static int32 ScalarEncodeBase64( const unsigned char* src, int32 srcLen,
+											char* dest, int32 destLen, int32& srcUsed) {
+	int32 i = 0;
+	int32 o = 0;
+	for( ; i + 3 <= srcLen && o + 4 <= destLen; i += 3, o += 4) {
+		uint32 group = (src[i] << 16) | (src[i+1] << 8) | src[i+2];
+		dest[o] = nBase64Chars[group >> 18];
+		dest[o+1] = nBase64Chars[(group >> 12) & 63];
+		dest[o+2] = nBase64Chars[(group >> 6) & 63];
+		dest[o+3] = nBase64Chars[group & 63];
+	}
+	srcUsed = i;
+	return o;
+}
+
+#ifdef BM_HAVE_X86_KERNELS
+
+/*------------------------------------------------------------------------------*\
+	SSE2...()
+		-	the vectorized kernels, each works on 16 bytes at once and leaves
+			the remaining bytes to the scalar kernel
+\*------------------------------------------------------------------------------*/
+__attribute__((target("sse2")))
+static const char* SSE2FindEitherByte( const char* data, int32 len,
+													char c1, char c2) {
+	const __m128i v1 = _mm_set1_epi8( c1);
+	const __m128i v2 = _mm_set1_epi8( c2);
+	int32 i = 0;
+	for( ; i + 16 <= len; i += 16) {
+		const __m128i block = _mm_loadu_si128( (const __m128i*)(data + i));
+		uint32 mask = _mm_movemask_epi8(
+			_mm_or_si128( _mm_cmpeq_epi8( block, v1), _mm_cmpeq_epi8( block, v2))
+		);
+		if (mask)
+			return data + i + __builtin_ctz( mask);
+	}
+	return ScalarFindEitherByte( data + i, len - i, c1, c2);
+}
+
+__attribute__((target("sse2")))
+static int32 SSE2CountByte( const char* data, int32 len, char c) {
+	const __m128i v = _mm_set1_epi8( c);
+	int32 count = 0;
+	int32 i = 0;
+	for( ; i + 16 <= len; i += 16) {
+		const __m128i block = _mm_loadu_si128( (const __m128i*)(data + i));
+		count += __builtin_popcount(
+			_mm_movemask_epi8( _mm_cmpeq_epi8( block, v))
+		);
+	}
+	return count + ScalarCountByte( data + i, len - i, c);
+}
+
+__attribute__((target("sse2")))
+static int32 SSE2ReplaceByte( char* data, int32 len, char replaceThis,
+										char withThis) {
+	const __m128i from = _mm_set1_epi8( replaceThis);
+	const __m128i to = _mm_set1_epi8( withThis);
+	int32 count = 0;
+	int32 i = 0;
+	for( ; i + 16 <= len; i += 16) {
+		const __m128i block = _mm_loadu_si128( (const __m128i*)(data + i));
+		const __m128i eq = _mm_cmpeq_epi8( block, from);
+		uint32 mask = _mm_movemask_epi8( eq);
+		if (!mask)
+			continue;
+							// untouched blocks are not written back
+		_mm_storeu_si128( (__m128i*)(data + i),
+								_mm_or_si128( _mm_andnot_si128( eq, block),
+												  _mm_and_si128( eq, to)));
+		count += __builtin_popcount( mask);
+	}
+	return count + ScalarReplaceByte( data + i, len - i, replaceThis, withThis);
+}
+
+__attribute__((target("sse2")))
+static void SSE2CountLinebreaks( const char* data, int32 len,
+											int32& bareLFs, int32& crlfs) {
+	const __m128i cr = _mm_set1_epi8( '\r');
+	const __m128i lf = _mm_set1_epi8( '\n');
+	uint32 prevCR = 0;
+	int32 i = 0;
+	for( ; i + 16 <= len; i += 16) {
+		const __m128i block = _mm_loadu_si128( (const __m128i*)(data + i));
+		uint32 crMask = _mm_movemask_epi8( _mm_cmpeq_epi8( block, cr));
+		uint32 lfMask = _mm_movemask_epi8( _mm_cmpeq_epi8( block, lf));
+		if (lfMask) {
+			// a LF is part of a CRLF if the byte before it is a CR:
+			uint32 afterCR = (crMask << 1) | prevCR;
+			crlfs += __builtin_popcount( lfMask & afterCR);
+			bareLFs += __builtin_popcount( lfMask & ~afterCR);
+		}
+		prevCR = crMask >> 15;
+	}
+	ScalarCountLinebreaks( data + i, len - i, prevCR != 0, bareLFs, crlfs);
+}
+
+/*------------------------------------------------------------------------------*\
+	SSE2FindAnyByte(), SSE2SpanPrintable()
+		-	compare every block against each char of the given set (the sets
+			used by the quoted-printable filters are small)
+\*------------------------------------------------------------------------------*/
+__attribute__((target("sse2")))
+static const char* SSE2FindAnyByte( const char* data, int32 len,
+												const char* chars) {
+	__m128i needles[nMaxVectorSetSize];
+	int32 count = 0;
+	for( ; chars[count]; ++count)
+		needles[count] = _mm_set1_epi8( chars[count]);
+	int32 i = 0;
+	for( ; i + 16 <= len; i += 16) {
+		const __m128i block = _mm_loadu_si128( (const __m128i*)(data + i));
+		__m128i eq = _mm_setzero_si128();
+		for( int32 n=0; n<count; ++n)
+			eq = _mm_or_si128( eq, _mm_cmpeq_epi8( block, needles[n]));
+		uint32 mask = _mm_movemask_epi8( eq);
+		if (mask)
+			return data + i + __builtin_ctz( mask);
+	}
+	return ScalarFindAnyByte( data + i, len - i, chars);
+}
+
+__attribute__((target("sse2")))
+static int32 SSE2SpanPrintable( const char* data, int32 len,
+										  const char* except) {
+	__m128i excluded[nMaxVectorSetSize];
+	int32 count = 0;
+	for( ; except[count]; ++count)
+		excluded[count] = _mm_set1_epi8( except[count]);
+	// bytes >= 0x80 are negative, so a signed compare catches them, too:
+	const __m128i lo = _mm_set1_epi8( ' ');
+	const __m128i del = _mm_set1_epi8( 0x7F);
+	int32 i = 0;
+	for( ; i + 16 <= len; i += 16) {
+		const __m128i block = _mm_loadu_si128( (const __m128i*)(data + i));
+		__m128i bad = _mm_or_si128( _mm_cmpgt_epi8( lo, block),
+											 _mm_cmpeq_epi8( block, del));
+		for( int32 n=0; n<count; ++n)
+			bad = _mm_or_si128( bad, _mm_cmpeq_epi8( block, excluded[n]));
+		uint32 mask = _mm_movemask_epi8( bad);
+		if (mask)
+			return i + __builtin_ctz( mask);
+	}
+	return i + ScalarSpanPrintable( data + i, len - i, except);
+}
+
+/*------------------------------------------------------------------------------*\
+	SSE2SpanAscii(), SSSE3SpanValidUtf8()
+		-	the UTF-8 validation works on 16 bytes at once, by looking up the 
+			possible errors for each pair of adjacent bytes (indexed by their 
+			nibbles) and checking that the 2nd to 4th bytes of every multibyte 
+			char are continuation bytes (and vice versa)
+		-	as soon as a block contains an error, the scalar kernel takes over
+			from the start of the last char before that block in order to
+			find the exact position
+\*------------------------------------------------------------------------------*/
+__attribute__((target("sse2")))
+static int32 SSE2SpanAscii( const char* data, int32 len) {
+	int32 i = 0;
+	for( ; i + 16 <= len; i += 16) {
+		uint32 mask 
+			= _mm_movemask_epi8( _mm_loadu_si128( (const __m128i*)(data + i)));
+		if (mask)
+			return i + __builtin_ctz( mask);
+	}
+	return i + ScalarSpanAscii( data + i, len - i);
+}
+
+enum {
+	UTF8_TOO_SHORT = 1<<0,
+							// lead byte or ASCII followed by lead byte or ASCII
+	UTF8_TOO_LONG = 1<<1,
+							// ASCII followed by continuation
+	UTF8_OVERLONG_3 = 1<<2,
+	UTF8_TOO_LARGE = 1<<3,
+	UTF8_SURROGATE = 1<<4,
+	UTF8_OVERLONG_2 = 1<<5,
+	UTF8_TOO_LARGE_1000 = 1<<6,
+	UTF8_OVERLONG_4 = 1<<6,
+	UTF8_TWO_CONTS = 1<<7,
+							// continuation followed by continuation
+	UTF8_CARRY = UTF8_TOO_SHORT | UTF8_TOO_LONG | UTF8_TWO_CONTS
+};
+
+__attribute__((target("ssse3")))
+static int32 SSSE3SpanValidUtf8( const char* data, int32 len) {
+	const __m128i byte1HighTable = _mm_setr_epi8(
+		// 0___: ASCII
+		UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+		UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+		// 10__: continuation
+		UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS,
+		// 1100, 1101: lead of two
+		UTF8_TOO_SHORT | UTF8_OVERLONG_2,
+		UTF8_TOO_SHORT,
+		// 1110: lead of three
+		UTF8_TOO_SHORT | UTF8_OVERLONG_3 | UTF8_SURROGATE,
+		// 1111: lead of four (or more)
+		UTF8_TOO_SHORT | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4
+	);
+	const __m128i byte1LowTable = _mm_setr_epi8(
+		UTF8_CARRY | UTF8_OVERLONG_3 | UTF8_OVERLONG_2 | UTF8_OVERLONG_4,
+		UTF8_CARRY | UTF8_OVERLONG_2,
+		UTF8_CARRY,
+		UTF8_CARRY,
+		UTF8_CARRY | UTF8_TOO_LARGE,
+		UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+		UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+		UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+		UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+		UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+		UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+		UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+		UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+		UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_SURROGATE,
+		UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+		UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000
+	);
+	const __m128i byte2HighTable = _mm_setr_epi8(
+		// 0___: ASCII
+		UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+		UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+		// 1000, 1001, 101_: continuation
+		UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3 
+			| UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4,
+		UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3 
+			| UTF8_TOO_LARGE,
+		UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_SURROGATE 
+			| UTF8_TOO_LARGE,
+		UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_SURROGATE 
+			| UTF8_TOO_LARGE,
+		// 11__: lead
+		UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT
+	);
+	const __m128i nibbleMask = _mm_set1_epi8( 0x0F);
+	// a block ends with an incomplete char if any of its last three bytes
+	// is a lead byte whose char does not fit into the block:
+	const __m128i incompleteMax = _mm_setr_epi8( -1, -1, -1, -1, -1, -1, -1, -1,
+																-1, -1, -1, -1, -1, 
+																(char)0xEF, (char)0xDF, (char)0xBF);
+	__m128i prev = _mm_setzero_si128();
+	bool prevIncomplete = false;
+	int32 i = 0;
+	for( ; i + 16 <= len; i += 16) {
+		const __m128i block = _mm_loadu_si128( (const __m128i*)(data + i));
+		if (!_mm_movemask_epi8( block)) {
+			// pure ASCII:
+			if (prevIncomplete)
+				break;
+			prev = block;
+			continue;
+		}
+		const __m128i prev1 = _mm_alignr_epi8( block, prev, 15);
+		const __m128i byte1High 
+			= _mm_shuffle_epi8( byte1HighTable, 
+									  _mm_and_si128( _mm_srli_epi16( prev1, 4), 
+									  					  nibbleMask));
+		const __m128i byte1Low 
+			= _mm_shuffle_epi8( byte1LowTable, _mm_and_si128( prev1, nibbleMask));
+		const __m128i byte2High 
+			= _mm_shuffle_epi8( byte2HighTable, 
+									  _mm_and_si128( _mm_srli_epi16( block, 4), 
+									  					  nibbleMask));
+		const __m128i special 
+			= _mm_and_si128( _mm_and_si128( byte1High, byte1Low), byte2High);
+		// the 3rd and 4th byte of a char must be continuation bytes (which
+		// are the only ones flagged with UTF8_TWO_CONTS above):
+		const __m128i prev2 = _mm_alignr_epi8( block, prev, 14);
+		const __m128i prev3 = _mm_alignr_epi8( block, prev, 13);
+		const __m128i must23 
+			= _mm_and_si128( _mm_or_si128( _mm_subs_epu8( prev2, 
+																		 _mm_set1_epi8( 0xE0-0x80)),
+													 _mm_subs_epu8( prev3, 
+													 					 _mm_set1_epi8( 0xF0-0x80))),
+								  _mm_set1_epi8( (char)0x80));
+		const __m128i error = _mm_xor_si128( must23, special);
+		if (_mm_movemask_epi8( _mm_cmpeq_epi8( error, _mm_setzero_si128()))
+				!= 0xFFFF)
+			break;
+		prevIncomplete 
+			= _mm_movemask_epi8( _mm_cmpeq_epi8( _mm_subs_epu8( block, 
+																				  incompleteMax),
+															 _mm_setzero_si128())) != 0xFFFF;
+		prev = block;
+	}
+	// the char crossing into the current block has not been checked yet,
+	// so we start from its lead byte:
+	int32 start = i;
+	for( int32 j = i-1; j >= 0 && j >= i-3; --j) {
+		if ((data[j] & 0xC0) == 0xC0)
+			start = j;
+		if ((data[j] & 0xC0) != 0x80)
+			break;
+	}
+	return start + ScalarSpanValidUtf8( data + start, len - start);
+}
+
+/*------------------------------------------------------------------------------*\
+	HaveSSSE3()
+		-	the base64 kernels need pshufb, which SSE2 does not provide, so
+			they additionally check for SSSE3 (every AVX2-cpu has it)
+\*------------------------------------------------------------------------------*/
+static bool HaveSSSE3() {
+	static int32 nHaveSSSE3 = -1;
+	if (nHaveSSSE3 < 0) {
+		__builtin_cpu_init();
+		nHaveSSSE3 = __builtin_cpu_supports( "ssse3") ? 1 : 0;
+	}
+	return nHaveSSSE3 > 0;
+}
+
+/*------------------------------------------------------------------------------*\
+	SSSE3...Base64(), AVX2...Base64()
+		-	decode 16 (32) chars into 12 (24) bytes at once, as long as all the
+			chars are part of the alphabet (which is the case for everything
+			but the linebreak and the padding of a clean base64-line)
+		-	encode 12 (24) bytes into 16 (32) chars at once
+		-	the remaining groups are left to the scalar kernels, which stop
+			at the first char outside of the alphabet
+\*------------------------------------------------------------------------------*/
+__attribute__((target("ssse3")))
+static inline bool SSSE3Base64Values( __m128i block, __m128i& values) {
+	const __m128i upper 
+		= _mm_and_si128( _mm_cmpgt_epi8( block, _mm_set1_epi8( 'A'-1)),
+							  _mm_cmplt_epi8( block, _mm_set1_epi8( 'Z'+1)));
+	const __m128i lower
+		= _mm_and_si128( _mm_cmpgt_epi8( block, _mm_set1_epi8( 'a'-1)),
+							  _mm_cmplt_epi8( block, _mm_set1_epi8( 'z'+1)));
+	const __m128i digit
+		= _mm_and_si128( _mm_cmpgt_epi8( block, _mm_set1_epi8( '0'-1)),
+							  _mm_cmplt_epi8( block, _mm_set1_epi8( '9'+1)));
+	const __m128i plus = _mm_cmpeq_epi8( block, _mm_set1_epi8( '+'));
+	const __m128i slash = _mm_cmpeq_epi8( block, _mm_set1_epi8( '/'));
+	const __m128i valid = _mm_or_si128( _mm_or_si128( upper, lower),
+						 						  _mm_or_si128( digit,
+						 						  					 _mm_or_si128( plus, slash)));
+	if (_mm_movemask_epi8( valid) != 0xFFFF)
+		return false;
+	const __m128i shift = _mm_or_si128(
+		_mm_or_si128( _mm_and_si128( upper, _mm_set1_epi8( -'A')),
+						  _mm_and_si128( lower, _mm_set1_epi8( 26-'a'))),
+		_mm_or_si128( _mm_and_si128( digit, _mm_set1_epi8( 52-'0')),
+						  _mm_or_si128( _mm_and_si128( plus, _mm_set1_epi8( 62-'+')),
+											 _mm_and_si128( slash, _mm_set1_epi8( 63-'/'))))
+	);
+	values = _mm_add_epi8( block, shift);
+	return true;
+}
+
+__attribute__((target("ssse3")))
+static inline __m128i SSSE3Base64Chars( __m128i indices) {
+	// 'A' + index, with corrections for the lower-case letters, the
+	// digits, '+' and '/':
+	__m128i shift = _mm_set1_epi8( 'A');
+	shift = _mm_add_epi8( shift, 
+								 _mm_and_si128( _mm_cmpgt_epi8( indices, 
+								 										  _mm_set1_epi8( 25)),
+								 					 _mm_set1_epi8( 'a'-26-'A')));
+	shift = _mm_add_epi8( shift, 
+								 _mm_and_si128( _mm_cmpgt_epi8( indices, 
+								 										  _mm_set1_epi8( 51)),
+								 					 _mm_set1_epi8( '0'-52-'a'+26)));
+	shift = _mm_add_epi8( shift, 
+								 _mm_and_si128( _mm_cmpgt_epi8( indices, 
+								 										  _mm_set1_epi8( 61)),
+								 					 _mm_set1_epi8( '+'-62-'0'+52)));
+	shift = _mm_add_epi8( shift, 
+								 _mm_and_si128( _mm_cmpgt_epi8( indices, 
+								 										  _mm_set1_epi8( 62)),
+								 					 _mm_set1_epi8( '/'-63-'+'+62)));
+	return _mm_add_epi8( indices, shift);
+}
+
+__attribute__((target("ssse3")))
+static int32 SSSE3DecodeBase64( const unsigned char* src, int32 srcLen,
+										  char* dest, int32 destLen, int32& srcUsed) {
+	int32 i = 0;
+	int32 o = 0;
+	for( ; i + 16 <= srcLen && o + 16 <= destLen; i += 16, o += 12) {
+							// the store writes 16 bytes (of which 12 are used)
+		__m128i values;
+		if (!SSSE3Base64Values( _mm_loadu_si128( (const __m128i*)(src + i)),
+										values))
+			break;
+		// merge the four 6-bit values of each group into 24 bits...
+		values = _mm_maddubs_epi16( values, _mm_set1_epi32( 0x01400140));
+		values = _mm_madd_epi16( values, _mm_set1_epi32( 0x00011000));
+		// ...and pack these (big-endian) into 12 bytes:
+		values = _mm_shuffle_epi8( values, 
+											_mm_setr_epi8( 2, 1, 0, 6, 5, 4, 10, 9, 8, 
+																14, 13, 12, -1, -1, -1, -1));
+		_mm_storeu_si128( (__m128i*)(dest + o), values);
+	}
+	int32 used;
+	o += ScalarDecodeBase64( src + i, srcLen - i, dest + o, destLen - o, used);
+	srcUsed = i + used;
+	return o;
+}
+
+__attribute__((target("ssse3")))
+static int32 SSSE3EncodeBase64( const unsigned char* src, int32 srcLen,
+										  char* dest, int32 destLen, int32& srcUsed) {
+	int32 i = 0;
+	int32 o = 0;
+	for( ; i + 16 <= srcLen && o + 16 <= destLen; i += 12, o += 16) {
+							// the load reads 16 bytes (of which 12 are used)
+		__m128i block = _mm_loadu_si128( (const __m128i*)(src + i));
+		// spread every 3-byte group over 32 bits...
+		block = _mm_shuffle_epi8( block, 
+										  _mm_setr_epi8( 1, 0, 2, 1, 4, 3, 5, 4, 
+															  7, 6, 8, 7, 10, 9, 11, 10));
+		// ...and move each 6-bit index into a byte of its own:
+		const __m128i hi 
+			= _mm_mulhi_epu16( _mm_and_si128( block, _mm_set1_epi32( 0x0FC0FC00)),
+									 _mm_set1_epi32( 0x04000040));
+		const __m128i lo
+			= _mm_mullo_epi16( _mm_and_si128( block, _mm_set1_epi32( 0x003F03F0)),
+									 _mm_set1_epi32( 0x01000010));
+		_mm_storeu_si128( (__m128i*)(dest + o), 
+								SSSE3Base64Chars( _mm_or_si128( hi, lo)));
+	}
+	int32 used;
+	o += ScalarEncodeBase64( src + i, srcLen - i, dest + o, destLen - o, used);
+	srcUsed = i + used;
+	return o;
+}
+
+__attribute__((target("avx2")))
+static inline bool AVX2Base64Values( __m256i block, __m256i& values) {
+	const __m256i upper 
+		= _mm256_and_si256( _mm256_cmpgt_epi8( block, _mm256_set1_epi8( 'A'-1)),
+								  _mm256_cmpgt_epi8( _mm256_set1_epi8( 'Z'+1), block));
+	const __m256i lower
+		= _mm256_and_si256( _mm256_cmpgt_epi8( block, _mm256_set1_epi8( 'a'-1)),
+								  _mm256_cmpgt_epi8( _mm256_set1_epi8( 'z'+1), block));
+	const __m256i digit
+		= _mm256_and_si256( _mm256_cmpgt_epi8( block, _mm256_set1_epi8( '0'-1)),
+								  _mm256_cmpgt_epi8( _mm256_set1_epi8( '9'+1), block));
+	const __m256i plus = _mm256_cmpeq_epi8( block, _mm256_set1_epi8( '+'));
+	const __m256i slash = _mm256_cmpeq_epi8( block, _mm256_set1_epi8( '/'));
+	const __m256i valid 
+		= _mm256_or_si256( _mm256_or_si256( upper, lower),
+								 _mm256_or_si256( digit, _mm256_or_si256( plus, slash)));
+	if (uint32( _mm256_movemask_epi8( valid)) != 0xFFFFFFFFUL)
+		return false;
+	const __m256i shift = _mm256_or_si256(
+		_mm256_or_si256( _mm256_and_si256( upper, _mm256_set1_epi8( -'A')),
+							  _mm256_and_si256( lower, _mm256_set1_epi8( 26-'a'))),
+		_mm256_or_si256( 
+			_mm256_and_si256( digit, _mm256_set1_epi8( 52-'0')),
+			_mm256_or_si256( _mm256_and_si256( plus, _mm256_set1_epi8( 62-'+')),
+								  _mm256_and_si256( slash, _mm256_set1_epi8( 63-'/'))))
+	);
+	values = _mm256_add_epi8( block, shift);
+	return true;
+}
+
+__attribute__((target("avx2")))
+static inline __m256i AVX2Base64Chars( __m256i indices) {
+	__m256i shift = _mm256_set1_epi8( 'A');
+	shift = _mm256_add_epi8( shift, 
+									 _mm256_and_si256( 
+									 	_mm256_cmpgt_epi8( indices, _mm256_set1_epi8( 25)),
+									 	_mm256_set1_epi8( 'a'-26-'A')));
+	shift = _mm256_add_epi8( shift, 
+									 _mm256_and_si256( 
+									 	_mm256_cmpgt_epi8( indices, _mm256_set1_epi8( 51)),
+									 	_mm256_set1_epi8( '0'-52-'a'+26)));
+	shift = _mm256_add_epi8( shift, 
+									 _mm256_and_si256( 
+									 	_mm256_cmpgt_epi8( indices, _mm256_set1_epi8( 61)),
+									 	_mm256_set1_epi8( '+'-62-'0'+52)));
+	shift = _mm256_add_epi8( shift, 
+									 _mm256_and_si256( 
+									 	_mm256_cmpgt_epi8( indices, _mm256_set1_epi8( 62)),
+									 	_mm256_set1_epi8( '/'-63-'+'+62)));
+	return _mm256_add_epi8( indices, shift);
+}
+
+__attribute__((target("avx2")))
+static int32 AVX2DecodeBase64( const unsigned char* src, int32 srcLen,
+										 char* dest, int32 destLen, int32& srcUsed) {
+	int32 i = 0;
+	int32 o = 0;
+	for( ; i + 32 <= srcLen && o + 28 <= destLen; i += 32, o += 24) {
+							// the second store writes 16 bytes at offset 12
+		__m256i values;
+		if (!AVX2Base64Values( _mm256_loadu_si256( (const __m256i*)(src + i)),
+									  values))
+			break;
+		// pshufb works per 128-bit lane, so each lane yields 12 bytes:
+		values = _mm256_maddubs_epi16( values, _mm256_set1_epi32( 0x01400140));
+		values = _mm256_madd_epi16( values, _mm256_set1_epi32( 0x00011000));
+		values = _mm256_shuffle_epi8( values, 
+												_mm256_setr_epi8( 2, 1, 0, 6, 5, 4, 10, 9, 8, 
+																		14, 13, 12, -1, -1, -1, -1,
+																		2, 1, 0, 6, 5, 4, 10, 9, 8, 
+																		14, 13, 12, -1, -1, -1, -1));
+		_mm_storeu_si128( (__m128i*)(dest + o), _mm256_castsi256_si128( values));
+		_mm_storeu_si128( (__m128i*)(dest + o + 12), 
+								_mm256_extracti128_si256( values, 1));
+	}
+	int32 used;
+	o += ScalarDecodeBase64( src + i, srcLen - i, dest + o, destLen - o, used);
+	srcUsed = i + used;
+	return o;
+}
+
+__attribute__((target("avx2")))
+static int32 AVX2EncodeBase64( const unsigned char* src, int32 srcLen,
+										 char* dest, int32 destLen, int32& srcUsed) {
+	int32 i = 0;
+	int32 o = 0;
+	for( ; i + 28 <= srcLen && o + 32 <= destLen; i += 24, o += 32) {
+							// the second load reads 16 bytes at offset 12
+		__m256i block = _mm256_inserti128_si256(
+			_mm256_castsi128_si256( _mm_loadu_si128( (const __m128i*)(src + i))),
+			_mm_loadu_si128( (const __m128i*)(src + i + 12)), 1
+		);
+		block = _mm256_shuffle_epi8( block, 
+											  _mm256_setr_epi8( 1, 0, 2, 1, 4, 3, 5, 4, 
+											  						  7, 6, 8, 7, 10, 9, 11, 10,
+											  						  1, 0, 2, 1, 4, 3, 5, 4, 
+											  						  7, 6, 8, 7, 10, 9, 11, 10));
+		const __m256i hi 
+			= _mm256_mulhi_epu16( 
+				_mm256_and_si256( block, _mm256_set1_epi32( 0x0FC0FC00)),
+				_mm256_set1_epi32( 0x04000040));
+		const __m256i lo
+			= _mm256_mullo_epi16( 
+				_mm256_and_si256( block, _mm256_set1_epi32( 0x003F03F0)),
+				_mm256_set1_epi32( 0x01000010));
+		_mm256_storeu_si256( (__m256i*)(dest + o), 
+									AVX2Base64Chars( _mm256_or_si256( hi, lo)));
+	}
+	int32 used;
+	o += ScalarEncodeBase64( src + i, srcLen - i, dest + o, destLen - o, used);
+	srcUsed = i + used;
+	return o;
+}
+
+#endif	// BM_HAVE_X86_KERNELS
+
+/*------------------------------------------------------------------------------*\
+	FindByte( data, len, c)
+		-	returns pointer to first occurrence of c in data (or NULL)
+\*------------------------------------------------------------------------------*/
+const char* FindByte( const char* data, int32 len, char c) {
+	if (len <= 0)
+		return NULL;
+	return static_cast<const char*>( memchr( data, c, len));
+}
+
+/*------------------------------------------------------------------------------*\
+	FindEitherByte( data, len, c1, c2)
+		-	returns pointer to first occurrence of c1 or c2 in data (or NULL)
+\*------------------------------------------------------------------------------*/
+const char* FindEitherByte( const char* data, int32 len, char c1, char c2) {
+	if (len <= 0)
+		return NULL;
+#ifdef BM_HAVE_X86_KERNELS
+	if (UseVectorKernels())
+		return SSE2FindEitherByte( data, len, c1, c2);
+#endif
+	return ScalarFindEitherByte( data, len, c1, c2);
+}
+
+/*------------------------------------------------------------------------------*\
+	CountByte( data, len, c)
+		-	returns the number of occurrences of c in data
+\*------------------------------------------------------------------------------*/
+int32 CountByte( const char* data, int32 len, char c) {
+	if (len <= 0)
+		return 0;
+#ifdef BM_HAVE_X86_KERNELS
+	if (UseVectorKernels())
+		return SSE2CountByte( data, len, c);
+#endif
+	return ScalarCountByte( data, len, c);
+}
+
+/*------------------------------------------------------------------------------*\
+	ReplaceByte( data, len, replaceThis, withThis)
+		-	replaces every occurrence of replaceThis with withThis (in place)
+		-	returns the number of replaced bytes
+\*------------------------------------------------------------------------------*/
+int32 ReplaceByte( char* data, int32 len, char replaceThis, char withThis) {
+	if (len <= 0 || replaceThis == withThis)
+		return 0;
+#ifdef BM_HAVE_X86_KERNELS
+	if (UseVectorKernels())
+		return SSE2ReplaceByte( data, len, replaceThis, withThis);
+#endif
+	return ScalarReplaceByte( data, len, replaceThis, withThis);
+}
+
+/*------------------------------------------------------------------------------*\
+	FindAnyByte( data, len, chars)
+		-	returns pointer to first occurrence of any of the given chars in
+			data (or NULL)
+\*------------------------------------------------------------------------------*/
+const char* FindAnyByte( const char* data, int32 len, const char* chars) {
+	if (len <= 0)
+		return NULL;
+#ifdef BM_HAVE_X86_KERNELS
+	if (UseVectorKernels() && strlen( chars) <= nMaxVectorSetSize)
+		return SSE2FindAnyByte( data, len, chars);
+#endif
+	return ScalarFindAnyByte( data, len, chars);
+}
+
+/*------------------------------------------------------------------------------*\
+	SpanPrintable( data, len, except)
+		-	returns the length of the initial run of printable ASCII-chars
+			(including the space) in data that are not contained in except
+\*------------------------------------------------------------------------------*/
+int32 SpanPrintable( const char* data, int32 len, const char* except) {
+	if (len <= 0)
+		return 0;
+#ifdef BM_HAVE_X86_KERNELS
+	if (UseVectorKernels() && strlen( except) <= nMaxVectorSetSize)
+		return SSE2SpanPrintable( data, len, except);
+#endif
+	return ScalarSpanPrintable( data, len, except);
+}
+
+/*------------------------------------------------------------------------------*\
+	SpanAscii( data, len)
+		-	returns the length of the initial run of ASCII-chars in data
+\*------------------------------------------------------------------------------*/
+int32 SpanAscii( const char* data, int32 len) {
+	if (len <= 0)
+		return 0;
+#ifdef BM_HAVE_X86_KERNELS
+	if (UseVectorKernels())
+		return SSE2SpanAscii( data, len);
+#endif
+	return ScalarSpanAscii( data, len);
+}
+
+/*------------------------------------------------------------------------------*\
+	SpanValidUtf8( data, len)
+		-	returns the length of the initial part of data that consists of 
+			complete and valid UTF-8 chars only (such that converting it from
+			UTF-8 to UTF-8 would not change it)
+\*------------------------------------------------------------------------------*/
+int32 SpanValidUtf8( const char* data, int32 len) {
+	if (len <= 0)
+		return 0;
+#ifdef BM_HAVE_X86_KERNELS
+	if (UseVectorKernels() && HaveSSSE3())
+		return SSSE3SpanValidUtf8( data, len);
+#endif
+	return ScalarSpanValidUtf8( data, len);
+}
+
+/*------------------------------------------------------------------------------*\
+	CountLinebreaks( data, len, bareLFs, crlfs)
+		-	counts the LFs (not preceeded by CR) and the CRLFs in data,
+			such that linebreak conversions can size their output exactly
+\*------------------------------------------------------------------------------*/
+void CountLinebreaks( const char* data, int32 len, int32& bareLFs,
+							 int32& crlfs) {
+	bareLFs = crlfs = 0;
+	if (len <= 0)
+		return;
+#ifdef BM_HAVE_X86_KERNELS
+	if (UseVectorKernels()) {
+		SSE2CountLinebreaks( data, len, bareLFs, crlfs);
+		return;
+	}
+#endif
+	ScalarCountLinebreaks( data, len, false, bareLFs, crlfs);
+}
+
+/*------------------------------------------------------------------------------*\
+	ConvertLFToCRLF( src, len, dest)
+		-	copies src to dest, expanding every bare LF into a CRLF
+		-	the segments between linebreaks are copied en bloc
+\*------------------------------------------------------------------------------*/
+int32 ConvertLFToCRLF( const char* src, int32 len, char* dest) {
+	const char* end = src + len;
+	char* out = dest;
+	const char* seg = src;
+	const char* lf;
+	while( (lf = FindByte( seg, end - seg, '\n')) != NULL) {
+		int32 segLen = lf - seg;
+		memcpy( out, seg, segLen);
+		out += segLen;
+		if (lf == src || lf[-1] != '\r')
+			*out++ = '\r';
+		*out++ = '\n';
+		seg = lf + 1;
+	}
+	memcpy( out, seg, end - seg);
+	out += end - seg;
+	return out - dest;
+}
+
+/*------------------------------------------------------------------------------*\
+	ConvertCRLFToLF( src, len, dest)
+		-	copies src to dest, contracting every CRLF into a LF
+		-	since dest never gets ahead of src, the conversion may happen
+			in place
+\*------------------------------------------------------------------------------*/
+int32 ConvertCRLFToLF( const char* src, int32 len, char* dest) {
+	const char* end = src + len;
+	char* out = dest;
+	const char* seg = src;
+	const char* lf;
+	for( const char* pos = src;
+		  (lf = FindByte( pos, end - pos, '\n')) != NULL; pos = lf + 1) {
+		if (lf == src || lf[-1] != '\r')
+			continue;
+		int32 segLen = lf - 1 - seg;
+		if (out != seg)
+			memmove( out, seg, segLen);
+		out += segLen;
+		seg = lf;
+							// the LF starts the next segment
+	}
+	if (out != seg)
+		memmove( out, seg, end - seg);
+	out += end - seg;
+	return out - dest;
+}
+
+/*------------------------------------------------------------------------------*\
+	DecodeBase64( src, srcLen, dest, destLen, srcUsed)
+		-	decodes complete groups of four base64-chars, up to the first
+			char that is not part of the alphabet (whitespace, linebreak,
+			padding or garbage), which is left to the caller
+		-	returns the number of bytes written, srcUsed is set to the number
+			of chars consumed (always a multiple of 4)
+\*------------------------------------------------------------------------------*/
+int32 DecodeBase64( const char* src, int32 srcLen, char* dest, int32 destLen,
+						  int32& srcUsed) {
+	srcUsed = 0;
+	if (srcLen < 4 || destLen < 3)
+		return 0;
+	const unsigned char* usrc = reinterpret_cast<const unsigned char*>( src);
+#ifdef BM_HAVE_X86_KERNELS
+	if (UseVectorKernels() && HaveSSSE3()) {
+		if (BmStringSearch::ActiveKernel() == BmStringSearch::KERNEL_AVX2)
+			return AVX2DecodeBase64( usrc, srcLen, dest, destLen, srcUsed);
+		return SSSE3DecodeBase64( usrc, srcLen, dest, destLen, srcUsed);
+	}
+#endif
+	return ScalarDecodeBase64( usrc, srcLen, dest, destLen, srcUsed);
+}
+
+/*------------------------------------------------------------------------------*\
+	EncodeBase64( src, srcLen, dest, destLen, srcUsed)
+		-	encodes complete groups of three bytes (without any linebreaks,
+			the remaining bytes and the padding are left to the caller)
+		-	returns the number of chars written, srcUsed is set to the number
+			of bytes consumed (always a multiple of 3)
+\*------------------------------------------------------------------------------*/
+int32 EncodeBase64( const char* src, int32 srcLen, char* dest, int32 destLen,
+						  int32& srcUsed) {
+	srcUsed = 0;
+	if (srcLen < 3 || destLen < 4)
+		return 0;
+	const unsigned char* usrc = reinterpret_cast<const unsigned char*>( src);
+#ifdef BM_HAVE_X86_KERNELS
+	if (UseVectorKernels() && HaveSSSE3()) {
+		if (BmStringSearch::ActiveKernel() == BmStringSearch::KERNEL_AVX2)
+			return AVX2EncodeBase64( usrc, srcLen, dest, destLen, srcUsed);
+		return SSSE3EncodeBase64( usrc, srcLen, dest, destLen, srcUsed);
+	}
+#endif
+	return ScalarEncodeBase64( usrc, srcLen, dest, destLen, srcUsed);
+}
+
+}
@@ -0,0 +1,81 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+#ifndef _BmByteKernels_h
+#define _BmByteKernels_h
+
+#include <SupportDefs.h>
+
+#include "BmBase.h"
+
+/*------------------------------------------------------------------------------*\
+	BmByteKernels
+		-	single-byte scanning and transforming kernels (used for linebreak
+			conversion and for scrubbing binary nulls from mail text), plus
+			the base64-kernels doing the bulk work of BmBase64En-/Decoder.
+		-	on x86 (with SSE2 available) these are vectorized, the kernel
+			selection is shared with BmStringSearch.
+\*------------------------------------------------------------------------------*/
+namespace BmByteKernels {
+
+	IMPEXPBMBASE
+	const char* FindByte( const char* data, int32 len, char c);
+							// returns first occurrence of c (or NULL)
+	IMPEXPBMBASE
+	const char* FindEitherByte( const char* data, int32 len, char c1, char c2);
+							// returns first occurrence of c1 or c2 (or NULL)
+	IMPEXPBMBASE
+	int32 CountByte( const char* data, int32 len, char c);
+	IMPEXPBMBASE
+	int32 ReplaceByte( char* data, int32 len, char replaceThis, char withThis);
+							// returns number of replaced bytes
+	IMPEXPBMBASE
+	const char* FindAnyByte( const char* data, int32 len, const char* chars);
+							// returns first occurrence of any of the chars
+							// (or NULL)
+	IMPEXPBMBASE
+	int32 SpanPrintable( const char* data, int32 len, const char* except);
+							// returns length of initial run of printable 
+							// ASCII-chars (and spaces) not contained in except
+	IMPEXPBMBASE
+	int32 SpanAscii( const char* data, int32 len);
+							// returns length of initial run of ASCII-chars
+	IMPEXPBMBASE
+	int32 SpanValidUtf8( const char* data, int32 len);
+							// returns length of initial part consisting of
+							// complete and valid UTF-8 chars
+
+	IMPEXPBMBASE
+	void CountLinebreaks( const char* data, int32 len, int32& bareLFs,
+								 int32& crlfs);
+							// counts LFs that are not preceeded by a CR (a LF
+							// at the very start counts as bare) and CRLFs
+
+	IMPEXPBMBASE
+	int32 ConvertLFToCRLF( const char* src, int32 len, char* dest);
+							// dest must have room for len+bareLFs bytes,
+							// returns number of bytes written
+	IMPEXPBMBASE
+	int32 ConvertCRLFToLF( const char* src, int32 len, char* dest);
+							// dest must have room for len-crlfs bytes, may be
+							// identical to src (in-place conversion),
+							// returns number of bytes written
+
+	IMPEXPBMBASE
+	int32 DecodeBase64( const char* src, int32 srcLen, char* dest,
+							  int32 destLen, int32& srcUsed);
+							// decodes complete 4-char groups up to the first
+							// char outside of the alphabet,
+							// returns number of bytes written
+	IMPEXPBMBASE
+	int32 EncodeBase64( const char* src, int32 srcLen, char* dest,
+							  int32 destLen, int32& srcUsed);
+							// encodes complete 3-byte groups (no linebreaks),
+							// returns number of chars written
+}
+
+#endif
@@ -16,7 +16,12 @@
 
 class BmMail;
 struct IMPEXPBMBASE BmHeaderInfo {
-	BmString fieldName;
+	const char* fieldName;
+							// points to the (capitalized) name of the field
+	uint32 fieldHash;
+							// case-folded hash of the name (see 
+							// BmFieldAtom::FoldedHash()), names only need to be
+							// compared if the hashes match
 	const char** values;
 };
 /*------------------------------------------------------------------------------*\
@@ -0,0 +1,555 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+#include <string.h>
+
+#include "BmBasics.h"
+#include "BmBlockPool.h"
+#include "BmFilterPipeline.h"
+
+/********************************************************************************\
+	BmPipeQueue
+\********************************************************************************/
+
+/*------------------------------------------------------------------------------*\
+	class BmPipeQueue
+		-	a bounded single-producer/single-consumer queue of data blocks
+		-	one semaphore counts the free slots, the other one counts the
+			filled slots, so each side only ever touches its own index.
+		-	the end of data is signalled by a slot marked as last one.
+		-	Close() deletes the semaphores, which wakes up (and stops) any
+			blocked producer or consumer.
+\*------------------------------------------------------------------------------*/
+class BmPipeQueue {
+
+public:
+	BmPipeQueue( uint32 blockSize, int32 depth);
+	~BmPipeQueue();
+
+	status_t InitCheck() const;
+
+	// producer side:
+	char* NextFree();
+	void Commit( uint32 len);
+	void CommitEnd();
+
+	// consumer side:
+	bool NextFull( const char*& data, uint32& len);
+	void Release();
+
+	void Close();
+
+private:
+	struct Slot {
+		char* data;
+		uint32 len;
+		bool isEnd;
+	};
+	bool _AcquireFree();
+
+	Slot* mSlots;
+	int32 mDepth;
+	uint32 mBlockSize;
+	int32 mHead;
+							// next slot to be filled by producer
+	int32 mTail;
+							// next slot to be consumed by consumer
+	bool mProducerHoldsSlot;
+	sem_id mFreeSem;
+	sem_id mFullSem;
+	vint32 mClosed;
+
+	// Hide copy-constructor and assignment:
+	BmPipeQueue( const BmPipeQueue&);
+	BmPipeQueue operator=( const BmPipeQueue&);
+};
+
+/*------------------------------------------------------------------------------*\
+	BmPipeQueue()
+		-	constructor
+\*------------------------------------------------------------------------------*/
+BmPipeQueue::BmPipeQueue( uint32 blockSize, int32 depth)
+	:	mSlots( new Slot [depth])
+	,	mDepth( depth)
+	,	mBlockSize( blockSize)
+	,	mHead( 0)
+	,	mTail( 0)
+	,	mProducerHoldsSlot( false)
+	,	mFreeSem( create_sem( depth, "pipe-queue free"))
+	,	mFullSem( create_sem( 0, "pipe-queue full"))
+	,	mClosed( 0)
+{
+	for( int32 i=0; i<depth; ++i) {
+		mSlots[i].data = BmBlockPool::Allocate( blockSize);
+		mSlots[i].len = 0;
+		mSlots[i].isEnd = false;
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	~BmPipeQueue()
+		-	destructor
+\*------------------------------------------------------------------------------*/
+BmPipeQueue::~BmPipeQueue() {
+	Close();
+	for( int32 i=0; i<mDepth; ++i)
+		BmBlockPool::Free( mSlots[i].data, mBlockSize);
+	delete [] mSlots;
+}
+
+/*------------------------------------------------------------------------------*\
+	InitCheck()
+		-
+\*------------------------------------------------------------------------------*/
+status_t BmPipeQueue::InitCheck() const {
+	if (mFreeSem < 0)
+		return mFreeSem;
+	if (mFullSem < 0)
+		return mFullSem;
+	for( int32 i=0; i<mDepth; ++i) {
+		if (!mSlots[i].data)
+			return B_NO_MEMORY;
+	}
+	return B_OK;
+}
+
+/*------------------------------------------------------------------------------*\
+	_AcquireFree()
+		-	waits until the producer owns a free slot (at mHead)
+		-	returns false if the queue has been closed
+\*------------------------------------------------------------------------------*/
+bool BmPipeQueue::_AcquireFree() {
+	if (mProducerHoldsSlot)
+		return true;
+	status_t err;
+	while( (err = acquire_sem( mFreeSem)) == B_INTERRUPTED)
+		;
+	if (err != B_OK)
+		return false;
+	mProducerHoldsSlot = true;
+	return true;
+}
+
+/*------------------------------------------------------------------------------*\
+	NextFree()
+		-	returns the buffer of the next free slot (blocking until one is
+			available), or NULL if the queue has been closed
+\*------------------------------------------------------------------------------*/
+char* BmPipeQueue::NextFree() {
+	return _AcquireFree() ? mSlots[mHead].data : NULL;
+}
+
+/*------------------------------------------------------------------------------*\
+	Commit( len)
+		-	hands the slot that has been filled with len bytes to the consumer
+\*------------------------------------------------------------------------------*/
+void BmPipeQueue::Commit( uint32 len) {
+	if (!mProducerHoldsSlot)
+		return;
+	mSlots[mHead].len = len;
+	mSlots[mHead].isEnd = false;
+	mHead = (mHead + 1) % mDepth;
+	mProducerHoldsSlot = false;
+	release_sem( mFullSem);
+}
+
+/*------------------------------------------------------------------------------*\
+	CommitEnd()
+		-	tells the consumer that no more data will follow
+\*------------------------------------------------------------------------------*/
+void BmPipeQueue::CommitEnd() {
+	if (!_AcquireFree())
+		return;
+	mSlots[mHead].len = 0;
+	mSlots[mHead].isEnd = true;
+	mHead = (mHead + 1) % mDepth;
+	mProducerHoldsSlot = false;
+	release_sem( mFullSem);
+}
+
+/*------------------------------------------------------------------------------*\
+	NextFull( data, len)
+		-	waits for the next filled slot and returns its data
+		-	returns false if the end of data has been reached (or the queue
+			has been closed)
+\*------------------------------------------------------------------------------*/
+bool BmPipeQueue::NextFull( const char*& data, uint32& len) {
+	status_t err;
+	while( (err = acquire_sem( mFullSem)) == B_INTERRUPTED)
+		;
+	if (err != B_OK)
+		return false;
+	if (mSlots[mTail].isEnd) {
+		// leave the end-marker in place, such that we never wait again:
+		release_sem( mFullSem);
+		return false;
+	}
+	data = mSlots[mTail].data;
+	len = mSlots[mTail].len;
+	return true;
+}
+
+/*------------------------------------------------------------------------------*\
+	Release()
+		-	hands the slot returned by NextFull() back to the producer
+\*------------------------------------------------------------------------------*/
+void BmPipeQueue::Release() {
+	mTail = (mTail + 1) % mDepth;
+	release_sem( mFreeSem);
+}
+
+/*------------------------------------------------------------------------------*\
+	Close()
+		-	wakes up and stops both sides
+\*------------------------------------------------------------------------------*/
+void BmPipeQueue::Close() {
+	if (atomic_add( &mClosed, 1) > 0)
+		return;
+	// the semaphore-IDs stay as they are, both sides will just get 
+	// B_BAD_SEM_ID from now on:
+	delete_sem( mFreeSem);
+	delete_sem( mFullSem);
+}
+
+
+
+/********************************************************************************\
+	BmPipeQueueIBuf
+\********************************************************************************/
+
+/*------------------------------------------------------------------------------*\
+	class BmPipeQueueIBuf
+		-	the consuming end of a BmPipeQueue as a BmMemIBuf, such that the
+			next stage (or the reader of the pipeline) can read from it
+\*------------------------------------------------------------------------------*/
+class BmPipeQueueIBuf : public BmMemIBuf {
+	typedef BmMemIBuf inherited;
+
+public:
+	BmPipeQueueIBuf( BmPipeQueue* queue);
+
+	// overrides of BmMemIBuf:
+	uint32 Read( char* data, uint32 reqLen);
+	bool ReadBlock( const char*& data, uint32& len);
+	bool IsAtEnd();
+
+private:
+	BmPipeQueue* mQueue;
+	const char* mData;
+	uint32 mLen;
+	uint32 mPos;
+	bool mHaveSlot;
+	bool mAtEnd;
+};
+
+/*------------------------------------------------------------------------------*\
+	BmPipeQueueIBuf()
+		-	constructor
+\*------------------------------------------------------------------------------*/
+BmPipeQueueIBuf::BmPipeQueueIBuf( BmPipeQueue* queue)
+	:	mQueue( queue)
+	,	mData( NULL)
+	,	mLen( 0)
+	,	mPos( 0)
+	,	mHaveSlot( false)
+	,	mAtEnd( false)
+{
+}
+
+/*------------------------------------------------------------------------------*\
+	IsAtEnd()
+		-	makes sure that there's a non-empty slot to read from (blocking
+			until the producer delivers one)
+\*------------------------------------------------------------------------------*/
+bool BmPipeQueueIBuf::IsAtEnd() {
+	while( !mHaveSlot || mPos == mLen) {
+		if (mHaveSlot) {
+			mQueue->Release();
+			mHaveSlot = false;
+		}
+		if (mAtEnd)
+			return true;
+		if (mQueue->NextFull( mData, mLen)) {
+			mHaveSlot = true;
+			mPos = 0;
+		} else
+			mAtEnd = true;
+	}
+	return false;
+}
+
+/*------------------------------------------------------------------------------*\
+	Read( data, reqLen)
+		-	copies from the current slot, we only wait for another slot if we
+			haven't got any data yet (just like a network buffer would do)
+\*------------------------------------------------------------------------------*/
+uint32 BmPipeQueueIBuf::Read( char* data, uint32 reqLen) {
+	uint32 readLen = 0;
+	while( readLen < reqLen) {
+		if ((!mHaveSlot || mPos == mLen) && readLen)
+			break;
+		if (IsAtEnd())
+			break;
+		uint32 size = min_c( reqLen - readLen, mLen - mPos);
+		memcpy( data + readLen, mData + mPos, size);
+		mPos += size;
+		readLen += size;
+	}
+	return readLen;
+}
+
+/*------------------------------------------------------------------------------*\
+	ReadBlock( data, len)
+		-	hands out (a part of) the current slot
+\*------------------------------------------------------------------------------*/
+bool BmPipeQueueIBuf::ReadBlock( const char*& data, uint32& len) {
+	if (IsAtEnd()) {
+		len = 0;
+		return true;
+	}
+	len = min_c( len, mLen - mPos);
+	data = mData + mPos;
+	mPos += len;
+	return true;
+}
+
+
+
+/********************************************************************************\
+	BmFilterPipeline
+\********************************************************************************/
+
+/*------------------------------------------------------------------------------*\
+	BmFilterPipeline( blockSize, queueDepth)
+		-	constructor
+		-	blockSize is the size of the blocks passed between the stages,
+			queueDepth is the number of blocks each queue can hold
+\*------------------------------------------------------------------------------*/
+BmFilterPipeline::BmFilterPipeline( uint32 blockSize, int32 queueDepth)
+	:	mBlockSize( blockSize)
+	,	mQueueDepth( max_c( 2, queueDepth))
+	,	mStarted( false)
+	,	mOutput( NULL)
+{
+}
+
+/*------------------------------------------------------------------------------*\
+	~BmFilterPipeline()
+		-	destructor, stops all stage threads
+\*------------------------------------------------------------------------------*/
+BmFilterPipeline::~BmFilterPipeline() {
+	if (mStarted)
+		Stop();
+	for( int32 i=0; i<mStages.CountItems(); ++i)
+		delete static_cast<Stage*>( mStages.ItemAt( i));
+}
+
+/*------------------------------------------------------------------------------*\
+	AddStage( stage)
+		-	appends the given filter to the pipeline (the pipeline does not
+			take ownership of the filter)
+\*------------------------------------------------------------------------------*/
+void BmFilterPipeline::AddStage( BmMemFilter* filter) {
+	if (mStarted || !filter)
+		return;
+	Stage* stage = new Stage;
+	stage->filter = filter;
+	stage->input = NULL;
+	stage->output = NULL;
+	stage->outputReader = NULL;
+	stage->thread = -1;
+	stage->blockSize = mBlockSize;
+	stage->hadNetworkError = false;
+	stage->done = false;
+	mStages.AddItem( stage);
+}
+
+/*------------------------------------------------------------------------------*\
+	Start()
+		-	connects the stages via queues and starts a thread for each one
+\*------------------------------------------------------------------------------*/
+status_t BmFilterPipeline::Start() {
+	if (mStarted)
+		return B_OK;
+	if (mStages.IsEmpty())
+		return B_NO_INIT;
+	mStarted = true;
+	Stage* prevStage = NULL;
+	for( int32 i=0; i<mStages.CountItems(); ++i) {
+		Stage* stage = static_cast<Stage*>( mStages.ItemAt( i));
+		stage->output = new BmPipeQueue( mBlockSize, mQueueDepth);
+		status_t err = stage->output->InitCheck();
+		if (err != B_OK) {
+			_Shutdown();
+			return err;
+		}
+		stage->outputReader = new BmPipeQueueIBuf( stage->output);
+		if (prevStage) {
+			stage->input = stage->filter->Input();
+			stage->filter->SetInput( prevStage->outputReader);
+		}
+		prevStage = stage;
+	}
+	mOutput = prevStage->outputReader;
+	for( int32 i=0; i<mStages.CountItems(); ++i) {
+		Stage* stage = static_cast<Stage*>( mStages.ItemAt( i));
+		stage->thread = spawn_thread( &_StageThread, "filter-pipeline stage",
+												B_NORMAL_PRIORITY, stage);
+		if (stage->thread < 0) {
+			status_t err = stage->thread;
+			_Shutdown();
+			return err;
+		}
+		resume_thread( stage->thread);
+	}
+	return B_OK;
+}
+
+/*------------------------------------------------------------------------------*\
+	_StageThread( data)
+		-	reads from the stage's filter and puts every block it gets into the
+			stage's output queue
+		-	exceptions must not leave the thread, so they are kept in the stage
+			and end the data (the reader throws them again)
+\*------------------------------------------------------------------------------*/
+int32 BmFilterPipeline::_StageThread( void* data) {
+	Stage* stage = static_cast<Stage*>( data);
+	BmMemFilter* filter = stage->filter;
+	BmPipeQueue* queue = stage->output;
+	try {
+		while( !filter->IsAtEnd()) {
+			char* block = queue->NextFree();
+			if (!block) {
+				// queue has been closed
+				stage->done = true;
+				return B_OK;
+			}
+			uint32 len = filter->Read( block, stage->blockSize);
+			if (len)
+				queue->Commit( len);
+		}
+	} catch( BM_network_error& err) {
+		stage->error = err.what();
+		stage->hadNetworkError = true;
+	} catch( BM_error& err) {
+		stage->error = err.what();
+	}
+	stage->done = true;
+	queue->CommitEnd();
+	return B_OK;
+}
+
+/*------------------------------------------------------------------------------*\
+	_Shutdown()
+		-	closes all queues and waits for the stage threads to finish
+		-	every stage is reconnected to its own input before the queue it
+			has been reading from is deleted, such that no filter is left
+			pointing to a deleted buffer
+\*------------------------------------------------------------------------------*/
+void BmFilterPipeline::_Shutdown() {
+	for( int32 i=0; i<mStages.CountItems(); ++i) {
+		Stage* stage = static_cast<Stage*>( mStages.ItemAt( i));
+		if (stage->output)
+			stage->output->Close();
+	}
+	for( int32 i=0; i<mStages.CountItems(); ++i) {
+		Stage* stage = static_cast<Stage*>( mStages.ItemAt( i));
+		if (stage->thread >= 0) {
+			status_t result;
+			wait_for_thread( stage->thread, &result);
+			stage->thread = -1;
+		}
+	}
+	for( int32 i=0; i<mStages.CountItems(); ++i) {
+		Stage* stage = static_cast<Stage*>( mStages.ItemAt( i));
+		if (stage->input) {
+			stage->filter->SetInput( stage->input);
+			stage->input = NULL;
+		}
+		delete stage->outputReader;
+		stage->outputReader = NULL;
+		delete stage->output;
+		stage->output = NULL;
+	}
+	mOutput = NULL;
+}
+
+/*------------------------------------------------------------------------------*\
+	_ThrowStageError()
+		-	throws the exception that (the first) stage has run into, if any
+		-	must only be called once the output has been read completely, since
+			only then all stages are done
+\*------------------------------------------------------------------------------*/
+void BmFilterPipeline::_ThrowStageError() {
+	for( int32 i=0; i<mStages.CountItems(); ++i) {
+		Stage* stage = static_cast<Stage*>( mStages.ItemAt( i));
+		if (stage->error.Length()) {
+			if (stage->hadNetworkError)
+				BM_THROW_NETWORK( stage->error);
+			BM_THROW_RUNTIME( stage->error);
+		}
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	Read( data, reqLen)
+		-	reads from the output of the last stage
+\*------------------------------------------------------------------------------*/
+uint32 BmFilterPipeline::Read( char* data, uint32 reqLen) {
+	if (!mStarted && Start() != B_OK)
+		return 0;
+	uint32 len = mOutput ? mOutput->Read( data, reqLen) : 0;
+	if (!len && mOutput && mOutput->IsAtEnd())
+		_ThrowStageError();
+	return len;
+}
+
+/*------------------------------------------------------------------------------*\
+	ReadBlock( data, len)
+		-	hands out the blocks of the last stage by reference
+\*------------------------------------------------------------------------------*/
+bool BmFilterPipeline::ReadBlock( const char*& data, uint32& len) {
+	if (!mStarted && Start() != B_OK)
+		return false;
+	if (!mOutput || !mOutput->ReadBlock( data, len))
+		return false;
+	if (!len)
+		_ThrowStageError();
+	return true;
+}
+
+/*------------------------------------------------------------------------------*\
+	IsAtEnd()
+		-
+\*------------------------------------------------------------------------------*/
+bool BmFilterPipeline::IsAtEnd() {
+	if (!mStarted && Start() != B_OK)
+		return true;
+	if (mOutput && !mOutput->IsAtEnd())
+		return false;
+	_ThrowStageError();
+	return true;
+}
+
+/*------------------------------------------------------------------------------*\
+	Stop()
+		-	stops all stages (the data that is still in transit is dropped)
+		-	the first stage may be blocked reading from its own input (e.g. 
+			the network), so that input is stopped before we wait for the 
+			stage threads
+\*------------------------------------------------------------------------------*/
+void BmFilterPipeline::Stop() {
+	if (mStarted) {
+		Stage* first = static_cast<Stage*>( mStages.ItemAt( 0));
+		if (first && !first->done && first->filter->Input())
+			first->filter->Input()->Stop();
+		_Shutdown();
+	} else {
+		for( int32 i=0; i<mStages.CountItems(); ++i)
+			static_cast<Stage*>( mStages.ItemAt( i))->filter->Stop();
+	}
+}
@@ -0,0 +1,89 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+
+#ifndef _BmFilterPipeline_h
+#define _BmFilterPipeline_h
+
+#include <List.h>
+#include <OS.h>
+
+#include "BmBase.h"
+#include "BmMemIO.h"
+
+class BmPipeQueue;
+class BmPipeQueueIBuf;
+
+/*------------------------------------------------------------------------------*\
+	class BmFilterPipeline
+		-	runs a chain of BmMemFilters in a pipelined fashion: every filter
+			(stage) gets a thread of its own, the stages are connected by
+			bounded queues of data blocks.
+		-	the stages are added in chain order (the first stage reads from
+			the original input, every other stage is reconnected to read
+			from the queue of its predecessor).
+		-	the pipeline itself is a BmMemIBuf, reading from it yields the
+			output of the last stage.
+		-	every block produced by a stage's Read() is passed on as is, so
+			filters in immediate-pass-on mode keep passing on their data as
+			soon as they get it.
+		-	an exception thrown by any stage ends the pipeline and is thrown 
+			again (in the reader's thread) once the output has been read.
+\*------------------------------------------------------------------------------*/
+class IMPEXPBMBASE BmFilterPipeline : public BmMemIBuf {
+	typedef BmMemIBuf inherited;
+
+public:
+	BmFilterPipeline( uint32 blockSize=BmMemFilter::nBlockSize,
+							int32 queueDepth=4);
+	~BmFilterPipeline();
+
+	// native methods:
+	void AddStage( BmMemFilter* stage);
+	status_t Start();
+							// is called automatically on first read
+
+	// overrides of BmMemIBuf:
+	uint32 Read( char* data, uint32 reqLen);
+	bool ReadBlock( const char*& data, uint32& len);
+	bool IsAtEnd();
+	void Stop();
+
+	// getters:
+	int32 CountStages() const				{ return mStages.CountItems(); }
+
+private:
+	struct Stage {
+		BmMemFilter* filter;
+		BmMemIBuf* input;
+							// the filter's own input (restored on shutdown)
+		BmPipeQueue* output;
+		BmPipeQueueIBuf* outputReader;
+		thread_id thread;
+		uint32 blockSize;
+		BmString error;
+							// message of the exception the stage ran into
+		bool hadNetworkError;
+		volatile bool done;
+							// set when the stage's thread has finished
+	};
+	static int32 _StageThread( void* data);
+	void _Shutdown();
+	void _ThrowStageError();
+
+	BList mStages;
+	uint32 mBlockSize;
+	int32 mQueueDepth;
+	bool mStarted;
+	BmPipeQueueIBuf* mOutput;
+
+	// Hide copy-constructor and assignment:
+	BmFilterPipeline( const BmFilterPipeline&);
+	BmFilterPipeline operator=( const BmFilterPipeline&);
+};
+
+#endif
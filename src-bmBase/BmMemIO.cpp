@@ -6,13 +6,19 @@
  *		Oliver Tappe <beam@hirschkaefer.de>
  */
 #include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include <algorithm>
 #include <new>
 
 #include "BmBasics.h"
+#include "BmBlockPool.h"
 #include "BmMemIO.h"
 
 /********************************************************************************\
@@ -29,7 +35,8 @@ const char* BmMemFilter::nTagImmediatePassOn = "<ImmPassOn>";
 BmMemFilter::BmMemFilter( BmMemIBuf* input, uint32 blockSize, 
 								  const BmString& tags)
 	:	mInput( input)
-	,	mBuf( new char [blockSize])
+	,	mBuf( BmBlockPool::Allocate( blockSize))
+	,	mOutBuf( NULL)
 	,	mCurrPos( 0)
 	,	mCurrSize( 0)
 	,	mBlockSize( blockSize)
@@ -40,6 +47,8 @@ BmMemFilter::BmMemFilter( BmMemIBuf* input, uint32 blockSize,
 	,	mHadError( false)
 	,	mEndReached( false)
 {
+	if (!mBuf)
+		throw std::bad_alloc();
 }
 
 /*------------------------------------------------------------------------------*\
@@ -47,7 +56,8 @@ BmMemFilter::BmMemFilter( BmMemIBuf* input, uint32 blockSize,
 		-	destructor
 \*------------------------------------------------------------------------------*/
 BmMemFilter::~BmMemFilter() {
-	delete [] mBuf;
+	BmBlockPool::Free( mBuf, mBlockSize);
+	BmBlockPool::Free( mOutBuf, mBlockSize);
 }
 
 /*------------------------------------------------------------------------------*\
@@ -75,6 +85,8 @@ uint32 BmMemFilter::Read( char* data, uint32 reqLen) {
 	bool tooSmall = false;
 	assert( mInput);
 	while( !mHadError && !mEndReached && readLen < reqLen) {
+		const char* block = NULL;
+		uint32 blockLen = 0;
 		if (mCurrPos==mCurrSize || tooSmall) {
 			// block is empty or too small, we need to fetch more data:
 			if (!tooSmall && mInput->IsAtEnd()) {
@@ -86,22 +98,33 @@ uint32 BmMemFilter::Read( char* data, uint32 reqLen) {
 				readLen += destLen;
 				break;
 			}
-			// we "move-up" the remaining part of the buffer...
-			BM_ASSERT(mCurrPos <= mCurrSize);
-			srcLen = mCurrSize-mCurrPos;
-			memmove( mBuf, mBuf+mCurrPos, srcLen);
-			mCurrPos = 0;
-			mCurrSize = srcLen;
-			// ...and (re-)fill the buffer from our input-stream:
-			mCurrSize += mInput->Read( mBuf+srcLen, mBlockSize-srcLen);
+			blockLen = mBlockSize;
+			if (tooSmall || !mInput->ReadBlock( block, blockLen)) {
+				block = NULL;
+				// we "move-up" the remaining part of the buffer...
+				BM_ASSERT(mCurrPos <= mCurrSize);
+				srcLen = mCurrSize-mCurrPos;
+				memmove( mBuf, mBuf+mCurrPos, srcLen);
+				mCurrPos = 0;
+				mCurrSize = srcLen;
+				// ...and (re-)fill the buffer from our input-stream:
+				mCurrSize += mInput->Read( mBuf+srcLen, mBlockSize-srcLen);
+			} else
+				// our input has handed us a block by reference, so we filter 
+				// right from there (only the unfiltered rest will be copied):
+				mCurrPos = mCurrSize = 0;
 		}
 		BM_ASSERT(mCurrPos <= mCurrSize);
-		srcLen = mCurrSize - mCurrPos;
+		srcLen = block ? blockLen : mCurrSize - mCurrPos;
 		if (srcLen) {
 			// actually filter one buffer-block:
 			destLen = reqLen-readLen;
-			Filter( mBuf+mCurrPos, srcLen, data+readLen, destLen);
-			mCurrPos += srcLen;
+			Filter( block ? block : mBuf+mCurrPos, srcLen, data+readLen, destLen);
+			if (block) {
+				mCurrSize = blockLen - srcLen;
+				memcpy( mBuf, block+srcLen, mCurrSize);
+			} else
+				mCurrPos += srcLen;
 			mSrcCount += srcLen;
 			readLen += destLen;
 			if (!srcLen) {
@@ -122,6 +145,44 @@ uint32 BmMemFilter::Read( char* data, uint32 reqLen) {
 	return readLen;
 }
 
+/*------------------------------------------------------------------------------*\
+	ReadBlock( data, len)
+		-	if the filter would not change the next block of our input, that
+			block is passed on by reference (no copying at all).
+		-	otherwise the filtered data is written into an output block, which
+			is handed out instead
+\*------------------------------------------------------------------------------*/
+bool BmMemFilter::ReadBlock( const char*& data, uint32& len) {
+	assert( mInput);
+	uint32 maxLen = min_c( len, mBlockSize);
+	if (mCurrPos==mCurrSize && !mHadError && !mEndReached 
+	&& !mInput->IsAtEnd()) {
+		const char* block;
+		uint32 blockLen = maxLen;
+		if (mInput->ReadBlock( block, blockLen)) {
+			if (IsIdentityFor( block, blockLen)) {
+				mSrcCount += blockLen;
+				mDestCount += blockLen;
+				data = block;
+				len = blockLen;
+				return true;
+			}
+			// the block needs filtering, so we take it over into our buffer:
+			memcpy( mBuf, block, blockLen);
+			mCurrPos = 0;
+			mCurrSize = blockLen;
+		}
+	}
+	if (!mOutBuf) {
+		mOutBuf = BmBlockPool::Allocate( mBlockSize);
+		if (!mOutBuf)
+			return false;
+	}
+	data = mOutBuf;
+	len = Read( mOutBuf, maxLen);
+	return true;
+}
+
 /*------------------------------------------------------------------------------*\
 	AddStatusText()
 		-	
@@ -266,6 +327,24 @@ uint32 BmStringIBuf::Read( char* data, uint32 reqLen) {
 	return readLen;
 }
 
+/*------------------------------------------------------------------------------*\
+	ReadBlock( data, len)
+		-	hands out (a part of) the current string
+\*------------------------------------------------------------------------------*/
+bool BmStringIBuf::ReadBlock( const char*& data, uint32& len) {
+	if (IsAtEnd()) {
+		len = 0;
+		return true;
+	}
+	BufInfo* bufInfo = static_cast< BufInfo*>( mBufInfo.ItemAt(mIndex));
+	len = min_c( len, bufInfo->size - bufInfo->currPos);
+	data = bufInfo->buf + bufInfo->currPos;
+	bufInfo->currPos += len;
+	if (bufInfo->currPos == bufInfo->size)
+		mIndex++;
+	return true;
+}
+
 /*------------------------------------------------------------------------------*\
 	IsAtEnd()
 		-	
@@ -315,6 +394,124 @@ uint32 BmStringIBuf::Size() const {
 
 
 
+/********************************************************************************\
+	BmMappedFileIBuf
+\********************************************************************************/
+
+/*------------------------------------------------------------------------------*\
+	BmMappedFileIBuf( path, mayChange)
+		-	constructor, maps the file with the given path into memory
+		-	if mayChange is set, the file is never mapped but read, since 
+			comparing its size now says nothing about the size it will have 
+			while we read it
+\*------------------------------------------------------------------------------*/
+BmMappedFileIBuf::BmMappedFileIBuf( const char* path, bool mayChange)
+	:	mInitCheck( B_NO_INIT)
+	,	mFD( -1)
+	,	mData( NULL)
+	,	mSize( 0)
+	,	mPos( 0)
+	,	mBlock( NULL)
+{
+	mFD = open( path, O_RDONLY);
+	if (mFD < 0) {
+		mInitCheck = errno;
+		return;
+	}
+	struct stat st;
+	if (fstat( mFD, &st) < 0) {
+		mInitCheck = errno;
+		close( mFD);
+		mFD = -1;
+		return;
+	}
+	mSize = st.st_size;
+	mInitCheck = B_OK;
+	if (mayChange)
+		return;
+	if (mSize > 0 && (uint64)mSize < (uint64)(size_t)-1) {
+		void* data = mmap( NULL, (size_t)mSize, PROT_READ, MAP_PRIVATE, mFD, 0);
+		if (data != MAP_FAILED) {
+			mData = static_cast<const char*>( data);
+			// the mapping keeps the file alive, we don't need the fd anymore:
+			close( mFD);
+			mFD = -1;
+		}
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	~BmMappedFileIBuf()
+		-	destructor
+\*------------------------------------------------------------------------------*/
+BmMappedFileIBuf::~BmMappedFileIBuf() {
+	if (mData)
+		munmap( const_cast<char*>( mData), (size_t)mSize);
+	if (mFD >= 0)
+		close( mFD);
+	if (mBlock)
+		BmBlockPool::Free( mBlock, BmMemFilter::nBlockSize);
+}
+
+/*------------------------------------------------------------------------------*\
+	Read( data, reqLen)
+		-	copies up to reqLen bytes of the file into given buffer
+\*------------------------------------------------------------------------------*/
+uint32 BmMappedFileIBuf::Read( char* data, uint32 reqLen) {
+	if (IsAtEnd())
+		return 0;
+	uint32 len = (uint32)min_c( (off_t)reqLen, mSize - mPos);
+	if (mData)
+		memcpy( data, mData + mPos, len);
+	else {
+		ssize_t readLen = read( mFD, data, len);
+		if (readLen <= 0) {
+			// file has shrunk (or can't be read anymore), we stop here:
+			mSize = mPos;
+			return 0;
+		}
+		len = (uint32)readLen;
+	}
+	mPos += len;
+	return len;
+}
+
+/*------------------------------------------------------------------------------*\
+	ReadBlock( data, len)
+		-	hands out the next part of the mapping by reference (or reads the 
+			next block of the file into our buffer, if the file isn't mapped)
+\*------------------------------------------------------------------------------*/
+bool BmMappedFileIBuf::ReadBlock( const char*& data, uint32& len) {
+	if (IsAtEnd()) {
+		len = 0;
+		return true;
+	}
+	if (mData) {
+		len = (uint32)min_c( (off_t)len, mSize - mPos);
+		data = mData + mPos;
+		mPos += len;
+		return true;
+	}
+	if (!mBlock) {
+		mBlock = BmBlockPool::Allocate( BmMemFilter::nBlockSize);
+		if (!mBlock)
+			return false;
+	}
+	data = mBlock;
+	len = Read( mBlock, min_c( len, BmMemFilter::nBlockSize));
+	return true;
+}
+
+/*------------------------------------------------------------------------------*\
+	IsAtEnd()
+		-	
+\*------------------------------------------------------------------------------*/
+bool BmMappedFileIBuf::IsAtEnd() {
+	return mInitCheck != B_OK || mPos >= mSize;
+}
+
+
+
 /********************************************************************************\
 	BmStringOBuf
 \********************************************************************************/
@@ -387,12 +584,20 @@ uint32 BmStringOBuf::Write( const char* data, uint32 len) {
 uint32 BmStringOBuf::Write( BmMemIBuf* input, uint32 blockSize) {
 	uint32 writeLen=0;
 	uint32 len;
+	const char* block;
 	while( input && !input->IsAtEnd()) {
-		if (!GrowBufferToFit( blockSize))
-			break;
-		len = input->Read( mBuf+mCurrPos, blockSize);
+		len = blockSize;
+		if (input->ReadBlock( block, len)) {
+			// copy the block that has been handed to us:
+			if (len && Write( block, len) != len)
+				break;
+		} else {
+			if (!GrowBufferToFit( blockSize))
+				break;
+			len = input->Read( mBuf+mCurrPos, blockSize);
+			mCurrPos += len;
+		}
 		writeLen += len;
-		mCurrPos += len;
 	}
 	return writeLen;
 }
@@ -440,9 +645,11 @@ BmStringOBuf::operator<<(const BmString &string)
 		-	constructor
 \*------------------------------------------------------------------------------*/
 BmMemBufConsumer::BmMemBufConsumer( uint32 bufSize)
-	:	mBuf( new char [bufSize])
+	:	mBuf( BmBlockPool::Allocate( bufSize))
 	,	mBufSize( bufSize)
 {
+	if (!mBuf)
+		throw std::bad_alloc();
 }
 
 /*------------------------------------------------------------------------------*\
@@ -450,7 +657,7 @@ BmMemBufConsumer::BmMemBufConsumer( uint32 bufSize)
 		-	destructor
 \*------------------------------------------------------------------------------*/
 BmMemBufConsumer::~BmMemBufConsumer() {
-	delete [] mBuf;
+	BmBlockPool::Free( mBuf, mBufSize);
 }
 
 /*------------------------------------------------------------------------------*\
@@ -460,10 +667,15 @@ BmMemBufConsumer::~BmMemBufConsumer() {
 \*------------------------------------------------------------------------------*/
 void BmMemBufConsumer::Consume( BmMemIBuf* input, Functor* functor) {
 	uint32 len;
+	const char* block;
 	while( input && !input->IsAtEnd()) {
-		len = input->Read( mBuf, mBufSize);
+		len = mBufSize;
+		if (!input->ReadBlock( block, len)) {
+			len = input->Read( mBuf, mBufSize);
+			block = mBuf;
+		}
 		if (len>0 && functor)
-			if ((*functor)( mBuf, len) != B_OK)
+			if ((*functor)( block, len) != B_OK)
 				break;
 	}
 }
@@ -628,3 +840,4 @@ BmRingBuf::operator<<(const BmString &string)
 	Put( string.String(), string.Length());
 	return *this;
 }
+
@@ -23,6 +23,13 @@ class IMPEXPBMBASE BmMemIBuf {
 public:
 	virtual ~BmMemIBuf()						{}
 	virtual uint32 Read( char* data, uint32 reqLen) = 0;
+	virtual bool ReadBlock( const char*& , uint32& )
+													{ return false; }
+							// hands out the next block of data by reference instead
+							// of copying it (like Read() does). On entry, len is the
+							// maximum block size wanted, on exit it's the size of the
+							// block, which stays valid until the next read-call.
+							// Returns false if the stream doesn't support this.
 	virtual bool IsAtEnd() = 0;
 	virtual void Stop()						{}
 };
@@ -44,11 +51,14 @@ public:
 
 	// native methods:
 	virtual void Reset( BmMemIBuf* input=NULL);
+	void SetInput( BmMemIBuf* input)	{ mInput = input; }
+							// just changes the input (without resetting anything)
 	void AddStatusText( const BmString& text);
 	virtual void Stop();
 
 	// overrides of BmMemIBuf:
 	uint32 Read( char* data, uint32 reqLen);
+	bool ReadBlock( const char*& data, uint32& len);
 	bool IsAtEnd();
 
 	// getters
@@ -57,6 +67,7 @@ public:
 	uint32 DestCount() const				{ return mDestCount; }
 	bool HaveStatusText() const			{ return mStatusText.Length() > 0; }
 	const BmString& StatusText() const	{ return mStatusText; }
+	BmMemIBuf* Input() const				{ return mInput; }
 
 	static IMPEXPBMBASE const uint32 nBlockSize;
 	static IMPEXPBMBASE const char* nTagImmediatePassOn;
@@ -73,12 +84,32 @@ protected:
 								char* destBuf, uint32& destLen) = 0;
 	virtual void Finalize( char* , uint32& destLen) 
 													{ destLen=0; mIsFinalized = true; }
+	virtual bool IsIdentityFor( const char* , uint32 )
+													{ return false; }
+							// returns true if filtering the given block would not
+							// change it, such that it can be passed on by reference
+							// (the filter may update its state as if it had filtered
+							// the block)
 	//
 	bool SetTag( const char* tag, bool newVal);
 	bool IsTagSet( const char* tag);
+	//
+	static void FilterWith( BmMemFilter* filter, const char* srcBuf,
+									uint32& srcLen, char* destBuf, uint32& destLen)
+													{ filter->Filter( srcBuf, srcLen,
+																		 destBuf, destLen); }
+	static bool FinalizeWith( BmMemFilter* filter, char* destBuf,
+									  uint32& destLen)
+													{ filter->Finalize( destBuf, destLen);
+													  return filter->mIsFinalized; }
+							// let a filter drive another (embedded) filter directly,
+							// block by block (without the other one reading from
+							// an input)
 	
 	BmMemIBuf* mInput;
 	char* mBuf;
+	char* mOutBuf;
+							// output block for ReadBlock() (allocated on demand)
 	uint32 mCurrPos;
 	uint32 mCurrSize;
 	uint32 mBlockSize;
@@ -122,6 +153,7 @@ public:
 
 	// overrides of BmMemIBuf base:
 	uint32 Read( char* data, uint32 reqLen);
+	bool ReadBlock( const char*& data, uint32& len);
 	bool IsAtEnd();
 	bool EndsWithNewline();
 
@@ -148,6 +180,53 @@ private:
 	BmStringIBuf operator=( const BmStringIBuf&);
 };
 
+/*------------------------------------------------------------------------------*\
+	class BmMappedFileIBuf
+		-	an implementation of BmMemIBuf which reads from a file that is 
+			mapped into memory, such that the file's data can be handed out by
+			reference (no copying, the pages are only faulted in when needed).
+		-	if the file can't be mapped, the file is read block by block 
+			instead (and Data() returns NULL).
+		-	a mapped file that shrinks while being read raises SIGBUS, so 
+			files that may be changed by others while we read them (like 
+			attachments or mails that have not been sent yet) must be opened 
+			with mayChange set, which reads them with read() instead of 
+			mapping them.
+\*------------------------------------------------------------------------------*/
+class IMPEXPBMBASE BmMappedFileIBuf : public BmMemIBuf {
+	typedef BmMemIBuf inherited;
+
+public:
+	BmMappedFileIBuf( const char* path, bool mayChange=false);
+	~BmMappedFileIBuf();
+
+	// overrides of BmMemIBuf base:
+	uint32 Read( char* data, uint32 reqLen);
+	bool ReadBlock( const char*& data, uint32& len);
+	bool IsAtEnd();
+
+	// getters:
+	status_t InitCheck() const				{ return mInitCheck; }
+	const char* Data() const				{ return mData; }
+							// the complete file-contents (NULL if not mapped)
+	off_t Size() const						{ return mSize; }
+	bool IsMapped() const					{ return mData != NULL; }
+
+private:
+	status_t mInitCheck;
+	int mFD;
+							// only kept open if file is not mapped
+	const char* mData;
+	off_t mSize;
+	off_t mPos;
+	char* mBlock;
+							// buffer for ReadBlock() if file is not mapped
+
+	// Hide copy-constructor and assignment:
+	BmMappedFileIBuf( const BmMappedFileIBuf&);
+	BmMappedFileIBuf operator=( const BmMappedFileIBuf&);
+};
+
 /*------------------------------------------------------------------------------*\
 	class BmStringOBuf
 		-	a class which represents a dynamic string-buffer, i.e. the buffer
@@ -209,7 +288,7 @@ public:
 	// Functor which is called for each buffer that is to be consumed
 	struct Functor {
 		virtual ~Functor() 					{}
-		virtual status_t operator() (char* buf, uint32 bufLen) = 0;
+		virtual status_t operator() (const char* buf, uint32 bufLen) = 0;
 	};
 
 	void Consume( BmMemIBuf* input, Functor* functor=NULL);
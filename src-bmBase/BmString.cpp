@@ -6,7 +6,10 @@
  *		Oliver Tappe <beam@hirschkaefer.de>
  */
 #include "BmString.h"
+#include "BmBlockPool.h"
+#include "BmByteKernels.h"
 #include "BmMemIO.h"
+#include "BmStringSearch.h"
 
 char* strcasestr(const char *s, const char *find);
 
@@ -25,6 +28,19 @@ BmString BM_DEFAULT_STRING;
 // System Includes -------------------------------------------------------------
 #include <Debug.h>
 
+// allocation statistics are only gathered in debug builds, as the atomic
+// counters would otherwise slow down every string allocation:
+#if DEBUG
+static vint32 sHeapAllocCount = 0;
+static vint32 sInlineAllocCount = 0;
+static bool sUseInlineBuffer = true;
+#define COUNT_ALLOC(counter) atomic_add(&counter, 1)
+#define USE_INLINE_BUFFER sUseInlineBuffer
+#else
+#define COUNT_ALLOC(counter)
+#define USE_INLINE_BUFFER true
+#endif
+
 // Temporary Includes
 //#include "string_helper.h"
 
@@ -68,6 +84,86 @@ safestr(const char* str)
 }
 
 
+/* Heap data is preceded by the length and (in front of that) by the size
+ * of the BmBlockPool-block it lives in (0 if it has been malloc'ed). While
+ * a BmParseArena is open, larger strings are taken from the pool, so the
+ * strings built while parsing a mail recycle the blocks of the previous one.
+ */
+static const int32 kHeapPrefixLen = 2 * sizeof(int32);
+static const int32 kMinPooledLen = BmBlockPool::nMinBlockSize / 2;
+
+// helper function, returns the size of the pool-block to use for the given
+// data-length (0 if the data should be malloc'ed):
+static inline int32
+pool_size_for(int32 dataLen)
+{
+	int32 allocLen = dataLen + kHeapPrefixLen + 1;
+	if (allocLen < kMinPooledLen || !BmParseArena::IsOpen())
+		return 0;
+	return BmBlockPool::BlockSizeFor(allocLen);
+}
+
+
+// helper function, returns the pool-size stored in front of given heap data:
+static inline int32
+pool_size_of(char* data)
+{
+	return *((int32*)data - 2);
+}
+
+
+// helper function, allocates heap data (plus prefix) for the given length:
+static char*
+alloc_heap_data(int32 dataLen)
+{
+	int32 poolSize = pool_size_for(dataLen);
+	char* block = poolSize
+		? BmBlockPool::Allocate(poolSize)
+		: (char*)malloc(dataLen + kHeapPrefixLen + 1);
+	if (!block)
+		return NULL;
+	COUNT_ALLOC(sHeapAllocCount);
+	*(int32*)block = poolSize;
+	return block + kHeapPrefixLen;
+}
+
+
+// helper function, frees heap data allocated by alloc_heap_data():
+static void
+free_heap_data(char* data)
+{
+	int32 poolSize = pool_size_of(data);
+	if (poolSize)
+		BmBlockPool::Free(data - kHeapPrefixLen, poolSize);
+	else
+		free(data - kHeapPrefixLen);
+}
+
+
+// helper function, resizes heap data to the given length, keeping the first
+// keepLen bytes (a pool-block is kept as long as the data fits into it):
+static char*
+realloc_heap_data(char* data, int32 dataLen, int32 keepLen)
+{
+	int32 oldPoolSize = pool_size_of(data);
+	int32 poolSize = pool_size_for(dataLen);
+	if (oldPoolSize && oldPoolSize == poolSize)
+		return data;
+	if (!oldPoolSize && !poolSize) {
+		char* block = (char*)realloc(data - kHeapPrefixLen, 
+											  dataLen + kHeapPrefixLen + 1);
+		return block ? block + kHeapPrefixLen : NULL;
+	}
+	char* newData = alloc_heap_data(dataLen);
+	if (!newData)
+		return NULL;
+	memcpy(newData - sizeof(int32), data - sizeof(int32), 
+			 keepLen + sizeof(int32));
+	free_heap_data(data);
+	return newData;
+}
+
+
 // helper class for BmString::_ReplaceAtPositions():
 struct
 BmString::PosVect {
@@ -214,8 +310,7 @@ BmString::BmString(const char *str, int32 maxLength)
 */
 BmString::~BmString()
 {
-	if (_privateData)
-		free(_privateData - sizeof(int32));
+	_FreeData();
 }
 
 
@@ -397,8 +492,14 @@ BmString::Adopt(BmString &from)
 	if (&from == this) // Avoid auto-adoption
 		return *this;
 		
-	if (_privateData)
-		free(_privateData - sizeof(int32));
+	if (from._IsInline()) {
+		/* inline data can't be stolen, but copying it is cheap */
+		_DoAssign(from._privateData, from.Length());
+		from._privateData = NULL;
+		return *this;
+	}
+
+	_FreeData();
 
 	/* "steal" the data from the given BmString */
 	_privateData = from._privateData;
@@ -439,8 +540,14 @@ BmString::Adopt(BmString &from, int32 length)
 
 	int32 len = min_clamp0(length, from.Length());
 
-	if (_privateData)
-		free(_privateData - sizeof(int32));
+	if (from._IsInline()) {
+		/* inline data can't be stolen, but copying it is cheap */
+		_DoAssign(from._privateData, len);
+		from._privateData = NULL;
+		return *this;
+	}
+
+	_FreeData();
 
 	/* "steal" the data from the given BmString */
 	_privateData = from._privateData;
@@ -1183,18 +1290,12 @@ BmString::FindFirst(const char *string, int32 fromOffset) const
 int32
 BmString::FindFirst(char c) const
 {	
-	const char *start = String();
-	const char *end = String() + Length(); /* String's end */
-	
-	/* Scans the string until we find the character, */
-	/* or we hit the string's end */
-	while(start < end && *start != c)
-		start++;
+	const char *pos = (const char *)memchr(String(), c, Length());
 	
-	if (start == end)
+	if (pos == NULL)
 		return B_ERROR;
 			
-	return start - String();
+	return pos - String();
 }
 
 
@@ -1212,18 +1313,14 @@ BmString::FindFirst(char c, int32 fromOffset) const
 	if (fromOffset < 0)
 		return B_ERROR;
 		
-	const char *start = String() + min_clamp0(fromOffset, Length());
-	const char *end = String() + Length(); /* String's end */
-	
-	/* Scans the string until we found the character, */
-	/* or we hit the string's end */
-	while(start < end && *start != c)
-		start++;
+	int32 offset = min_clamp0(fromOffset, Length());
+	const char *pos = (const char *)memchr(String() + offset, c, 
+														Length() - offset);
 	
-	if (start >= end)
+	if (pos == NULL)
 		return B_ERROR;
 			
-	return start - String();
+	return pos - String();
 }
 
 
@@ -1456,8 +1553,15 @@ BmString&
 BmString::Replace(char replaceThis, char withThis, int32 maxReplaceCount, int32 fromOffset)
 {
 	CHECK_PARAM(fromOffset >= 0, "'fromOffset' must not be negative!");
-	if (maxReplaceCount > 0) {
-		for (int32 pos = min_clamp0(fromOffset, Length()); 
+	int32 from = min_clamp0(fromOffset, Length());
+	if (maxReplaceCount >= Length() - from) {
+		// every occurrence is to be replaced, so we do not need to look for
+		// each one individually:
+		if (from < Length())
+			BmByteKernels::ReplaceByte(_privateData + from, Length() - from,
+												replaceThis, withThis);
+	} else if (maxReplaceCount > 0) {
+		for (int32 pos = from; 
 			  		maxReplaceCount > 0; --maxReplaceCount, ++pos) {
 			pos = FindFirst(replaceThis, pos);
 			if (pos < 0)
@@ -1867,9 +1971,8 @@ BmString::CharacterEscape(const char *setOfCharsToEscape, char escapeWith)
 	}
 	int32 lastPos = 0;
 	char* oldAdr = _privateData;
-	char* newData = (char*)malloc(newLength + sizeof(int32) + 1);
+	char* newData = alloc_heap_data(newLength);
 	if (newData) {
-		newData += sizeof(int32);
 		char* newAdr = newData;
 		for (uint32 i = 0; i < count; ++i) {
 			pos = positions.ItemAt( i);
@@ -1887,7 +1990,7 @@ BmString::CharacterEscape(const char *setOfCharsToEscape, char escapeWith)
 		if (len > 0)
 			memcpy(newAdr, oldAdr, len);
 
-		free(_privateData - sizeof(int32));
+		_FreeData();
 		_privateData = newData;
 		_privateData[newLength] = 0;
 		_SetLength( newLength);
@@ -2028,29 +2131,54 @@ BmString::operator<<(double d)
 char*
 BmString::_Alloc(int32 dataLen, bool allocateEmptyString)
 {
-	char *dataPtr = _privateData ? _privateData - sizeof(int32) : NULL;
 	if (dataLen <= 0) {
 		if (!allocateEmptyString) {
 			// Release buffer if requested size is 0 and we're not told to
 			// allocate an empty string.
-			free(dataPtr);
-			_privateData = NULL;
+			_FreeData();
 			return NULL;
 		} else
 			dataLen = 0;
 	}
-	int32 allocLen = dataLen + sizeof(int32) + 1;
-	dataPtr = (char *)realloc(dataPtr, allocLen);
-	if (dataPtr) {
-		dataPtr += sizeof(int32);
+	if (dataLen <= kInlineCapacity && USE_INLINE_BUFFER) {
+		// the data fits into the inline buffer, so we avoid the heap:
+		if (!_privateData)
+			COUNT_ALLOC(sInlineAllocCount);
+		else if (!_IsInline()) {
+			memcpy(_inlineData, _privateData, min_clamp0(dataLen, Length()));
+			free_heap_data(_privateData);
+		}
+		_privateData = _inlineData;
+	} else {
+		char *dataPtr;
+		if (!_privateData || _IsInline()) {
+			// moving from inline buffer (or nothing) to the heap:
+			dataPtr = alloc_heap_data(dataLen);
+			if (!dataPtr)
+				return NULL;
+			if (_privateData)
+				memcpy(dataPtr, _inlineData, Length());
+		} else {
+			dataPtr = realloc_heap_data(_privateData, dataLen, 
+												 min_clamp0(dataLen, Length()));
+			if (!dataPtr)
+				return NULL;
+		}
 		_privateData = dataPtr;
-		int32 newLen = allocLen - sizeof(int32) - 1;
-		_SetLength(newLen);
-		_privateData[newLen] = '\0';
 	}
-	return dataPtr;
+	_SetLength(dataLen);
+	_privateData[dataLen] = '\0';
+	return _privateData;
 }	
 
+void
+BmString::_FreeData()
+{
+	if (_privateData && !_IsInline())
+		free_heap_data(_privateData);
+	_privateData = NULL;
+}
+
 void
 BmString::_Init(const char *str, int32 len)
 {
@@ -2134,9 +2262,10 @@ BmString::_DoPrepend(const char *str, int32 count)
 
 /* XXX: These could be inlined too, if they are too slow */
 int32
-BmString::_FindAfter(const char *str, int32 offset, int32 /*strlen*/) const
+BmString::_FindAfter(const char *str, int32 offset, int32 strlen) const
 {	
-	char *ptr = strstr(String() + offset, str);
+	const char *ptr = BmStringSearch::Find(String() + offset, Length() - offset,
+														str, strlen);
 
 	if (ptr != NULL)
 		return ptr - String();
@@ -2146,9 +2275,10 @@ BmString::_FindAfter(const char *str, int32 offset, int32 /*strlen*/) const
 
 
 int32
-BmString::_IFindAfter(const char *str, int32 offset, int32 /*strlen*/) const
+BmString::_IFindAfter(const char *str, int32 offset, int32 strlen) const
 {
-	char *ptr = strcasestr(String() + offset, str);
+	const char *ptr = BmStringSearch::IFind(String() + offset, 
+														 Length() - offset, str, strlen);
 
 	if (ptr != NULL)
 		return ptr - String();
@@ -2158,9 +2288,9 @@ BmString::_IFindAfter(const char *str, int32 offset, int32 /*strlen*/) const
 
 
 int32
-BmString::_ShortFindAfter(const char *str, int32 /*len*/) const
+BmString::_ShortFindAfter(const char *str, int32 len) const
 {
-	char *ptr = strstr(String(), str);
+	const char *ptr = BmStringSearch::Find(String(), Length(), str, len);
 	
 	if (ptr != NULL)
 		return ptr - String();
@@ -2238,6 +2368,8 @@ BmString::_ReplaceAtPositions(const PosVect* positions,
 {
 	int32 len = Length();
 	uint32 count = positions->CountItems();
+	if (!count)
+		return;
 	int32 newLength = len + count * (withLen - searchLen);
 	if (!newLength) {
 		_GrowBy(-len);
@@ -2246,9 +2378,8 @@ BmString::_ReplaceAtPositions(const PosVect* positions,
 	int32 pos;
 	int32 lastPos = 0;
 	char *oldAdr = _privateData;
-	char *newData = (char *)malloc(newLength + sizeof(int32) + 1);
+	char *newData = alloc_heap_data(newLength);
 	if (newData) {
-		newData += sizeof(int32);
 		char *newAdr = newData;
 		for(uint32 i = 0; i < count; ++i) {
 			pos = positions->ItemAt(i);
@@ -2267,7 +2398,7 @@ BmString::_ReplaceAtPositions(const PosVect* positions,
 		if (len > 0)
 			memcpy(newAdr, oldAdr, len);
 
-		free(_privateData - sizeof(int32));
+		_FreeData();
 		_privateData = newData;
 		_privateData[newLength] = 0;
 		_SetLength( newLength);
@@ -2385,6 +2516,8 @@ BmString operator+(const BmString& s1, const char* s2)
 	ConvertLinebreaksToLF()
 		-	converts linebreaks of this string from CRLF to LF
 		-	single CRs are not affected
+		-	the linebreaks are counted first, such that the result can be 
+			written in one go (in place, if we are converting ourselves)
 \*------------------------------------------------------------------------------*/
 BmString& BmString::ConvertLinebreaksToLF( const BmString* srcData) {
 	const BmString* src = srcData ? srcData : this;
@@ -2393,22 +2526,29 @@ BmString& BmString::ConvertLinebreaksToLF( const BmString* srcData) {
 		return *this;
 	}
 	
-	BmStringOBuf tempIO( (int32)max_c( 128, src->Length()*1.2), 1.2f);
-	int32 lastSrcPos = 0;
-	int32 len;
-	for( int32 srcPos=0; (srcPos=src->_FindAfter( "\r\n", lastSrcPos, 2)) != B_ERROR; ) {
-		len = srcPos-lastSrcPos;
-		tempIO.Write( src->String()+lastSrcPos, len);
-		tempIO.Write( "\n", 1);
-		lastSrcPos = srcPos+2;
+	int32 bareLFs, crlfs;
+	BmByteKernels::CountLinebreaks( src->String(), src->Length(), bareLFs, 
+											  crlfs);
+	if (!crlfs) {
+		// nothing to change
+		if (srcData && srcData != this)
+			this->SetTo( *srcData);
+		return *this;
+	}
+	int32 newLen = src->Length() - crlfs;
+	if (src == this) {
+		char* buf = LockBuffer( Length());
+		if (!buf)
+			return *this;
+		BmByteKernels::ConvertCRLFToLF( buf, Length(), buf);
+		UnlockBuffer( newLen);
+	} else {
+		char* buf = LockBuffer( newLen);
+		if (!buf)
+			return *this;
+		BmByteKernels::ConvertCRLFToLF( src->String(), src->Length(), buf);
+		UnlockBuffer( newLen);
 	}
-	if (tempIO.HasData()) {
-		// only copy remainder if we have actually changed anything
-		if ((len = src->Length()-lastSrcPos)!=0)
-			tempIO.Write( src->String()+lastSrcPos, len);
-		Adopt( tempIO.TheString());
-	} else if (srcData)
-		this->SetTo( *srcData);
 	return *this;
 }
 
@@ -2416,32 +2556,56 @@ BmString& BmString::ConvertLinebreaksToLF( const BmString* srcData) {
 	ConvertLinebreaksToCRLF()
 		-	converts linebreaks of this string from LF to CRLF
 		-	single CRs are not affected
+		-	the linebreaks are counted first, such that the result buffer can
+			be allocated with its exact size
 \*------------------------------------------------------------------------------*/
 BmString& BmString::ConvertLinebreaksToCRLF( const BmString* srcData) {
-	const BmString* src = srcData ? srcData : this;
-	if (!src->Length()) {
+	if (srcData && srcData != this)
+		return ConvertLinebreaksToCRLF( srcData->String(), srcData->Length());
+	if (!Length())
+		return *this;
+	
+	int32 bareLFs, crlfs;
+	BmByteKernels::CountLinebreaks( String(), Length(), bareLFs, crlfs);
+	if (!bareLFs)
+		// nothing to change
+		return *this;
+	int32 newLen = Length() + bareLFs;
+	BmString result;
+	char* buf = result.LockBuffer( newLen);
+	if (!buf)
+		return *this;
+	BmByteKernels::ConvertLFToCRLF( String(), Length(), buf);
+	result.UnlockBuffer( newLen);
+	Adopt( result);
+	return *this;
+}
+
+/*------------------------------------------------------------------------------*\
+	ConvertLinebreaksToCRLF( srcData, srcLen)
+		-	converts linebreaks of the given buffer from LF to CRLF and stores
+			the result in this string
+		-	the buffer must not be part of this string, it may come straight 
+			from a file-mapping, for instance
+\*------------------------------------------------------------------------------*/
+BmString& BmString::ConvertLinebreaksToCRLF( const char* srcData, 
+															int32 srcLen) {
+	if (!srcData || srcLen <= 0) {
 		Truncate( 0);
 		return *this;
 	}
 	
-	BmStringOBuf tempIO( (int32)max_c( 128, src->Length()*1.2), 1.2f);
-	int32 lastSrcPos = 0;
-	int32 len;
-	for( int32 srcPos=0; (srcPos=src->_FindAfter( "\n", srcPos, 1)) != B_ERROR; srcPos++) {
-		if (!srcPos || src->ByteAt(srcPos-1)!='\r') {
-			len = srcPos-lastSrcPos;
-			tempIO.Write( src->String()+lastSrcPos, len);
-			tempIO.Write( "\r\n", 2);
-			lastSrcPos = srcPos+1;
-		}
-	}
-	if (tempIO.HasData()) {
-		// only copy remainder if we have actually changed anything
-		if ((len = src->Length()-lastSrcPos)!=0)
-			tempIO.Write( src->String()+lastSrcPos, len);
-		Adopt( tempIO.TheString());
-	} else if (srcData)
-		this->SetTo( *srcData);
+	int32 bareLFs, crlfs;
+	BmByteKernels::CountLinebreaks( srcData, srcLen, bareLFs, crlfs);
+	int32 newLen = srcLen + bareLFs;
+	char* buf = LockBuffer( newLen);
+	if (!buf)
+		return *this;
+	if (bareLFs)
+		BmByteKernels::ConvertLFToCRLF( srcData, srcLen, buf);
+	else
+		memcpy( buf, srcData, srcLen);
+	UnlockBuffer( newLen);
 	return *this;
 }
 
@@ -2547,3 +2711,57 @@ BmString::Trim( bool left, bool right) {
 	}
 	return *this;
 }
+
+/*------------------------------------------------------------------------------*\
+	HeapAllocCount()
+		-	returns the number of string buffers allocated on the heap since
+			the last call to ResetAllocCounts() (always 0 in release builds)
+\*------------------------------------------------------------------------------*/
+int32
+BmString::HeapAllocCount() {
+#if DEBUG
+	return sHeapAllocCount;
+#else
+	return 0;
+#endif
+}
+
+/*------------------------------------------------------------------------------*\
+	InlineAllocCount()
+		-	returns the number of strings that were set up in their inline
+			buffer (thus avoiding the heap) since the last call to 
+			ResetAllocCounts() (always 0 in release builds)
+\*------------------------------------------------------------------------------*/
+int32
+BmString::InlineAllocCount() {
+#if DEBUG
+	return sInlineAllocCount;
+#else
+	return 0;
+#endif
+}
+
+/*------------------------------------------------------------------------------*\
+	ResetAllocCounts()
+		-	resets the allocation counters
+\*------------------------------------------------------------------------------*/
+void
+BmString::ResetAllocCounts() {
+#if DEBUG
+	sHeapAllocCount = 0;
+	sInlineAllocCount = 0;
+#endif
+}
+
+/*------------------------------------------------------------------------------*\
+	UseInlineBuffer( use)
+		-	switches the inline buffer on or off for strings that are set up
+			afterwards, such that benchmarks can measure how many heap 
+			allocations it avoids (debug builds only, ignored otherwise)
+\*------------------------------------------------------------------------------*/
+void
+BmString::UseInlineBuffer(bool use) {
+#if DEBUG
+	sUseInlineBuffer = use;
+#endif
+}
@@ -309,6 +309,8 @@ private:
 #endif
 
 	char			*_Alloc( int32 dataLen, bool allocateEmptyString = false);
+	void			_FreeData();
+	bool			_IsInline() const 	{ return _privateData == _inlineData; }
 
 	struct PosVect;
 	void 			_ReplaceAtPositions( const PosVect* positions,
@@ -319,6 +321,15 @@ private:
 protected:
 	char *_privateData;
 
+private:
+	enum { kInlineCapacity = 19 };
+	int32 _inlineLength;
+	char _inlineData[kInlineCapacity + 1];
+		/* short strings live in this inline buffer instead of the heap.
+		 * _inlineLength plays the role of the length-prefix, so that
+		 * Length() works the same way for both kinds of storage.
+		 */
+
 
 	// ----------------------------------------------------------
 	// Beam extensions start here!	
@@ -326,11 +337,18 @@ protected:
 public:
 	BmString& ConvertLinebreaksToLF( const BmString* srcData=NULL);
 	BmString& ConvertLinebreaksToCRLF( const BmString* srcData=NULL);
+	BmString& ConvertLinebreaksToCRLF( const char* srcData, int32 srcLen);
 	BmString& ConvertTabsToSpaces( int32 numSpaces,
 											 const BmString* srcData=NULL);
 	BmString& DeUrlify();
 	BmString& Trim( bool left=true, bool right=true);
 
+	// allocation statistics (for benchmarks and diagnostics, these are only
+	// gathered in debug builds):
+	static int32 HeapAllocCount();
+	static int32 InlineAllocCount();
+	static void ResetAllocCounts();
+	static void UseInlineBuffer(bool use);
 };
 
 /*----- Comutative compare operators --------------------------------------*/
@@ -0,0 +1,344 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+#include <string.h>
+
+#include "BmStringSearch.h"
+
+// the vectorized kernels need a compiler that knows about per-function
+// target attributes (gcc >= 4.9), all others just get the scalar kernels:
+#if defined(__GNUC__) \
+	&& (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)) \
+	&& (defined(__i386__) || defined(__x86_64__))
+#	define BM_HAVE_X86_KERNELS 1
+#	include <immintrin.h>
+#endif
+
+namespace BmStringSearch {
+
+typedef const char* (*TFindFunc)( const char*, int32, const char*, int32);
+
+/*------------------------------------------------------------------------------*\
+	ToLower()
+		-	ASCII-only case folding (just like strcasestr() in the C-locale)
+\*------------------------------------------------------------------------------*/
+static inline unsigned char ToLower( unsigned char c) {
+	return (c >= 'A' && c <= 'Z') ? c | 0x20 : c;
+}
+
+/*------------------------------------------------------------------------------*\
+	ToUpper()
+		-	ASCII-only case folding
+\*------------------------------------------------------------------------------*/
+static inline unsigned char ToUpper( unsigned char c) {
+	return (c >= 'a' && c <= 'z') ? c & ~0x20 : c;
+}
+
+/*------------------------------------------------------------------------------*\
+	IEqual()
+		-	case-insensitive comparison of the given number of bytes
+\*------------------------------------------------------------------------------*/
+static inline bool IEqual( const char* s1, const char* s2, int32 len) {
+	for( int32 i=0; i<len; ++i) {
+		if (ToLower( s1[i]) != ToLower( s2[i]))
+			return false;
+	}
+	return true;
+}
+
+/*------------------------------------------------------------------------------*\
+	ScalarFind()
+		-	looks for the first char of str with memchr(), then compares
+			the rest
+\*------------------------------------------------------------------------------*/
+static const char* ScalarFind( const char* data, int32 dataLen,
+										 const char* str, int32 strLen) {
+	const char* last = data + dataLen - strLen;
+	for( const char* pos = data; pos <= last; ++pos) {
+		pos = static_cast<const char*>( memchr( pos, str[0], last - pos + 1));
+		if (!pos)
+			return NULL;
+		if (memcmp( pos + 1, str + 1, strLen - 1) == 0)
+			return pos;
+	}
+	return NULL;
+}
+
+/*------------------------------------------------------------------------------*\
+	ScalarIFind()
+		-
+\*------------------------------------------------------------------------------*/
+static const char* ScalarIFind( const char* data, int32 dataLen,
+										  const char* str, int32 strLen) {
+	const char* last = data + dataLen - strLen;
+	const unsigned char first = ToLower( str[0]);
+	for( const char* pos = data; pos <= last; ++pos) {
+		if (ToLower( *pos) == first && IEqual( pos + 1, str + 1, strLen - 1))
+			return pos;
+	}
+	return NULL;
+}
+
+#ifdef BM_HAVE_X86_KERNELS
+
+/*------------------------------------------------------------------------------*\
+	SSE2Find()
+		-	compares the first and last char of str against 16 positions
+			at once, only positions where both match are verified.
+\*------------------------------------------------------------------------------*/
+__attribute__((target("sse2")))
+static const char* SSE2Find( const char* data, int32 dataLen,
+									  const char* str, int32 strLen) {
+	const __m128i first = _mm_set1_epi8( str[0]);
+	const __m128i last = _mm_set1_epi8( str[strLen-1]);
+	int32 i = 0;
+	for( ; i + strLen - 1 + 16 <= dataLen; i += 16) {
+		const __m128i blockFirst
+			= _mm_loadu_si128( (const __m128i*)(data + i));
+		const __m128i blockLast
+			= _mm_loadu_si128( (const __m128i*)(data + i + strLen - 1));
+		uint32 mask = _mm_movemask_epi8(
+			_mm_and_si128( _mm_cmpeq_epi8( first, blockFirst),
+								_mm_cmpeq_epi8( last, blockLast))
+		);
+		while( mask) {
+			int32 bit = __builtin_ctz( mask);
+			if (strLen < 3
+			|| memcmp( data + i + bit + 1, str + 1, strLen - 2) == 0)
+				return data + i + bit;
+			mask &= mask - 1;
+		}
+	}
+	return ScalarFind( data + i, dataLen - i, str, strLen);
+}
+
+/*------------------------------------------------------------------------------*\
+	SSE2IFind()
+		-	like SSE2Find(), but compares against both cases of first and
+			last char.
+\*------------------------------------------------------------------------------*/
+__attribute__((target("sse2")))
+static const char* SSE2IFind( const char* data, int32 dataLen,
+										const char* str, int32 strLen) {
+	const __m128i firstLower = _mm_set1_epi8( ToLower( str[0]));
+	const __m128i firstUpper = _mm_set1_epi8( ToUpper( str[0]));
+	const __m128i lastLower = _mm_set1_epi8( ToLower( str[strLen-1]));
+	const __m128i lastUpper = _mm_set1_epi8( ToUpper( str[strLen-1]));
+	int32 i = 0;
+	for( ; i + strLen - 1 + 16 <= dataLen; i += 16) {
+		const __m128i blockFirst
+			= _mm_loadu_si128( (const __m128i*)(data + i));
+		const __m128i blockLast
+			= _mm_loadu_si128( (const __m128i*)(data + i + strLen - 1));
+		const __m128i eqFirst
+			= _mm_or_si128( _mm_cmpeq_epi8( firstLower, blockFirst),
+								 _mm_cmpeq_epi8( firstUpper, blockFirst));
+		const __m128i eqLast
+			= _mm_or_si128( _mm_cmpeq_epi8( lastLower, blockLast),
+								 _mm_cmpeq_epi8( lastUpper, blockLast));
+		uint32 mask = _mm_movemask_epi8( _mm_and_si128( eqFirst, eqLast));
+		while( mask) {
+			int32 bit = __builtin_ctz( mask);
+			if (IEqual( data + i + bit + 1, str + 1, strLen - 2))
+				return data + i + bit;
+			mask &= mask - 1;
+		}
+	}
+	return ScalarIFind( data + i, dataLen - i, str, strLen);
+}
+
+/*------------------------------------------------------------------------------*\
+	AVX2Find()
+		-	same as SSE2Find(), but works on 32 positions at once
+\*------------------------------------------------------------------------------*/
+__attribute__((target("avx2")))
+static const char* AVX2Find( const char* data, int32 dataLen,
+									  const char* str, int32 strLen) {
+	const __m256i first = _mm256_set1_epi8( str[0]);
+	const __m256i last = _mm256_set1_epi8( str[strLen-1]);
+	int32 i = 0;
+	for( ; i + strLen - 1 + 32 <= dataLen; i += 32) {
+		const __m256i blockFirst
+			= _mm256_loadu_si256( (const __m256i*)(data + i));
+		const __m256i blockLast
+			= _mm256_loadu_si256( (const __m256i*)(data + i + strLen - 1));
+		uint32 mask = _mm256_movemask_epi8(
+			_mm256_and_si256( _mm256_cmpeq_epi8( first, blockFirst),
+									_mm256_cmpeq_epi8( last, blockLast))
+		);
+		while( mask) {
+			int32 bit = __builtin_ctz( mask);
+			if (strLen < 3
+			|| memcmp( data + i + bit + 1, str + 1, strLen - 2) == 0)
+				return data + i + bit;
+			mask &= mask - 1;
+		}
+	}
+	return SSE2Find( data + i, dataLen - i, str, strLen);
+}
+
+/*------------------------------------------------------------------------------*\
+	AVX2IFind()
+		-	same as SSE2IFind(), but works on 32 positions at once
+\*------------------------------------------------------------------------------*/
+__attribute__((target("avx2")))
+static const char* AVX2IFind( const char* data, int32 dataLen,
+										const char* str, int32 strLen) {
+	const __m256i firstLower = _mm256_set1_epi8( ToLower( str[0]));
+	const __m256i firstUpper = _mm256_set1_epi8( ToUpper( str[0]));
+	const __m256i lastLower = _mm256_set1_epi8( ToLower( str[strLen-1]));
+	const __m256i lastUpper = _mm256_set1_epi8( ToUpper( str[strLen-1]));
+	int32 i = 0;
+	for( ; i + strLen - 1 + 32 <= dataLen; i += 32) {
+		const __m256i blockFirst
+			= _mm256_loadu_si256( (const __m256i*)(data + i));
+		const __m256i blockLast
+			= _mm256_loadu_si256( (const __m256i*)(data + i + strLen - 1));
+		const __m256i eqFirst
+			= _mm256_or_si256( _mm256_cmpeq_epi8( firstLower, blockFirst),
+									 _mm256_cmpeq_epi8( firstUpper, blockFirst));
+		const __m256i eqLast
+			= _mm256_or_si256( _mm256_cmpeq_epi8( lastLower, blockLast),
+									 _mm256_cmpeq_epi8( lastUpper, blockLast));
+		uint32 mask = _mm256_movemask_epi8( _mm256_and_si256( eqFirst, eqLast));
+		while( mask) {
+			int32 bit = __builtin_ctz( mask);
+			if (IEqual( data + i + bit + 1, str + 1, strLen - 2))
+				return data + i + bit;
+			mask &= mask - 1;
+		}
+	}
+	return SSE2IFind( data + i, dataLen - i, str, strLen);
+}
+
+#endif	// BM_HAVE_X86_KERNELS
+
+static const TFindFunc nFindFuncs[KERNEL_COUNT] = {
+	ScalarFind,
+#ifdef BM_HAVE_X86_KERNELS
+	SSE2Find,
+	AVX2Find
+#else
+	ScalarFind,
+	ScalarFind
+#endif
+};
+
+static const TFindFunc nIFindFuncs[KERNEL_COUNT] = {
+	ScalarIFind,
+#ifdef BM_HAVE_X86_KERNELS
+	SSE2IFind,
+	AVX2IFind
+#else
+	ScalarIFind,
+	ScalarIFind
+#endif
+};
+
+static const char* nKernelNames[KERNEL_COUNT] = {
+	"scalar",
+	"sse2",
+	"avx2"
+};
+
+/*------------------------------------------------------------------------------*\
+	BestKernel()
+		-	determines the best kernel supported by the CPU
+\*------------------------------------------------------------------------------*/
+static Kernel BestKernel() {
+	if (IsKernelSupported( KERNEL_AVX2))
+		return KERNEL_AVX2;
+	if (IsKernelSupported( KERNEL_SSE2))
+		return KERNEL_SSE2;
+	return KERNEL_SCALAR;
+}
+
+// the kernel in use (determined lazily, races are harmless, since every
+// thread would select the same kernel):
+static int32 nActiveKernel = -1;
+
+/*------------------------------------------------------------------------------*\
+	ActiveKernel()
+		-
+\*------------------------------------------------------------------------------*/
+Kernel ActiveKernel() {
+	if (nActiveKernel < 0)
+		nActiveKernel = BestKernel();
+	return static_cast<Kernel>( nActiveKernel);
+}
+
+/*------------------------------------------------------------------------------*\
+	IsKernelSupported( kernel)
+		-
+\*------------------------------------------------------------------------------*/
+bool IsKernelSupported( Kernel kernel) {
+	switch( kernel) {
+		case KERNEL_SCALAR:
+			return true;
+#ifdef BM_HAVE_X86_KERNELS
+		case KERNEL_SSE2:
+			__builtin_cpu_init();
+			return __builtin_cpu_supports( "sse2");
+		case KERNEL_AVX2:
+			__builtin_cpu_init();
+			return __builtin_cpu_supports( "avx2");
+#endif
+		default:
+			return false;
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	SelectKernel( kernel)
+		-
+\*------------------------------------------------------------------------------*/
+bool SelectKernel( Kernel kernel) {
+	if (!IsKernelSupported( kernel))
+		return false;
+	nActiveKernel = kernel;
+	return true;
+}
+
+/*------------------------------------------------------------------------------*\
+	KernelName( kernel)
+		-
+\*------------------------------------------------------------------------------*/
+const char* KernelName( Kernel kernel) {
+	if (kernel < 0 || kernel >= KERNEL_COUNT)
+		return "unknown";
+	return nKernelNames[kernel];
+}
+
+/*------------------------------------------------------------------------------*\
+	Find( data, dataLen, str, strLen)
+		-
+\*------------------------------------------------------------------------------*/
+const char* Find( const char* data, int32 dataLen,
+						const char* str, int32 strLen) {
+	if (strLen <= 0)
+		return data;
+	if (strLen > dataLen)
+		return NULL;
+	if (strLen == 1)
+		return static_cast<const char*>( memchr( data, str[0], dataLen));
+	return nFindFuncs[ActiveKernel()]( data, dataLen, str, strLen);
+}
+
+/*------------------------------------------------------------------------------*\
+	IFind( data, dataLen, str, strLen)
+		-
+\*------------------------------------------------------------------------------*/
+const char* IFind( const char* data, int32 dataLen,
+						 const char* str, int32 strLen) {
+	if (strLen <= 0)
+		return data;
+	if (strLen > dataLen)
+		return NULL;
+	return nIFindFuncs[ActiveKernel()]( data, dataLen, str, strLen);
+}
+
+}
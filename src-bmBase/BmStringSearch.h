@@ -0,0 +1,54 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+#ifndef _BmStringSearch_h
+#define _BmStringSearch_h
+
+#include <SupportDefs.h>
+
+#include "BmBase.h"
+
+/*------------------------------------------------------------------------------*\
+	BmStringSearch
+		-	length-bounded substring search kernels used by BmString and
+			BmStringView.
+		-	on x86, vectorized kernels (SSE2 or AVX2, whichever is best
+			supported by the CPU) are selected at runtime, everywhere else a
+			scalar (memchr-based) implementation is used.
+		-	the searched data does not need to be null-terminated.
+\*------------------------------------------------------------------------------*/
+namespace BmStringSearch {
+
+	enum Kernel {
+		KERNEL_SCALAR = 0,
+		KERNEL_SSE2,
+		KERNEL_AVX2,
+		KERNEL_COUNT
+	};
+
+	IMPEXPBMBASE
+	const char* Find( const char* data, int32 dataLen,
+							const char* str, int32 strLen);
+							// returns first occurrence of str in data (or NULL)
+	IMPEXPBMBASE
+	const char* IFind( const char* data, int32 dataLen,
+							 const char* str, int32 strLen);
+							// same as Find(), but ignores case (of ASCII chars)
+
+	IMPEXPBMBASE
+	Kernel ActiveKernel();
+	IMPEXPBMBASE
+	bool IsKernelSupported( Kernel kernel);
+	IMPEXPBMBASE
+	bool SelectKernel( Kernel kernel);
+							// meant for tests & benchmarks, returns false if
+							// the given kernel is not supported by the CPU
+	IMPEXPBMBASE
+	const char* KernelName( Kernel kernel);
+}
+
+#endif
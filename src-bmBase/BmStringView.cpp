@@ -0,0 +1,211 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+#include <ctype.h>
+#include <string.h>
+
+#include "BmStringSearch.h"
+#include "BmStringView.h"
+
+/********************************************************************************\
+	BmStringView
+\********************************************************************************/
+
+/*------------------------------------------------------------------------------*\
+	BmStringView( str)
+		-	constructor, views the given c-string
+\*------------------------------------------------------------------------------*/
+BmStringView::BmStringView( const char* str)
+	:	mData( str ? str : "")
+	,	mLength( str ? strlen( str) : 0)
+{
+}
+
+/*------------------------------------------------------------------------------*\
+	BmStringView( str, offset, length)
+		-	constructor, views the given part of a BmString
+		-	offset and length are clamped to the string's boundaries
+\*------------------------------------------------------------------------------*/
+BmStringView::BmStringView( const BmString& str, int32 offset, int32 length)
+	:	mData( str.String())
+	,	mLength( 0)
+{
+	int32 strLen = str.Length();
+	if (offset < 0)
+		offset = 0;
+	else if (offset > strLen)
+		offset = strLen;
+	if (length < 0 || length > strLen - offset)
+		length = strLen - offset;
+	mData += offset;
+	mLength = length;
+}
+
+/*------------------------------------------------------------------------------*\
+	SubView( offset, length)
+		-	returns a view onto the given part of this view
+		-	a negative length means: until the end
+\*------------------------------------------------------------------------------*/
+BmStringView BmStringView::SubView( int32 offset, int32 length) const {
+	if (offset < 0)
+		offset = 0;
+	else if (offset > mLength)
+		offset = mLength;
+	if (length < 0 || length > mLength - offset)
+		length = mLength - offset;
+	return BmStringView( mData + offset, length);
+}
+
+/*------------------------------------------------------------------------------*\
+	FindFirst( c, fromOffset)
+		-	returns offset of first occurrence of given char, or B_ERROR
+\*------------------------------------------------------------------------------*/
+int32 BmStringView::FindFirst( char c, int32 fromOffset) const {
+	if (fromOffset < 0)
+		fromOffset = 0;
+	if (fromOffset >= mLength)
+		return B_ERROR;
+	const char* pos
+		= static_cast<const char*>(
+			memchr( mData + fromOffset, c, mLength - fromOffset)
+		);
+	return pos ? pos - mData : B_ERROR;
+}
+
+/*------------------------------------------------------------------------------*\
+	FindFirst( str, fromOffset)
+		-	returns offset of first occurrence of given string, or B_ERROR
+\*------------------------------------------------------------------------------*/
+int32 BmStringView::FindFirst( const BmStringView& str, int32 fromOffset) const {
+	if (fromOffset < 0)
+		fromOffset = 0;
+	if (fromOffset > mLength)
+		return B_ERROR;
+	const char* pos = BmStringSearch::Find( mData + fromOffset, 
+														 mLength - fromOffset, 
+														 str.Data(), str.Length());
+	return pos ? pos - mData : B_ERROR;
+}
+
+/*------------------------------------------------------------------------------*\
+	IFindFirst( str, fromOffset)
+		-	returns offset of first case-insensitive occurrence of given string,
+			or B_ERROR
+\*------------------------------------------------------------------------------*/
+int32 BmStringView::IFindFirst( const BmStringView& str, int32 fromOffset) const {
+	if (fromOffset < 0)
+		fromOffset = 0;
+	if (fromOffset > mLength)
+		return B_ERROR;
+	const char* pos = BmStringSearch::IFind( mData + fromOffset, 
+														  mLength - fromOffset, 
+														  str.Data(), str.Length());
+	return pos ? pos - mData : B_ERROR;
+}
+
+/*------------------------------------------------------------------------------*\
+	FindLast( c)
+		-	returns offset of last occurrence of given char, or B_ERROR
+\*------------------------------------------------------------------------------*/
+int32 BmStringView::FindLast( char c) const {
+	for( int32 i = mLength - 1; i >= 0; --i) {
+		if (mData[i] == c)
+			return i;
+	}
+	return B_ERROR;
+}
+
+/*------------------------------------------------------------------------------*\
+	Compare( str)
+		-	strcmp()-style comparison of two views
+\*------------------------------------------------------------------------------*/
+int BmStringView::Compare( const BmStringView& str) const {
+	int32 len = mLength < str.Length() ? mLength : str.Length();
+	int res = memcmp( mData, str.Data(), len);
+	if (res)
+		return res;
+	return mLength == str.Length() ? 0 : (mLength < str.Length() ? -1 : 1);
+}
+
+/*------------------------------------------------------------------------------*\
+	ICompare( str)
+		-	strcasecmp()-style comparison of two views
+\*------------------------------------------------------------------------------*/
+int BmStringView::ICompare( const BmStringView& str) const {
+	int32 len = mLength < str.Length() ? mLength : str.Length();
+	for( int32 i = 0; i < len; ++i) {
+		int diff = tolower( (unsigned char)mData[i])
+						- tolower( (unsigned char)str.Data()[i]);
+		if (diff)
+			return diff;
+	}
+	return mLength == str.Length() ? 0 : (mLength < str.Length() ? -1 : 1);
+}
+
+/*------------------------------------------------------------------------------*\
+	StartsWith( str)
+		-	returns whether or not this view starts with the given string
+\*------------------------------------------------------------------------------*/
+bool BmStringView::StartsWith( const BmStringView& str) const {
+	return str.Length() <= mLength
+		&& memcmp( mData, str.Data(), str.Length()) == 0;
+}
+
+/*------------------------------------------------------------------------------*\
+	EndsWith( str)
+		-	returns whether or not this view ends with the given string
+\*------------------------------------------------------------------------------*/
+bool BmStringView::EndsWith( const BmStringView& str) const {
+	return str.Length() <= mLength
+		&& memcmp( mData + mLength - str.Length(), str.Data(),
+					  str.Length()) == 0;
+}
+
+/*------------------------------------------------------------------------------*\
+	Trim( left, right)
+		-	removes whitespace from left/right/both sides of the view
+\*------------------------------------------------------------------------------*/
+BmStringView& BmStringView::Trim( bool left, bool right) {
+	if (left) {
+		while( mLength && isspace( (unsigned char)*mData)) {
+			mData++;
+			mLength--;
+		}
+	}
+	if (right) {
+		while( mLength && isspace( (unsigned char)mData[mLength-1]))
+			mLength--;
+	}
+	return *this;
+}
+
+/*------------------------------------------------------------------------------*\
+	ToString()
+		-	returns a BmString containing a copy of the viewed data
+\*------------------------------------------------------------------------------*/
+BmString BmStringView::ToString() const {
+	BmString str;
+	CopyInto( str);
+	return str;
+}
+
+/*------------------------------------------------------------------------------*\
+	CopyInto( into)
+		-	copies the viewed data into the given string
+\*------------------------------------------------------------------------------*/
+void BmStringView::CopyInto( BmString& into) const {
+	if (!mLength) {
+		into.Truncate( 0);
+		return;
+	}
+	char* buf = into.LockBuffer( mLength);
+	if (buf) {
+		memcpy( buf, mData, mLength);
+		buf[mLength] = '\0';
+	}
+	into.UnlockBuffer( buf ? mLength : 0);
+}
@@ -0,0 +1,80 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+
+#ifndef _BmStringView_h
+#define _BmStringView_h
+
+#include <SupportDefs.h>
+
+#include "BmBase.h"
+#include "BmString.h"
+
+/*------------------------------------------------------------------------------*\
+	class BmStringView
+		-	a non-owning view onto a range of characters (usually part of a
+			BmString).
+		-	the viewed data is *not* null-terminated, so all operations are
+			bounded by the view's length.
+		-	the owner of the data must outlive the view, views are meant to
+			be used during parsing, without copying every token into a new
+			BmString.
+\*------------------------------------------------------------------------------*/
+class IMPEXPBMBASE BmStringView {
+
+public:
+	BmStringView()
+		:	mData( "")
+		,	mLength( 0)							{}
+	BmStringView( const char* str);
+	BmStringView( const char* str, int32 length)
+		:	mData( str ? str : "")
+		,	mLength( str && length > 0 ? length : 0)
+													{}
+	BmStringView( const BmString& str)
+		:	mData( str.String())
+		,	mLength( str.Length())			{}
+	BmStringView( const BmString& str, int32 offset, int32 length);
+
+	// native methods:
+	BmStringView SubView( int32 offset, int32 length = -1) const;
+
+	int32 FindFirst( char c, int32 fromOffset = 0) const;
+	int32 FindFirst( const BmStringView& str, int32 fromOffset = 0) const;
+	int32 IFindFirst( const BmStringView& str, int32 fromOffset = 0) const;
+	int32 FindLast( char c) const;
+
+	int Compare( const BmStringView& str) const;
+	int ICompare( const BmStringView& str) const;
+	bool StartsWith( const BmStringView& str) const;
+	bool EndsWith( const BmStringView& str) const;
+
+	BmStringView& Trim( bool left = true, bool right = true);
+							// only adjusts the view, the data is left alone
+
+	BmString ToString() const;
+	void CopyInto( BmString& into) const;
+
+	// operators:
+	inline char operator[]( int32 index) const
+													{ return mData[index]; }
+	inline bool operator==( const BmStringView& str) const
+													{ return Compare( str) == 0; }
+	inline bool operator!=( const BmStringView& str) const
+													{ return Compare( str) != 0; }
+
+	// getters:
+	inline const char* Data() const		{ return mData; }
+	inline int32 Length() const			{ return mLength; }
+	inline bool IsEmpty() const			{ return mLength == 0; }
+
+private:
+	const char* mData;
+	int32 mLength;
+};
+
+#endif
@@ -114,6 +114,7 @@ BmNetJobModel::~BmNetJobModel()
 bool BmNetJobModel::Connect( const BNetAddress* addr)
 {
 	Disconnect();
+	mReader->Reset();
 	mConnection = TheNetEndpointRoster->CreateEndpoint();
 	mErrorString.Truncate( 0);
 	if (mConnection->InitCheck() != B_OK) {
@@ -647,6 +648,7 @@ void BmDotstuffEncoder::Finalize( char* destBuf, uint32& destLen)
 \*------------------------------------------------------------------------------*/
 BmNetIBuf::BmNetIBuf( BmNetJobModel* job)
 	:	mJob( job)
+	,	mStopped( false)
 {
 }
 
@@ -661,7 +663,7 @@ uint32 BmNetIBuf::Read( char* dest, uint32 destLen)
 	int32 timeWaiting = 0;
 	int32 numBytes = 0;
 	Connection()->SetTimeout( feedbackTimeout);
-	while( mJob->ShouldContinue() && !numBytes) {
+	while( !mStopped && mJob->ShouldContinue() && !numBytes) {
 		BM_LOG3( mJob->LogType(), 
 					BmString("Trying to receive up to ") << destLen << " bytes...");
 		numBytes = Connection()->Receive( dest, destLen);
@@ -684,7 +686,17 @@ uint32 BmNetIBuf::Read( char* dest, uint32 destLen)
 \*------------------------------------------------------------------------------*/
 bool BmNetIBuf::IsAtEnd() 
 {
-	return false;
+	return mStopped;
+}
+
+/*------------------------------------------------------------------------------*\
+	Stop()
+		-	makes a blocked Read() return (within the feedback-timeout), such
+			that a filter-pipeline reading from the network can be stopped
+\*------------------------------------------------------------------------------*/
+void BmNetIBuf::Stop() 
+{
+	mStopped = true;
 }
 
 
@@ -235,9 +235,14 @@ class IMPEXPBMDAEMON BmNetIBuf : public BmMemIBuf {
 public:
 	BmNetIBuf( BmNetJobModel* job);
 	
+	// native methods:
+	void Reset()								{ mStopped = false; }
+							// re-arms the buffer after a Stop()
+
 	// overrides of BmMemIBuf base:
 	uint32 Read( char* data, uint32 reqLen);
 	bool IsAtEnd();
+	void Stop();
 
 	// getters:
 	BmNetEndpoint* Connection()			{ return mJob 
@@ -246,7 +251,8 @@ public:
 
 protected:
 	BmNetJobModel* mJob;
-	
+	volatile bool mStopped;
+							// set by Stop() (from another thread)
 };
 
 
@@ -15,18 +15,22 @@
 #endif
 #include <NetAddress.h>
 #include <NetEndpoint.h>
+#include <Path.h>
 
 #include "regexx.hh"
 using namespace regexx;
 
 #include "BmBasics.h"
+#include "BmByteKernels.h"
 #include "BmEncoding.h"
 	using namespace BmEncoding;
 #include "BmFilter.h"
 #include "BmIdentity.h"
 #include "BmLogHandler.h"
 #include "BmMail.h"
+#include "BmMailFilter.h"
 #include "BmMailHeader.h"
+#include "BmMailRef.h"
 #include "BmMemIO.h"
 #include "BmNetEndpointRoster.h"
 #include "BmNetUtil.h"
@@ -36,6 +40,7 @@ using namespace regexx;
 #include "BmRosterBase.h"
 #include "BmSmtpAccount.h"
 #include "BmSmtp.h"
+#include "BmStringView.h"
 #include "BmUtil.h"
 
 
@@ -175,6 +180,7 @@ BmSmtp::BmSmtp( const BmString& name, BmSmtpAccount* account)
 	,	mCurrMailSize( 0)
 	,	mState( 0)
 	,	mServerMayHaveSizeLimit( false)
+	,	mServerSizeLimit( 0)
 	,	mServerSupportsDSN( false)
 	,	mServerSupportsTLS( false)
 {
@@ -405,8 +411,13 @@ void BmSmtp::StateHelo() {
 	try {
 		CheckForPositiveAnswer();
 		Regexx rx;
-		if (rx.exec( StatusText(), "^\\d\\d\\d.SIZE\\b", Regexx::newline)) {
+		if (rx.exec( 
+			StatusText(), "^\\d\\d\\d.SIZE\\b[ \\t]*(\\d*)", Regexx::newline
+		)) {
 			mServerMayHaveSizeLimit = true;
+			// a limit of 0 means that the server doesn't announce it:
+			BmString sizeLimitStr = rx.match[0].atom[0];
+			mServerSizeLimit = atoi( sizeLimitStr.String());
 		}
 		if (rx.exec( StatusText(), "^\\d\\d\\d.DSN\\b", Regexx::newline)) {
 			mServerSupportsDSN = true;
@@ -620,7 +631,16 @@ void BmSmtp::StateSendMails() {
 			continue;
 		}
 		BmRef<BmMail> mail = BmMail::CreateInstance( mailRefs[i].Get());
-		if (mail) {
+		if (!mail)
+			continue;
+		// the mail is sent straight from the text of its file, such that only
+		// its header has to be parsed (the mail is only read as a whole if 
+		// the outbound filters need it, see below):
+		BmRef<BmMail> headerMail = mail;
+		BmString mailText;
+		BmStringView bodyText;
+		if (!ReadMailForSending( mailRefs[i].Get(), headerMail, mailText, 
+										 bodyText)) {
 			if (mail->InitCheck() != B_OK)
 				mail->StartJobInThisThread( BmMail::BM_READ_MAIL_JOB);
 			if (mail->InitCheck() != B_OK) {
@@ -628,11 +648,27 @@ void BmSmtp::StateSendMails() {
 									<< " can't be read, skipping it.");
 				continue;
 			}
+			headerMail = mail;
+			bodyText = BmStringView( mail->RawText(), mail->HeaderLength(), 
+											 mail->RawText().Length()
+												- mail->HeaderLength());
+		}
+		mCurrMailSize = headerMail->HeaderLength() + bodyText.Length();
+		if (mServerSizeLimit > 0 && mCurrMailSize > mServerSizeLimit) {
+			// no need to transmit anything, the server would reject the mail
+			// anyway:
+			BM_LOGERR( BmString("SendMails(): mail no. ") << i+1
+								<< " couldn't be sent.\n\nError:\n"
+								<< "The mail has a size of " 
+								<< BytesToString( mCurrMailSize) 
+								<< ", but the server only accepts mails of up to "
+								<< BytesToString( mServerSizeLimit) << ".");
+			mailRefs[i]->MarkAs( BM_MAIL_STATUS_ERROR);
+			continue;
 		}
-		mCurrMailSize = mail->RawText().Length();
 
-		BmString headerText = mail->HeaderText();
-		if (!mail->Header()->IsFieldEmpty(BM_FIELD_RESENT_BCC)) {
+		BmString headerText = headerMail->HeaderText();
+		if (!headerMail->Header()->IsFieldEmpty(BM_FIELD_RESENT_BCC)) {
 			// remove RESENT-BCC-header from mailtext...
 			headerText = rx.replace(
 				headerText,
@@ -640,7 +676,7 @@ void BmSmtp::StateSendMails() {
 				"", Regexx::newline
 			);
 		}
-		if (!mail->Header()->IsFieldEmpty(BM_FIELD_BCC)) {
+		if (!headerMail->Header()->IsFieldEmpty(BM_FIELD_BCC)) {
 			// remove BCC-header from mailtext...
 			headerText = rx.replace(
 				headerText,
@@ -652,29 +688,36 @@ void BmSmtp::StateSendMails() {
 		try {
 			BmRcptSet rcptSet;
 			if (ThePrefs->GetBool("SpecialHeaderForEachBcc")) {
-				if (HasStdRcpts( mail.Get(), rcptSet)) {
-					Mail( mail.Get());
+				if (HasStdRcpts( headerMail.Get(), rcptSet)) {
+					Mail( headerMail.Get());
 					Rcpt( rcptSet);
-					Data( mail.Get(), headerText);
+					Data( headerMail.Get(), headerText, bodyText);
 				}
-				BccRcpt( mail.Get(), true, headerText);
+				BccRcpt( headerMail.Get(), true, headerText, bodyText);
 			} else {
-				Mail( mail.Get());
-				if (HasStdRcpts( mail.Get(), rcptSet))
+				Mail( headerMail.Get());
+				if (HasStdRcpts( headerMail.Get(), rcptSet))
 					Rcpt( rcptSet);
-				BccRcpt( mail.Get(), false, headerText);
-				Data( mail.Get(), headerText);
+				BccRcpt( headerMail.Get(), false, headerText, bodyText);
+				Data( headerMail.Get(), headerText, bodyText);
 			}
+			mailText.Truncate( 0, false);
 			if (ShouldContinue()) {
-				mail->MarkAs( BM_MAIL_STATUS_SENT);
-				mail->ApplyOutboundFilters();
-					// give filters a chance that check for 'Sent'-status...
+				mailRefs[i]->MarkAs( BM_MAIL_STATUS_SENT);
+				// give filters a chance that check for 'Sent'-status (they
+				// need the complete mail, so it's only read if there are any):
+				if (BmMailFilter::HaveOutboundFilters()) {
+					if (mail->InitCheck() != B_OK)
+						mail->StartJobInThisThread( BmMail::BM_READ_MAIL_JOB);
+					if (mail->InitCheck() == B_OK)
+						mail->ApplyOutboundFilters();
+				}
 			}
 		} catch( BM_runtime_error &err) {
 			// a problem occurred, we tell the user:
 			BM_LOGERR( BmString("SendMails(): mail no. ") << i+1
 								<< " couldn't be sent.\n\nError:\n" << err.what());
-			mail->MarkAs( BM_MAIL_STATUS_ERROR);
+			mailRefs[i]->MarkAs( BM_MAIL_STATUS_ERROR);
 				// mark mail as ERROR since it couldn't be sent
 			SendCommand("RSET");
 				// reset SMTP-state in order to start afresh with next mail
@@ -684,6 +727,57 @@ void BmSmtp::StateSendMails() {
 	mCurrMailNr = 0;
 }
 
+/*------------------------------------------------------------------------------*\
+	ReadMailForSending( ref, headerMail, mailText, bodyText)
+		-	reads the file of the given mail into mailText and parses only its
+			header (into headerMail), such that the mail can be sent straight 
+			from the file's text (bodyText refers into mailText)
+		-	the file is read, not mapped, since a mail in the outbox may be
+			changed by others while we are sending it
+		-	returns false if the mail has to be read as a whole instead, since 
+			the file couldn't be read or isn't in canonical form (the mail-text
+			of a BmMail uses CRLF-linebreaks and contains no binary nulls)
+\*------------------------------------------------------------------------------*/
+bool BmSmtp::ReadMailForSending( BmMailRef* ref, BmRef<BmMail>& headerMail,
+											BmString& mailText, BmStringView& bodyText) {
+	BmMappedFileIBuf mailData( BPath( ref->EntryRefPtr()).Path(), true);
+	if (mailData.InitCheck() != B_OK || !mailData.Size()
+	|| mailData.Size() > INT32_MAX)
+		return false;
+	int32 size = int32(mailData.Size());
+	char* buf = mailText.LockBuffer( size);
+	if (!buf)
+		return false;
+	int32 len = 0;
+	uint32 readLen;
+	while( len < size && (readLen = mailData.Read( buf+len, size-len)) > 0)
+		len += readLen;
+	buf[len] = '\0';
+	mailText.UnlockBuffer( len);
+	int32 bareLFs, crlfs;
+	BmByteKernels::CountLinebreaks( mailText.String(), mailText.Length(), 
+											  bareLFs, crlfs);
+	if (bareLFs 
+	|| BmByteKernels::FindByte( mailText.String(), mailText.Length(), 0))
+		return false;
+	BmStringView mailView( mailText);
+	int32 headerLen = mailView.FindFirst( "\r\n\r\n");
+	if (headerLen == B_ERROR)
+		headerLen = mailView.Length();
+	else
+		headerLen += 2;
+							// don't include separator-line in header-string
+	BM_LOG2( BM_LogSmtp, 
+				BmString("sending mail <") << ref->Key() 
+					<< "> from mail-file");
+	headerMail 
+		= new BmMail( mailView.SubView( 0, headerLen).ToString(), ref->Account());
+	if (headerMail->InitCheck() != B_OK)
+		return false;
+	bodyText = mailView.SubView( headerLen);
+	return true;
+}
+
 /*------------------------------------------------------------------------------*\
 	StateDisconnect()
 		-	tells the server that we are finished
@@ -707,10 +801,8 @@ void BmSmtp::Mail( BmMail* mail) {
 		sender << OwnDomain( fqdn);
 	}
 	BmString cmd = BmString("MAIL from:<") << sender <<">";
-	if (mServerMayHaveSizeLimit) {
-		int32 mailSize = mail->RawText().Length();
-		cmd << " SIZE=" << mailSize;
-	}
+	if (mServerMayHaveSizeLimit)
+		cmd << " SIZE=" << mCurrMailSize;
 	SendCommand( cmd);
 	CheckForPositiveAnswer();
 }
@@ -762,13 +854,14 @@ void BmSmtp::Rcpt( const BmRcptSet& rcptSet) {
 }
 
 /*------------------------------------------------------------------------------*\
-	BccRcpt( mail, sendDataForEachBcc)
+	BccRcpt( mail, sendDataForEachBcc, headerText, bodyText)
 		-	announces all Bcc-recipients of given mail to the server
 		-	if param sendDataForEachBcc is set, a new mail will be created for each
 			Bcc-recipient, containing only it inside the Bcc-header
 \*------------------------------------------------------------------------------*/
 void BmSmtp::BccRcpt( BmMail* mail, bool sendDataForEachBcc,
-							 const BmString& headerText) {
+							 const BmString& headerText, 
+							 const BmStringView& bodyText) {
 	BmAddrList::const_iterator iter;
 	const BmAddressList& bccList
 		= mail->IsRedirect()
@@ -781,17 +874,21 @@ void BmSmtp::BccRcpt( BmMail* mail, bool sendDataForEachBcc,
 		SendCommand( cmd);
 		CheckForPositiveAnswer();
 		if (sendDataForEachBcc)
-			Data( mail, headerText, iter->AddrSpec());
+			Data( mail, headerText, bodyText, iter->AddrSpec());
 	}
 }
 
 /*------------------------------------------------------------------------------*\
-	Data( mail, forBcc)
-		-	sends the given mail (the mailtext) to the server
+	Data( mail, headerText, bodyText, forBcc)
+		-	sends the given mail (headerText followed by bodyText, which starts
+			with the empty line behind the header) to the server
+		-	the text is dot-stuffed and sent block by block, so no copy of 
+			the mail is made (bodyText may point into the mail-file's text)
 		-	if param forBcc is set, the contained address is set as the mail's
 			Bcc-header (only this address)
 \*------------------------------------------------------------------------------*/
-void BmSmtp::Data( BmMail* mail, const BmString& headerText, BmString forBcc) {
+void BmSmtp::Data( BmMail* mail, const BmString& headerText, 
+						 const BmStringView& bodyText, BmString forBcc) {
 	BmString cmd( "DATA");
 	SendCommand( cmd);
 	CheckForPositiveAnswer();
@@ -810,10 +907,10 @@ void BmSmtp::Data( BmMail* mail, const BmString& headerText, BmString forBcc) {
 	} else
 		completeHeader = headerText;
 	BmStringIBuf sendBuf( completeHeader);
-	sendBuf.AddBuffer( mail->RawText().String()+mail->HeaderLength());
+	sendBuf.AddBuffer( bodyText.Data(), bodyText.Length());
 	time_t before = time(NULL);
 	SendCommandBuf( sendBuf, "", true, true);
-	int32 len = mail->RawText().Length();
+	int32 len = mCurrMailSize;
 	if (len > ThePrefs->GetInt("LogSpeedThreshold", 100*1024)) {
 		time_t after = time(NULL);
 		time_t duration = after-before > 0 ? after-before : 1;
@@ -19,7 +19,9 @@
 
 #include "BmNetJobModel.h"
 
+class BmMailRef;
 class BmSmtpAccount;
+class BmStringView;
 
 enum {
 	BM_SMTP_NEEDS_PWD			= 'bmSp'
@@ -137,18 +139,24 @@ private:
 	void StateSendMails();
 	void StateDisconnect();
 
+	bool ReadMailForSending( BmMailRef* ref, BmRef<BmMail>& headerMail,
+									 BmString& mailText, BmStringView& bodyText);
 	void Quit( bool WaitForAnswer=false);
 	void Mail( BmMail *mail);
 	bool HasStdRcpts( BmMail *mail, BmRcptSet& rcptSet);
 	void Rcpt( const BmRcptSet& rcptSet);
 	void BccRcpt( BmMail *mail, bool sendDataForEachBcc, 
-					  const BmString& headerText);
-	void Data( BmMail *mail, const BmString& headerText, BmString forBcc="");
+					  const BmString& headerText, const BmStringView& bodyText);
+	void Data( BmMail *mail, const BmString& headerText, 
+				  const BmStringView& bodyText, BmString forBcc="");
 	void UpdateSMTPStatus( const float, const char*, bool failed=false, 
 								  bool stopped=false);
 	void UpdateMailStatus( const float, const char*, int32);
 
 	bool mServerMayHaveSizeLimit;
+	int32 mServerSizeLimit;
+							// maximum size of a mail as announced by the server
+							// (0 if unknown)
 	bool mServerSupportsDSN;
 	bool mServerSupportsTLS;
 	BmString mSupportedAuthTypes;
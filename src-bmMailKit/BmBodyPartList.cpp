@@ -21,20 +21,31 @@ using namespace regexx;
 
 
 #include "BmBasics.h"
+#include "BmBlockPool.h"
 #include "BmBodyPartList.h"
 #include "BmEncoding.h"
 	using namespace BmEncoding;
+#include "BmFilterPipeline.h"
 #include "BmLogHandler.h"
 #include "BmMail.h"
 #include "BmMailHeader.h"
 #include "BmPrefs.h"
 #include "BmRosterBase.h"
 #include "BmStorageUtil.h"
+#include "BmStringSearch.h"
+#include "BmStringView.h"
 #include "BmUtil.h"
 
 #undef BM_LOGNAME
 #define BM_LOGNAME "MailParser"
 
+// the text in front of the first subpart of a multipart:
+static const char* BM_MULTIPART_PREAMBLE 
+	= "This is a multi-part message in MIME format.\r\n\r\n";
+
+// text bodies of at least this size are converted by a filter-pipeline:
+static const int32 nPipelineThreshold = 4*1024*1024;
+
 /********************************************************************************\
 	BmContentField
 \********************************************************************************/
@@ -52,58 +63,88 @@ BmContentField::BmContentField( const BmString cfString) {
 	-	parses given content-field
 \*------------------------------------------------------------------------------*/
 void BmContentField::SetTo( const BmString cfString) {
-	Regexx rx;
-
-	if (rx.exec( cfString, "^\\s*([^\\s;]+)\\s*([;\\s].*)?\\s*$", 
-					 Regexx::newline)) {
-		// extract value:
-		if (rx.match[0].atom.size() > 0) {
-			if (cfString[rx.match[0].atom[0].start()] == '"') {
-				// skip quotes during extraction:
-				cfString.CopyInto( mValue, rx.match[0].atom[0].start()+1, 
-										 rx.match[0].atom[0].Length()-2);
+	BmStringView field( cfString);
+	field.Trim( true, false);
+
+	// extract value:
+	int32 valueLen = 0;
+	while( valueLen < field.Length() && field[valueLen] != ';'
+	&& !isspace( (unsigned char)field[valueLen]))
+		valueLen++;
+	if (!valueLen) {
+		BM_LOG(BM_LogMailParse, BmString("field-value <")<<cfString
+							<<"> has unknown structure!");
+		return;
+	}
+	BmStringView value = field.SubView( 0, valueLen);
+	if (value[0] == '"')
+		// skip quotes during extraction:
+		value = value.SubView( 1, valueLen-2);
+	value.CopyInto( mValue);
+	mValue.ToLower();
+	BM_LOG2( BM_LogMailParse, BmString("...found value: ")<<mValue);
+
+	// parse and extract parameters, each of which looks like
+	// 	;? key = value
+	// where value may be quoted (with the closing quote being optional):
+	BmStringView params = field.SubView( valueLen);
+	const int32 len = params.Length();
+	int32 pos = 0;
+	while( pos < len) {
+		int32 p = pos;
+		if (params[p] == ';')
+			p++;
+		while( p < len && isspace( (unsigned char)params[p]))
+			p++;
+		int32 keyStart = p;
+		while( p < len && (isalnum( (unsigned char)params[p]) || params[p]=='_'))
+			p++;
+		int32 keyEnd = p;
+		while( p < len && isspace( (unsigned char)params[p]))
+			p++;
+		if (keyEnd == keyStart || p == len || params[p] != '=') {
+			// no match at this position, try next one:
+			pos++;
+			continue;
+		}
+		p++;
+		while( p < len && isspace( (unsigned char)params[p]))
+			p++;
+		int32 valStart = p;
+		BmStringView val;
+		if (p+1 < len && params[p] == '"' && params[p+1] != '"') {
+			// skip quotes during extraction:
+			int32 closingQuote = params.FindFirst( '"', p+1);
+			if (closingQuote == B_ERROR) {
+				val = params.SubView( valStart+1);
+				p = len;
 			} else {
-				mValue = rx.match[0].atom[0];
+				val = params.SubView( valStart+1, closingQuote-valStart-1);
+				p = closingQuote+1;
 			}
-		}
-		mValue.ToLower();
-		BM_LOG2( BM_LogMailParse, BmString("...found value: ")<<mValue);
-		// parse and extract parameters:
-		BmString params;
-		if (rx.match[0].atom.size() > 1)
-			params = rx.match[0].atom[1];
-		if (rx.exec( params, 
-						 ";?\\s*(\\w+)\\s*=\\s*((?:\\\"[^\"]+\\\"?)|(?:[^;\\s]+))", 
-						 Regexx::global)) {
-			for( uint32 i=0; i<rx.match.size(); ++i) {
-				BmString key;
-				BmString val;
-				if (rx.match[0].atom.size() > 0) {
-					key = rx.match[i].atom[0];
-					if (rx.match[0].atom.size() > 1) {
-						if (params[rx.match[i].atom[1].start()] == '"') {
-							// skip quotes during extraction:
-							int skip = params[rx.match[i].atom[1].start()
-													+rx.match[i].atom[1].Length()-1] == '"'
-											? 2 : 1;
-							params.CopyInto( val, rx.match[i].atom[1].start()+1, 
-												  rx.match[i].atom[1].Length()-skip);
-						} else {
-							val = rx.match[i].atom[1];
-						}
-					}
-					key.ToLower();
-					mParams[key] = val;
-					BM_LOG2( BM_LogMailParse, 
-								BmString("...found param: ")<<key
-									<<" with value: "<<val);
-				}
+		} else {
+			while( p < len && params[p] != ';' 
+			&& !isspace( (unsigned char)params[p]))
+				p++;
+			if (p == valStart) {
+				pos++;
+				continue;
+			}
+			val = params.SubView( valStart, p-valStart);
+			if (val[0] == '"') {
+				// skip quotes during extraction:
+				int32 skip = val.Length() > 1 && val[val.Length()-1] == '"' 
+									? 2 : 1;
+				val = val.SubView( 1, val.Length()-skip);
 			}
 		}
-	} else {
-		BM_LOG(BM_LogMailParse, BmString("field-value <")<<cfString
-							<<"> has unknown structure!");
-		return;
+		BmString key = params.SubView( keyStart, keyEnd-keyStart).ToString();
+		key.ToLower();
+		val.CopyInto( mParams[key]);
+		BM_LOG2( BM_LogMailParse, 
+					BmString("...found param: ")<<key
+						<<" with value: "<<mParams[key]);
+		pos = p;
 	}
 	mInitCheck = B_OK;
 }
@@ -190,9 +231,14 @@ BmBodyPart::BmBodyPart( BmBodyPartList* model, const BmString& msgtext,
 	,	mStartInRawText( 0)
 	,	mBodyLength( 0)
 	,	mHaveDecodedData( false)
+	,	mDataIsInFile( false)
+	,	mFileSize( 0)
 	,	mSuggestedCharset( defaultCharset)
 	,	mCurrentCharset( defaultCharset)
 	, 	mHadErrorDuringConversion( false)
+	,	mEncodedBodySize( -1)
+	,	mHaveConvertedText( false)
+	,	mIsPreparedForSending( false)
 {
 	if (!mSuggestedCharset.Length())
 		mCurrentCharset = mSuggestedCharset 
@@ -217,9 +263,14 @@ BmBodyPart::BmBodyPart( BmBodyPartList* model, const entry_ref* ref,
 	// we can't store info about mailtext, since there is no mailtext available:
 	,	mBodyLength( 0)
 	,	mHaveDecodedData( false)
+	,	mDataIsInFile( false)
+	,	mFileSize( 0)
 	,	mSuggestedCharset( defaultCharset)
 	,	mCurrentCharset( defaultCharset)
 	, 	mHadErrorDuringConversion( false)
+	,	mEncodedBodySize( -1)
+	,	mHaveConvertedText( false)
+	,	mIsPreparedForSending( false)
 {
 	if (!mSuggestedCharset.Length())
 		mCurrentCharset = mSuggestedCharset 
@@ -253,9 +304,19 @@ BmBodyPart::BmBodyPart( BmBodyPartList* model, const entry_ref* ref,
 			}
 		}
 		if (!mHaveDecodedData) {
-			FetchFile(filepath, mDecodedData);
+			if (mimetype.ICompare( "text/", 5) != 0
+			&& mimetype.ICompare( "message/", 8) != 0) {
+				// binary data will be encoded straight from the file when 
+				// the mail is being sent, so all we need for now is the size:
+				off_t size = 0;
+				BEntry( ref, true).GetSize( &size);
+				mFileSize = int32( min_c( size, (off_t)INT32_MAX));
+				mDataIsInFile = true;
+			} else {
+				FetchFile(filepath, mDecodedData);
+				mHaveDecodedData = true;
+			}
 			mCurrentCharset = mSuggestedCharset = "UTF-8";
-			mHaveDecodedData = true;
 		}
 
 		mContentType.SetTo( mimetype<<"; name=\"" << ref->name << '"');
@@ -283,7 +344,7 @@ BmBodyPart::BmBodyPart( BmBodyPartList* model, const entry_ref* ref,
 			mBodyLength = mDecodedData.Length();
 		} else {
 			// we compute an encoded-size estimate for base64:
-			mBodyLength = (int)(mDecodedData.Length()*4.1)/3;
+			mBodyLength = (int)(DecodedLength()*4.1)/3;
 		}
 		
 		mInitCheck = B_OK;
@@ -313,12 +374,23 @@ BmBodyPart::BmBodyPart( const BmBodyPart& in)
 	,	mStartInRawText( 0)
 	,	mBodyLength( 0)
 	,	mHaveDecodedData( false)
+	,	mDataIsInFile( false)
+	,	mFileSize( 0)
 	,	mSuggestedCharset( in.SuggestedCharset())
 	,	mCurrentCharset( in.CurrentCharset())
 	, 	mHadErrorDuringConversion( false)
+	,	mEncodedBodySize( -1)
+	,	mHaveConvertedText( false)
+	,	mIsPreparedForSending( false)
 {
-	mDecodedData.SetTo( in.DecodedData());
-	mHaveDecodedData = true;
+	if (in.mDataIsInFile && !in.mHaveDecodedData) {
+		// no need to read the file just for copying:
+		mDataIsInFile = true;
+		mFileSize = in.mFileSize;
+	} else {
+		mDecodedData.SetTo( in.DecodedData());
+		mHaveDecodedData = true;
+	}
 	BmModelItemMap::const_iterator iter;
 	for( iter = in.begin(); iter != in.end(); ++iter) {
 		BmBodyPart* bodyPart = dynamic_cast< BmBodyPart*>( iter->second.Get());
@@ -353,6 +425,7 @@ void BmBodyPart::SetTo( const BmString& msgtext, int32 start, int32 length,
  	
  	mHadErrorDuringConversion = false;
  	mParsingErrors.Truncate(0);
+ 	InvalidateEncodedSize();
  	
  	if (length < 0)
  		length = 0;
@@ -400,7 +473,7 @@ void BmBodyPart::SetTo( const BmString& msgtext, int32 start, int32 length,
 	}
 	// MIME-type
 	BM_LOG2( BM_LogMailParse, "parsing Content-Type");
-	type = header->GetFieldVal( BM_FIELD_CONTENT_TYPE);
+	type = header->GetFieldVal( BM_ATOM_CONTENT_TYPE);
 	if (!type.Length() || type.ICompare("text")==0) {
 		// set content-type to default if is empty or contains "text"
 		// (which is illegal but used by some broken mail-clients, it seems...)
@@ -420,7 +493,7 @@ void BmBodyPart::SetTo( const BmString& msgtext, int32 start, int32 length,
 	}
 	// transferEncoding
 	BM_LOG2( BM_LogMailParse, "parsing Content-Transfer-Encoding");
-	transferEncoding = header->GetFieldVal( BM_FIELD_CONTENT_TRANSFER_ENCODING);
+	transferEncoding = header->GetFieldVal( BM_ATOM_CONTENT_TRANSFER_ENCODING);
 	transferEncoding.RemoveSet( BM_WHITESPACE.String());
 							// some broken (webmail)-clients produce stuff like
 							// "7 bit"...
@@ -465,22 +538,22 @@ void BmBodyPart::SetTo( const BmString& msgtext, int32 start, int32 length,
 	}
 	// id
 	BM_LOG2( BM_LogMailParse, "parsing Content-Id");
-	mContentId = header->GetFieldVal( BM_FIELD_CONTENT_ID);
+	mContentId = header->GetFieldVal( BM_ATOM_CONTENT_ID);
 	BM_LOG2( BM_LogMailParse, BmString("...found value: ")<<mContentId);
 	// disposition
 	BM_LOG2( BM_LogMailParse, "parsing Content-Disposition");
-	disposition = header->GetFieldVal( BM_FIELD_CONTENT_DISPOSITION);
+	disposition = header->GetFieldVal( BM_ATOM_CONTENT_DISPOSITION);
 	if (!disposition.Length())
 		disposition = (IsPlainText() ? "inline" : "attachment");
 	mContentDisposition.SetTo( disposition);
 	// description
 	BM_LOG2( BM_LogMailParse, "parsing Content-Description");
-	mContentDescription = header->GetFieldVal( BM_FIELD_CONTENT_DESCRIPTION);
+	mContentDescription = header->GetFieldVal( BM_ATOM_CONTENT_DESCRIPTION);
 	BM_LOG2( BM_LogMailParse, 
 				BmString("...found value: ")<<mContentDescription);
 	// Language
 	BM_LOG2( BM_LogMailParse, "parsing Content-Language");
-	mContentLanguage = header->GetFieldVal( BM_FIELD_CONTENT_LANGUAGE);
+	mContentLanguage = header->GetFieldVal( BM_ATOM_CONTENT_LANGUAGE);
 	mContentLanguage.ToLower();
 	BM_LOG2( BM_LogMailParse, BmString("...found value: ")<<mContentLanguage);
 	// determine a filename (if possible)
@@ -494,131 +567,34 @@ void BmBodyPart::SetTo( const BmString& msgtext, int32 start, int32 length,
 	}
 		
 	if (mIsMultiPart) {
-		BmString boundary = BmString("--")+mContentType.Param("boundary");
-		if (boundary.Length()==2) {
+		const BmString& boundary = mContentType.Param("boundary");
+		if (!boundary.Length()) {
 			BmString errStr("No boundary specified within multipart-message!");
 			BM_LOG( BM_LogMailParse, errStr);
 			AddParsingError( errStr);
 			return;
 		}
-		char* startPos 
-			= strstr( msgtext.String()+mStartInRawText, boundary.String());
-		if (!startPos) {
+		BM_LOG2( BM_LogMailParse, "finding boundaries...");
+		BmBoundaryScanner scanner( boundary);
+		BmBoundaryScanner::PartVect parts;
+		if (!scanner.Scan( msgtext, mStartInRawText, start+length, parts)) {
 			BmString errStr 
-				= BmString("Boundary <")<<boundary<<"> not found within message.";
+				= BmString("Boundary <--")<<boundary<<"> not found within message.";
 			BM_LOG( BM_LogMailParse, errStr);
 			AddParsingError( errStr);
 			return;
 		}
-		BmString checkStr;
-		BmString foundBoundary;
-		bool isLastBoundary = false;
-		Regexx rx;
-		char* nPos = startPos;
-		int32 foundBoundaryLen;
-							// length of current boundary that was found and matches the
-							// given boundary
-		int32 firstBoundaryLen=0;
-							// length of first (given) boundary
-		while( !isLastBoundary) {
-			while( 1) {
-				// in this loop we determine the next occurence of the current 
-				// boundary, being careful not to accept boundaries that do not
-				// start at the beginning of a line or which are followed by 
-				// nonspace-characters.
-				foundBoundaryLen = boundary.Length();
-				// boundary may have stop-marks (meaning this should be the last
-				// sub-mimepart), we skip those:
-				if (*(nPos+foundBoundaryLen)=='-' 
-				&& *(nPos+foundBoundaryLen+1)=='-')
-					foundBoundaryLen+=2;
-				// skip any space and tabs:
-				while (*(nPos+foundBoundaryLen)==' ' 
-				|| *(nPos+foundBoundaryLen)=='\t')
-					foundBoundaryLen++;
-				// now skip over \r\n if present:
-				if (*(nPos+foundBoundaryLen)=='\r')
-					foundBoundaryLen++;
-				if (*(nPos+foundBoundaryLen)=='\n')
-					foundBoundaryLen++;
-				if (!firstBoundaryLen)
-					firstBoundaryLen = foundBoundaryLen;
-				BM_LOG2( BM_LogMailParse, "finding next boundary...");
-				nPos = strstr( nPos+foundBoundaryLen, boundary.String());
-				if (!nPos) {
-					BM_LOG2( BM_LogMailParse, 
-								"...done (no further boundary found)");
-					break;
-				}
-				BM_LOG2( BM_LogMailParse, "...done (found next boundary)");
-				if (*(nPos-1)=='\n') {
-					BM_LOG2( BM_LogMailParse, "init of boundary check...");
-					char* endOfLine = strchr( nPos, '\r');
-					BM_LOG2( BM_LogMailParse, "...done (init of boundary check)");
-					if (endOfLine) {
-						int32 len=endOfLine-nPos;
-						BM_LOG2( BM_LogMailParse, 
-									BmString("setting checkStr to length ") << len);
-						checkStr.SetTo( nPos, len);
-					} else {
-						BM_LOG2( BM_LogMailParse, "setting checkStr to remainder");
-						checkStr.SetTo( nPos);
-					}
-					// checking for last boundary (with -- appended):
-					BM_LOG2( BM_LogMailParse, "boundary check(1)...");
-					if (rx.exec( checkStr, "^(.+?)--\\s*$", Regexx::newline)
-					&& boundary.ICompare( rx.match[0].atom[0])==0) {
-						isLastBoundary = true;
-						break;
-					}
-					// checking if found boundary starts line and is just 
-					// followed by whitespace (if anything at all):
-					BM_LOG2( BM_LogMailParse, "...boundary check(2)...");
-					if (rx.exec( checkStr, "^(.+?)\\s*$", Regexx::newline)
-					&& boundary.ICompare( rx.match[0].atom[0])==0)
-						break;
-					BM_LOG2( BM_LogMailParse, "...done");
-				}
-			}
-			if (nPos) {
-				int32 startOffs = startPos-msgtext.String()+firstBoundaryLen;
-				BM_LOG2( BM_LogMailParse, 
-							"Subpart of multipart found will be added to array");
-				int32 len = std::max((long)0,nPos-msgtext.String()-startOffs-2);
-							// -2 in order to leave out \r\n before boundary
-				BmBodyPart *subPart 
-					= new BmBodyPart( (BmBodyPartList*)ListModel().Get(), 
-										   msgtext, startOffs, len,
-											defaultCharset, NULL, this);
-				BmAutolockCheckGlobal lock( ListModel()->ModelLocker());
-				if (!lock.IsLocked())
-					BM_THROW_RUNTIME( "BmBodyPart::SetTo(): Unable to get lock");
-				AddSubItem( subPart);
-				startPos = nPos;
-			} else {
-				int32 startOffs = startPos-msgtext.String()+firstBoundaryLen;
-				if (start+length > startOffs) {
-					// the final boundary is missing, we include the remaining 
-					// part as a sub-bodypart anyway:
-					int32 nlPos=msgtext.FindFirst( "\r\n", startOffs);
-					if (nlPos!=B_ERROR && nlPos<start+length) {
-						BM_LOG2( BM_LogMailParse, 
-									"Subpart of multipart found will be added to array");
-						BmBodyPart *subPart 
-							= new BmBodyPart( (BmBodyPartList*)ListModel().Get(), 
-												   msgtext, startOffs, 
-													start+length-startOffs, 
-													defaultCharset, NULL, this);
-						BmAutolockCheckGlobal lock( ListModel()->ModelLocker());
-						if (!lock.IsLocked())
-							BM_THROW_RUNTIME( 
-								"BmBodyPart::SetTo(): Unable to get lock"
-							);
-						AddSubItem( subPart);
-					}
-				}
-				break;
-			}
+		BM_LOG2( BM_LogMailParse, 
+					BmString("...done (") << parts.size() << " subparts found)");
+		for( uint32 i=0; i<parts.size(); ++i) {
+			BmBodyPart *subPart 
+				= new BmBodyPart( (BmBodyPartList*)ListModel().Get(), 
+									   msgtext, parts[i].start, parts[i].length,
+										defaultCharset, NULL, this);
+			BmAutolockCheckGlobal lock( ListModel()->ModelLocker());
+			if (!lock.IsLocked())
+				BM_THROW_RUNTIME( "BmBodyPart::SetTo(): Unable to get lock");
+			AddSubItem( subPart);
 		}
 	}
 	mInitCheck = B_OK;
@@ -695,6 +671,12 @@ void BmBodyPart::DecodeText(const char* tryCharset) {
 	-	
 \*------------------------------------------------------------------------------*/
 const BmString& BmBodyPart::DecodedData() const {
+	if (mDataIsInFile && !mHaveDecodedData) {
+		// someone needs the attachment's data in memory, so we fetch it:
+		FetchFile( BPath( &mEntryRef).Path(), mDecodedData);
+		mHaveDecodedData = true;
+		return mDecodedData;
+	}
 	if (!mHaveDecodedData || mCurrentCharset != mSuggestedCharset) {
 		mParsingErrors.Truncate(0);
 		BmRef<BmListModel> listModel( ListModel());
@@ -709,35 +691,96 @@ const BmString& BmBodyPart::DecodedData() const {
 					BM_LOG2( BM_LogMailParse, 
 								BmString( "(re-)converting bodytext of ") 
 									<< mBodyLength << " bytes...");
+					const char* bodyText 
+						= mail->RawText().String()+mStartInRawText;
+					int32 bodyLength = mBodyLength;
+					BmString encodingStyle = mContentTransferEncoding;
+					BmString transferDecodedText;
 					BmCharsetVect charsetVect;
 					if (mSuggestedCharset != mCurrentCharset 
 					|| !ThePrefs->GetBool("AutoCharsetDetectionInbound", true))
 						// user suggested a charset, we try that:
 						charsetVect.push_back( mSuggestedCharset);
-					else
+					else {
 						// we try the native charset first and (in case of errors)
 						// all preferred charsets:
 						GetPreferredCharsets( charsetVect, mSuggestedCharset);
+						// instead of trying them one after the other, we have a
+						// look at the transfer-decoded bytes and pick the
+						// charset that fits:
+						if (!Is7Bit() && !Is8Bit() && !IsBinary()) {
+							BmStringIBuf text( bodyText, bodyLength);
+							BmMemFilterRef decoder 
+								= FindDecoderFor( &text, encodingStyle);
+							BmStringOBuf tempIO( mBodyLength);
+							tempIO.Write( decoder.get());
+							if (decoder->HaveStatusText())
+								AddParsingError(decoder->StatusText());
+							transferDecodedText.Adopt( tempIO.TheString());
+							bodyText = transferDecodedText.String();
+							bodyLength = transferDecodedText.Length();
+							encodingStyle = "binary";
+						}
+						BmCharsetDetector detector( bodyText, bodyLength);
+						int32 index = detector.PickCharset( charsetVect);
+						if (index >= 0) {
+							BM_LOG2( BM_LogMailParse, 
+										BmString( "detected charset ") 
+											<< charsetVect[index]);
+							BmString charset = charsetVect[index];
+							charsetVect.clear();
+							charsetVect.push_back( charset);
+						}
+					}
 					BmString charset;
 					for( uint32 i=0; i<charsetVect.size(); ++i) {
-						BmStringIBuf text( mail->RawText().String()+mStartInRawText,
-												 mBodyLength);
-						BmMemFilterRef decoder 
-							= FindDecoderFor( &text, mContentTransferEncoding);
-						BmLinebreakDecoder linebreakDecoder( decoder.get());
 						BmStringOBuf tempIO( mBodyLength, 1.2f);
 						charset = charsetVect[i];
 						BM_LOG2( BM_LogMailParse, 
 									BmString( "trying charset ") << charset);
-						BmUtf8Encoder textConverter( &linebreakDecoder, charset);
-						BmMailtextCleaner mailtextCleaner( &textConverter);
-						tempIO.Write( &mailtextCleaner);
-						mHadErrorDuringConversion = textConverter.HadToDiscardChars() 
-											|| textConverter.HadError();
-						if (decoder->HaveStatusText())
-							AddParsingError(decoder->StatusText());
+						bool needsChain = true;
+						if (BmTextBodyDecoder::CanHandle( charset)) {
+							// common charsets are decoded in a single pass:
+							BmStringIBuf text( bodyText, bodyLength);
+							BmTextBodyDecoder textDecoder( 
+								&text, encodingStyle, charset
+							);
+							tempIO.Write( &textDecoder);
+							if (!textDecoder.NeedsFallback()) {
+								needsChain = false;
+								mHadErrorDuringConversion = false;
+								if (textDecoder.HaveStatusText())
+									AddParsingError(textDecoder.StatusText());
+							} else
+								tempIO.Reset();
+						}
+						if (needsChain) {
+							BmStringIBuf text( bodyText, bodyLength);
+							BmMemFilterRef decoder 
+								= FindDecoderFor( &text, encodingStyle);
+							BmLinebreakDecoder linebreakDecoder( decoder.get());
+							BmUtf8Encoder textConverter( &linebreakDecoder, charset);
+							BmMailtextCleaner mailtextCleaner( &textConverter);
+							if (bodyLength >= nPipelineThreshold) {
+								// large bodies keep all stages of the chain busy
+								// at once (the pipeline must be gone before we
+								// look at the converter's state):
+								BmFilterPipeline pipeline;
+								pipeline.AddStage( decoder.get());
+								pipeline.AddStage( &linebreakDecoder);
+								pipeline.AddStage( &textConverter);
+								pipeline.AddStage( &mailtextCleaner);
+								tempIO.Write( &pipeline);
+							} else
+								tempIO.Write( &mailtextCleaner);
+							mHadErrorDuringConversion 
+								= textConverter.HadToDiscardChars() 
+									|| textConverter.HadError();
+							if (decoder->HaveStatusText())
+								AddParsingError(decoder->StatusText());
+						}
 						if (!mHadErrorDuringConversion || i==charsetVect.size()-1) {
-							if (i>0) {
+							if (i>0 || charset != mSuggestedCharset) {
 								AddParsingError(
 									BmString("Autodetected charset (")
 										<< charset << "), may need manual correction"
@@ -771,6 +814,17 @@ const BmString& BmBodyPart::DecodedData() const {
 	return mDecodedData; 
 }
 
+/*------------------------------------------------------------------------------*\
+	DecodedLength()
+	-	returns the size of the decoded data (without reading the attachment
+		file, if the data hasn't been fetched yet)
+\*------------------------------------------------------------------------------*/
+int32 BmBodyPart::DecodedLength() const {
+	if (mDataIsInFile && !mHaveDecodedData)
+		return mFileSize;
+	return DecodedData().Length();
+}
+
 /*------------------------------------------------------------------------------*\
 	ContainsRef()
 	-	
@@ -886,6 +940,7 @@ void BmBodyPart::SetBodyText( const BmString& utf8Text,
 												? "8bit"
 												: "quoted-printable")
 											: "7bit";
+	InvalidateEncodedSize();
 }
 
 /*------------------------------------------------------------------------------*\
@@ -946,156 +1001,267 @@ int32 BmBodyPart::PruneUnneededMultiParts() {
 }
 
 /*------------------------------------------------------------------------------*\
-	EstimateEncodedSize()
-		-	
+	BodyIsInRawText()
+		-	returns whether the part's body is available (in encoded form) within
+			the mail's raw text, which is the case for all parts of a mail but
+			the one being edited
 \*------------------------------------------------------------------------------*/
-int32 BmBodyPart::EstimateEncodedSize() {
-	int32 size = 1024 + (IsMultiPart() ? 0 : mBodyLength);
-							// 1024 makes room for header-fields
-	BmModelItemMap::const_iterator iter;
-	for( iter = begin(); iter != end(); ) {
-		BmBodyPart* bodyPart = dynamic_cast< BmBodyPart*>( iter++->second.Get());
-		size += bodyPart->EstimateEncodedSize();
-	}
-	return size;
+bool BmBodyPart::BodyIsInRawText() const {
+	BmRef<BmListModel> listModel( ListModel());
+	BmBodyPartList* bodyPartList 
+		= dynamic_cast< BmBodyPartList*>( listModel.Get());
+	return bodyPartList && bodyPartList->Mail() && mStartInRawText 
+			&& bodyPartList->EditableTextBody() != this;
 }
 
 /*------------------------------------------------------------------------------*\
-	()
-		-	
+	InvalidateEncodedSize()
+		-	forgets the (cached) encoded text and size of the part's body, 
+			needs to be called whenever the body, its charset or its
+			transfer-encoding change
 \*------------------------------------------------------------------------------*/
-void BmBodyPart::ConstructBodyForSending( BmStringOBuf &msgText) {
-	BmString boundary;
-	if (IsMultiPart()) {
-		PropagateHigherEncoding();
-		boundary = GenerateBoundary();
-		mContentType.SetParam( "boundary", boundary);
-	}
+void BmBodyPart::InvalidateEncodedSize() {
+	mEncodedBodySize = -1;
+	mHaveConvertedText = false;
+	mConvertedText.Truncate( 0);
+}
+
+/*------------------------------------------------------------------------------*\
+	ConvertText()
+		-	converts the (utf-8) text of this part into its charset (or, if that
+			fails and auto-detection is active, into one of the preferred 
+			charsets) and encodes the result
+		-	throws a BM_text_error if the text can't be converted
+\*------------------------------------------------------------------------------*/
+void BmBodyPart::ConvertText() {
+	BM_LOG2( BM_LogMailParse, 
+				BmString( "encoding/converting bodytext of ") 
+								  << DecodedLength() << " bytes to " 
+								  << mCurrentCharset);
 	BmRef<BmListModel> listModel( ListModel());
-	const BmMail* mail = NULL;
-	BmBodyPartList* bodyPartList = NULL;
-	if (listModel) {
-		bodyPartList = dynamic_cast< BmBodyPartList*>( listModel.Get());
-		if (bodyPartList)
-			mail = bodyPartList->Mail();
-	}
-	bool haveEncodedText 
-		= bodyPartList && mail && mStartInRawText 
-			&& bodyPartList->EditableTextBody() != this;
-	BmString encodedTextStr;
-	if (IsText()) {
-		if (!haveEncodedText) {
-			// need to convert the text from utf-8 to native charset:
-			BM_LOG2( BM_LogMailParse, 
-						BmString( "encoding/converting bodytext of ") 
-										  << DecodedLength() << " bytes to " 
-										  << mCurrentCharset);
-			BmCharsetVect charsetVect;
-			if (ThePrefs->GetBool("AutoCharsetDetectionOutbound", true)) {
-				// we try the native charset first and (in case of errors)
-				// all preferred charsets:
-				GetPreferredCharsets(charsetVect, mCurrentCharset, true);
-			} else
-				charsetVect.push_back(mCurrentCharset);
-			BmString charset;
-			for( uint32 i=0; i<charsetVect.size(); ++i) {
-				charset = charsetVect[i];
-				BM_LOG2( BM_LogMailParse, BmString( "trying charset ") << charset);
-				BmStringIBuf text( DecodedData());
-				BmUtf8Decoder textConverter( &text, charset);
-				BmMemFilterRef encoder 
-					= FindEncoderFor( &textConverter, mContentTransferEncoding);
-				BmStringOBuf encodedText(DecodedLength());
-				encodedText.Write( encoder.get());
-				if (textConverter.HadError() || textConverter.HadToDiscardChars()) {
-					if (i+1 == charsetVect.size()) {
-						// last round, autodetection of charset failed, so we bail:
-						BmString errText
-							= (bodyPartList->EditableTextBody() == this)
-								?	BmString("The mailtext contains characters that ")
-									<< "could not be converted to the selected charset ("
-									<< mCurrentCharset << ").\n\n"
-									<< "Please select the correct charset or remove "
-									<< "the offending characters."
-								:	BmString("The attachment ") << FileName()
-									<< " contains characters that "
-									<< "could not be converted to the selected charset ("
-									<< mCurrentCharset << ").\n\n"
-									<< "Please re-add the attachment with the correct "
-									<< "charset.";
-						throw BM_text_error( 
-							errText, "", textConverter.FirstDiscardedPos()
-						);
-					}
-				} else {
-					encodedTextStr.Adopt( encodedText.TheString());
-					mCurrentCharset = mSuggestedCharset = charset;
-					break;
-				}
+	BmBodyPartList* bodyPartList 
+		= dynamic_cast< BmBodyPartList*>( listModel.Get());
+	BmCharsetVect charsetVect;
+	if (ThePrefs->GetBool("AutoCharsetDetectionOutbound", true)) {
+		// we try the native charset first and (in case of errors)
+		// all preferred charsets:
+		GetPreferredCharsets(charsetVect, mCurrentCharset, true);
+	} else
+		charsetVect.push_back(mCurrentCharset);
+	BmString charset;
+	for( uint32 i=0; i<charsetVect.size(); ++i) {
+		charset = charsetVect[i];
+		BM_LOG2( BM_LogMailParse, BmString( "trying charset ") << charset);
+		BmStringIBuf text( DecodedData());
+		BmUtf8Decoder textConverter( &text, charset);
+		BmMemFilterRef encoder 
+			= FindEncoderFor( &textConverter, mContentTransferEncoding);
+		BmStringOBuf encodedText(DecodedLength());
+		encodedText.Write( encoder.get());
+		if (textConverter.HadError() || textConverter.HadToDiscardChars()) {
+			if (i+1 == charsetVect.size()) {
+				// last round, autodetection of charset failed, so we bail:
+				BmString errText
+					= (bodyPartList && bodyPartList->EditableTextBody() == this)
+						?	BmString("The mailtext contains characters that ")
+							<< "could not be converted to the selected charset ("
+							<< mCurrentCharset << ").\n\n"
+							<< "Please select the correct charset or remove "
+							<< "the offending characters."
+						:	BmString("The attachment ") << FileName()
+							<< " contains characters that "
+							<< "could not be converted to the selected charset ("
+							<< mCurrentCharset << ").\n\n"
+							<< "Please re-add the attachment with the correct "
+							<< "charset.";
+				throw BM_text_error( 
+					errText, "", textConverter.FirstDiscardedPos()
+				);
 			}
-			BM_LOG2( BM_LogMailParse, "...done (bodytext)");
+		} else {
+			mConvertedText.Adopt( encodedText.TheString());
+			mCurrentCharset = mSuggestedCharset = charset;
+			break;
 		}
+	}
+	mHaveConvertedText = true;
+	int32 len = mConvertedText.Length();
+	mEncodedBodySize 
+		= len + (len && mConvertedText[len-1] != '\n' ? 2 : 0);
+	BM_LOG2( BM_LogMailParse, "...done (bodytext)");
+}
+
+/*------------------------------------------------------------------------------*\
+	PrepareForSending()
+		-	fixes everything that is needed for determining the exact size
+			of the part: multiparts get a fresh boundary, texts are converted
+			into their charset
+\*------------------------------------------------------------------------------*/
+void BmBodyPart::PrepareForSending() {
+	if (IsMultiPart()) {
+		PropagateHigherEncoding();
+		mContentType.SetParam( "boundary", GenerateBoundary());
+	} else if (IsText()) {
+		if (!BodyIsInRawText() && !mHaveConvertedText)
+			ConvertText();
 		mContentType.SetParam( "charset", mCurrentCharset);
 	}
-	msgText << BM_FIELD_CONTENT_TYPE << ": " << mContentType << "\r\n";
-	msgText << BM_FIELD_CONTENT_TRANSFER_ENCODING << ": " 
-			  << mContentTransferEncoding << "\r\n";
-	msgText << BM_FIELD_CONTENT_DISPOSITION << ": " << mContentDisposition 
-			  << "\r\n";
+	mIsPreparedForSending = true;
+}
+
+/*------------------------------------------------------------------------------*\
+	MimeHeader()
+		-	returns the MIME-header of this part (including the empty line that
+			separates it from the body)
+\*------------------------------------------------------------------------------*/
+BmString BmBodyPart::MimeHeader() const {
+	BmString header;
+	header << BM_FIELD_CONTENT_TYPE << ": " << mContentType << "\r\n";
+	header << BM_FIELD_CONTENT_TRANSFER_ENCODING << ": " 
+			 << mContentTransferEncoding << "\r\n";
+	header << BM_FIELD_CONTENT_DISPOSITION << ": " << mContentDisposition 
+			 << "\r\n";
 	if (mContentDescription.Length())
-		msgText << BM_FIELD_CONTENT_DESCRIPTION << ": " << mContentDescription 
-				  << "\r\n";
+		header << BM_FIELD_CONTENT_DESCRIPTION << ": " << mContentDescription 
+				 << "\r\n";
 	if (mContentId.Length())
-		msgText << BM_FIELD_CONTENT_ID << ": " << mContentId << "\r\n";
+		header << BM_FIELD_CONTENT_ID << ": " << mContentId << "\r\n";
 	if (mContentLanguage.Length())
-		msgText << BM_FIELD_CONTENT_LANGUAGE << ": " << mContentLanguage 
-				  << "\r\n";
-	msgText << "\r\n";
+		header << BM_FIELD_CONTENT_LANGUAGE << ": " << mContentLanguage 
+				 << "\r\n";
+	header << "\r\n";
+	return header;
+}
 
-	if (IsMultiPart())
-		msgText << "This is a multi-part message in MIME format.\r\n\r\n";
-	else {
-		uint32 newStartPos = msgText.CurrPos();
-	
-		if (haveEncodedText) {
-			// we already have the encoded text, we simply copy that:
-			BM_LOG2( BM_LogMailParse, 
-						BmString( "copying bodytext of ") << mBodyLength 
-							<< " bytes...");
-			mBodyLength = msgText.Write( mail->RawText().String()+mStartInRawText, 
-												  mBodyLength);
-			BM_LOG2( BM_LogMailParse, "...done (bodytext)");
-		} else {
-			if (IsText()) {
-				// copy encoded text into message:
-				BmStringIBuf text( encodedTextStr);
-				mBodyLength = msgText.Write(&text);
-			} else {
-				// encode buffer:
-				BmStringIBuf text( DecodedData());
-				BM_LOG2( BM_LogMailParse, 
-							BmString( "encoding bodytext of ") << DecodedLength() 
-								<< " bytes...");
-				BmMemFilterRef encoder 
-					= FindEncoderFor( &text, mContentTransferEncoding);
-				mBodyLength = msgText.Write( encoder.get());
-				BM_LOG2( BM_LogMailParse, "...done (bodytext)");
-			}
-		}
-		mStartInRawText = newStartPos;
-		uint32 len = msgText.CurrPos();
-		if (len && msgText.ByteAt( len-1) != '\n')
-			msgText << "\r\n";
+/*------------------------------------------------------------------------------*\
+	EncodedBodySize()
+		-	returns the exact size of this part's body when being sent 
+			(including the linebreak that is added to bodies that lack one)
+		-	the result is cached until the part is changed
+\*------------------------------------------------------------------------------*/
+int32 BmBodyPart::EncodedBodySize() {
+	if (mEncodedBodySize >= 0)
+		return mEncodedBodySize;
+	char lastChar = 0;
+	int32 size;
+	if (IsMultiPart()) {
+		size = strlen( BM_MULTIPART_PREAMBLE);
+		lastChar = '\n';
+	} else if (BodyIsInRawText()) {
+		BmRef<BmListModel> listModel( ListModel());
+		BmBodyPartList* bodyPartList 
+			= dynamic_cast< BmBodyPartList*>( listModel.Get());
+		size = mBodyLength;
+		if (size)
+			lastChar 
+				= bodyPartList->Mail()->RawText()[mStartInRawText+size-1];
+	} else if (IsText()) {
+		// converting the text determines the size, too:
+		ConvertText();
+		return mEncodedBodySize;
+	} else if (mDataIsInFile && !mHaveDecodedData 
+	&& mContentTransferEncoding.ICompare( "base64") == 0) {
+		// no need to read the attachment file, the size is all we need:
+		size = EncodedLength( mContentTransferEncoding, NULL, mFileSize, 
+									 lastChar);
+	} else if (mDataIsInFile && !mHaveDecodedData) {
+		// the size is computed while encoding the attachment file block by 
+		// block, such that the file isn't read into memory (it isn't mapped,
+		// since it may be changed by others at any time):
+		BmMappedFileIBuf file( BPath( &mEntryRef).Path(), true);
+		if (file.InitCheck() != B_OK)
+			BM_THROW_RUNTIME( 
+				BmString("Could not open attachment <") << FileName() 
+					<< ">\n\nError:" << strerror( file.InitCheck())
+			);
+		off_t fileSize = file.Size();
+		size = EncodedLength( mContentTransferEncoding, &file, lastChar);
+		if (file.Size() < fileSize)
+			BM_THROW_RUNTIME( 
+				BmString("Unable to read body of <") << FileName() 
+					<< "> completely"
+			);
+	} else {
+		const BmString& data = DecodedData();
+		size = EncodedLength( mContentTransferEncoding, data.String(), 
+									 data.Length(), lastChar);
 	}
-	BmModelItemMap::const_iterator iter;
-	for( iter = begin(); iter != end(); ++iter) {
-		if (IsMultiPart())
-			msgText << "--"<<boundary<<"\r\n";
-		BmBodyPart* subPart = dynamic_cast< BmBodyPart*>( iter->second.Get());
-		subPart->ConstructBodyForSending( msgText);
+	if (size && lastChar != '\n')
+		size += 2;
+	return mEncodedBodySize = size;
+}
+
+/*------------------------------------------------------------------------------*\
+	EncodedSize()
+		-	returns the exact number of bytes ConstructBodyForSending() will
+			produce for this part (and all its subparts)
+\*------------------------------------------------------------------------------*/
+int32 BmBodyPart::EncodedSize() {
+	if (!mIsPreparedForSending)
+		PrepareForSending();
+	int32 size = MimeHeader().Length() + EncodedBodySize();
+	if (IsMultiPart()) {
+		int32 boundaryLen = TypeParam( "boundary").Length();
+		BmModelItemMap::const_iterator iter;
+		for( iter = begin(); iter != end(); ++iter) {
+			BmBodyPart* subPart = dynamic_cast< BmBodyPart*>( iter->second.Get());
+			size += boundaryLen + 4 + subPart->EncodedSize();
+							// "--" << boundary << "\r\n"
+		}
+		size += boundaryLen + 6;
+							// "--" << boundary << "--\r\n"
 	}
+	return size;
+}
+
+/*------------------------------------------------------------------------------*\
+	ConstructBodyForSending( body)
+		-	adds this part (and all its subparts) to the given body-stream
+\*------------------------------------------------------------------------------*/
+void BmBodyPart::ConstructBodyForSending( BmMimeBodyIBuf& body) {
+	if (!mIsPreparedForSending)
+		PrepareForSending();
+	// the next construction will get a fresh boundary:
+	mIsPreparedForSending = false;
+	body << MimeHeader();
+
+	// the part's body is only produced when it is being read from the 
+	// stream (which updates mStartInRawText and mBodyLength, too):
 	if (IsMultiPart())
-		msgText << "--"<<boundary<<"--\r\n";
+		body << BM_MULTIPART_PREAMBLE;
+	else if (BodyIsInRawText()) {
+		// we already have the encoded text, we simply pass that on:
+		BmRef<BmListModel> listModel( ListModel());
+		BmBodyPartList* bodyPartList 
+			= dynamic_cast< BmBodyPartList*>( listModel.Get());
+		body.AddPartBody( this, 
+								bodyPartList->Mail()->RawText().String()
+									+ mStartInRawText, 
+								mBodyLength);
+	} else if (IsText()) {
+		// pass on the encoded text (which is adopted by the stream):
+		body.AddPartBody( this, mConvertedText);
+		mHaveConvertedText = false;
+	} else if (mDataIsInFile && !mHaveDecodedData) {
+		// encode straight from the (mapped) attachment file:
+		body.AddPartBodyFromFile( this, BPath( &mEntryRef).Path(), 
+										  mContentTransferEncoding);
+	} else {
+		// encode buffer:
+		const BmString& data = DecodedData();
+		body.AddPartBody( this, data.String(), data.Length(), 
+								mContentTransferEncoding);
+	}
+	if (IsMultiPart()) {
+		BmString boundary = TypeParam( "boundary");
+		BmModelItemMap::const_iterator iter;
+		for( iter = begin(); iter != end(); ++iter) {
+			body << "--"<<boundary<<"\r\n";
+			BmBodyPart* subPart = dynamic_cast< BmBodyPart*>( iter->second.Get());
+			subPart->ConstructBodyForSending( body);
+		}
+		body << "--"<<boundary<<"--\r\n";
+	}
 }
 
 /*------------------------------------------------------------------------------*\
@@ -1143,6 +1309,7 @@ BmBodyPartList::BmBodyPartList( BmMail* mail)
 	,	mMail( mail)
 	,	mEditableTextBody( NULL)
 	,	mInitCheck( B_NO_INIT)
+	,	mIsPreparedForSending( false)
 {
 }
 
@@ -1162,10 +1329,16 @@ void BmBodyPartList::ParseMail() {
 	Cleanup();
 	if (mMail && mMail->HeaderLength() >= 2) {
 		const BmString& msgText = mMail->RawText();
+		// N.B.: we can't ask the mail for its default charset, since the mail
+		//       would in turn ask us (and we have no text-part yet):
+		const BmString& defaultCharset 
+			= mMail->SuggestedCharset().Length() 
+				? mMail->SuggestedCharset()
+				: BmEncoding::DefaultCharset;
 		BmBodyPart* bodyPart 
 			= new BmBodyPart( this, msgText, mMail->HeaderLength()+2, 
 									MAX(msgText.Length()-mMail->HeaderLength()-2, 0), 
-									mMail->DefaultCharset(),	mMail->Header());
+									defaultCharset,	mMail->Header());
 		AddItemToList( bodyPart);
 	}
 	mInitCheck = B_OK;
@@ -1335,20 +1508,65 @@ void BmBodyPartList::PruneUnneededMultiParts() {
 }
 
 /*------------------------------------------------------------------------------*\
-	EstimateEncodedSize()
-		-	
+	PrepareForSending()
+		-	determines whether the parts need to be wrapped into a multipart
+			(and generates the boundary for that)
 \*------------------------------------------------------------------------------*/
-int32 BmBodyPartList::EstimateEncodedSize() {
+void BmBodyPartList::PrepareForSending() {
+	BmRef<BmBodyPart> editableTextBody( EditableTextBody());
+	bool hasMultiPartTop = editableTextBody && editableTextBody->Parent();
+	bool isMultiPart = hasMultiPartTop
+								? editableTextBody->Parent()->size() > 1
+								: size() > 1;
+	if (isMultiPart && !hasMultiPartTop)
+		mBoundary = BmBodyPart::GenerateBoundary();
+	else
+		mBoundary.Truncate( 0);
+	mIsPreparedForSending = true;
+}
+
+/*------------------------------------------------------------------------------*\
+	MultiPartHeader()
+		-	returns the header (and preamble) of the multipart that wraps
+			the parts (if they need to be wrapped)
+\*------------------------------------------------------------------------------*/
+BmString BmBodyPartList::MultiPartHeader() const {
+	BmString header;
+	if (mBoundary.Length()) {
+		header << BM_FIELD_CONTENT_TYPE << ": multipart/mixed; boundary=\""
+				 << mBoundary<<"\"\r\n";
+		header << BM_FIELD_CONTENT_TRANSFER_ENCODING << ": 7bit\r\n\r\n";
+		header << BM_MULTIPART_PREAMBLE;
+	}
+	return header;
+}
+
+/*------------------------------------------------------------------------------*\
+	EncodedSize()
+		-	returns the exact size of the body when being sent, such that
+			the buffer for the mail can be allocated in one go
+		-	prepares all parts for sending (the next call to 
+			ConstructBodyForSending() will produce exactly this many bytes)
+\*------------------------------------------------------------------------------*/
+int32 BmBodyPartList::EncodedSize() {
 	BmAutolockCheckGlobal lock( mModelLocker);
 	if (!lock.IsLocked())
 		BM_THROW_RUNTIME( 
-			ModelNameNC() << ":EstimateEncodedSize(): Unable to get lock"
+			ModelNameNC() << ":EncodedSize(): Unable to get lock"
 		);
-	int32 size = 0;
+	if (!mIsPreparedForSending)
+		PrepareForSending();
+	int32 size = MultiPartHeader().Length();
+	if (mBoundary.Length())
+		size += mBoundary.Length() + 4;
+							// "--" << boundary << "\r\n"
 	BmModelItemMap::const_iterator iter;
 	for( iter = begin(); iter != end(); ) {
 		BmBodyPart* bodyPart = dynamic_cast< BmBodyPart*>( iter++->second.Get());
-		size += bodyPart->EstimateEncodedSize();
+		size += bodyPart->EncodedSize();
+		if (mBoundary.Length())
+			size += mBoundary.Length() + (iter == end() ? 6 : 4);
+							// "--" << boundary << ["--"] << "\r\n"
 	}
 	return size;
 }
@@ -1363,32 +1581,426 @@ bool BmBodyPartList::ConstructBodyForSending( BmStringOBuf& msgText) {
 		BM_THROW_RUNTIME( 
 			ModelNameNC() << ":ConstructBodyForSending(): Unable to get lock"
 		);
-	BmRef<BmBodyPart> editableTextBody( EditableTextBody());
-	bool hasMultiPartTop = editableTextBody && editableTextBody->Parent();
-	bool isMultiPart = hasMultiPartTop
-								? editableTextBody->Parent()->size() > 1
-								: size() > 1;
-	BmString boundary;
-	if (isMultiPart && !hasMultiPartTop) {
-		boundary = BmBodyPart::GenerateBoundary();
-		msgText << BM_FIELD_CONTENT_TYPE << ": multipart/mixed; boundary=\""
-				  << boundary<<"\"\r\n";
-		msgText << BM_FIELD_CONTENT_TRANSFER_ENCODING << ": 7bit\r\n\r\n";
-		msgText << "This is a multi-part message in MIME format.\r\n\r\n";
-		msgText << "--"<<boundary<<"\r\n";
-	}
+	BmMimeBodyIBuf body( msgText.CurrPos());
+	if (!ConstructBodyForSending( body))
+		return false;
+	BM_LOG2( BM_LogMailParse, "encoding body...");
+	msgText.Write( &body);
+	BM_LOG2( BM_LogMailParse, 
+				BmString("...done (") << body.ReadLen() << " bytes of body)");
+	return true;
+}
+
+/*------------------------------------------------------------------------------*\
+	ConstructBodyForSending( body)
+		-	collects the MIME-structure of the mail into the given stream, the
+			parts' bodies will be encoded while the stream is being read
+		-	the stream refers to the body-parts (and the mail's text), so it
+			must be read before any of these change
+\*------------------------------------------------------------------------------*/
+bool BmBodyPartList::ConstructBodyForSending( BmMimeBodyIBuf& body) {
+	BmAutolockCheckGlobal lock( mModelLocker);
+	if (!lock.IsLocked())
+		BM_THROW_RUNTIME( 
+			ModelNameNC() << ":ConstructBodyForSending(): Unable to get lock"
+		);
+	if (!mIsPreparedForSending)
+		PrepareForSending();
+	// the next construction will get a fresh boundary:
+	mIsPreparedForSending = false;
+	BmString boundary = mBoundary;
+	body << MultiPartHeader();
+	if (boundary.Length())
+		body << "--"<<boundary<<"\r\n";
 	BmModelItemMap::const_iterator iter;
 	for( iter = begin(); iter != end(); ++iter) {
 		BmBodyPart* bodyPart = dynamic_cast< BmBodyPart*>( iter->second.Get());
-		bodyPart->ConstructBodyForSending( msgText);
-		if (isMultiPart && !hasMultiPartTop) {
+		bodyPart->ConstructBodyForSending( body);
+		if (boundary.Length()) {
 			BmModelItemMap::const_iterator next = iter;
 			next++;
 			if (next == end())
-				msgText << "--"<<boundary<<"--\r\n";
+				body << "--"<<boundary<<"--\r\n";
 			else
-				msgText << "--"<<boundary<<"\r\n";
+				body << "--"<<boundary<<"\r\n";
 		}
 	}
 	return true;
 }
+
+
+
+/********************************************************************************\
+	BmBoundaryScanner
+\********************************************************************************/
+
+/*------------------------------------------------------------------------------*\
+	BmBoundaryScanner( boundary)
+		-	c'tor
+\*------------------------------------------------------------------------------*/
+BmBoundaryScanner::BmBoundaryScanner( const BmString& boundary)
+	:	mBoundary( BmString("--") << boundary)
+	,	mLineStart( BmString("\n--") << boundary)
+{
+}
+
+/*------------------------------------------------------------------------------*\
+	LineLength( pos, end)
+		-	returns the length of the boundary-line at pos, including the 
+			closing "--", trailing spaces and tabs and the linebreak
+\*------------------------------------------------------------------------------*/
+int32 BmBoundaryScanner::LineLength( const char* pos, const char* end) const {
+	const char* p = pos + mBoundary.Length();
+	if (p+1 < end && p[0] == '-' && p[1] == '-')
+		p += 2;
+	while( p < end && (*p == ' ' || *p == '\t'))
+		p++;
+	if (p < end && *p == '\r')
+		p++;
+	if (p < end && *p == '\n')
+		p++;
+	return p - pos;
+}
+
+/*------------------------------------------------------------------------------*\
+	IsBoundaryLine( pos, end, isLast)
+		-	checks whether the boundary found at pos is followed by nothing but
+			whitespace (up to the next CR), the closing "--" aside (which sets
+			isLast)
+\*------------------------------------------------------------------------------*/
+bool BmBoundaryScanner::IsBoundaryLine( const char* pos, const char* end, 
+													 bool& isLast) const {
+	const char* p = pos + mBoundary.Length();
+	isLast = p+1 < end && p[0] == '-' && p[1] == '-';
+	if (isLast)
+		p += 2;
+	while( p < end && *p != '\r' && isspace( (unsigned char)*p))
+		p++;
+	return p == end || *p == '\r';
+}
+
+/*------------------------------------------------------------------------------*\
+	Scan( text, bodyStart, bodyEnd, parts)
+		-	collects the position and length of every part of the multipart 
+			whose body starts at bodyStart
+		-	the first boundary is accepted anywhere, all others have to start
+			a line; if the closing boundary is missing, the text up to bodyEnd
+			makes up the last part (if it contains a linebreak at all)
+		-	each part is assumed to start behind a boundary-line as long as 
+			the first one
+\*------------------------------------------------------------------------------*/
+bool BmBoundaryScanner::Scan( const BmString& text, int32 bodyStart, 
+										int32 bodyEnd, PartVect& parts) const {
+	parts.clear();
+	if (bodyStart < 0 || bodyStart > text.Length())
+		return false;
+	const char* textStart = text.String();
+	const char* end = textStart + text.Length();
+	const char* partStart 
+		= BmStringSearch::Find( textStart+bodyStart, text.Length()-bodyStart,
+										mBoundary.String(), mBoundary.Length());
+	if (!partStart)
+		return false;
+	int32 firstLineLen = LineLength( partStart, end);
+	// as linebreaks can only be found at the end of a boundary-line, the
+	// search for the next one can safely start with that linebreak:
+	const char* pos = partStart + firstLineLen - 1;
+	bool isLast = false;
+	while( !isLast) {
+		const char* boundaryLine = NULL;
+		while( pos < end) {
+			const char* found 
+				= BmStringSearch::Find( pos, end-pos, mLineStart.String(), 
+												mLineStart.Length());
+			if (!found)
+				break;
+			if (IsBoundaryLine( found+1, end, isLast)) {
+				boundaryLine = found+1;
+				break;
+			}
+			pos = found + LineLength( found+1, end);
+		}
+		int32 startOffs = partStart - textStart + firstLineLen;
+		if (!boundaryLine) {
+			if (bodyEnd > startOffs) {
+				// the final boundary is missing, we include the remaining 
+				// part anyway:
+				int32 nlPos = text.FindFirst( "\r\n", startOffs);
+				if (nlPos != B_ERROR && nlPos < bodyEnd) {
+					Part part = { startOffs, bodyEnd-startOffs };
+					parts.push_back( part);
+				}
+			}
+			break;
+		}
+		Part part = { 
+			startOffs, 
+			std::max( (int32)0, int32(boundaryLine-textStart) - startOffs - 2)
+							// -2 in order to leave out \r\n before boundary
+		};
+		parts.push_back( part);
+		partStart = boundaryLine;
+		pos = boundaryLine + LineLength( boundaryLine, end) - 1;
+	}
+	return true;
+}
+
+
+
+/********************************************************************************\
+	BmMimeBodyIBuf
+\********************************************************************************/
+
+struct BmMimeBodyIBuf::Segment {
+	BmString text;
+	const char* data;
+	uint32 len;
+	BmString path;
+	BmString encodingStyle;
+	BmRef<BmBodyPart> part;
+							// segments without a part are plain text
+	Segment()
+		: data( NULL), len( 0)						{}
+};
+
+/*------------------------------------------------------------------------------*\
+	BmMimeBodyIBuf()
+		-	constructor
+\*------------------------------------------------------------------------------*/
+BmMimeBodyIBuf::BmMimeBodyIBuf( uint32 startPos)
+	:	mIndex( 0)
+	,	mStartPos( startPos)
+	,	mReadLen( 0)
+	,	mSegmentStart( 0)
+	,	mLastChar( '\n')
+	,	mPendingLinebreakLen( 0)
+	,	mSource( NULL)
+	,	mSourceSize( 0)
+	,	mEncoder( NULL)
+	,	mBlock( NULL)
+	,	mBlockLen( 0)
+	,	mBlockPos( 0)
+{
+}
+
+/*------------------------------------------------------------------------------*\
+	~BmMimeBodyIBuf()
+		-	destructor
+\*------------------------------------------------------------------------------*/
+BmMimeBodyIBuf::~BmMimeBodyIBuf() {
+	delete mEncoder;
+	delete mSource;
+	if (mBlock)
+		BmBlockPool::Free( mBlock, BmMemFilter::nBlockSize);
+	for( int i=0; i<mSegments.CountItems(); ++i)
+		delete static_cast< Segment*>( mSegments.ItemAt(i));
+}
+
+/*------------------------------------------------------------------------------*\
+	AddText( text)
+		-	appends the given text, joining it with any text added before
+\*------------------------------------------------------------------------------*/
+void BmMimeBodyIBuf::AddText( const BmString& text) {
+	Segment* last = static_cast< Segment*>( mSegments.LastItem());
+	bool lastIsBeingRead = mSource && mIndex == mSegments.CountItems()-1;
+	if (!last || last->part || lastIsBeingRead) {
+		last = new Segment;
+		mSegments.AddItem( last);
+	}
+	last->text << text;
+}
+
+/*------------------------------------------------------------------------------*\
+	AddPartBody( part, encodedText)
+		-	appends the given (already encoded) body of the given part
+\*------------------------------------------------------------------------------*/
+void BmMimeBodyIBuf::AddPartBody( BmBodyPart* part, BmString& encodedText) {
+	Segment* segment = new Segment;
+	segment->text.Adopt( encodedText);
+	segment->part = part;
+	mSegments.AddItem( segment);
+}
+
+/*------------------------------------------------------------------------------*\
+	AddPartBody( part, data, len, encodingStyle)
+		-	appends the body of the given part, which will be encoded with
+			the given encoding-style while being read
+\*------------------------------------------------------------------------------*/
+void BmMimeBodyIBuf::AddPartBody( BmBodyPart* part, const char* data, 
+											 uint32 len, const BmString& encodingStyle) {
+	Segment* segment = new Segment;
+	segment->data = data;
+	segment->len = len;
+	segment->encodingStyle = encodingStyle;
+	segment->part = part;
+	mSegments.AddItem( segment);
+}
+
+/*------------------------------------------------------------------------------*\
+	AddPartBodyFromFile( part, path, encodingStyle)
+		-	appends the body of the given part, which will be read from the 
+			given file and encoded with the given encoding-style while 
+			being read
+\*------------------------------------------------------------------------------*/
+void BmMimeBodyIBuf::AddPartBodyFromFile( BmBodyPart* part, 
+														const BmString& path,
+														const BmString& encodingStyle) {
+	Segment* segment = new Segment;
+	segment->path = path;
+	segment->encodingStyle = encodingStyle;
+	segment->part = part;
+	mSegments.AddItem( segment);
+}
+
+/*------------------------------------------------------------------------------*\
+	StartSegment( segment)
+		-	sets up source (and encoder) for the given segment
+\*------------------------------------------------------------------------------*/
+void BmMimeBodyIBuf::StartSegment( Segment* segment) {
+	mSegmentStart = mReadLen;
+	if (segment->part)
+		segment->part->mStartInRawText = mStartPos + mReadLen;
+	if (segment->path.Length()) {
+		// the file is read (not mapped), since it may be changed by others 
+		// while we read it, and reading from a mapped file that shrinks 
+		// would crash us:
+		BmMappedFileIBuf* file 
+			= new BmMappedFileIBuf( segment->path.String(), true);
+		mSource = file;
+		if (file->InitCheck() != B_OK)
+			BM_THROW_RUNTIME( 
+				BmString("Could not open attachment <") 
+					<< segment->part->FileName() << ">\n\nError:" 
+					<< strerror( file->InitCheck())
+			);
+		if (file->Size() != segment->part->mFileSize)
+			BM_LOG( BM_LogMailParse, 
+					  BmString( "attachment <") << segment->part->FileName() 
+							<< "> has changed since it was added");
+		mSourceSize = file->Size();
+		BM_LOG2( BM_LogMailParse, 
+					BmString( "encoding attachment of ") << file->Size() 
+						<< " bytes...");
+	} else if (segment->data) {
+		mSource = new BmStringIBuf( segment->data, segment->len);
+		BM_LOG2( BM_LogMailParse, 
+					BmString( "encoding bodytext of ") << segment->len 
+						<< " bytes...");
+	} else
+		mSource = new BmStringIBuf( segment->text);
+	if (segment->encodingStyle.Length())
+		mEncoder = FindEncoderFor( mSource, segment->encodingStyle).release();
+}
+
+/*------------------------------------------------------------------------------*\
+	FinishSegment( segment)
+		-	records the body-length of the segment's part (making sure it ends
+			with a linebreak) and moves on to the next segment
+\*------------------------------------------------------------------------------*/
+void BmMimeBodyIBuf::FinishSegment( Segment* segment) {
+	if (segment->path.Length() 
+	&& static_cast< BmMappedFileIBuf*>( mSource)->Size() < mSourceSize)
+		// the file has shrunk while being read:
+		ThrowTruncatedSegment( segment);
+	if (segment->part) {
+		segment->part->mBodyLength = mReadLen - mSegmentStart;
+		if (mLastChar != '\n')
+			mPendingLinebreakLen = 2;
+		BM_LOG2( BM_LogMailParse, "...done (body of part)");
+	}
+	delete mEncoder;
+	mEncoder = NULL;
+	delete mSource;
+	mSource = NULL;
+	mBlockLen = mBlockPos = 0;
+	mIndex++;
+}
+
+/*------------------------------------------------------------------------------*\
+	ThrowTruncatedSegment( segment)
+		-	reports that the given segment could not be read completely
+\*------------------------------------------------------------------------------*/
+void BmMimeBodyIBuf::ThrowTruncatedSegment( Segment* segment) {
+	BmString what = segment->part 
+							? BmString("body of <") << segment->part->FileName() << ">"
+							: BmString("mail-text");
+	if (mEncoder && mEncoder->HadError())
+		BM_THROW_RUNTIME( BmString("Unable to encode ") << what);
+	BM_THROW_RUNTIME( BmString("Unable to read ") << what << " completely");
+}
+
+/*------------------------------------------------------------------------------*\
+	Read( data, reqLen)
+		-	
+		-	throws if a segment's source (or encoder) runs dry before it has
+			reached its end, as the part's body would be cut short otherwise
+\*------------------------------------------------------------------------------*/
+uint32 BmMimeBodyIBuf::Read( char* data, uint32 reqLen) {
+	uint32 readLen = 0;
+	while( readLen < reqLen && !IsAtEnd()) {
+		if (mPendingLinebreakLen) {
+			data[readLen++] = "\r\n"[2-mPendingLinebreakLen--];
+			mReadLen++;
+			mLastChar = data[readLen-1];
+			continue;
+		}
+		Segment* segment = static_cast< Segment*>( mSegments.ItemAt( mIndex));
+		if (!mSource)
+			StartSegment( segment);
+		uint32 len = 0;
+		bool atEnd;
+		if (mEncoder) {
+			if (mBlockPos == mBlockLen && !mEncoder->IsAtEnd()) {
+				if (!mBlock)
+					mBlock = BmBlockPool::Allocate( BmMemFilter::nBlockSize);
+				mBlockLen = mEncoder->Read( mBlock, BmMemFilter::nBlockSize);
+				mBlockPos = 0;
+				if (!mBlockLen && !mEncoder->IsAtEnd())
+					ThrowTruncatedSegment( segment);
+			}
+			len = min_c( reqLen-readLen, mBlockLen-mBlockPos);
+			memcpy( data+readLen, mBlock+mBlockPos, len);
+			mBlockPos += len;
+			atEnd = mBlockPos == mBlockLen && mEncoder->IsAtEnd();
+		} else {
+			len = mSource->Read( data+readLen, reqLen-readLen);
+			atEnd = mSource->IsAtEnd();
+			if (!len && !atEnd)
+				ThrowTruncatedSegment( segment);
+		}
+		if (len) {
+			readLen += len;
+			mReadLen += len;
+			mLastChar = data[readLen-1];
+		}
+		if (atEnd)
+			FinishSegment( segment);
+	}
+	return readLen;
+}
+
+/*------------------------------------------------------------------------------*\
+	IsAtEnd()
+		-	
+\*------------------------------------------------------------------------------*/
+bool BmMimeBodyIBuf::IsAtEnd() {
+	return mIndex >= mSegments.CountItems() && !mPendingLinebreakLen;
+}
+
+/*------------------------------------------------------------------------------*\
+	operator<<()
+		-	
+\*------------------------------------------------------------------------------*/
+BmMimeBodyIBuf& BmMimeBodyIBuf::operator<<( const char* text) {
+	AddText( text);
+	return *this;
+}
+
+/*------------------------------------------------------------------------------*\
+	operator<<()
+		-	
+\*------------------------------------------------------------------------------*/
+BmMimeBodyIBuf& BmMimeBodyIBuf::operator<<( const BmString& text) {
+	AddText( text);
+	return *this;
+}
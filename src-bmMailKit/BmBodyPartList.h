@@ -19,6 +19,7 @@
 
 class BFile;
 class BmMail;
+class BmMimeBodyIBuf;
 
 /*------------------------------------------------------------------------------*\
 	BmContentField
@@ -69,6 +70,7 @@ class IMPEXPBMMAILKIT BmBodyPart : public BmListModelItem {
 	static const int16 nArchiveVersion = 1;
 	
 	friend class BmBodyPartList;
+	friend class BmMimeBodyIBuf;
 
 public:
 	// c'tors and d'tor:
@@ -96,7 +98,9 @@ public:
 	entry_ref WriteToTempFile( BmString filename="");
 	void WriteToFile( BFile& file);
 	void SaveAs( const entry_ref& destDirRef, BmString filename);
-	void SuggestCharset( const BmString& s) { mSuggestedCharset = s; }
+	void SuggestCharset( const BmString& s) 
+													{ mSuggestedCharset = s;
+													  InvalidateEncodedSize(); }
 
 	static BmString GenerateBoundary();
 
@@ -107,7 +111,7 @@ public:
 	inline bool IsMultiPart() const		{ return mIsMultiPart; }
 	void DecodeText(const char* tryCharset = NULL);
 	const BmString& DecodedData() const;
-	inline int32 DecodedLength() const	{ return DecodedData().Length(); }
+	int32 DecodedLength() const;
 	inline status_t InitCheck() const	{ return mInitCheck; }
 
 	inline const BmString ContentTypeAsString() const	
@@ -162,8 +166,14 @@ private:
 	bool ContainsRef( const entry_ref& ref) const;
 	void PropagateHigherEncoding();
 	int32 PruneUnneededMultiParts();
-	int32 EstimateEncodedSize();
-	void ConstructBodyForSending( BmStringOBuf &msgText);
+	bool BodyIsInRawText() const;
+	void InvalidateEncodedSize();
+	void ConvertText();
+	void PrepareForSending();
+	BmString MimeHeader() const;
+	int32 EncodedBodySize();
+	int32 EncodedSize();
+	void ConstructBodyForSending( BmMimeBodyIBuf& body);
 	void AddParsingError( const BmString& errStr) const;
 
 	bool mIsMultiPart;
@@ -177,6 +187,10 @@ private:
 
 	mutable bool mHaveDecodedData;
 	mutable BmString mDecodedData;
+	bool mDataIsInFile;
+							// decoded data lives in the file referred to by 
+							// mEntryRef (and will be fetched on demand only)
+	int32 mFileSize;
 	int32 mStartInRawText;
 	int32 mBodyLength;
 	
@@ -184,6 +198,15 @@ private:
 	mutable BmString mSuggestedCharset;
 	mutable bool mHadErrorDuringConversion;
 	mutable BmString mParsingErrors;
+
+	int32 mEncodedBodySize;
+							// exact size of the body when being sent 
+							// (-1 if unknown)
+	BmString mConvertedText;
+							// the text converted into its charset (and encoded),
+							// ready to be sent
+	bool mHaveConvertedText;
+	bool mIsPreparedForSending;
 	
 	entry_ref mEntryRef;
 
@@ -217,8 +240,9 @@ public:
 	void AddAttachmentFromRef( const entry_ref* ref,
 										const BmString& defaultCharset);
 	void PruneUnneededMultiParts();
-	int32 EstimateEncodedSize();
+	int32 EncodedSize();
 	bool ConstructBodyForSending( BmStringOBuf& msgText);
+	bool ConstructBodyForSending( BmMimeBodyIBuf& body);
 	void SetEditableText( const BmString& utf8Text, const BmString& charset);
 	const BmString& DefaultCharset()	const;
 
@@ -248,6 +272,13 @@ private:
 	BmRef<BmBodyPart> mEditableTextBody;
 	status_t mInitCheck;
 	BmString mSignature;						// signature (as found in mail-text)
+	BmString mBoundary;
+							// boundary of the multipart wrapping the parts
+							// (empty if the parts need no wrapping)
+	bool mIsPreparedForSending;
+
+	void PrepareForSending();
+	BmString MultiPartHeader() const;
 
 	// Hide copy-constructor and assignment:
 	BmBodyPartList( const BmBodyPartList&);
@@ -255,4 +286,116 @@ private:
 };
 
 
+
+/*------------------------------------------------------------------------------*\
+	BmBoundaryScanner
+		-	splits the body of a multipart into its parts, finding all the 
+			boundary-lines in one pass over the text (a boundary-line starts 
+			with "--" and the boundary, followed by "--" for the last one, and
+			may only contain whitespace after that)
+\*------------------------------------------------------------------------------*/
+class IMPEXPBMMAILKIT BmBoundaryScanner {
+
+public:
+	struct Part {
+		int32 start;
+		int32 length;
+	};
+	typedef vector< Part> PartVect;
+
+	BmBoundaryScanner( const BmString& boundary);
+
+	// native methods:
+	bool Scan( const BmString& text, int32 bodyStart, int32 bodyEnd,
+				  PartVect& parts) const;
+							// returns false if the boundary can't be found
+
+private:
+	int32 LineLength( const char* pos, const char* end) const;
+	bool IsBoundaryLine( const char* pos, const char* end, 
+								bool& isLast) const;
+
+	BmString mBoundary;
+							// "--" followed by the boundary
+	BmString mLineStart;
+							// "\n" followed by mBoundary
+
+	// Hide copy-constructor and assignment:
+	BmBoundaryScanner( const BmBoundaryScanner&);
+	BmBoundaryScanner operator=( const BmBoundaryScanner&);
+};
+
+/*------------------------------------------------------------------------------*\
+	BmMimeBodyIBuf
+		-	an implementation of BmMemIBuf which produces the MIME-body of an 
+			outbound mail lazily: the parts' headers, boundaries and texts are 
+			collected up front, but the parts' bodies are only encoded while 
+			the body is being read, such that an attachment is read from its 
+			file block by block (and never held in memory as a whole).
+		-	when a part's body has been produced, its position within the 
+			mail-text (relative to the given start position) is recorded in 
+			the part.
+\*------------------------------------------------------------------------------*/
+class IMPEXPBMMAILKIT BmMimeBodyIBuf : public BmMemIBuf {
+	typedef BmMemIBuf inherited;
+
+public:
+	BmMimeBodyIBuf( uint32 startPos=0);
+	~BmMimeBodyIBuf();
+
+	// native methods:
+	void AddText( const BmString& text);
+	void AddPartBody( BmBodyPart* part, BmString& encodedText);
+							// adopts the given text
+	void AddPartBody( BmBodyPart* part, const char* data, uint32 len,
+							const BmString& encodingStyle=BM_DEFAULT_STRING);
+							// data must stay valid until it has been read,
+							// it is passed on unchanged if no encoding-style
+							// is given
+	void AddPartBodyFromFile( BmBodyPart* part, const BmString& path,
+									  const BmString& encodingStyle);
+
+	// overrides of BmMemIBuf base:
+	uint32 Read( char* data, uint32 reqLen);
+	bool IsAtEnd();
+
+	// getters:
+	inline uint32 ReadLen() const			{ return mReadLen; }
+
+	BmMimeBodyIBuf 	&operator<<(const char *);
+	BmMimeBodyIBuf 	&operator<<(const BmString &);
+
+private:
+	struct Segment;
+	void StartSegment( Segment* segment);
+	void FinishSegment( Segment* segment);
+	void ThrowTruncatedSegment( Segment* segment);
+
+	BList mSegments;
+	int32 mIndex;
+	uint32 mStartPos;
+	uint32 mReadLen;
+	uint32 mSegmentStart;
+	char mLastChar;
+	int32 mPendingLinebreakLen;
+							// part of the linebreak that still has to be
+							// appended to a part's body
+	BmMemIBuf* mSource;
+	off_t mSourceSize;
+	BmMemFilter* mEncoder;
+							// source (and the size of its file, if any) and
+							// encoder of the current segment
+	char* mBlock;
+	uint32 mBlockLen;
+	uint32 mBlockPos;
+							// encoded data (encoders need room for a whole
+							// line, so they don't write into the caller's 
+							// buffer directly)
+
+	// Hide copy-constructor and assignment:
+	BmMimeBodyIBuf( const BmMimeBodyIBuf&);
+	BmMimeBodyIBuf operator=( const BmMimeBodyIBuf&);
+};
+
+
 #endif
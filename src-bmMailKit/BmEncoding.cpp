@@ -8,11 +8,18 @@
 
 #include <ctype.h>
 
+#include <new>
+
+#include <Autolock.h>
+#include <Locker.h>
+
 #include "regexx.hh"
 #include "split.hh"
 using namespace regexx;
 
 #include "BmBasics.h"
+#include "BmBlockPool.h"
+#include "BmByteKernels.h"
 #include "BmEncoding.h"
 using namespace BmEncoding;
 #include "BmLogHandler.h"
@@ -241,144 +248,200 @@ struct BmTextPart {
 		,	encodingStyle( es) 				{ }
 };
 
+struct BmEncodedWord {
+	int32 start;
+	int32 end;
+	int32 charsetStart;
+	int32 charsetLen;
+	char encodingStyle;
+	int32 textStart;
+	int32 textLen;
+};
+
 /*------------------------------------------------------------------------------*\
-	()
-		-	
+	FindEncodedWord( text, len, pos, word)
+		-	looks for the next encoded-word (=?charset?encoding?text?=, see 
+			rfc2047) in the given text, starting at pos
+		-	matches exactly what the regular expression 
+			"=\?(.+?)\?(.)\?(.*?)\?=" would match (so none of the parts may 
+			contain a newline, but the charset may contain a '?')
+\*------------------------------------------------------------------------------*/
+static bool FindEncodedWord( const char* text, int32 len, int32 pos, 
+									  BmEncodedWord& word) {
+	while( pos+1 < len) {
+		const char* eq = BmByteKernels::FindByte( text+pos, len-pos, '=');
+		if (!eq)
+			return false;
+		int32 start = eq-text;
+		pos = start+1;
+		if (start+1 >= len || text[start+1] != '?')
+			continue;
+		// the charset is the shortest (non-empty) run of chars that is 
+		// followed by the rest of an encoded-word:
+		for( int32 q=start+3; q+2<len && text[q-1]!='\n'; ++q) {
+			if (text[q] != '?' || text[q+1] == '\n' || text[q+2] != '?')
+				continue;
+			// the encoded text ends with the first "?=":
+			int32 t = q+3;
+			while( t+1<len && text[t]!='\n' && (text[t]!='?' || text[t+1]!='='))
+				t++;
+			if (t+1 >= len || text[t] == '\n')
+				// no end found, which won't change for longer charsets
+				break;
+			word.start = start;
+			word.end = t+2;
+			word.charsetStart = start+2;
+			word.charsetLen = q-start-2;
+			word.encodingStyle = text[q+1];
+			word.textStart = q+3;
+			word.textLen = t-q-3;
+			return true;
+		}
+	}
+	return false;
+}
+
+/*------------------------------------------------------------------------------*\
+	IsWhitespace( text, len)
+		-	returns whether or not the given text consists of whitespace only
+\*------------------------------------------------------------------------------*/
+static bool IsWhitespace( const char* text, int32 len) {
+	for( int32 i=0; i<len; ++i) {
+		if (!isspace( (unsigned char)text[i]))
+			return false;
+	}
+	return true;
+}
+
+/*------------------------------------------------------------------------------*\
+	AddToTextPart( textPartVect, currTextPart, charset, encodingStyle, 
+						text, len)
+		-	appends the given text to the current text-part, starting a new 
+			text-part if charset or encoding differ (such that adjacent 
+			encoded-words of the same kind are decoded together)
+\*------------------------------------------------------------------------------*/
+static void AddToTextPart( vector< BmTextPart>& textPartVect, 
+									BmTextPart& currTextPart, 
+									const BmString& charset, 
+									const BmString& encodingStyle,
+									const char* text, int32 len) {
+	if (currTextPart.charset != charset 
+	|| currTextPart.encodingStyle != encodingStyle) {
+		// current text-part doesn't fit this text, we need to create
+		// a new text-part:
+		if (currTextPart.text.Length())
+			// add current text-part to vector before creating new one:
+			textPartVect.push_back( currTextPart);
+		currTextPart.charset = charset;
+		currTextPart.text.Truncate( 0);
+		currTextPart.encodingStyle = encodingStyle;
+	}
+	currTextPart.text.Append( text, len);
+}
+
+static bool IsAsciiCompatible( const BmString& charset);
+
+/*------------------------------------------------------------------------------*\
+	ConvertHeaderPartToUTF8( headerPart, defaultCharset, hadConversionError)
+		-	decodes all encoded-words contained in the given header-part and
+			converts the result to UTF-8
+		-	the header-part is scanned by hand (no regex), text that needs 
+			no conversion at all is copied as is
 \*------------------------------------------------------------------------------*/
 BmString BmEncoding::ConvertHeaderPartToUTF8( const BmString& headerPart, 
 															 const BmString& defaultCharset,
 															 bool& hadConversionError) {
-	int32 nm;
-	Regexx rx;
-	rx.expr( "=\\?(.+?)\\?(.)\\?(.*?)\\?=");
-	rx.str( headerPart);
-	const uint32 blockSize = std::max( (int32)128, headerPart.Length());
+	const char* header = headerPart.String();
+	const int32 len = headerPart.Length();
+	const uint32 blockSize = std::max( (int32)128, len);
 	vector< BmTextPart> textPartVect;
 	BmTextPart currTextPart( defaultCharset, "", "");
 	
 	hadConversionError = false;
 
-	BmStringOBuf result( blockSize, 2.0);
-	if ((nm = rx.exec( Regexx::global))!=0) {
-		Regexx rxWhite;
-		int32 len=headerPart.Length();
+	BmEncodedWord word;
+	if (FindEncodedWord( header, len, 0, word)) {
 		int32 curr=0;
-		vector<RegexxMatch>::const_iterator i;
-		for( i = rx.match.begin(); i != rx.match.end(); ++i) {
-			if (curr < i->start()) {
-				// copy the characters between start/curr match and next match,
-				// unless it's all whitespace (rfc2047 requires whitespace between
-				// encoded words to be removed):
-				BmString chars( headerPart.String()+curr, i->start()-curr);
-				if (!rxWhite.exec( chars, "^\\s*$")) {
-					if (currTextPart.charset != defaultCharset 
-					|| currTextPart.encodingStyle != "") {
-						// current text-part doesn't fit this text, we need to create
-						// a new text-part:
-						if (currTextPart.text.Length())
-							// add current text-part to vector before creating new one:
-							textPartVect.push_back( currTextPart);
-						currTextPart.charset = defaultCharset;
-						currTextPart.text = "";
-						currTextPart.encodingStyle = "";
-					}
-					currTextPart.text.Append( chars);
-				}
-			}
-			// convert the match (an encoded word) into UTF8:
-			BmString srcCharset( i->atom[0]);
+		BmString srcCharset;
+		BmString srcEncodingStyle;
+		do {
+			// copy the characters between start/curr match and next match,
+			// unless it's all whitespace (rfc2047 requires whitespace between
+			// encoded words to be removed):
+			if (curr < word.start 
+			&& !IsWhitespace( header+curr, word.start-curr))
+				AddToTextPart( textPartVect, currTextPart, defaultCharset, 
+									BM_DEFAULT_STRING, header+curr, word.start-curr);
+			// add the encoded word to the text-parts:
+			srcCharset.SetTo( header+word.charsetStart, word.charsetLen);
 			if (!srcCharset.Length() || !srcCharset.ICompare("unknown-8bit"))
 				// avoid empty charsets and the (dummy) charset "unknown-8bit"
 				srcCharset = defaultCharset;
-			const BmString srcEncodingStyle( i->atom[1]);
-			BmString chars( headerPart.String()+i->atom[2].start(), 
-								 i->atom[2].Length());
-			if (currTextPart.charset != srcCharset 
-			|| currTextPart.encodingStyle != srcEncodingStyle) {
-				// current text-part doesn't fit this text, we need to create
-				// a new text-part:
-				if (currTextPart.text.Length())
-					// add current text-part to vector before creating new one:
-					textPartVect.push_back( currTextPart);
-				currTextPart.charset = srcCharset;
-				currTextPart.text = "";
-				currTextPart.encodingStyle = srcEncodingStyle;
-			}
-			currTextPart.text.Append( chars);
-			curr = i->start()+i->Length();
-		}
-		if (curr<len) {
-			// copy the remaining characters,
-			// unless it's all whitespace (rfc2047 requires whitespace between
-			// encoded words to be removed):
-			BmString chars( headerPart.String()+curr, len-curr);
-			if (!rxWhite.exec( chars, "^\\s*$")) {
-				if (currTextPart.charset != defaultCharset 
-				|| currTextPart.encodingStyle != "") {
-					// current text-part doesn't fit this text, we need to create
-					// a new text-part:
-					if (currTextPart.text.Length())
-						// add current text-part to vector before creating new one:
-					textPartVect.push_back( currTextPart);
-					currTextPart.charset = defaultCharset;
-					currTextPart.text = "";
-					currTextPart.encodingStyle = "";
-				}
-				currTextPart.text.Append( chars);
-			}
-		}
+			srcEncodingStyle.SetTo( word.encodingStyle, 1);
+			AddToTextPart( textPartVect, currTextPart, srcCharset, 
+								srcEncodingStyle, header+word.textStart, 
+								word.textLen);
+			curr = word.end;
+		} while( FindEncodedWord( header, len, curr, word));
+		if (curr<len && !IsWhitespace( header+curr, len-curr))
+			// copy the remaining characters:
+			AddToTextPart( textPartVect, currTextPart, defaultCharset, 
+								BM_DEFAULT_STRING, header+curr, len-curr);
 	} else {
 		// no encoded words neccessary, we just copy the header-part:
-		currTextPart.charset = defaultCharset;
 		currTextPart.text = headerPart;
-		currTextPart.encodingStyle = "";
 	}
 	if (currTextPart.text.Length())
 		// add current text-part to vector before iterating through vector:
 		textPartVect.push_back( currTextPart);
+
+	if (textPartVect.size() == 1 && !textPartVect[0].encodingStyle.Length()
+	&& IsAsciiCompatible( textPartVect[0].charset)) {
+		const BmString& text = textPartVect[0].text;
+		if (BmByteKernels::SpanAscii( text.String(), text.Length()) 
+				== text.Length())
+			// plain ASCII, which wouldn't be changed by the conversion:
+			return text;
+	}
+
 	// now step over all text-parts and decode them, concatenating the resulting
 	// strings:
+	BmStringOBuf result( blockSize, 2.0);
+	bool autoDetect = ThePrefs->GetBool("AutoCharsetDetectionInbound", true);
 	for( uint32 i=0; i<textPartVect.size(); ++i) {
 		BmTextPart& textPart = textPartVect[i];
-		BmCharsetVect charsetVect;
 		// we try the native charset first and (in case of errors)
-		// all preferred charsets:
-		if (ThePrefs->GetBool("AutoCharsetDetectionInbound", true))
-			GetPreferredCharsets( charsetVect, textPart.charset);
-		else
-			charsetVect.push_back(textPart.charset);
+		// all preferred charsets (which are only determined when needed):
+		BmCharsetVect charsetVect( 1, textPart.charset);
 		BmString charset;
-		for( uint32 i=0; i<charsetVect.size(); ++i) {
-			charset = charsetVect[i];
+		for( uint32 c=0; c<charsetVect.size(); ++c) {
+			charset = charsetVect[c];
 			BmStringOBuf utf8( blockSize, 2.0);
 			BM_LOG2( BM_LogMailParse, 
 						BmString( "ConvertHeaderPartToUTF8(): trying charset ") 
 							<< charset);
-			if (textPart.encodingStyle == "") {
-				// no decoding neccessary, just character-conversion:
-				BmStringIBuf text( textPart.text);
-				BmUtf8Encoder textConverter( &text, charset);
-				utf8.Write( &textConverter);
-				if (textConverter.HadError() || textConverter.HadToDiscardChars())
-					hadConversionError = true;
-				else {
-					result.Write(utf8.TheString());
-					break;
-				}
-			} else {
+			// the converters come from the pool of iconv-descriptors, so 
+			// setting them up for every text-part is cheap:
+			BmStringIBuf text( textPart.text);
+			BmMemFilterRef decoder;
+			if (textPart.encodingStyle.Length()) {
 				// encoded-words, need decoding + character-conversion:
-				BmStringIBuf text( textPart.text);
 				BmString tags = BmQuotedPrintableDecoder::nTagIsEncodedWord;
-				BmMemFilterRef decoder 
+				decoder 
 					= FindDecoderFor(&text, textPart.encodingStyle, blockSize, tags);
-				BmUtf8Encoder textConverter( decoder.get(), charset, blockSize);
-				utf8.Write( &textConverter, blockSize);
-				if (textConverter.HadError() || textConverter.HadToDiscardChars())
-					hadConversionError = true;
-				else {
-					result.Write(utf8.TheString());
-					break;
-				}
+			}
+			BmUtf8Encoder textConverter( 
+				decoder.get() ? (BmMemIBuf*)decoder.get() : &text, charset, 
+				blockSize
+			);
+			utf8.Write( &textConverter, blockSize);
+			if (textConverter.HadError() || textConverter.HadToDiscardChars()) {
+				hadConversionError = true;
+				if (!c && autoDetect)
+					GetPreferredCharsets( charsetVect, textPart.charset);
+			} else {
+				result.Write(utf8.TheString());
+				break;
 			}
 		}
 	}
@@ -482,14 +545,9 @@ bool BmEncoding::NeedsQuotedPrintableEncoding( const BmString& utf8String,
 \*------------------------------------------------------------------------------*/
 bool BmEncoding::IsCompatibleWithText( const BmString& s) {
 	// check if given string contains any characters that suggest the data
-	// is in fact binary:
-	for( int32 i=0; i<s.Length(); ++i) {
-		// currently, we believe that only ascii-0 is not compatible
-		// with attachments of type text:
-		if (!s[i])
-			return false;
-	}
-	return true;
+	// is in fact binary (currently, we believe that only ascii-0 is not 
+	// compatible with attachments of type text):
+	return BmByteKernels::FindByte( s.String(), s.Length(), '\0') == NULL;
 }
 
 /*------------------------------------------------------------------------------*\
@@ -554,6 +612,286 @@ BmMemFilterRef BmEncoding::FindEncoderFor( BmMemIBuf* input,
 
 
 
+/*------------------------------------------------------------------------------*\
+	EncodedLength( encodingStyle, data, len, lastChar)
+		-	returns the exact number of bytes the encoder found by 
+			FindEncoderFor() yields for the given data (and the last of those 
+			bytes in lastChar, 0 if there are none)
+		-	base64 only depends on the length (data is just needed for the
+			last char, so it may be NULL if the caller only wants to know 
+			whether the encoded data ends with a linebreak), 7bit, 8bit and 
+			binary are computed by counting linebreaks, quoted-printable is 
+			really encoded (see below)
+\*------------------------------------------------------------------------------*/
+int32 BmEncoding::EncodedLength( const BmString& encodingStyle, 
+											const char* data, int32 len, 
+											char& lastChar) {
+	lastChar = 0;
+	if (len <= 0)
+		return 0;
+	if (encodingStyle.ICompare("b")==0 
+	|| encodingStyle.ICompare("base64")==0) {
+		// every complete line of 76 chars gets a CRLF, but the line containing
+		// the padded last group does not:
+		int32 fullGroupChars = (len / 3) * 4;
+		int32 linebreaks = fullGroupChars / BM_MAX_HEADER_LINE_LEN;
+		int32 chars = ((len + 2) / 3) * 4;
+		if (len % 3)
+			lastChar = '=';
+		else if (fullGroupChars % BM_MAX_HEADER_LINE_LEN == 0)
+			lastChar = '\n';
+		else
+			lastChar = BmBase64Encoder::nBase64Alphabet[
+				data ? ((uint8)data[len-1]) & 63 : 0
+			];
+		return chars + 2*linebreaks;
+	}
+	if (encodingStyle.ICompare("q")==0 
+	|| encodingStyle.ICompare("quoted-printable")==0) {
+		BmStringIBuf text( data, len);
+		return EncodedLength( encodingStyle, &text, lastChar);
+	}
+	if (encodingStyle.ICompare("binary")==0) {
+		lastChar = data[len-1];
+		return len;
+	}
+	// 7bit, 8bit (and anything unknown, which is treated as 7bit): CRs are 
+	// dropped and LFs become CRLFs:
+	int32 crs = BmByteKernels::CountByte( data, len, '\r');
+	int32 lfs = BmByteKernels::CountByte( data, len, '\n');
+	for( int32 i=len-1; i>=0; --i) {
+		if (data[i] != '\r') {
+			lastChar = data[i];
+			break;
+		}
+	}
+	return len - crs + lfs;
+}
+
+/*------------------------------------------------------------------------------*\
+	EncodedLength( encodingStyle, input, lastChar)
+		-	returns the exact number of bytes the encoder found by 
+			FindEncoderFor() yields for the data of the given stream (and the
+			last of those bytes in lastChar, 0 if there are none)
+		-	the data is really encoded (block by block into a scratch block 
+			that is thrown away), so this works for data that isn't available 
+			in memory as a whole
+\*------------------------------------------------------------------------------*/
+int32 BmEncoding::EncodedLength( const BmString& encodingStyle, 
+											BmMemIBuf* input, char& lastChar) {
+	lastChar = 0;
+	BmMemFilterRef encoder = FindEncoderFor( input, encodingStyle);
+	char* block = BmBlockPool::Allocate( BmMemFilter::nBlockSize);
+	if (!block)
+		throw std::bad_alloc();
+	int32 encodedLen = 0;
+	while( !encoder->IsAtEnd()) {
+		uint32 blockLen = encoder->Read( block, BmMemFilter::nBlockSize);
+		if (!blockLen)
+			break;
+		lastChar = block[blockLen-1];
+		encodedLen += blockLen;
+	}
+	BmBlockPool::Free( block, BmMemFilter::nBlockSize);
+	return encodedLen;
+}
+
+
+
+/********************************************************************************\
+	BmIconvPool
+\********************************************************************************/
+
+const int32 BmIconvPool::nMaxIdlePerKey = 4;
+
+struct BmIconvKey {
+	BmString name;
+							// "<from>\n<to>[//TRANSLIT|//IGNORE]"
+	bool discard;
+};
+
+// the pool data lives in a single object, such that the idle descriptors get
+// closed when the library is unloaded:
+struct BmIconvPoolData {
+	typedef map< BmString, vector< iconv_t> > IdleMap;
+	typedef map< iconv_t, BmIconvKey> BusyMap;
+
+	BLocker locker;
+	IdleMap idleDescrs;
+	BusyMap busyDescrs;
+
+	BmIconvPoolData()
+		:	locker( "IconvPoolLock")			{}
+	~BmIconvPoolData()						{ BmIconvPool::ReleaseIdleDescriptors(); }
+};
+
+static BmIconvPoolData sIconvPool;
+
+static vint32 sIconvCheckOuts = 0;
+static vint32 sIconvHits = 0;
+static vint32 sIconvOpens = 0;
+static vint32 sIconvCloses = 0;
+static vint32 sIconvIdle = 0;
+
+/*------------------------------------------------------------------------------*\
+	CheckOut( fromCharset, toCharset, transliterate, discard)
+		-	returns an idle descriptor for the given conversion or opens a new
+			one if there is none
+		-	returns (iconv_t)-1 if the conversion is not supported
+\*------------------------------------------------------------------------------*/
+iconv_t BmIconvPool::CheckOut( const BmString& fromCharset,
+										 const BmString& toCharset,
+										 bool transliterate, bool discard) {
+	BmString toSet = toCharset;
+	if (transliterate)
+		toSet << "//TRANSLIT";
+	else if (discard)
+		toSet << "//IGNORE";
+	BmIconvKey key;
+	key.name = fromCharset + "\n" + toSet;
+	key.discard = discard && !transliterate;
+	atomic_add( &sIconvCheckOuts, 1);
+	iconv_t descr = ICONV_ERR;
+	{
+		BAutolock lock( sIconvPool.locker);
+		vector< iconv_t>& idle = sIconvPool.idleDescrs[key.name];
+		if (!idle.empty()) {
+			descr = idle.back();
+			idle.pop_back();
+			sIconvPool.busyDescrs[descr] = key;
+			atomic_add( &sIconvHits, 1);
+			atomic_add( &sIconvIdle, -1);
+			return descr;
+		}
+	}
+	if ((descr = iconv_open( toSet.String(), fromCharset.String())) == ICONV_ERR)
+		return ICONV_ERR;
+	atomic_add( &sIconvOpens, 1);
+	{
+		BAutolock lock( sIconvPool.locker);
+		sIconvPool.busyDescrs[descr] = key;
+	}
+	int32 checkOuts = sIconvCheckOuts;
+	BM_LOG2( BM_LogMailParse,
+				BmString("iconv-pool: opened converter from ") << fromCharset
+					<< " to " << toSet << ", hit rate is now "
+					<< (checkOuts ? 100 * sIconvHits / checkOuts : 0) << "%");
+	return descr;
+}
+
+/*------------------------------------------------------------------------------*\
+	CheckIn( descr)
+		-	resets the given descriptor and puts it back into the pool (or
+			closes it, if there are enough idle ones of its kind already)
+\*------------------------------------------------------------------------------*/
+void BmIconvPool::CheckIn( iconv_t descr) {
+	if (descr == ICONV_ERR)
+		return;
+	// return to initial state and undo any changes of the discard-flag:
+	iconv( descr, NULL, NULL, NULL, NULL);
+	{
+		BAutolock lock( sIconvPool.locker);
+		BmIconvPoolData::BusyMap::iterator iter
+			= sIconvPool.busyDescrs.find( descr);
+		if (iter != sIconvPool.busyDescrs.end()) {
+			int discard = iter->second.discard ? 1 : 0;
+			iconvctl( descr, ICONV_SET_DISCARD_ILSEQ, &discard);
+			vector< iconv_t>& idle = sIconvPool.idleDescrs[iter->second.name];
+			sIconvPool.busyDescrs.erase( iter);
+			if (idle.size() < (uint32)nMaxIdlePerKey) {
+				idle.push_back( descr);
+				atomic_add( &sIconvIdle, 1);
+				return;
+			}
+		}
+	}
+	iconv_close( descr);
+	atomic_add( &sIconvCloses, 1);
+}
+
+/*------------------------------------------------------------------------------*\
+	ReleaseIdleDescriptors()
+		-	closes all descriptors that are currently not in use
+\*------------------------------------------------------------------------------*/
+void BmIconvPool::ReleaseIdleDescriptors() {
+	BAutolock lock( sIconvPool.locker);
+	BmIconvPoolData::IdleMap::iterator iter;
+	for( iter = sIconvPool.idleDescrs.begin();
+		  iter != sIconvPool.idleDescrs.end(); ++iter) {
+		for( uint32 i=0; i<iter->second.size(); ++i) {
+			iconv_close( iter->second[i]);
+			atomic_add( &sIconvCloses, 1);
+			atomic_add( &sIconvIdle, -1);
+		}
+	}
+	sIconvPool.idleDescrs.clear();
+}
+
+/*------------------------------------------------------------------------------*\
+	GetStats( stats)
+		-	fills the given stats with the current counters
+\*------------------------------------------------------------------------------*/
+void BmIconvPool::GetStats( Stats& stats) {
+	stats.checkOuts = sIconvCheckOuts;
+	stats.hits = sIconvHits;
+	stats.opens = sIconvOpens;
+	stats.closes = sIconvCloses;
+	stats.idleDescriptors = sIconvIdle;
+}
+
+/*------------------------------------------------------------------------------*\
+	ResetStats()
+		-	resets the counters (the number of idle descriptors is left alone)
+\*------------------------------------------------------------------------------*/
+void BmIconvPool::ResetStats() {
+	sIconvCheckOuts = 0;
+	sIconvHits = 0;
+	sIconvOpens = 0;
+	sIconvCloses = 0;
+}
+
+
+
+/*------------------------------------------------------------------------------*\
+	IsAsciiCompatible( charset)
+		-	returns whether or not the given charset is a stateless one that 
+			represents every ASCII-char by itself (such that converting pure 
+			ASCII from/to UTF-8 would not change it)
+\*------------------------------------------------------------------------------*/
+static bool IsAsciiCompatible( const BmString& charset) {
+	static const char* names[] = {
+		"us-ascii", "ascii", "utf-8", NULL
+	};
+	static const char* prefixes[] = {
+		"iso-8859-", "windows-125", "cp125", "koi8-", NULL
+	};
+	for( int32 i=0; names[i]; ++i) {
+		if (charset.ICompare( names[i]) == 0)
+			return true;
+	}
+	for( int32 i=0; prefixes[i]; ++i) {
+		if (charset.ICompare( prefixes[i], strlen( prefixes[i])) == 0)
+			return true;
+	}
+	return false;
+}
+
+/*------------------------------------------------------------------------------*\
+	UnchangedPrefixLen( isUtf8, isAsciiCompatible, data, len)
+		-	returns the length of the initial part of data that would not be 
+			changed by converting it between UTF-8 and the other charset
+			(which always ends on a char boundary)
+\*------------------------------------------------------------------------------*/
+static uint32 UnchangedPrefixLen( bool isUtf8, bool isAsciiCompatible, 
+											 const char* data, uint32 len) {
+	if (isUtf8)
+		return BmByteKernels::SpanValidUtf8( data, len);
+	if (isAsciiCompatible)
+		return BmByteKernels::SpanAscii( data, len);
+	return 0;
+}
+
+
 
 /********************************************************************************\
 	BmUtf8Decoder
@@ -578,6 +916,8 @@ BmUtf8Decoder::BmUtf8Decoder( BmMemIBuf* input, const BmString& destCharset,
 	if (mDestCharset.ICompare("utf8")==0)
 		// common mistake: utf8 instead of utf-8:
 		mDestCharset = "utf-8";
+	mIsUtf8 = mDestCharset.ICompare( "utf-8") == 0;
+	mIsAsciiCompatible = IsAsciiCompatible( mDestCharset);
 
 	InitConverter();
 }
@@ -589,7 +929,7 @@ BmUtf8Decoder::BmUtf8Decoder( BmMemIBuf* input, const BmString& destCharset,
 BmUtf8Decoder::~BmUtf8Decoder()
 {
 	if (mIconvDescr != ICONV_ERR) {
-		iconv_close( mIconvDescr);
+		BmIconvPool::CheckIn( mIconvDescr);
 		mIconvDescr = ICONV_ERR;
 	}
 }
@@ -612,19 +952,19 @@ void BmUtf8Decoder::Reset( BmMemIBuf* input) {
 \*------------------------------------------------------------------------------*/
 void BmUtf8Decoder::InitConverter() {
 	if (mIconvDescr != ICONV_ERR) {
-		iconv_close( mIconvDescr);
+		BmIconvPool::CheckIn( mIconvDescr);
 		mIconvDescr = ICONV_ERR;
 	}
-	BmString flag;
-	if (IsTagSet(nTagTransliterate))
-		flag = "//TRANSLIT";
-	else if (IsTagSet(nTagDiscard))
-		flag = "//IGNORE";
-	BmString toSet = mDestCharset	+ flag;
+	bool transliterate = IsTagSet(nTagTransliterate);
+	bool discard = IsTagSet(nTagDiscard);
 	if (!mDestCharset.Length()
-	|| (mIconvDescr = iconv_open( toSet.String(), "utf-8")) == ICONV_ERR) {
+	|| (mIconvDescr = BmIconvPool::CheckOut( "utf-8", mDestCharset, 
+														  transliterate, 
+														  discard)) == ICONV_ERR) {
 		AddStatusText( BmString("libiconv: unable to convert from utf-8 to ") 
-								<< toSet);
+								<< mDestCharset 
+								<< (transliterate ? "//TRANSLIT" 
+										: discard ? "//IGNORE" : ""));
 		mHadError = true;
 		return;
 	}
@@ -659,12 +999,24 @@ void BmUtf8Decoder::Filter( const char* srcBuf, uint32& srcLen,
 	BM_LOG3( BM_LogMailParse, 
 				BmString("starting to decode utf8 of ") << srcLen << " bytes");
 
-	const char* inBuf = srcBuf;
-	size_t inBytesLeft = srcLen;
-	char* outBuf = destBuf;
-	size_t outBytesLeft = destLen;
-	size_t irrevCount = iconv( mIconvDescr, ICONV_IN_BUF(&inBuf), 
-										&inBytesLeft, &outBuf, &outBytesLeft);
+	// the part that would not be changed by the conversion is just copied,
+	// iconv only gets to see the rest:
+	uint32 unchangedLen 
+		= mIconvDescr == ICONV_ERR
+			? 0
+			: UnchangedPrefixLen( mIsUtf8, mIsAsciiCompatible, srcBuf, 
+										 min_c( srcLen, destLen));
+	memcpy( destBuf, srcBuf, unchangedLen);
+
+	const char* inBuf = srcBuf+unchangedLen;
+	size_t inBytesLeft = srcLen-unchangedLen;
+	char* outBuf = destBuf+unchangedLen;
+	size_t outBytesLeft = destLen-unchangedLen;
+	size_t irrevCount 
+		= inBytesLeft
+			? iconv( mIconvDescr, ICONV_IN_BUF(&inBuf), &inBytesLeft, 
+						&outBuf, &outBytesLeft)
+			: 0;
 	srcLen -= inBytesLeft;
 	destLen -= outBytesLeft;
 	if (irrevCount == (size_t)-1) {
@@ -672,12 +1024,15 @@ void BmUtf8Decoder::Filter( const char* srcBuf, uint32& srcLen,
 			BM_LOG3( BM_LogMailParse, 
 						"Result in utf8-decode: too big, need to continue");
 		else if (errno == EINVAL) {
-			if (mStoppedOnMultibyte) {
+			// a multibyte char that has been split across block boundaries 
+			// is fed on its own before the next block is fetched, so we only 
+			// complain if we got stuck on it twice without any progress:
+			if (mStoppedOnMultibyte && !srcLen) {
 				AddStatusText( "utf8-decode: encountered incomplete multibyte "
 									"character, parts of text may be missing");
 				mHadError = true;
 			} else {
-				mStoppedOnMultibyte = true;
+				mStoppedOnMultibyte = !srcLen;
 				BM_LOG3( BM_LogMailParse, 
 							"Result in utf8-decode: stopped on multibyte char, "
 							"need to continue");
@@ -728,6 +1083,16 @@ void BmUtf8Decoder::Finalize( char* destBuf, uint32& destLen) {
 	BM_LOG3( BM_LogMailParse, "utf8-decode: done");
 }
 
+/*------------------------------------------------------------------------------*\
+	IsIdentityFor()
+		-	converting valid UTF-8 into UTF-8 (or ASCII into an ASCII-
+			compatible charset) is a no-op
+\*------------------------------------------------------------------------------*/
+bool BmUtf8Decoder::IsIdentityFor( const char* block, uint32 len) {
+	return mIconvDescr != ICONV_ERR && !mStoppedOnMultibyte
+		&& UnchangedPrefixLen( mIsUtf8, mIsAsciiCompatible, block, len) == len;
+}
+
 
 
 /********************************************************************************\
@@ -754,6 +1119,8 @@ BmUtf8Encoder::BmUtf8Encoder( BmMemIBuf* input, const BmString& srcCharset,
 	if (mSrcCharset.ICompare("utf8")==0)
 		// common mistake: utf8 instead of utf-8:
 		mSrcCharset = "utf-8";
+	mIsUtf8 = mSrcCharset.ICompare( "utf-8") == 0;
+	mIsAsciiCompatible = IsAsciiCompatible( mSrcCharset);
 
 	InitConverter();
 }
@@ -765,7 +1132,7 @@ BmUtf8Encoder::BmUtf8Encoder( BmMemIBuf* input, const BmString& srcCharset,
 BmUtf8Encoder::~BmUtf8Encoder()
 {
 	if (mIconvDescr != ICONV_ERR) {
-		iconv_close( mIconvDescr);
+		BmIconvPool::CheckIn( mIconvDescr);
 		mIconvDescr = ICONV_ERR;
 	}
 }
@@ -789,21 +1156,20 @@ void BmUtf8Encoder::Reset( BmMemIBuf* input) {
 \*------------------------------------------------------------------------------*/
 void BmUtf8Encoder::InitConverter() { 
 	if (mIconvDescr != ICONV_ERR) {
-		iconv_close( mIconvDescr);
+		BmIconvPool::CheckIn( mIconvDescr);
 		mIconvDescr = ICONV_ERR;
 	}
-	BmString flag;
-	if (IsTagSet(nTagTransliterate))
-		flag = "//TRANSLIT";
-	else if (IsTagSet(nTagDiscard))
-		flag = "//IGNORE";
-	BmString toSet = BmString("utf-8") + flag;
+	bool transliterate = IsTagSet(nTagTransliterate);
+	bool discard = IsTagSet(nTagDiscard);
 	if (!mSrcCharset.Length()
-	|| (mIconvDescr = iconv_open( toSet.String(), 
-											mSrcCharset.String())) == ICONV_ERR) {
+	|| (mIconvDescr = BmIconvPool::CheckOut( mSrcCharset, "utf-8", 
+														  transliterate, 
+														  discard)) == ICONV_ERR) {
 		BM_LOG( BM_LogMailParse,
 				  BmString("libiconv: unable to convert from ") 
-							<< mSrcCharset << " to " << toSet);
+							<< mSrcCharset << " to utf-8"
+							<< (transliterate ? "//TRANSLIT" 
+									: discard ? "//IGNORE" : ""));
 		mHadError = true;
 		return;
 	}
@@ -838,12 +1204,24 @@ void BmUtf8Encoder::Filter( const char* srcBuf, uint32& srcLen,
 	BM_LOG3( BM_LogMailParse, 
 				BmString("starting to encode utf8 of ") << srcLen << " bytes");
 
-	const char* inBuf = srcBuf;
-	size_t inBytesLeft = srcLen;
-	char* outBuf = destBuf;
-	size_t outBytesLeft = destLen;
-	size_t irrevCount = iconv( mIconvDescr, ICONV_IN_BUF(&inBuf), 
-										&inBytesLeft, &outBuf, &outBytesLeft);
+	// the part that would not be changed by the conversion is just copied,
+	// iconv only gets to see the rest:
+	uint32 unchangedLen 
+		= mIconvDescr == ICONV_ERR
+			? 0
+			: UnchangedPrefixLen( mIsUtf8, mIsAsciiCompatible, srcBuf, 
+										 min_c( srcLen, destLen));
+	memcpy( destBuf, srcBuf, unchangedLen);
+
+	const char* inBuf = srcBuf+unchangedLen;
+	size_t inBytesLeft = srcLen-unchangedLen;
+	char* outBuf = destBuf+unchangedLen;
+	size_t outBytesLeft = destLen-unchangedLen;
+	size_t irrevCount 
+		= inBytesLeft
+			? iconv( mIconvDescr, ICONV_IN_BUF(&inBuf), &inBytesLeft, 
+						&outBuf, &outBytesLeft)
+			: 0;
 	srcLen -= inBytesLeft;
 	destLen -= outBytesLeft;
 	if (irrevCount == (size_t)-1) {
@@ -851,7 +1229,9 @@ void BmUtf8Encoder::Filter( const char* srcBuf, uint32& srcLen,
 			BM_LOG3( BM_LogMailParse, 
 						"Result in utf8-encode: too big, need to continue");
 		else if (errno == EINVAL) {
-			if (mStoppedOnMultibyte) {
+			// as in the decoder, only getting stuck on a multibyte char 
+			// without any progress counts:
+			if (mStoppedOnMultibyte && !srcLen) {
 				if (!mHaveResetToInitialState) {
 					// return to inital state:
 					iconv( mIconvDescr, NULL, NULL, NULL, NULL);
@@ -862,7 +1242,7 @@ void BmUtf8Encoder::Filter( const char* srcBuf, uint32& srcLen,
 					mHadError = true;
 				}
 			} else {
-				mStoppedOnMultibyte = true;
+				mStoppedOnMultibyte = !srcLen;
 				mHaveResetToInitialState = false;
 				BM_LOG3( BM_LogMailParse, 
 							"Result in utf8-encode: stopped on multibyte char, "
@@ -889,6 +1269,16 @@ void BmUtf8Encoder::Filter( const char* srcBuf, uint32& srcLen,
 	BM_LOG3( BM_LogMailParse, "utf8-encode: done");
 }
 
+/*------------------------------------------------------------------------------*\
+	IsIdentityFor()
+		-	converting valid UTF-8 into UTF-8 (or ASCII into an ASCII-
+			compatible charset) is a no-op
+\*------------------------------------------------------------------------------*/
+bool BmUtf8Encoder::IsIdentityFor( const char* block, uint32 len) {
+	return mIconvDescr != ICONV_ERR && !mStoppedOnMultibyte
+		&& UnchangedPrefixLen( mIsUtf8, mIsAsciiCompatible, block, len) == len;
+}
+
 
 
 /********************************************************************************\
@@ -936,7 +1326,28 @@ void BmQuotedPrintableDecoder::Filter( const char* srcBuf, uint32& srcLen,
 
 	char c,c1,c2;
 	const BmString qpChars("abcdef0123456789ABCDEF");
+	bool isEncodedWord = IsTagSet( nTagIsEncodedWord);
+	const char* specialChars = isEncodedWord ? "\r\n=_" : "\r\n=";
 	for( ; src<srcEnd && dest<destEnd; ++src) {
+		if (!mSoftbreakPending && !mSpacesThatMayNeedRemoval) {
+			// copy the run of plain chars up to the next one that needs 
+			// special handling en bloc (spaces at the end of the run may
+			// live before a newline, so these are left to the code below):
+			int32 runLen = min_c( srcEnd-src, destEnd-dest);
+			const char* special 
+				= BmByteKernels::FindAnyByte( src, runLen, specialChars);
+			if (special)
+				runLen = special-src;
+			while( runLen && src[runLen-1] == ' ')
+				runLen--;
+			if (runLen) {
+				memcpy( dest, src, runLen);
+				src += runLen;
+				dest += runLen;
+				if (src>=srcEnd || dest>=destEnd)
+					break;
+			}
+		}
 		c = *src;
 		if (c == '\r') {
 			// skip over carriage-returns:
@@ -996,7 +1407,7 @@ void BmQuotedPrintableDecoder::Filter( const char* srcBuf, uint32& srcLen,
 					// characters missing at end (broken encoding), we just copy:
 					*dest++ = c;
 				}
-			} else if (IsTagSet(nTagIsEncodedWord) && c == '_') {
+			} else if (isEncodedWord && c == '_') {
 				// in encoded-words, underlines are really spaces 
 				// (a real underline is encoded):
 				*dest++ = ' ';
@@ -1119,12 +1530,20 @@ void BmQuotedPrintableEncoder::Filter( const char* srcBuf, uint32& srcLen,
 	BM_LOG3( BM_LogMailParse, 
 				BmString("starting to encode quoted-printable of ") 
 						<< srcLen << " bytes");
+	bool safeForEBCDIC = ThePrefs->GetBool( "MakeQPSafeForEBCDIC", false);
 	const char* safeChars = 
-				(ThePrefs->GetBool( "MakeQPSafeForEBCDIC", false)
+				(safeForEBCDIC
 					? "%&/()?+*,.;:<>-_"
 					: "%&/()?+*,.;:<>-_!\"#$@[]\\^'{|}~");
 							// in bodies, the underscore is safe, i.e. it need
 							// not be encoded.
+	const char* unsafeChars = 
+				(safeForEBCDIC
+					? "!\"#$'=@[\\]^`{|}~"
+					: "=`");
+							// the printable chars that are neither 
+							// alphanumeric nor safe (must be kept in sync
+							// with safeChars)
 	const char* src = srcBuf;
 	const char* srcEnd = srcBuf+srcLen;
 	char* dest = destBuf;
@@ -1133,6 +1552,29 @@ void BmQuotedPrintableEncoder::Filter( const char* srcBuf, uint32& srcLen,
 	for( ; src<srcEnd && dest<destEnd; ++src) {
 		if (!OutputLineIfNeeded( dest, destEnd))
 			break;
+		if (!mSpacesThatMayNeedEncoding && !mNeedFlush) {
+			// queue the run of safe chars en bloc, as far as it fits onto 
+			// the current line (such that no folding is required in between),
+			// spaces at the end of the run are left to the code below, as
+			// these may need encoding:
+			int32 room = BM_MAX_HEADER_LINE_LEN - mQueuedChars.Length();
+			int32 runLen 
+				= room > 0
+					? BmByteKernels::SpanPrintable( src, min_c( srcEnd-src, room),
+															  unsafeChars)
+					: 0;
+			while( runLen && src[runLen-1] == ' ')
+				runLen--;
+			if (runLen) {
+				if (runLen > 1) {
+					mQueuedChars.Put( src, runLen-1);
+					mCurrAddedLen = 1;
+				}
+				Queue( src+runLen-1, 1);
+				src += runLen-1;
+				continue;
+			}
+		}
 		c = *src;
 		if (c=='\r')
 			continue;							// ignore '\r'
@@ -1245,7 +1687,7 @@ BmQpEncodedWordEncoder::BmQpEncodedWordEncoder( BmMemIBuf* input,
 BmQpEncodedWordEncoder::~BmQpEncodedWordEncoder()
 {
 	if (mIconvDescr != ICONV_ERR) {
-		iconv_close( mIconvDescr);
+		BmIconvPool::CheckIn( mIconvDescr);
 		mIconvDescr = ICONV_ERR;
 	}
 }
@@ -1267,14 +1709,14 @@ void BmQpEncodedWordEncoder::Reset( BmMemIBuf* input) {
 \*------------------------------------------------------------------------------*/
 void BmQpEncodedWordEncoder::InitConverter() {
 	if (mIconvDescr != ICONV_ERR) {
-		iconv_close( mIconvDescr);
+		BmIconvPool::CheckIn( mIconvDescr);
 		mIconvDescr = ICONV_ERR;
 	}
-	BmString toSet = mDestCharset;
 	if (!mDestCharset.Length()
-	|| (mIconvDescr = iconv_open( toSet.String(), "utf-8")) == ICONV_ERR) {
+	|| (mIconvDescr = BmIconvPool::CheckOut( "utf-8", 
+														  mDestCharset)) == ICONV_ERR) {
 		AddStatusText( BmString("libiconv: unable to convert from utf-8 to ") 
-								<< toSet);
+								<< mDestCharset);
 		mHadError = true;
 		return;
 	}
@@ -1640,6 +2082,17 @@ void BmBase64Decoder::Filter( const char* srcBuf, uint32& srcLen,
 	char* destEnd = destBuf+destLen;
 		
 	while( src<srcEnd && dest<=destEnd-3) {
+		if (!mIndex) {
+			// decode the complete groups up to the next char outside of the
+			// alphabet (usually the linebreak) en bloc, that char itself is
+			// handled below:
+			int32 used;
+			dest += BmByteKernels::DecodeBase64( (const char*)src, srcEnd-src,
+															 dest, destEnd-dest, used);
+			src += used;
+			if (src>=srcEnd || dest>destEnd-3)
+				break;
+		}
 		if ((value = nBase64Alphabet[*src++])<0) {
 			if (value == -2) {
 				// padding-char ('=') encountered, we flush converted chars...
@@ -1734,8 +2187,32 @@ void BmBase64Encoder::Filter( const char* srcBuf, uint32& srcLen,
 	const unsigned char* srcEnd = (unsigned char*)srcBuf+srcLen;
 	char* dest = destBuf;
 	char* destEnd = destBuf+destLen;
+	bool onSingleLine = IsTagSet( nTagOnSingleLine);
 		
 	while( src<srcEnd && dest<=destEnd-6) {
+		if (!mIndex) {
+			// encode the complete groups up to the end of the current line
+			// en bloc (leaving room for the linebreak):
+			int32 srcAvail = srcEnd-src;
+			if (!onSingleLine)
+				srcAvail = min_c( srcAvail, 
+										(BM_MAX_HEADER_LINE_LEN-mCurrLineLen+3)/4*3);
+			int32 used;
+			int32 written 
+				= BmByteKernels::EncodeBase64( (const char*)src, srcAvail, 
+														 dest, destEnd-dest-2, used);
+			if (used) {
+				src += used;
+				dest += written;
+				mCurrLineLen += written;
+				if (!onSingleLine && mCurrLineLen >= BM_MAX_HEADER_LINE_LEN) {
+					*dest++ = '\r';
+					*dest++ = '\n';
+					mCurrLineLen = 0;
+				}
+				continue;
+			}
+		}
 		mConcat |= (*src++ << ((2-mIndex)*8));
 		if (++mIndex == 3) {
 			*dest++ = nBase64Alphabet[(mConcat >> 18) & 63];
@@ -1744,8 +2221,7 @@ void BmBase64Encoder::Filter( const char* srcBuf, uint32& srcLen,
 			*dest++ = nBase64Alphabet[mConcat & 63];
 			mConcat = mIndex = 0;
 			mCurrLineLen += 4;
-			if (!IsTagSet(nTagOnSingleLine) 
-			&& mCurrLineLen >= BM_MAX_HEADER_LINE_LEN) {
+			if (!onSingleLine && mCurrLineLen >= BM_MAX_HEADER_LINE_LEN) {
 				*dest++ = '\r';
 				*dest++ = '\n';
 				mCurrLineLen = 0;
@@ -1811,10 +2287,16 @@ void BmLinebreakDecoder::Filter( const char* srcBuf, uint32& srcLen,
 	char* dest = destBuf;
 	char* destEnd = destBuf+destLen;
 
-	char c;
-	for( ; src<srcEnd && dest<destEnd; ++src) {
-		if ((c = *src) != '\r')
-			*dest++ = c;
+	// copy everything between CRs en bloc, the CRs are dropped:
+	while( src<srcEnd && dest<destEnd) {
+		uint32 avail = min_c( srcEnd-src, destEnd-dest);
+		const char* cr = BmByteKernels::FindByte( src, avail, '\r');
+		uint32 len = cr ? cr-src : avail;
+		memcpy( dest, src, len);
+		src += len;
+		dest += len;
+		if (cr)
+			src++;
 	}
 
 	srcLen = src-srcBuf;
@@ -1822,6 +2304,14 @@ void BmLinebreakDecoder::Filter( const char* srcBuf, uint32& srcLen,
 	BM_LOG3( BM_LogMailParse, "linebreak-decode: done");
 }
 
+/*------------------------------------------------------------------------------*\
+	IsIdentityFor()
+		-	a block without any CRs passes unchanged
+\*------------------------------------------------------------------------------*/
+bool BmLinebreakDecoder::IsIdentityFor( const char* block, uint32 len) {
+	return !BmByteKernels::FindByte( block, len, '\r');
+}
+
 
 
 /********************************************************************************\
@@ -1852,16 +2342,25 @@ void BmLinebreakEncoder::Filter( const char* srcBuf, uint32& srcLen,
 	char* dest = destBuf;
 	char* destEnd = destBuf+destLen;
 
-	char c;
-	for( ; src<srcEnd && dest<destEnd; ++src) {
-		if ((c = *src) == '\n') {
+	// copy everything between linebreaks en bloc, every CR is dropped and 
+	// every LF is written as CRLF:
+	while( src<srcEnd && dest<destEnd) {
+		uint32 avail = min_c( srcEnd-src, destEnd-dest);
+		const char* pos 
+			= BmByteKernels::FindEitherByte( src, avail, '\r', '\n');
+		uint32 len = pos ? pos-src : avail;
+		memcpy( dest, src, len);
+		src += len;
+		dest += len;
+		if (!pos)
+			continue;
+		if (*pos == '\n') {
 			if (dest>destEnd-2)
 				break;
 			*dest++ = '\r';
-		} 
-		if (c != '\r')
-			// copy character unless it's '\r' (we dump that):
-			*dest++ = c;
+			*dest++ = '\n';
+		}
+		src++;
 	}
 
 	srcLen = src-srcBuf;
@@ -1869,6 +2368,14 @@ void BmLinebreakEncoder::Filter( const char* srcBuf, uint32& srcLen,
 	BM_LOG3( BM_LogMailParse, "linebreak-encode: done");
 }
 
+/*------------------------------------------------------------------------------*\
+	IsIdentityFor()
+		-	a block without any linebreaks passes unchanged
+\*------------------------------------------------------------------------------*/
+bool BmLinebreakEncoder::IsIdentityFor( const char* block, uint32 len) {
+	return !BmByteKernels::FindEitherByte( block, len, '\r', '\n');
+}
+
 
 
 /********************************************************************************\
@@ -1881,7 +2388,6 @@ void BmLinebreakEncoder::Filter( const char* srcBuf, uint32& srcLen,
 \*------------------------------------------------------------------------------*/
 BmMailtextCleaner::BmMailtextCleaner( BmMemIBuf* input, uint32 blockSize)
 	:	inherited( input, blockSize)
-	,	mLastWasStartOfShiftSpace(false)
 {
 }
 
@@ -1900,35 +2406,457 @@ void BmMailtextCleaner::Filter( const char* srcBuf, uint32& srcLen,
 	char* destEnd = destBuf+destLen;
 
 	// filter out shift-space (C2A0 in UTF-8) as it confuses BTextView, as well
-	// as our own wrapping code. We replace it by a normal space:
-	char c;
-	for( ; src<srcEnd && dest<destEnd; ++src) {
-		switch((c = *src)) {
-			case '\xC2':
-				mLastWasStartOfShiftSpace = true;
-				*dest++ = c;
+	// as our own wrapping code. We replace it by a normal space.
+	// A \xC2 at the end of the source is only passed on if there is no more
+	// input, otherwise it is left for the next round (since we can't replace
+	// it once it has been handed out):
+	while( src<srcEnd && dest<destEnd) {
+		const char* start = BmByteKernels::FindByte( src, min_c( srcEnd-src, 
+																			destEnd-dest), 
+																	'\xC2');
+		uint32 len = start ? start-src : min_c( srcEnd-src, destEnd-dest);
+		memcpy( dest, src, len);
+		src += len;
+		dest += len;
+		if (!start)
+			continue;
+		if (start+1 < srcEnd) {
+			if (start[1] == '\xA0') {
+				*dest++ = '\x20';
+				src += 2;
+			} else
+				*dest++ = *src++;
+		} else if (mInput->IsAtEnd())
+			*dest++ = *src++;
+		else
+			break;
+	}
+
+	srcLen = src-srcBuf;
+	destLen = dest-destBuf;
+	BM_LOG3( BM_LogMailParse, "mailtext-cleaner: done");
+}
+
+/*------------------------------------------------------------------------------*\
+	IsIdentityFor()
+		-	a block without any (second half of a) shift-space passes unchanged
+\*------------------------------------------------------------------------------*/
+bool BmMailtextCleaner::IsIdentityFor( const char* block, uint32 len) {
+	// blocks ending with the start of a shift-space are left to Filter(), 
+	// since it may have to replace that last char
+	return len && block[len-1] != '\xC2' 
+		&& !BmByteKernels::FindByte( block, len, '\xA0');
+}
+
+
+
+/********************************************************************************\
+	BmTextBodyDecoder
+\********************************************************************************/
+
+const uint32 BmTextBodyDecoder::nScratchSize = 8192;
+
+/*------------------------------------------------------------------------------*\
+	RemoveCRs( data, len)
+		-	drops all CRs from the given data (in place)
+		-	returns the new length of the data
+\*------------------------------------------------------------------------------*/
+static uint32 RemoveCRs( char* data, uint32 len) {
+	char* cr = const_cast<char*>( BmByteKernels::FindByte( data, len, '\r'));
+	if (!cr)
+		return len;
+	char* dest = cr;
+	const char* src = cr+1;
+	const char* end = data+len;
+	while( src < end) {
+		cr = const_cast<char*>( BmByteKernels::FindByte( src, end-src, '\r'));
+		uint32 runLen = cr ? cr-src : end-src;
+		memmove( dest, src, runLen);
+		dest += runLen;
+		src += runLen + (cr ? 1 : 0);
+	}
+	return dest-data;
+}
+
+/*------------------------------------------------------------------------------*\
+	IsIncompleteUtf8Char( data, len)
+		-	returns whether or not the given data could be the start of a
+			multibyte char (which continues in the next block)
+\*------------------------------------------------------------------------------*/
+static bool IsIncompleteUtf8Char( const char* data, uint32 len) {
+	uint8 lead = data[0];
+	uint32 charLen = lead >= 0xC2 && lead <= 0xDF ? 2
+							: lead >= 0xE0 && lead <= 0xEF ? 3
+							: lead >= 0xF0 && lead <= 0xF4 ? 4
+							: 0;
+	if (len >= charLen)
+		return false;
+	for( uint32 i=1; i<len; ++i) {
+		if ((data[i] & 0xC0) != 0x80)
+			return false;
+	}
+	return true;
+}
+
+/*------------------------------------------------------------------------------*\
+	BmTextBodyDecoder()
+		-	constructor
+\*------------------------------------------------------------------------------*/
+BmTextBodyDecoder::BmTextBodyDecoder( BmMemIBuf* input,
+												  const BmString& encodingStyle,
+												  const BmString& srcCharset,
+												  uint32 blockSize)
+	:	inherited( input, blockSize)
+	,	mTransferDecoder( FindDecoderFor( input, encodingStyle, nScratchSize))
+	,	mCharset( CharsetFor( srcCharset))
+	,	mScratch( BmBlockPool::Allocate( nScratchSize))
+	,	mScratchLen( 0)
+	,	mNeedsFallback( false)
+{
+	if (!mScratch)
+		throw std::bad_alloc();
+	if (mCharset == CHARSET_UNSUPPORTED) {
+		mNeedsFallback = true;
+		mHadError = true;
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	~BmTextBodyDecoder()
+		-	destructor
+\*------------------------------------------------------------------------------*/
+BmTextBodyDecoder::~BmTextBodyDecoder() {
+	BmBlockPool::Free( mScratch, nScratchSize);
+}
+
+/*------------------------------------------------------------------------------*\
+	CharsetFor( charset)
+		-	maps the given charset-name to the charsets we can handle ourselves
+\*------------------------------------------------------------------------------*/
+BmTextBodyDecoder::Charset BmTextBodyDecoder::CharsetFor(
+	const BmString& charset)
+{
+	if (charset.ICompare( "utf-8")==0 || charset.ICompare( "utf8")==0)
+		return CHARSET_UTF8;
+	if (charset.ICompare( "us-ascii")==0)
+		return CHARSET_US_ASCII;
+	if (charset.ICompare( "iso-8859-1")==0)
+		return CHARSET_LATIN1;
+	if (charset.ICompare( "iso-8859-15")==0)
+		return CHARSET_LATIN9;
+	return CHARSET_UNSUPPORTED;
+}
+
+/*------------------------------------------------------------------------------*\
+	CanHandle( srcCharset)
+		-	returns whether or not text in the given charset can be decoded by
+			BmTextBodyDecoder (otherwise the chain must be used)
+\*------------------------------------------------------------------------------*/
+bool BmTextBodyDecoder::CanHandle( const BmString& srcCharset) {
+	return CharsetFor( srcCharset) != CHARSET_UNSUPPORTED;
+}
+
+/*------------------------------------------------------------------------------*\
+	Filter()
+		-	transfer-decodes as much of the source as fits into the scratch
+			buffer (such that the converted scratch will fit into the
+			destination), then converts the scratch in one go; repeats until
+			either source or destination is exhausted
+\*------------------------------------------------------------------------------*/
+void BmTextBodyDecoder::Filter( const char* srcBuf, uint32& srcLen,
+										  char* destBuf, uint32& destLen) {
+	BM_LOG3( BM_LogMailParse,
+				BmString("starting to decode text-body of ") << srcLen
+					<< " bytes");
+
+	const char* src = srcBuf;
+	const char* srcEnd = srcBuf+srcLen;
+	char* dest = destBuf;
+	char* destEnd = destBuf+destLen;
+	// a single char of the source expands to at most three bytes of UTF-8:
+	uint32 maxExpansion = mCharset == CHARSET_LATIN9 ? 3
+									: mCharset == CHARSET_LATIN1 ? 2
+									: 1;
+
+	while( src < srcEnd && !mNeedsFallback) {
+		uint32 maxScratchLen
+			= min_c( nScratchSize, uint32(destEnd-dest) / maxExpansion);
+		if (maxScratchLen <= mScratchLen)
+			break;
+		uint32 inLen = srcEnd-src;
+		uint32 outLen = maxScratchLen-mScratchLen;
+		FilterWith( mTransferDecoder.get(), src, inLen,
+						mScratch+mScratchLen, outLen);
+		if (!inLen && !outLen)
+			break;
+		src += inLen;
+		mScratchLen += RemoveCRs( mScratch+mScratchLen, outLen);
+		uint32 convertedLen = destEnd-dest;
+		ConvertScratch( dest, convertedLen);
+		dest += convertedLen;
+	}
+
+	srcLen = src-srcBuf;
+	destLen = dest-destBuf;
+	BM_LOG3( BM_LogMailParse, "text-body-decode: done");
+}
+
+/*------------------------------------------------------------------------------*\
+	Finalize()
+		-	finalizes the transfer-decoder and converts whatever it hands out
+\*------------------------------------------------------------------------------*/
+void BmTextBodyDecoder::Finalize( char* destBuf, uint32& destLen) {
+	const uint32 nMinRoom = 16;
+							// enough for the rest of the transfer-decoding and
+							// an incomplete multibyte char
+	if (mNeedsFallback || destLen < nMinRoom) {
+		destLen = 0;
+		mIsFinalized = mNeedsFallback;
+		return;
+	}
+	uint32 outLen = nScratchSize-mScratchLen;
+	bool transferFinalized
+		= FinalizeWith( mTransferDecoder.get(), mScratch+mScratchLen, outLen);
+	mScratchLen += RemoveCRs( mScratch+mScratchLen, outLen);
+	ConvertScratch( destBuf, destLen);
+	if (mTransferDecoder->HaveStatusText())
+		AddStatusText( mTransferDecoder->StatusText());
+	if (mScratchLen && transferFinalized) {
+		// incomplete multibyte char at the end of the text, that's something
+		// for the chain to report:
+		mNeedsFallback = true;
+		mHadError = true;
+	}
+	mIsFinalized = transferFinalized;
+}
+
+/*------------------------------------------------------------------------------*\
+	ConvertScratch( destBuf, destLen)
+		-	converts the (transfer-decoded) data in the scratch buffer into
+			UTF-8, replacing every shift-space by a normal space (just like
+			BmMailtextCleaner does)
+		-	an incomplete multibyte char at the end of the scratch buffer is
+			left for the next round, invalid chars stop the decoder
+\*------------------------------------------------------------------------------*/
+void BmTextBodyDecoder::ConvertScratch( char* destBuf, uint32& destLen) {
+	const char* src = mScratch;
+	const char* srcEnd = mScratch+mScratchLen;
+	char* dest = destBuf;
+
+	if (mCharset == CHARSET_UTF8) {
+		const char* validEnd
+			= src + BmByteKernels::SpanValidUtf8( src, mScratchLen);
+		while( src < validEnd) {
+			const char* nbspEnd
+				= BmByteKernels::FindByte( src, validEnd-src, '\xA0');
+			uint32 runLen = nbspEnd ? nbspEnd-src : validEnd-src;
+			memcpy( dest, src, runLen);
+			dest += runLen;
+			src += runLen;
+			if (nbspEnd) {
+				// the \xA0 is a continuation byte, so it's a shift-space only
+				// if it follows \xC2:
+				if (nbspEnd > mScratch && nbspEnd[-1] == '\xC2')
+					dest[-1] = ' ';
+				else
+					*dest++ = '\xA0';
+				src++;
+			}
+		}
+		if (src < srcEnd && (srcEnd-src > 3
+								  || !IsIncompleteUtf8Char( src, srcEnd-src))) {
+			mNeedsFallback = true;
+			mHadError = true;
+		}
+	} else if (mCharset == CHARSET_US_ASCII) {
+		uint32 asciiLen = BmByteKernels::SpanAscii( src, mScratchLen);
+		memcpy( dest, src, asciiLen);
+		dest += asciiLen;
+		src += asciiLen;
+		if (src < srcEnd) {
+			mNeedsFallback = true;
+			mHadError = true;
+		}
+	} else {
+		while( src < srcEnd) {
+			uint32 asciiLen = BmByteKernels::SpanAscii( src, srcEnd-src);
+			memcpy( dest, src, asciiLen);
+			dest += asciiLen;
+			src += asciiLen;
+			if (src == srcEnd)
 				break;
-			case '\xA0':
-				if (mLastWasStartOfShiftSpace) {
-					*(dest-1) = '\x20';
-					mLastWasStartOfShiftSpace = false;
-					break;
+			uint8 c = *src++;
+			uint16 unicode = c;
+			if (mCharset == CHARSET_LATIN9) {
+				// the chars where iso-8859-15 differs from iso-8859-1:
+				switch( c) {
+					case 0xA4: unicode = 0x20AC; break;
+					case 0xA6: unicode = 0x0160; break;
+					case 0xA8: unicode = 0x0161; break;
+					case 0xB4: unicode = 0x017D; break;
+					case 0xB8: unicode = 0x017E; break;
+					case 0xBC: unicode = 0x0152; break;
+					case 0xBD: unicode = 0x0153; break;
+					case 0xBE: unicode = 0x0178; break;
 				}
-				else
-					// fall through
-			default:
-				*dest++ = c;
-				mLastWasStartOfShiftSpace = false;
+			}
+			if (unicode == 0xA0)
+				// shift-space
+				*dest++ = ' ';
+			else if (unicode < 0x800) {
+				*dest++ = char(0xC0 | (unicode >> 6));
+				*dest++ = char(0x80 | (unicode & 0x3F));
+			} else {
+				*dest++ = char(0xE0 | (unicode >> 12));
+				*dest++ = char(0x80 | ((unicode >> 6) & 0x3F));
+				*dest++ = char(0x80 | (unicode & 0x3F));
+			}
 		}
 	}
 
-	srcLen = src-srcBuf;
+	// keep the rest (an incomplete multibyte char) for the next round:
+	mScratchLen = srcEnd-src;
+	memmove( mScratch, src, mScratchLen);
 	destLen = dest-destBuf;
-	BM_LOG3( BM_LogMailParse, "mailtext-cleaner: done");
 }
 
 
 
+/********************************************************************************\
+	BmCharsetDetector
+\********************************************************************************/
+
+const int32 BmCharsetDetector::nUnknown = -1;
+const int32 BmCharsetDetector::nFails = 0x7FFFFFFF;
+
+/*------------------------------------------------------------------------------*\
+	the models of the single-byte charsets known to the detector:
+		-	undefined contains the bytes that have no meaning in the charset
+		-	hasC1Controls indicates whether 0x80-0x9F are control chars
+\*------------------------------------------------------------------------------*/
+struct BmCharsetModel {
+	const char* name;
+	const char* undefined;
+	bool hasC1Controls;
+};
+static const BmCharsetModel BmCharsetModels[] = {
+	{ "iso-8859-1", "", true },
+	{ "iso-8859-2", "", true },
+	{ "iso-8859-3", "\xA5\xAE\xBE\xC3\xD0\xE3\xF0", true },
+	{ "iso-8859-4", "", true },
+	{ "iso-8859-5", "", true },
+	{ "iso-8859-9", "", true },
+	{ "iso-8859-10", "", true },
+	{ "iso-8859-13", "", true },
+	{ "iso-8859-14", "", true },
+	{ "iso-8859-15", "", true },
+	{ "iso-8859-16", "", true },
+	{ "windows-1250", "\x81\x83\x88\x90\x98", false },
+	{ "windows-1251", "\x98", false },
+	{ "windows-1252", "\x81\x8D\x8F\x90\x9D", false },
+	{ "koi8-r", "", false },
+	{ NULL, NULL, false }
+};
+
+/*------------------------------------------------------------------------------*\
+	BmCharsetDetector( data, len)
+		-	constructor, gathers the statistics about the given text, which is
+			expected to be transfer-decoded already
+\*------------------------------------------------------------------------------*/
+BmCharsetDetector::BmCharsetDetector( const char* data, int32 len)
+	:	mHighByteCount( 0)
+	,	mUtf8CharCount( 0)
+	,	mIsValidUtf8( true)
+{
+	memset( mByteCounts, 0, sizeof( mByteCounts));
+	const char* pos = data;
+	const char* end = data+len;
+	while( pos < end) {
+		pos += BmByteKernels::SpanAscii( pos, end-pos);
+		if (pos == end)
+			break;
+		uint8 lead = *pos;
+		int32 charLen = lead >= 0xC2 && lead <= 0xDF ? 2
+								: lead >= 0xE0 && lead <= 0xEF ? 3
+								: lead >= 0xF0 && lead <= 0xF4 ? 4
+								: 0;
+		if (charLen && charLen <= end-pos
+		&& BmByteKernels::SpanValidUtf8( pos, charLen) == charLen)
+			mUtf8CharCount++;
+		else {
+			mIsValidUtf8 = false;
+			charLen = 1;
+		}
+		for( int32 i=0; i<charLen; ++i)
+			mByteCounts[(uint8)pos[i] - 0x80]++;
+		mHighByteCount += charLen;
+		pos += charLen;
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	Penalty( charset)
+		-	returns how unlikely it is that the text is in the given charset:
+			*	0 means the text looks fine in that charset
+			*	nFails means that converting the text would fail
+			*	nUnknown means that the detector knows nothing about the charset
+		-	control chars count against a charset, as does text that is valid
+			utf-8 (which is hardly ever the case for real text in a single-byte
+			charset)
+\*------------------------------------------------------------------------------*/
+int32 BmCharsetDetector::Penalty( const BmString& charset) const {
+	if (charset.ICompare( "us-ascii")==0)
+		return mHighByteCount ? nFails : 0;
+	if (charset.ICompare( "utf-8")==0 || charset.ICompare( "utf8")==0)
+		return mIsValidUtf8 ? 0 : nFails;
+	for( int32 m=0; BmCharsetModels[m].name; ++m) {
+		const BmCharsetModel& model = BmCharsetModels[m];
+		if (charset.ICompare( model.name) != 0)
+			continue;
+		for( const char* u=model.undefined; *u; ++u) {
+			if (mByteCounts[(uint8)*u - 0x80])
+				return nFails;
+		}
+		int32 penalty = mIsValidUtf8 ? mUtf8CharCount : 0;
+		if (model.hasC1Controls) {
+			for( int32 i=0; i<0x20; ++i)
+				penalty += mByteCounts[i];
+		}
+		return penalty;
+	}
+	return nUnknown;
+}
+
+/*------------------------------------------------------------------------------*\
+	PickCharset( candidates)
+		-	returns the index of the candidate the text should be converted from:
+			the first candidate the text looks fine in or (if there is none) the
+			first one with the least penalty; if all candidates fail, the last 
+			one is picked (such that the conversion shows the error).
+		-	returns -1 if the candidates can't be judged, i.e. if a charset 
+			unknown to the detector would have to be tried first
+\*------------------------------------------------------------------------------*/
+int32 BmCharsetDetector::PickCharset( 
+	const BmEncoding::BmCharsetVect& candidates) const
+{
+	int32 bestIndex = -1;
+	int32 bestPenalty = nFails;
+	for( uint32 i=0; i<candidates.size(); ++i) {
+		int32 penalty = Penalty( candidates[i]);
+		if (penalty == nUnknown)
+			// the candidate may or may not fit, but any earlier one that can
+			// be converted without errors would have been preferred anyway:
+			return bestIndex;
+		if (penalty == 0)
+			return i;
+		if (penalty < bestPenalty) {
+			bestIndex = i;
+			bestPenalty = penalty;
+		}
+	}
+	return bestIndex >= 0 ? bestIndex : (int32)candidates.size()-1;
+}
+
 /********************************************************************************\
 	BmBinaryDecoder
 \********************************************************************************/
@@ -1958,6 +2886,14 @@ void BmBinaryDecoder::Filter( const char* srcBuf, uint32& srcLen,
 	BM_LOG3( BM_LogMailParse, "binary-decode: done");
 }
 
+/*------------------------------------------------------------------------------*\
+	IsIdentityFor()
+		-	binary data is never changed
+\*------------------------------------------------------------------------------*/
+bool BmBinaryDecoder::IsIdentityFor( const char* , uint32 ) {
+	return true;
+}
+
 
 
 /********************************************************************************\
@@ -1988,3 +2924,11 @@ void BmBinaryEncoder::Filter( const char* srcBuf, uint32& srcLen,
 	srcLen = destLen = size;
 	BM_LOG3( BM_LogMailParse, "binary-encode: done");
 }
+
+/*------------------------------------------------------------------------------*\
+	IsIdentityFor()
+		-	binary data is never changed
+\*------------------------------------------------------------------------------*/
+bool BmBinaryEncoder::IsIdentityFor( const char* , uint32 ) {
+	return true;
+}
@@ -91,10 +91,57 @@ namespace BmEncoding {
 											 const BmString& encodingStyle,
 											 uint32 blockSize=BmMemFilter::nBlockSize,
 											 const BmString& tags=BM_DEFAULT_STRING);
+	IMPEXPBMMAILKIT 
+	int32 EncodedLength( const BmString& encodingStyle, const char* data,
+								int32 len, char& lastChar);
+	IMPEXPBMMAILKIT 
+	int32 EncodedLength( const BmString& encodingStyle, BmMemIBuf* input,
+								char& lastChar);
 
 }
 
 
+/*------------------------------------------------------------------------------*\
+	class BmIconvPool
+		-	a thread-safe pool of iconv-descriptors shared by all converting
+			filters, such that parsing a folder full of mails does not have to
+			open (and close) a descriptor for every single filter.
+		-	descriptors are keyed by source- and destination-charset and by the
+			transliterate- and discard-flags.
+		-	a descriptor is reset to its initial state (including the
+			discard-flag, which the filters change on invalid input) when it
+			is checked in.
+\*------------------------------------------------------------------------------*/
+class IMPEXPBMMAILKIT BmIconvPool {
+
+public:
+	static iconv_t CheckOut( const BmString& fromCharset,
+									 const BmString& toCharset,
+									 bool transliterate=false, bool discard=false);
+							// returns (iconv_t)-1 if the conversion is not
+							// supported
+	static void CheckIn( iconv_t descr);
+							// descr must have been checked out before
+
+	static void ReleaseIdleDescriptors();
+							// closes all descriptors that are not in use
+
+	// statistics:
+	struct Stats {
+		int32 checkOuts;
+		int32 hits;
+							// number of check-outs served by an idle descriptor
+		int32 opens;
+		int32 closes;
+		int32 idleDescriptors;
+	};
+	static void GetStats( Stats& stats);
+	static void ResetStats();
+
+	static const int32 nMaxIdlePerKey;
+							// max number of idle descriptors kept per key
+};
+
 /*------------------------------------------------------------------------------*\
 	class BmUtf8Decoder
 		-	
@@ -128,8 +175,13 @@ protected:
 	void Filter( const char* srcBuf, uint32& srcLen, 
 					 char* destBuf, uint32& destLen);
 	void Finalize( char* destBuf, uint32& destLen);
+	bool IsIdentityFor( const char* block, uint32 len);
 
 	BmString mDestCharset;
+	bool mIsUtf8;
+	bool mIsAsciiCompatible;
+							// parts of the text that need no conversion
+							// bypass iconv
 	iconv_t mIconvDescr;
 	bool mHadToDiscardChars;
 	int32 mFirstDiscardedPos;
@@ -168,8 +220,13 @@ protected:
 	// overrides of BmMailFilter base:
 	void Filter( const char* srcBuf, uint32& srcLen, 
 					 char* destBuf, uint32& destLen);
+	bool IsIdentityFor( const char* block, uint32 len);
 
 	BmString mSrcCharset;
+	bool mIsUtf8;
+	bool mIsAsciiCompatible;
+							// parts of the text that need no conversion
+							// bypass iconv
 	iconv_t mIconvDescr;
 	bool mHadToDiscardChars;
 	int32 mFirstDiscardedPos;
@@ -360,6 +417,7 @@ protected:
 	// overrides of BmMailFilter base:
 	void Filter( const char* srcBuf, uint32& srcLen, 
 					 char* destBuf, uint32& destLen);
+	bool IsIdentityFor( const char* block, uint32 len);
 
 };
 
@@ -377,6 +435,7 @@ protected:
 	// overrides of BmMailFilter base:
 	void Filter( const char* srcBuf, uint32& srcLen, 
 					 char* destBuf, uint32& destLen);
+	bool IsIdentityFor( const char* block, uint32 len);
 };
 
 /*------------------------------------------------------------------------------*\
@@ -393,9 +452,102 @@ protected:
 	// overrides of BmMailFilter base:
 	void Filter( const char* srcBuf, uint32& srcLen, 
 					 char* destBuf, uint32& destLen);
+	bool IsIdentityFor( const char* block, uint32 len);
+};
+
+/*------------------------------------------------------------------------------*\
+	class BmTextBodyDecoder
+		-	decodes the body of a text-part in a single pass, doing the job of
+			the chain <transfer-decoder> -> BmLinebreakDecoder -> BmUtf8Encoder
+			-> BmMailtextCleaner on every block at once.
+		-	only a few common charsets are supported (see CanHandle()), the
+			chain has to be used for all others.
+		-	if the text contains anything the chain would complain about
+			(chars that are invalid in the charset, incomplete multibyte chars),
+			the decoder stops and asks for the chain to be used instead (see
+			NeedsFallback()).
+\*------------------------------------------------------------------------------*/
+class IMPEXPBMMAILKIT BmTextBodyDecoder : public BmMemFilter {
+	typedef BmMemFilter inherited;
+
+public:
+	BmTextBodyDecoder( BmMemIBuf* input, const BmString& encodingStyle,
+							 const BmString& srcCharset,
+							 uint32 blockSize=nBlockSize);
+	~BmTextBodyDecoder();
+
+	// native methods:
+	static bool CanHandle( const BmString& srcCharset);
+
+	// getters:
+	bool NeedsFallback() const				{ return mNeedsFallback; }
+
+protected:
+	// overrides of BmMailFilter base:
+	void Filter( const char* srcBuf, uint32& srcLen,
+					 char* destBuf, uint32& destLen);
+	void Finalize( char* destBuf, uint32& destLen);
+
+private:
+	enum Charset {
+		CHARSET_UNSUPPORTED = 0,
+		CHARSET_US_ASCII,
+		CHARSET_UTF8,
+		CHARSET_LATIN1,
+		CHARSET_LATIN9
+	};
+	static Charset CharsetFor( const BmString& charset);
+	void ConvertScratch( char* destBuf, uint32& destLen);
+
+	BmEncoding::BmMemFilterRef mTransferDecoder;
+	Charset mCharset;
+	char* mScratch;
+							// holds the transfer-decoded data of the current
+							// block
+	uint32 mScratchLen;
+	bool mNeedsFallback;
+
+	static const uint32 nScratchSize;
+};
+
+/*------------------------------------------------------------------------------*\
+	class BmCharsetDetector
+		-	examines the (transfer-decoded) bytes of a text in a single pass and
+			picks the charset the text should be converted from out of a list 
+			of candidates, such that mis-labelled texts are converted only once
+			(instead of once per candidate).
+		-	for us-ascii, utf-8 and the common iso-8859-x and windows-125x
+			charsets, the detector knows which bytes are undefined (and make
+			the conversion fail) and which are control chars (that hardly ever 
+			occur in real text). For any other charset no prediction is made.
+\*------------------------------------------------------------------------------*/
+class IMPEXPBMMAILKIT BmCharsetDetector {
+
+public:
+	BmCharsetDetector( const char* data, int32 len);
+
+	// native methods:
+	int32 PickCharset( const BmEncoding::BmCharsetVect& candidates) const;
+	int32 Penalty( const BmString& charset) const;
+
+	// getters:
+	bool IsAscii() const						{ return mHighByteCount == 0; }
+	bool IsValidUtf8() const				{ return mIsValidUtf8; }
+
+	static const int32 nUnknown;
+	static const int32 nFails;
 
 private:
-	bool mLastWasStartOfShiftSpace;
+	int32 mByteCounts[128];
+							// counts every byte >= 0x80
+	int32 mHighByteCount;
+	int32 mUtf8CharCount;
+							// number of valid multibyte utf-8 chars
+	bool mIsValidUtf8;
+
+	// Hide copy-constructor and assignment:
+	BmCharsetDetector( const BmCharsetDetector&);
+	BmCharsetDetector operator=( const BmCharsetDetector&);
 };
 
 /*------------------------------------------------------------------------------*\
@@ -412,6 +564,7 @@ protected:
 	// overrides of BmMailFilter base:
 	void Filter( const char* srcBuf, uint32& srcLen, 
 					 char* destBuf, uint32& destLen);
+	bool IsIdentityFor( const char* block, uint32 len);
 
 };
 
@@ -429,6 +582,7 @@ protected:
 	// overrides of BmMailFilter base:
 	void Filter( const char* srcBuf, uint32& srcLen, 
 					 char* destBuf, uint32& destLen);
+	bool IsIdentityFor( const char* block, uint32 len);
 };
 
 #endif
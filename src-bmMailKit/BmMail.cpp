@@ -10,11 +10,13 @@
 
 #include <Directory.h>
 #include <FindDirectory.h>
+#include <Path.h>
 
 #include "split.hh"
 using namespace regexx;
 
 #include "BmBasics.h"
+#include "BmBlockPool.h"
 #include "BmBodyPartList.h"
 #include "BmEncoding.h"
 	using namespace BmEncoding;
@@ -103,6 +105,49 @@ const char* BM_FIELD_X_LIST				= "X-List";
 const char* BM_FIELD_X_MAILER				= "X-Mailer";
 const char* BM_FIELD_X_PRIORITY			= "X-Priority";
 
+const BmFieldAtom BM_ATOM_BCC( BM_FIELD_BCC);
+const BmFieldAtom BM_ATOM_CC( BM_FIELD_CC);
+const BmFieldAtom BM_ATOM_CONTENT_TYPE( BM_FIELD_CONTENT_TYPE);
+const BmFieldAtom BM_ATOM_CONTENT_DISPOSITION( BM_FIELD_CONTENT_DISPOSITION);
+const BmFieldAtom BM_ATOM_CONTENT_DESCRIPTION( BM_FIELD_CONTENT_DESCRIPTION);
+const BmFieldAtom BM_ATOM_CONTENT_LANGUAGE( BM_FIELD_CONTENT_LANGUAGE);
+const BmFieldAtom BM_ATOM_CONTENT_TRANSFER_ENCODING( BM_FIELD_CONTENT_TRANSFER_ENCODING);
+const BmFieldAtom BM_ATOM_CONTENT_ID( BM_FIELD_CONTENT_ID);
+const BmFieldAtom BM_ATOM_DATE( BM_FIELD_DATE);
+const BmFieldAtom BM_ATOM_FROM( BM_FIELD_FROM);
+const BmFieldAtom BM_ATOM_IN_REPLY_TO( BM_FIELD_IN_REPLY_TO);
+const BmFieldAtom BM_ATOM_LIST_ARCHIVE( BM_FIELD_LIST_ARCHIVE);
+const BmFieldAtom BM_ATOM_LIST_HELP( BM_FIELD_LIST_HELP);
+const BmFieldAtom BM_ATOM_LIST_ID( BM_FIELD_LIST_ID);
+const BmFieldAtom BM_ATOM_LIST_POST( BM_FIELD_LIST_POST);
+const BmFieldAtom BM_ATOM_LIST_SUBSCRIBE( BM_FIELD_LIST_SUBSCRIBE);
+const BmFieldAtom BM_ATOM_LIST_UNSUBSCRIBE( BM_FIELD_LIST_UNSUBSCRIBE);
+const BmFieldAtom BM_ATOM_MAIL_FOLLOWUP_TO( BM_FIELD_MAIL_FOLLOWUP_TO);
+const BmFieldAtom BM_ATOM_MAIL_REPLY_TO( BM_FIELD_MAIL_REPLY_TO);
+const BmFieldAtom BM_ATOM_MAILING_LIST( BM_FIELD_MAILING_LIST);
+const BmFieldAtom BM_ATOM_MESSAGE_ID( BM_FIELD_MESSAGE_ID);
+const BmFieldAtom BM_ATOM_MIME( BM_FIELD_MIME);
+const BmFieldAtom BM_ATOM_PRIORITY( BM_FIELD_PRIORITY);
+const BmFieldAtom BM_ATOM_RECEIVED( BM_FIELD_RECEIVED);
+const BmFieldAtom BM_ATOM_REFERENCES( BM_FIELD_REFERENCES);
+const BmFieldAtom BM_ATOM_REPLY_TO( BM_FIELD_REPLY_TO);
+const BmFieldAtom BM_ATOM_RESENT_BCC( BM_FIELD_RESENT_BCC);
+const BmFieldAtom BM_ATOM_RESENT_CC( BM_FIELD_RESENT_CC);
+const BmFieldAtom BM_ATOM_RESENT_DATE( BM_FIELD_RESENT_DATE);
+const BmFieldAtom BM_ATOM_RESENT_FROM( BM_FIELD_RESENT_FROM);
+const BmFieldAtom BM_ATOM_RESENT_MESSAGE_ID( BM_FIELD_RESENT_MESSAGE_ID);
+const BmFieldAtom BM_ATOM_RESENT_REPLY_TO( BM_FIELD_RESENT_REPLY_TO);
+const BmFieldAtom BM_ATOM_RESENT_SENDER( BM_FIELD_RESENT_SENDER);
+const BmFieldAtom BM_ATOM_RESENT_TO( BM_FIELD_RESENT_TO);
+const BmFieldAtom BM_ATOM_SENDER( BM_FIELD_SENDER);
+const BmFieldAtom BM_ATOM_SUBJECT( BM_FIELD_SUBJECT);
+const BmFieldAtom BM_ATOM_TO( BM_FIELD_TO);
+const BmFieldAtom BM_ATOM_USER_AGENT( BM_FIELD_USER_AGENT);
+const BmFieldAtom BM_ATOM_X_BEENTHERE( BM_FIELD_X_BEENTHERE);
+const BmFieldAtom BM_ATOM_X_LIST( BM_FIELD_X_LIST);
+const BmFieldAtom BM_ATOM_X_MAILER( BM_FIELD_X_MAILER);
+const BmFieldAtom BM_ATOM_X_PRIORITY( BM_FIELD_X_PRIORITY);
+
 const char* BM_MAIL_STATUS_DRAFT			= "Draft";
 const char* BM_MAIL_STATUS_ERROR			= "Error";
 const char* BM_MAIL_STATUS_FORWARDED	= "Forwarded";
@@ -154,6 +199,8 @@ BmMail::BmMail( bool outbound)
 	,	mHeader( NULL)
 	,	mBody( NULL)
 	,	mInitCheck( B_NO_INIT)
+	,	mBodyIsPending( false)
+	,	mTextIsInFile( false)
 	,	mOutbound( outbound)
 	,	mRightMargin( ThePrefs->GetInt( "MaxLineLen"))
 	,	mMoveToTrash( false)
@@ -189,6 +236,8 @@ BmMail::BmMail( const BmString &msgText, const BmString account)
 	,	mBody( NULL)
 	,	mMailRef( NULL)
 	,	mInitCheck( B_NO_INIT)
+	,	mBodyIsPending( false)
+	,	mTextIsInFile( false)
 	,	mOutbound( false)
 	,	mRightMargin( ThePrefs->GetInt( "MaxLineLen"))
 	,	mMoveToTrash( false)
@@ -213,6 +262,8 @@ BmMail::BmMail( BmMailRef* ref)
 	,	mBody( NULL)
 	,	mMailRef( ref)
 	,	mInitCheck( B_NO_INIT)
+	,	mBodyIsPending( false)
+	,	mTextIsInFile( false)
 	,	mOutbound( false)
 	,	mRightMargin( ThePrefs->GetInt( "MaxLineLen"))
 	,	mMoveToTrash( false)
@@ -240,10 +291,24 @@ BmMail::~BmMail() {
 			received from
 \*------------------------------------------------------------------------------*/
 void BmMail::SetTo( const BmString &_text, const BmString account) {
+	SetTo( _text.String(), _text.Length(), account);
+}
+
+/*------------------------------------------------------------------------------*\
+	SetTo( msgText, msgLen, account)
+		-	initializes mail-object from the given buffer, which may come 
+			straight from a file-mapping (the mail-text is converted into
+			its canonical form while being copied, such that the buffer is 
+			touched only once)
+\*------------------------------------------------------------------------------*/
+void BmMail::SetTo( const char* msgText, int32 msgLen, 
+						  const BmString account) {
+	BmParseArena parseArena;
+							// recycles the filter buffers used while parsing
 	BmString text;
 	BM_LOG2( BM_LogMailParse, "Converting Linebreaks to CRLF...");
 		// take care to remove all binary nulls
-	text.ConvertLinebreaksToCRLF(&_text);
+	text.ConvertLinebreaksToCRLF( msgText, msgLen);
 	text.ReplaceAll( 0, 32);
 	BM_LOG2( BM_LogMailParse, "done (Converting Linebreaks to CRLF)");
 
@@ -257,8 +322,13 @@ void BmMail::SetTo( const BmString &_text, const BmString account) {
 		headerLen += 2;
 							// don't include separator-line in header-string
 
+	// the body of any previous text is dropped before the new header is
+	// parsed (which asks for the default charset):
+	mBody = NULL;
+
 	BM_LOG2( BM_LogMailParse, "Adopting mailtext...");
 	mText.Adopt( text);						// take over the msg-string
+	mBodyIsPending = mTextIsInFile = false;
 	BM_LOG2( BM_LogMailParse, "...done (Adopting mailtext)");
 	mAccountName = account;
 
@@ -269,10 +339,10 @@ void BmMail::SetTo( const BmString &_text, const BmString account) {
 	mHeader = new BmMailHeader( header, this);
 	BM_LOG2( BM_LogMailParse, "...done (header)");
 
-	BM_LOG2( BM_LogMailParse, "init of body...");
+	// the body-structure is only parsed when someone asks for it 
+	// (see Body()), such that jobs which only need the header (like filters
+	// or moving mails around) do not pay for parsing all the attachments:
 	mBody = new BmBodyPartList( this);
-	mBody->ParseMail();
-	BM_LOG2( BM_LogMailParse, "done (init of body)");
 
 	mInitCheck = B_OK;
 }
@@ -328,63 +398,67 @@ bool BmMail::StartJob() {
 		}
 		
 		// ...ok, mail-file found, we fetch the mail from it:
-		BmString mailText;
 		// read special attributes for mail-state...
 		mailFile.ReadAttr( BM_MAIL_ATTR_MARGIN, B_INT32_TYPE, 0, 
 								 &mRightMargin, sizeof(int32));
-		// ...and read file contents:
-		off_t mailSize;
-		if ((err = mailFile.GetSize( &mailSize)) != B_OK)
+		// ...and map the file contents into memory (Beam replaces mail-files
+		// instead of changing them, but unsent mails may still be changed
+		// by others, so these are read instead):
+		bool mayChange = mMailRef->Status() == BM_MAIL_STATUS_DRAFT
+							  || mMailRef->Status() == BM_MAIL_STATUS_PENDING;
+		BmMappedFileIBuf mailData( BPath( &eref).Path(), mayChange);
+		if ((err = mailData.InitCheck()) != B_OK)
 			BM_THROW_RUNTIME( 
-				BmString("Could not get size of mail-file <") << eref.name 
+				BmString("Could not open mail-file <") << eref.name 
 					<< "> \n\nError:" << strerror(err)
 			);
+		off_t mailSize = mailData.Size();
 		BM_LOG2( BM_LogMailParse, 
 					BmString("...should be reading ") << mailSize << " bytes");
-		char* buf = mailText.LockBuffer( int32(mailSize));
-		if (!buf)
-			throw BM_runtime_error( BmString("Not enough memory for mail from "
-														"file\n\t<") << eref.name << ">");
-		off_t realSize = 0;
-		const size_t blocksize = 65536;
-		for(  int32 offs=0; 
-				(skipChecks || ShouldContinue()) && offs < mailSize; ) {
-			char* pos = buf+offs;
-			ssize_t read = mailFile.Read( 
-				pos, 
-				mailSize-offs < blocksize 
-					? size_t(mailSize-offs)
-					: blocksize
-			);
-			BM_LOG3( BM_LogMailParse, 
-						BmString("...read a block of ") << read << " bytes");
-			if (read < 0)
-				throw BM_runtime_error( BmString("Could not fetch mail from "
-															"file\n\t<") 
-													<< eref.name << ">\n\n Result: " 
-													<< strerror(read));
-			if (!read)
-				break;
-			realSize += read;
-			offs += read;
-		}
-		if (!skipChecks && !ShouldContinue())
-			return false;
-		BM_LOG2( BM_LogMailParse, 
-					BmString("...real size is ") << realSize << " bytes");
-		if (realSize > mailSize)
-			throw BM_runtime_error( BmString("Real size is ") << realSize 
-							<< " bytes but expected size was only " << mailSize 
-							<< " bytes!?!");
-		buf[realSize] = '\0';
-		mailText.UnlockBuffer( int32(realSize));
-		// take care to remove all binary nulls:
-		mailText.ReplaceAll( 0, 32);
-		// we initialize the BmMail-internals from the plain text:
-		BM_LOG2( BM_LogMailParse, BmString("initializing BmMail from msgtext"));
+		if (mailSize > INT32_MAX)
+			throw BM_runtime_error( BmString("Mail-file <") << eref.name 
+												<< "> is too large");
 		mIdentityName = mMailRef->Identity();
 		mImapUID = mMailRef->ImapUID();
-		SetTo( mailText, mMailRef->Account());
+		if (mailData.IsMapped()) {
+			if (!skipChecks && !ShouldContinue())
+				return false;
+			// we parse the mail straight from the mapping, so the file's 
+			// pages are only touched once (while being canonicalized):
+			BM_LOG2( BM_LogMailParse, 
+						BmString("initializing BmMail from mapped mail-file"));
+			SetTo( mailData.Data(), int32(mailSize), mMailRef->Account());
+		} else {
+			// file could not be mapped, so we read it block by block:
+			BmString mailText;
+			char* buf = mailText.LockBuffer( int32(mailSize));
+			if (!buf)
+				throw BM_runtime_error( BmString("Not enough memory for mail "
+															"from file\n\t<") 
+													<< eref.name << ">");
+			int32 realSize = 0;
+			const uint32 blocksize = 65536;
+			while( (skipChecks || ShouldContinue()) && realSize < mailSize) {
+				uint32 read = mailData.Read( 
+					buf+realSize, 
+					(uint32)min_c( (off_t)blocksize, mailSize-realSize)
+				);
+				BM_LOG3( BM_LogMailParse, 
+							BmString("...read a block of ") << read << " bytes");
+				if (!read)
+					break;
+				realSize += read;
+			}
+			if (!skipChecks && !ShouldContinue())
+				return false;
+			BM_LOG2( BM_LogMailParse, 
+						BmString("...real size is ") << realSize << " bytes");
+			buf[realSize] = '\0';
+			mailText.UnlockBuffer( realSize);
+			// we initialize the BmMail-internals from the plain text:
+			BM_LOG2( BM_LogMailParse, BmString("initializing BmMail from msgtext"));
+			SetTo( mailText, mMailRef->Account());
+		}
 		BM_LOG2( BM_LogMailParse, BmString("Done, mail is initialized"));
 	} catch (BM_error &e) {
 		BM_SHOWERR( e.what());
@@ -507,6 +581,9 @@ void BmMail::StoreIntoFile( BDirectory* destDir, BmString filename,
 	status_t err = B_NO_INIT;
 	ssize_t res;
 
+	if (mTextIsInFile)
+		// we are going to overwrite the file that contains our text:
+		FetchRawText();
 	if ((err = mEntry.SetTo( destDir, filename.String())) != B_OK)
 		BM_THROW_RUNTIME( 
 			BmString("Could not create entry for mail-file <") 
@@ -549,35 +626,97 @@ void BmMail::StoreIntoFile( BDirectory* destDir, BmString filename,
 			BmString("Could not create backed mail-file\n\t<") 
 				<< filename << ">\n\n Result: " << strerror(err)
 		);
-	// ...store all attributes...
+	// ...write the raw mail into the file...
+	BM_LOG2( BM_LogMailParse, "storing mail-data...");
+	int32 contentLength = -1;
+	if (mBodyIsPending)
+		// the body is produced straight into the file:
+		contentLength = WriteRawText( mailFile) - HeaderLength();
+	else {
+		int32 len = mText.Length();
+		if ((res = mailFile.Write( mText.String(), len)) < len) {
+			if (res < 0) {
+				BM_THROW_RUNTIME( BmString("Unable to write to mailfile <") 
+											<< filename << ">\n\n Result: " 
+											<< strerror(err));
+			} else {
+				BM_THROW_RUNTIME( BmString("Could not write complete mail to "
+													"file.\nWrote ") 
+											<< res << " bytes instead of " << len);
+			}
+		}
+	}
+
+	// ...and finally store all attributes:
 	BM_LOG2( BM_LogMailParse, "storing mail-attributes...");
-	StoreAttributes( mailFile.File(), status, whenCreated);
+	StoreAttributes( mailFile.File(), status, whenCreated, contentLength);
 	BM_LOG2( BM_LogMailParse, "storing header-attributes...");
 	mHeader->StoreAttributes( mailFile.File());
+	BM_LOG2( BM_LogMailParse, "done with storing");
+}
 
-	// ...and finally write the raw mail into the file:
-	BM_LOG2( BM_LogMailParse, "storing mail-data...");
-	int32 len = mText.Length();
-	if ((res = mailFile.Write( mText.String(), len)) < len) {
-		if (res < 0) {
-			BM_THROW_RUNTIME( BmString("Unable to write to mailfile <") 
-										<< filename << ">\n\n Result: " 
-										<< strerror(err));
-		} else {
-			BM_THROW_RUNTIME( BmString("Could not write complete mail to "
-												"file.\nWrote ") 
-										<< res << " bytes instead of " << len);
-		}
+/*------------------------------------------------------------------------------*\
+	BmFileWriter
+		-	writes every block it is given into a (backed) mail-file
+\*------------------------------------------------------------------------------*/
+struct BmFileWriter : public BmMemBufConsumer::Functor {
+	BmFileWriter( BmBackedFile& file)
+		:	mFile( file)
+		,	mWrittenLen( 0)
+		,	mResult( B_OK)						{}
+	status_t operator() (const char* buf, uint32 bufLen) {
+		ssize_t res = mFile.Write( buf, bufLen);
+		if (res > 0)
+			mWrittenLen += res;
+		if (res < 0)
+			mResult = res;
+		else if ((uint32)res < bufLen)
+			mResult = B_DEVICE_FULL;
+		return mResult;
 	}
-	BM_LOG2( BM_LogMailParse, "done with storing");
+	BmBackedFile& mFile;
+	int32 mWrittenLen;
+	status_t mResult;
+};
+
+/*------------------------------------------------------------------------------*\
+	WriteRawText( mailFile)
+		-	writes the header of a freshly constructed mail into the given file
+			and then streams the mail's body behind it, such that attachments
+			are encoded straight from their files into the mail-file
+		-	afterwards the body-parts refer to the text in the mail-file, 
+			which is only read again if someone asks for it (see RawText())
+		-	returns the number of bytes written
+\*------------------------------------------------------------------------------*/
+int32 BmMail::WriteRawText( BmBackedFile& mailFile) {
+	mBodyIsPending = false;
+							// the parts read their bodies from the old text
+	BmMimeBodyIBuf body( HeaderLength());
+	mBody->ConstructBodyForSending( body);
+	BmStringIBuf headerText( HeaderText());
+	BmFileWriter writer( mailFile);
+	BmMemBufConsumer consumer( BmMemFilter::nBlockSize);
+	consumer.Consume( &headerText, &writer);
+	if (writer.mResult == B_OK)
+		consumer.Consume( &body, &writer);
+	if (writer.mResult != B_OK)
+		BM_THROW_RUNTIME( BmString("Unable to write to mailfile\n\n Result: ") 
+									<< strerror( writer.mResult));
+	BM_LOG2( BM_LogMailParse, 
+				BmString("...done (") << body.ReadLen() << " bytes of body)");
+	mText.Truncate( 0);
+	mTextIsInFile = true;
+	return writer.mWrittenLen;
 }
 
 /*------------------------------------------------------------------------------*\
 	StoreAttributes()
 		-	stores mail-attributes inside a file
+		-	contentLength is only needed if the mail-text doesn't contain the 
+			body (-1 means it is computed from the mail-text)
 \*------------------------------------------------------------------------------*/
 void BmMail::StoreAttributes( BNode& mailNode, const BmString& status, 
-										bigtime_t whenCreated) {
+										bigtime_t whenCreated, int32 contentLength) {
 	//
 	mailNode.WriteAttr( BM_MAIL_ATTR_STATUS, B_STRING_TYPE, 0, 
 							  status.String(), status.Length()+1);
@@ -600,7 +739,8 @@ void BmMail::StoreAttributes( BNode& mailNode, const BmString& status,
 	}
 	//
 	int32 headerLength = HeaderLength();
-	int32 contentLength = MAX( 0, mText.Length()-headerLength);
+	if (contentLength < 0)
+		contentLength = MAX( 0, mText.Length()-headerLength);
 	
 	mailNode.WriteAttr( BM_MAIL_ATTR_HEADER, B_INT32_TYPE, 0, 
 							  &headerLength, sizeof(int32));
@@ -826,15 +966,73 @@ bool BmMail::Send(bool now)
 }
 
 // #pragma mark - Attachments
+/*------------------------------------------------------------------------------*\
+	CountBoundaryLines( text, start, boundary, maxCount)
+		-	counts the lines (behind the given start) that consist of the given
+			MIME-boundary (the closing one included), stopping as soon as 
+			maxCount lines have been found
+\*------------------------------------------------------------------------------*/
+static int32 CountBoundaryLines( const BmString& text, int32 start,
+											const BmString& boundary, int32 maxCount) {
+	if (start >= text.Length())
+		return 0;
+	BmString delimiter = BmString("--") << boundary;
+	const char* textStart = text.String() + start;
+	const char* pos = textStart;
+	int32 count = 0;
+	while( count < maxCount 
+	&& (pos = strstr( pos, delimiter.String())) != NULL) {
+		bool isAtLineStart = pos == textStart || *(pos-1) == '\n';
+		pos += delimiter.Length();
+		if (pos[0] == '-' && pos[1] == '-')
+			pos += 2;
+		while( *pos == ' ' || *pos == '\t')
+			pos++;
+		if (isAtLineStart && (*pos == '\r' || *pos == '\n' || !*pos))
+			count++;
+	}
+	return count;
+}
+
+/*------------------------------------------------------------------------------*\
+	IsPlainTextType( fieldVal, type)
+		-	returns whether a body-part with the given content-type (the field's
+			value and the type without params) is treated as plain text
+		-	just like BmBodyPart::SetTo(), an empty field or a bare "text" 
+			(without any params) are taken to mean text/plain
+\*------------------------------------------------------------------------------*/
+static bool IsPlainTextType( const BmString& fieldVal, const BmString& type) {
+	return !fieldVal.Length() || fieldVal.ICompare( "text") == 0 
+		|| type.ICompare( "text/plain") == 0;
+}
+
 /*------------------------------------------------------------------------------*\
 	HasAttachments()
-		-	
+		-	if the body hasn't been parsed yet, we try to tell from the header
+			(and the top-level boundaries), since storing a mail shouldn't 
+			require parsing all of its attachments
 \*------------------------------------------------------------------------------*/
 bool BmMail::HasAttachments() const { 
-	if (mBody)
-		return mBody->HasAttachments();
-	else
+	if (!mBody)
 		return false;
+	if (mBody->InitCheck() != B_OK && mHeader) {
+		const BmString& fieldVal = mHeader->GetFieldVal( BM_ATOM_CONTENT_TYPE);
+		BmContentField contentType( fieldVal);
+		const BmString& type = contentType.Value();
+		if (IsPlainTextType( fieldVal, type))
+			// a single text, which is the mail-text:
+			return false;
+		if (type.ICompare( "multipart", 9) != 0)
+			// a single part that isn't shown as mail-text:
+			return true;
+		// three boundary-lines mean that the multipart contains at least
+		// two parts:
+		const BmString& boundary = contentType.Param( "boundary");
+		if (boundary.Length()
+		&& CountBoundaryLines( mText, HeaderLength()+2, boundary, 3) == 3)
+			return true;
+	}
+	return Body()->HasAttachments();
 }
 
 /*------------------------------------------------------------------------------*\
@@ -844,16 +1042,28 @@ bool BmMail::HasAttachments() const {
 void BmMail::AddAttachmentFromRef( const entry_ref* ref,
 											  const BmString& charset) {
 	if (mBody)
-		mBody->AddAttachmentFromRef( ref, charset);
+		Body()->AddAttachmentFromRef( ref, charset);
 }
 
 // #pragma mark - Body Text
 /*------------------------------------------------------------------------------*\
-	()
-		-	
+	Body()
+		-	returns the body-structure of the mail, parsing it first if that
+			hasn't happened yet
 \*------------------------------------------------------------------------------*/
 BmBodyPartList* BmMail::Body() const
 {
+	if (mBody && mBody->InitCheck() != B_OK) {
+		BmAutolockCheckGlobal lock( mBody->ModelLocker());
+		if (!lock.IsLocked())
+			BM_THROW_RUNTIME( "BmMail::Body(): Unable to get lock");
+		// check again, another thread may have parsed the body meanwhile:
+		if (mBody->InitCheck() != B_OK) {
+			BM_LOG2( BM_LogMailParse, "init of body...");
+			mBody->ParseMail();
+			BM_LOG2( BM_LogMailParse, "done (init of body)");
+		}
+	}
 	return mBody.Get(); 
 }
 
@@ -862,7 +1072,7 @@ BmBodyPartList* BmMail::Body() const
 	-	
 \*------------------------------------------------------------------------------*/
 bool BmMail::ReconstructRawText() {
-	BmRef< BmBodyPart> bodyPart( mBody->EditableTextBody());
+	BmRef< BmBodyPart> bodyPart( Body()->EditableTextBody());
 	return ConstructRawText( bodyPart ? bodyPart->DecodedData() : BM_DEFAULT_STRING,
 								 DefaultCharset(), 
 								 mAccountName);
@@ -886,37 +1096,116 @@ bool BmMail::ConstructAndStore() {
 bool BmMail::ConstructRawText( const BmString& editedUtf8Text, 
 										 const BmString& charset,
 										 const BmString smtpAccount) {
-	int32 startSize = mBody->EstimateEncodedSize() + editedUtf8Text.Length() 
-							+ std::max( mHeader->HeaderLength(), (int32)4096)+4096;
-	startSize += 65536-(startSize%65536);
-	BmStringOBuf msgText( startSize, 1.2f);
+	if (mTextIsInFile)
+		// the body-parts refer to the text in the mail-file, which is going
+		// to be overwritten:
+		FetchRawText();
 	mAccountName = smtpAccount;
-	if (!mHeader->ConstructRawText( msgText, charset))
+	BmStringOBuf headerText( std::max( mHeader->HeaderLength(), (int32)4096), 
+									 1.2f);
+	if (!mHeader->ConstructRawText( headerText, charset))
 		return false;
-	mBody->SetEditableText( editedUtf8Text, charset);
-	if (!mBody->ConstructBodyForSending( msgText))
-		return false;
-	uint32 len = msgText.CurrPos();
-	if (len && msgText.ByteAt( len-1) != '\n')
-		msgText << "\r\n";
-	mText.Adopt( msgText.TheString());
-	BM_LOG3( BM_LogMailParse, 
-				BmString("CONSTRUCTED MSG: \n-----START--------\n") << mText 
-					<< "\n-----END----------");
+	BmBodyPartList* body = Body();
+	body->SetEditableText( editedUtf8Text, charset);
+	// determining the exact size converts all texts (so any problems with
+	// the charset show up now), the body itself is only produced when it is
+	// needed, which usually means it is streamed into the mail-file by
+	// Store() (until then the body-parts may refer to the old text):
+	body->EncodedSize();
+	mBodyIsPending = true;
 	return true;
 }
 
+/*------------------------------------------------------------------------------*\
+	RawText()
+		-	returns the complete text of the mail, producing or reading it 
+			first, if that hasn't happened yet
+\*------------------------------------------------------------------------------*/
+const BmString& BmMail::RawText() const {
+	if (mBodyIsPending || mTextIsInFile)
+		FetchRawText();
+	return mText;
+}
+
+/*------------------------------------------------------------------------------*\
+	FetchRawText()
+		-	produces the text of a freshly constructed mail in memory or reads
+			the text of a mail that has been streamed into its mail-file
+\*------------------------------------------------------------------------------*/
+void BmMail::FetchRawText() const {
+	if (mBodyIsPending) {
+		mBodyIsPending = false;
+							// the parts read their bodies from the old text
+		BmBodyPartList* body = Body();
+		// the body knows its exact size in advance, so the buffer can be 
+		// allocated in one go (one additional block is needed by the buffer's 
+		// Write() and two bytes for a final linebreak):
+		BmStringOBuf msgText( HeaderLength() + body->EncodedSize() + 2 
+										+ BmMemFilter::nBlockSize, 
+									 1.2f);
+		msgText.Write( HeaderText());
+		body->ConstructBodyForSending( msgText);
+		uint32 len = msgText.CurrPos();
+		if (len && msgText.ByteAt( len-1) != '\n')
+			msgText << "\r\n";
+		mText.Adopt( msgText.TheString());
+		BM_LOG3( BM_LogMailParse, 
+					BmString("CONSTRUCTED MSG: \n-----START--------\n") << mText 
+						<< "\n-----END----------");
+	} else if (mTextIsInFile) {
+		mTextIsInFile = false;
+		BFile mailFile;
+		status_t err;
+		off_t size;
+		if ((err = mailFile.SetTo( &mEntry, B_READ_ONLY)) != B_OK
+		|| (err = mailFile.GetSize( &size)) != B_OK)
+			BM_THROW_RUNTIME( 
+				BmString("Could not open mail-file <") << BPath( &mEntry).Path() 
+					<< "> \n\nError:" << strerror(err)
+			);
+		char* buf = mText.LockBuffer( int32(size));
+		ssize_t res = mailFile.Read( buf, size);
+		mText.UnlockBuffer( res > 0 ? res : 0);
+		if (res < size)
+			BM_THROW_RUNTIME( 
+				BmString("Could not read mail-file <") << BPath( &mEntry).Path()
+					<< "> completely"
+			);
+	}
+}
+
 // #pragma mark - Charset
 /*------------------------------------------------------------------------------*\
 	DefaultCharset()
-		-	
+		-	returns the charset of the mail-text
+		-	if the body hasn't been parsed yet, the charset is taken from the
+			header's content-type (the way the body-part would do it), since we
+			don't want to parse all the attachments just for the charset.
+			For a multipart, the charset of the text isn't known until then,
+			so the default charset is used.
 \*------------------------------------------------------------------------------*/
 const BmString& BmMail::DefaultCharset() const {
 	if (mSuggestedCharset.Length())
 		return mSuggestedCharset;
-	if (mBody)
+	if (mBody && mBody->InitCheck() == B_OK)
 		return mBody->DefaultCharset();
-	return BmEncoding::DefaultCharset;
+	if (!mBody || !mHeader)
+		return BmEncoding::DefaultCharset;
+	const BmString& fieldVal = mHeader->GetFieldVal( BM_ATOM_CONTENT_TYPE);
+	BmContentField contentType( fieldVal);
+	if (!IsPlainTextType( fieldVal, contentType.Value()))
+		return BmEncoding::DefaultCharset;
+	if ((!fieldVal.Length() || fieldVal.ICompare( "text") == 0)
+	&& ThePrefs->GetBool( "StrictCharsetHandling", false))
+		// strict mode: no charset means: us-ascii
+		mHeaderCharset = "us-ascii";
+	else {
+		mHeaderCharset = contentType.Param( "charset");
+		if (!mHeaderCharset.Length() 
+		|| !mHeaderCharset.ICompare( "unknown-8bit"))
+			mHeaderCharset = BmEncoding::DefaultCharset;
+	}
+	return mHeaderCharset;
 }
 
 // #pragma mark - Base Mail
@@ -966,7 +1255,7 @@ void BmMail::SetNewHeader( const BmString& headerStr) {
 	uint32 len = newMsgText.Length();
 	if (!len || newMsgText[len-1] != '\n')
 		newMsgText << "\r\n";
-	newMsgText << mText.String() + HeaderLength();
+	newMsgText << RawText().String() + HeaderLength();
 	SetTo( newMsgText, mAccountName);
 	Store();
 	StartJobInThisThread();
@@ -1008,9 +1297,9 @@ const BmString& BmMail::HeaderText() const
 	GetFieldVal()
 	-	
 \*------------------------------------------------------------------------------*/
-const BmString& BmMail::GetFieldVal( const BmString fieldName) {
+const BmString& BmMail::GetFieldVal( const BmFieldAtom& field) {
 	if (mHeader)
-		return mHeader->GetFieldVal( fieldName);
+		return mHeader->GetFieldVal( field);
 	else
 		return BM_DEFAULT_STRING;
 }
@@ -1019,33 +1308,33 @@ const BmString& BmMail::GetFieldVal( const BmString fieldName) {
 	SetFieldVal()
 	-	
 \*------------------------------------------------------------------------------*/
-void BmMail::SetFieldVal( const BmString fieldName, const BmString value) {
+void BmMail::SetFieldVal( const BmFieldAtom& field, const BmString value) {
 	// we set the field-value inside the mail-header only if it has content
 	// otherwise we remove the field from the header:
 	if (!mHeader)
 		return;
 	if (value.Length())
-		mHeader->SetFieldVal( fieldName, value);
+		mHeader->SetFieldVal( field, value);
 	else
-		mHeader->RemoveField( fieldName);
+		mHeader->RemoveField( field);
 }
 
 /*------------------------------------------------------------------------------*\
 	RemoveFieldVal()
 	-	
 \*------------------------------------------------------------------------------*/
-void BmMail::RemoveField( const BmString fieldName) {
-	mHeader->RemoveField( fieldName);
+void BmMail::RemoveField( const BmFieldAtom& field) {
+	mHeader->RemoveField( field);
 }
 
 /*------------------------------------------------------------------------------*\
 	()
 		-	
 \*------------------------------------------------------------------------------*/
-bool BmMail::IsFieldEmpty( const BmString fieldName)
+bool BmMail::IsFieldEmpty( const BmFieldAtom& field)
 { 
 	return mHeader 
-				? mHeader->IsFieldEmpty(fieldName)
+				? mHeader->IsFieldEmpty(field)
 				: true; 
 }
 
@@ -1075,9 +1364,9 @@ void BmMail::IsRedirect( bool b)
 \*------------------------------------------------------------------------------*/
 bool BmMail::HasComeFromList() const {
 	return mHeader 
-			 && (!mHeader->IsFieldEmpty( BM_FIELD_LIST_ID)
-			 	  || !mHeader->IsFieldEmpty( BM_FIELD_MAILING_LIST)
-			 	  || !mHeader->IsFieldEmpty( BM_FIELD_X_LIST));
+			 && (!mHeader->IsFieldEmpty( BM_ATOM_LIST_ID)
+			 	  || !mHeader->IsFieldEmpty( BM_ATOM_MAILING_LIST)
+			 	  || !mHeader->IsFieldEmpty( BM_ATOM_X_LIST));
 }
 
 // #pragma mark - Identities
@@ -1096,11 +1385,11 @@ void BmMail::SetupFromIdentityAndRecvAddr( BmIdentity* ident,
 				= BmAddress::QuotedPhrase(realName) + " <" + recvAddr + ">";
 		} else
 			fromAddress = recvAddr;
-		SetFieldVal( BM_FIELD_FROM, fromAddress);
+		SetFieldVal( BM_ATOM_FROM, fromAddress);
 		if (ident->ReplyTo().Length())
-			SetFieldVal( BM_FIELD_REPLY_TO, ident->ReplyTo());
+			SetFieldVal( BM_ATOM_REPLY_TO, ident->ReplyTo());
 		else
-			RemoveField( BM_FIELD_REPLY_TO);
+			RemoveField( BM_ATOM_REPLY_TO);
 		SetSignatureByName( ident->SignatureName());
 		AccountName( ident->SMTPAccount());
 		IdentityName( ident->Key());
@@ -1174,7 +1463,7 @@ void BmMail::SetSignatureByName( const BmString sigName) {
 	if (!mBody || mSignatureName==sigName)
 		return;
 	mSignatureName = sigName;
-	mBody->Signature( TheSignatureList->GetSignatureStringFor( sigName));
+	Body()->Signature( TheSignatureList->GetSignatureStringFor( sigName));
 }
 
 // #pragma mark - Status
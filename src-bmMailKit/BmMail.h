@@ -25,6 +25,7 @@
 #include "BmMailRef.h"
 #include "BmUtil.h"
 
+class BmBackedFile;
 class BmIdentity;
 
 // mail-attribute types:
@@ -96,6 +97,50 @@ extern IMPEXPBMMAILKIT const char* BM_FIELD_X_LIST;
 extern IMPEXPBMMAILKIT const char* BM_FIELD_X_MAILER;
 extern IMPEXPBMMAILKIT const char* BM_FIELD_X_PRIORITY;
 
+// the same field-names as interned atoms (use these for lookups):
+extern IMPEXPBMMAILKIT const BmFieldAtom BM_ATOM_BCC;
+extern IMPEXPBMMAILKIT const BmFieldAtom BM_ATOM_CC;
+extern IMPEXPBMMAILKIT const BmFieldAtom BM_ATOM_CONTENT_DISPOSITION;
+extern IMPEXPBMMAILKIT const BmFieldAtom BM_ATOM_CONTENT_DESCRIPTION;
+extern IMPEXPBMMAILKIT const BmFieldAtom BM_ATOM_CONTENT_ID;
+extern IMPEXPBMMAILKIT const BmFieldAtom BM_ATOM_CONTENT_LANGUAGE;
+extern IMPEXPBMMAILKIT const BmFieldAtom BM_ATOM_CONTENT_TRANSFER_ENCODING;
+extern IMPEXPBMMAILKIT const BmFieldAtom BM_ATOM_CONTENT_TYPE;
+extern IMPEXPBMMAILKIT const BmFieldAtom BM_ATOM_DATE;
+extern IMPEXPBMMAILKIT const BmFieldAtom BM_ATOM_FROM;
+extern IMPEXPBMMAILKIT const BmFieldAtom BM_ATOM_IN_REPLY_TO;
+extern IMPEXPBMMAILKIT const BmFieldAtom BM_ATOM_LIST_ARCHIVE;
+extern IMPEXPBMMAILKIT const BmFieldAtom BM_ATOM_LIST_HELP;
+extern IMPEXPBMMAILKIT const BmFieldAtom BM_ATOM_LIST_ID;
+extern IMPEXPBMMAILKIT const BmFieldAtom BM_ATOM_LIST_POST;
+extern IMPEXPBMMAILKIT const BmFieldAtom BM_ATOM_LIST_SUBSCRIBE;
+extern IMPEXPBMMAILKIT const BmFieldAtom BM_ATOM_LIST_UNSUBSCRIBE;
+extern IMPEXPBMMAILKIT const BmFieldAtom BM_ATOM_MAIL_FOLLOWUP_TO;
+extern IMPEXPBMMAILKIT const BmFieldAtom BM_ATOM_MAIL_REPLY_TO;
+extern IMPEXPBMMAILKIT const BmFieldAtom BM_ATOM_MAILING_LIST;
+extern IMPEXPBMMAILKIT const BmFieldAtom BM_ATOM_MESSAGE_ID;
+extern IMPEXPBMMAILKIT const BmFieldAtom BM_ATOM_MIME;
+extern IMPEXPBMMAILKIT const BmFieldAtom BM_ATOM_PRIORITY;
+extern IMPEXPBMMAILKIT const BmFieldAtom BM_ATOM_RECEIVED;
+extern IMPEXPBMMAILKIT const BmFieldAtom BM_ATOM_REFERENCES;
+extern IMPEXPBMMAILKIT const BmFieldAtom BM_ATOM_REPLY_TO;
+extern IMPEXPBMMAILKIT const BmFieldAtom BM_ATOM_RESENT_BCC;
+extern IMPEXPBMMAILKIT const BmFieldAtom BM_ATOM_RESENT_CC;
+extern IMPEXPBMMAILKIT const BmFieldAtom BM_ATOM_RESENT_DATE;
+extern IMPEXPBMMAILKIT const BmFieldAtom BM_ATOM_RESENT_FROM;
+extern IMPEXPBMMAILKIT const BmFieldAtom BM_ATOM_RESENT_MESSAGE_ID;
+extern IMPEXPBMMAILKIT const BmFieldAtom BM_ATOM_RESENT_REPLY_TO;
+extern IMPEXPBMMAILKIT const BmFieldAtom BM_ATOM_RESENT_SENDER;
+extern IMPEXPBMMAILKIT const BmFieldAtom BM_ATOM_RESENT_TO;
+extern IMPEXPBMMAILKIT const BmFieldAtom BM_ATOM_SENDER;
+extern IMPEXPBMMAILKIT const BmFieldAtom BM_ATOM_SUBJECT;
+extern IMPEXPBMMAILKIT const BmFieldAtom BM_ATOM_TO;
+extern IMPEXPBMMAILKIT const BmFieldAtom BM_ATOM_USER_AGENT;
+extern IMPEXPBMMAILKIT const BmFieldAtom BM_ATOM_X_BEENTHERE;
+extern IMPEXPBMMAILKIT const BmFieldAtom BM_ATOM_X_LIST;
+extern IMPEXPBMMAILKIT const BmFieldAtom BM_ATOM_X_MAILER;
+extern IMPEXPBMMAILKIT const BmFieldAtom BM_ATOM_X_PRIORITY;
+
 extern IMPEXPBMMAILKIT const char* BM_MAIL_STATUS_DRAFT;
 extern IMPEXPBMMAILKIT const char* BM_MAIL_STATUS_ERROR;
 extern IMPEXPBMMAILKIT const char* BM_MAIL_STATUS_FORWARDED;
@@ -137,6 +182,7 @@ public:
 								  const BmString& charset,
 								  BmString smtpAccount);
 	void SetTo( const BmString &text, const BmString account);
+	void SetTo( const char* text, int32 length, const BmString account);
 	void SetNewHeader( const BmString& headerStr);
 	void SetSignatureByName( const BmString sigName);
 	void SetupFromIdentityAndRecvAddr( BmIdentity* ident, 
@@ -151,15 +197,15 @@ public:
 							  BEntry* backupEntry = NULL);
 	void ResyncFromDisk();
 	//
-	const BmString& GetFieldVal( const BmString fieldName);
+	const BmString& GetFieldVal( const BmFieldAtom& field);
 	bool HasAttachments() const;
 	bool HasComeFromList() const;
 	void DetermineRecvAddrAndIdentity( BmString& receivingAddr,
 												  BmRef<BmIdentity>& ident);
 	void MarkAs( const char* status);
-	void RemoveField( const BmString fieldName);
-	void SetFieldVal( const BmString fieldName, const BmString value);
-	bool IsFieldEmpty( const BmString fieldName);
+	void RemoveField( const BmFieldAtom& field);
+	void SetFieldVal( const BmFieldAtom& field, const BmString value);
+	bool IsFieldEmpty( const BmFieldAtom& field);
 	const BmString& Status() const;
 	//
 	void RatioSpam( float rs);
@@ -192,13 +238,17 @@ public:
 	BmMailHeader* Header() const;
 	int32 HeaderLength() const;
 	inline int32 RightMargin() const		{ return mRightMargin; }
-	inline const BmString& RawText() const		
-													{ return mText; }
+	const BmString& RawText() const;
+	inline bool RawTextIsInMemory() const	
+													{ return !mBodyIsPending 
+																&& !mTextIsInFile; }
 	const BmString& HeaderText() const;
 	inline const bool Outbound() const	{ return mOutbound; }
 	bool IsRedirect() const;
 	BmMailRef* MailRef() const;
 	const BmString& DefaultCharset()	const;
+	inline const BmString& SuggestedCharset() const	
+													{ return mSuggestedCharset; }
 	inline BmString SignatureName() const		
 													{ return mSignatureName; }
 	inline const BmString& IdentityName() const	
@@ -233,20 +283,29 @@ protected:
 
 	BmString CreateBasicFilename();
 	void StoreAttributes( BNode& mailNode, const BmString& status, 
-								 bigtime_t whenCreated);
+								 bigtime_t whenCreated, int32 contentLength = -1);
 
 private:
 	void SetDefaultHeaders( const BmString& defaultHeaders);
 	BmMail();
 	
 	const BmString& DefaultStatus() const;
+	void FetchRawText() const;
+	int32 WriteRawText( BmBackedFile& mailFile);
 
 	BmRef<BmMailHeader> mHeader;
 							// contains header-information
 	BmRef<BmBodyPartList> mBody;
 							// contains body-information (split into subparts)
-	BmString mText;
+	mutable BmString mText;
 							// text of complete message
+	mutable bool mBodyIsPending;
+							// the mail has been constructed, but its body 
+							// hasn't been produced yet (the body-parts may 
+							// still refer to the old text in mText)
+	mutable bool mTextIsInFile;
+							// the mail-text has been streamed into the 
+							// mail-file and is only read from there on demand
 	BmString mAccountName;
 							// name of account this message came from/is sent through
 	BmString mIdentityName;
@@ -284,6 +343,9 @@ private:
 	BmString mSuggestedCharset;
 							// charset explicitly selected by user, overrides
 							// any other.
+	mutable BmString mHeaderCharset;
+							// charset as taken from the header, used as long
+							// as the body hasn't been parsed (see DefaultCharset())
 	BmString mImapUID;
 							// UID for this mail as retrieved from the IMAP
 							// server.
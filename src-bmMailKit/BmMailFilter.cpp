@@ -74,6 +74,23 @@ void BmMailFilter::AddMail( BmMail* mail) {
 		mMails.push_back( mail);
 }
 
+/*------------------------------------------------------------------------------*\
+	HaveOutboundFilters()
+		-	returns whether the outbound filter-chain contains any filters
+\*------------------------------------------------------------------------------*/
+bool BmMailFilter::HaveOutboundFilters() {
+	BmRef< BmListModelItem> chainItem 
+		= TheFilterChainList->FindItemByKey( BM_OutboundLabel);
+	BmFilterChain* chain = dynamic_cast< BmFilterChain*>( chainItem.Get());
+	if (!chain)
+		return false;
+	BmAutolockCheckGlobal lock( chain->ModelLocker());
+	if (!lock.IsLocked())
+		// can't tell, so we better assume there are some:
+		return true;
+	return chain->posBegin() != chain->posEnd();
+}
+
 /*------------------------------------------------------------------------------*\
 	ShouldContinue()
 		-	determines whether or not the mail-filter should continue to run
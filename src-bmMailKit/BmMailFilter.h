@@ -47,6 +47,9 @@ public:
 	void SetMailRefVect( BmMailRefVect* refVect);
 	void AddMail( BmMail* mail);
 	void ManageHeaderVect( const char**header);
+	static bool HaveOutboundFilters();
+							// tells whether outbound mails would be filtered
+							// at all (such that mails needn't be read for that)
 
 	// overrides of BmJobModel base:
 	bool StartJob();
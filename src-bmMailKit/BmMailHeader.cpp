@@ -9,10 +9,13 @@
 #include <algorithm>
 #include <ctype.h>
 
+#include <Autolock.h>
+#include <DataIO.h>
 #include <List.h>
+#include <Locker.h>
 #include <NodeInfo.h>
 
-#include "regexx.hh"
+#include "split.hh"
 using namespace regexx;
 
 #include "BmEncoding.h"
@@ -24,24 +27,601 @@ using namespace regexx;
 #include "BmPrefs.h"
 #include "BmRosterBase.h"
 #include "BmSmtpAccount.h"
+#include "BmStringView.h"
 
 #undef BM_LOGNAME
 #define BM_LOGNAME "MailParser"
 
-static BmString BmAddressFieldNames = 
+// N.B.: these are plain char-arrays (instead of BmStrings), since field-atoms
+// may already be interned during static initialization (see BmMail.cpp):
+static const char BmAddressFieldNames[] = 
 	"<Bcc><Resent-Bcc><Cc><List-Id><Resent-Cc><From><Resent-From><Reply-To>"
 	"<Resent-Reply-To><Sender><Resent-Sender><To><Resent-To>";
 
-static BmString BmIdentificationFieldNames = 
+static const char BmIdentificationFieldNames[] = 
 	"<Message-ID><In-Reply-To><References>";
 
-static BmString BmNoEncodingFieldNames = 
+static const char BmNoEncodingFieldNames[] = 
 	"<Received><Message-ID><Resent-Message-ID><In-Reply-To><References><Date>"
 	"<Resent-Date>";
 
-static BmString BmNoStrippingFieldNames = 
+static const char BmNoStrippingFieldNames[] = 
 	"<Received><Subject><UserAgent>";
 
+/********************************************************************************\
+	BmFieldAtom
+\********************************************************************************/
+
+/*------------------------------------------------------------------------------*\
+	BmFieldAtomTable
+		-	the global table of all interned field-names, hashed case-
+			insensitively with open addressing
+		-	entries are never removed, such that atoms stay valid forever
+\*------------------------------------------------------------------------------*/
+class BmFieldAtomTable {
+	typedef BmFieldAtom::Entry Entry;
+
+public:
+	BmFieldAtomTable()
+		:	mLocker( "FieldAtomTable")
+		,	mSlots( 64, -1)						{}
+
+	const Entry* Intern( const char* name, int32 len);
+	const Entry* Lookup( const char* name, int32 len, uint32 hash);
+
+	static uint32 FlagsFor( const BmString& name);
+
+private:
+	uint32 FindSlot( uint32 hash, const char* name, int32 len) const;
+	void Rehash();
+
+	BLocker mLocker;
+	vector< Entry*> mEntries;
+							// all entries, indexed by their id
+	vector< int32> mSlots;
+							// the hash-table, holds ids (-1 marks a free slot)
+
+	// Hide copy-constructor and assignment:
+	BmFieldAtomTable( const BmFieldAtomTable&);
+	BmFieldAtomTable operator=( const BmFieldAtomTable&);
+};
+
+/*------------------------------------------------------------------------------*\
+	FieldAtomTable()
+		-	returns the one and only atom-table, which is created on first use
+\*------------------------------------------------------------------------------*/
+static BmFieldAtomTable& FieldAtomTable() {
+	static BmFieldAtomTable table;
+	return table;
+}
+
+/*------------------------------------------------------------------------------*\
+	FoldedHash( name, len)
+		-	FNV-1a over the lowercased characters of the given name
+\*------------------------------------------------------------------------------*/
+uint32 BmFieldAtom::FoldedHash( const char* name, int32 len) {
+	uint32 hash = 2166136261UL;
+	for( int32 i=0; i<len; ++i) {
+		hash ^= (unsigned char)tolower( (unsigned char)name[i]);
+		hash *= 16777619UL;
+	}
+	return hash;
+}
+
+/*------------------------------------------------------------------------------*\
+	FlagsFor( name)
+		-	determines the properties of the field with the given 
+			(capitalized) name
+\*------------------------------------------------------------------------------*/
+uint32 BmFieldAtomTable::FlagsFor( const BmString& name) {
+	BmString fname = BmString("<") << name << ">";
+	uint32 flags = 0;
+	if (BmString( BmAddressFieldNames).IFindFirst( fname) != B_ERROR)
+		flags |= BmFieldAtom::ADDRESS_FIELD;
+	if (BmString( BmIdentificationFieldNames).IFindFirst( fname) != B_ERROR)
+		flags |= BmFieldAtom::IDENTIFICATION_FIELD;
+	if (name.ICompare( "Content-", 8) == 0
+	|| BmString( BmNoEncodingFieldNames).IFindFirst( fname) != B_ERROR)
+		flags |= BmFieldAtom::NO_ENCODING;
+	if (name.Compare( "X-", 2) == 0
+	|| BmString( BmNoStrippingFieldNames).IFindFirst( fname) != B_ERROR)
+		flags |= BmFieldAtom::NO_STRIPPING;
+							// no stripping for unknown fields
+	return flags;
+}
+
+/*------------------------------------------------------------------------------*\
+	FindSlot( hash, name, len)
+		-	returns the slot holding the given field-name or the free slot 
+			where it would have to be inserted
+		-	the caller must hold the lock
+\*------------------------------------------------------------------------------*/
+uint32 BmFieldAtomTable::FindSlot( uint32 hash, const char* name, 
+											  int32 len) const {
+	uint32 mask = mSlots.size()-1;
+	uint32 slot;
+	for( slot = hash & mask; mSlots[slot] >= 0; slot = (slot+1) & mask) {
+		const Entry* entry = mEntries[mSlots[slot]];
+		if (entry->foldedHash == hash && entry->name.Length() == len
+		&& entry->name.ICompare( name, len) == 0)
+			break;
+	}
+	return slot;
+}
+
+/*------------------------------------------------------------------------------*\
+	Lookup( name, len, hash)
+		-	returns the entry for the given field-name (ignoring case) or NULL
+			if the name is not known
+		-	hash must be the folded hash of the name
+\*------------------------------------------------------------------------------*/
+const BmFieldAtom::Entry* BmFieldAtomTable::Lookup( const char* name, 
+																	 int32 len, uint32 hash) {
+	BAutolock lock( mLocker);
+	int32 id = mSlots[FindSlot( hash, name, len)];
+	return id >= 0 ? mEntries[id] : NULL;
+}
+
+/*------------------------------------------------------------------------------*\
+	Intern( name, len)
+		-	returns the entry for the given field-name, creating a new one if
+			the name (ignoring case) is not known yet
+\*------------------------------------------------------------------------------*/
+const BmFieldAtom::Entry* BmFieldAtomTable::Intern( const char* name, 
+																	 int32 len) {
+	uint32 hash = BmFieldAtom::FoldedHash( name, len);
+	BAutolock lock( mLocker);
+	uint32 slot = FindSlot( hash, name, len);
+	if (mSlots[slot] >= 0)
+		return mEntries[mSlots[slot]];
+	Entry* entry = new Entry;
+	entry->id = mEntries.size();
+	entry->foldedHash = hash;
+	if (len > 0)
+		entry->name.SetTo( name, len);
+	entry->name.CapitalizeEachWord();
+	entry->flags = FlagsFor( entry->name);
+	mEntries.push_back( entry);
+	mSlots[slot] = entry->id;
+	if (mEntries.size()*2 > mSlots.size())
+		Rehash();
+	return entry;
+}
+
+/*------------------------------------------------------------------------------*\
+	Rehash()
+		-	doubles the size of the hash-table (keeping it at most half full)
+\*------------------------------------------------------------------------------*/
+void BmFieldAtomTable::Rehash() {
+	mSlots.assign( mSlots.size()*2, -1);
+	uint32 mask = mSlots.size()-1;
+	for( uint32 i=0; i<mEntries.size(); ++i) {
+		uint32 slot = mEntries[i]->foldedHash & mask;
+		while( mSlots[slot] >= 0)
+			slot = (slot+1) & mask;
+		mSlots[slot] = i;
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	BmFieldAtom( fieldName)
+		-	c'tor, interns the given field-name
+\*------------------------------------------------------------------------------*/
+BmFieldAtom::BmFieldAtom( const char* fieldName)
+	:	mEntry( FieldAtomTable().Intern( fieldName ? fieldName : "", 
+													 fieldName ? strlen( fieldName) : 0))
+	,	mHash( mEntry->foldedHash)
+	,	mFlags( mEntry->flags)
+{
+}
+
+/*------------------------------------------------------------------------------*\
+	BmFieldAtom( fieldName)
+		-	c'tor, interns the given field-name
+\*------------------------------------------------------------------------------*/
+BmFieldAtom::BmFieldAtom( const BmString& fieldName)
+	:	mEntry( FieldAtomTable().Intern( fieldName.String(), 
+													 fieldName.Length()))
+	,	mHash( mEntry->foldedHash)
+	,	mFlags( mEntry->flags)
+{
+}
+
+/*------------------------------------------------------------------------------*\
+	BmFieldAtom( fieldName)
+		-	c'tor, interns the given field-name
+\*------------------------------------------------------------------------------*/
+BmFieldAtom::BmFieldAtom( const BmStringView& fieldName)
+	:	mEntry( FieldAtomTable().Intern( fieldName.Data(), fieldName.Length()))
+	,	mHash( mEntry->foldedHash)
+	,	mFlags( mEntry->flags)
+{
+}
+
+/*------------------------------------------------------------------------------*\
+	Lookup( fieldName)
+		-	returns the atom for the given field-name without interning it
+		-	if the name isn't known yet, a custom atom is returned instead
+\*------------------------------------------------------------------------------*/
+BmFieldAtom BmFieldAtom::Lookup( const BmStringView& fieldName) {
+	BmFieldAtom atom;
+	atom.mHash = FoldedHash( fieldName.Data(), fieldName.Length());
+	atom.mEntry = FieldAtomTable().Lookup( fieldName.Data(), fieldName.Length(),
+														atom.mHash);
+	if (atom.mEntry)
+		atom.mFlags = atom.mEntry->flags;
+	else {
+		fieldName.CopyInto( atom.mCustomName);
+		atom.mCustomName.CapitalizeEachWord();
+		atom.mFlags = BmFieldAtomTable::FlagsFor( atom.mCustomName);
+	}
+	return atom;
+}
+
+/*------------------------------------------------------------------------------*\
+	IsSameCustom( atom)
+		-	compares atoms of which at least one is custom by their names, 
+			since a name may have been interned after a custom atom has been
+			created for it
+		-	only called for atoms with the same hash
+\*------------------------------------------------------------------------------*/
+bool BmFieldAtom::IsSameCustom( const BmFieldAtom& a) const {
+	if (mEntry && a.mEntry)
+		return false;
+	return Name().ICompare( a.Name()) == 0;
+}
+
+/*------------------------------------------------------------------------------*\
+	IsLessOnCollision( atom)
+		-	orders atoms with the same hash by their names
+\*------------------------------------------------------------------------------*/
+bool BmFieldAtom::IsLessOnCollision( const BmFieldAtom& a) const {
+	if (mEntry && mEntry == a.mEntry)
+		return false;
+	return Name().ICompare( a.Name()) < 0;
+}
+
+/********************************************************************************\
+	BmHeaderTokenizer
+\********************************************************************************/
+
+/*------------------------------------------------------------------------------*\
+	IsFieldSpace( c)
+		-	returns whether the given char is (folding) whitespace
+\*------------------------------------------------------------------------------*/
+static inline bool IsFieldSpace( char c) {
+	return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+/*------------------------------------------------------------------------------*\
+	IsTokenDelimiter( c)
+		-	returns whether the given char ends an atom
+		-	the dot is part of atoms, since that covers dot-atoms as well as
+			obsolete phrases like 'John Q. Public'
+\*------------------------------------------------------------------------------*/
+static inline bool IsTokenDelimiter( char c) {
+	switch( c) {
+		case ' ': case '\t': case '\r': case '\n':
+		case '(': case ')': case '<': case '>': case '[': case ']':
+		case ':': case ';': case '@': case ',': case '"':
+			return true;
+		default:
+			return false;
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	BmHeaderTokenizer( text)
+		-	
+\*------------------------------------------------------------------------------*/
+BmHeaderTokenizer::BmHeaderTokenizer( const BmStringView& text)
+	:	mText( text)
+	,	mPos( 0)
+	,	mType( BM_TOKEN_END)
+	,	mTerminated( true)
+{
+}
+
+/*------------------------------------------------------------------------------*\
+	NextField( fieldName, fieldBody)
+		-	fetches the next field of the header, a field ends with the first
+			linebreak that isn't followed by whitespace (i.e. isn't folded)
+		-	name and body are trimmed, the body is still folded
+		-	text behind the last linebreak doesn't belong to any field
+		-	returns false if there are no more fields
+\*------------------------------------------------------------------------------*/
+bool BmHeaderTokenizer::NextField( BmStringView& fieldName,
+											  BmStringView& fieldBody) {
+	int32 len = mText.Length();
+	int32 fieldStart = mPos;
+	int32 pos;
+	for( int32 offset = mPos;
+		  (pos = mText.FindFirst( "\r\n", offset)) != B_ERROR;
+		  offset = pos+2) {
+		if (pos == fieldStart
+		|| (pos+2 < len && isspace( (unsigned char)mText[pos+2])))
+			continue;
+		mPos = pos+2;
+		BmStringView field = mText.SubView( fieldStart, pos-fieldStart);
+		int32 colonPos = field.FindFirst( ':');
+		if (colonPos == B_ERROR) {
+			fieldName = BmStringView();
+			fieldBody = field;
+		} else {
+			fieldName = field.SubView( 0, colonPos).Trim();
+			fieldBody = field.SubView( colonPos+1).Trim();
+		}
+		return true;
+	}
+	mPos = len;
+	return false;
+}
+
+/*------------------------------------------------------------------------------*\
+	NextToken()
+		-	fetches the next token of a field-body and returns its type
+		-	specials are single chars, any other token is the longest run
+			of its kind
+\*------------------------------------------------------------------------------*/
+BmHeaderTokenizer::TokenType BmHeaderTokenizer::NextToken() {
+	int32 len = mText.Length();
+	int32 start = mPos;
+	mTerminated = true;
+	if (mPos >= len)
+		mType = BM_TOKEN_END;
+	else {
+		char c = mText[mPos];
+		if (IsFieldSpace( c)) {
+			while( ++mPos < len && IsFieldSpace( mText[mPos]))
+				;
+			mType = BM_TOKEN_SPACE;
+		} else if (c == '(') {
+			mPos = SkipDelimited( mPos, '(', ')');
+			mType = BM_TOKEN_COMMENT;
+		} else if (c == '"') {
+			mPos = SkipDelimited( mPos, '"', '"');
+			mType = BM_TOKEN_QUOTED_STRING;
+		} else if (c == '[') {
+			mPos = SkipDelimited( mPos, '[', ']');
+			mType = BM_TOKEN_DOMAIN_LITERAL;
+		} else if (IsTokenDelimiter( c)) {
+			mPos++;
+			mType = BM_TOKEN_SPECIAL;
+		} else {
+			while( ++mPos < len && !IsTokenDelimiter( mText[mPos]))
+				;
+			mType = BM_TOKEN_ATOM;
+		}
+	}
+	mToken = mText.SubView( start, mPos-start);
+	return mType;
+}
+
+/*------------------------------------------------------------------------------*\
+	SkipDelimited( pos, opening, closing)
+		-	returns the offset behind the closing char that matches the
+			opening one at the given position, skipping quoted-pairs
+		-	only comments nest
+\*------------------------------------------------------------------------------*/
+int32 BmHeaderTokenizer::SkipDelimited( int32 pos, char opening, char closing) {
+	int32 len = mText.Length();
+	int32 nestLevel = 1;
+	for( ++pos; pos < len; ++pos) {
+		char c = mText[pos];
+		if (c == '\\')
+			pos++;
+		else if (c == closing) {
+			if (--nestLevel == 0)
+				return pos+1;
+		} else if (c == opening && opening == '(')
+			nestLevel++;
+	}
+	mTerminated = false;
+	return len;
+}
+
+/*------------------------------------------------------------------------------*\
+	UnquoteToken( into)
+		-	appends the contents of the current quoted-string or comment
+			(without the delimiters and with quoted-pairs resolved)
+\*------------------------------------------------------------------------------*/
+void BmHeaderTokenizer::UnquoteToken( BmString& into) const {
+	const char* data = mToken.Data();
+	int32 end = mToken.Length() - (mTerminated ? 1 : 0);
+	int32 runStart = 1;
+	for( int32 pos = 1; pos < end; ++pos) {
+		if (data[pos] == '\\' && pos+1 < end) {
+			into.Append( data+runStart, pos-runStart);
+			runStart = ++pos;
+		}
+	}
+	if (end > runStart)
+		into.Append( data+runStart, end-runStart);
+}
+
+/*------------------------------------------------------------------------------*\
+	AppendStrippedToken( tokenizer, stripped, commentBuffer)
+		-	appends the current token to a stripped field-value: comments are
+			moved into the comment-buffer (if any), whitespace is replaced by
+			a single space and unterminated quoted-strings and comments are
+			closed
+\*------------------------------------------------------------------------------*/
+static void AppendStrippedToken( const BmHeaderTokenizer& tokenizer,
+											BmString& stripped,
+											BmString* commentBuffer) {
+	const BmStringView& token = tokenizer.Token();
+	switch( tokenizer.Type()) {
+		case BmHeaderTokenizer::BM_TOKEN_SPACE:
+			stripped.Append( " ", 1);
+			break;
+		case BmHeaderTokenizer::BM_TOKEN_COMMENT:
+			if (commentBuffer) {
+				commentBuffer->Append( token.Data(), token.Length());
+				if (!tokenizer.IsTerminated())
+					commentBuffer->Append( ")", 1);
+			}
+			break;
+		case BmHeaderTokenizer::BM_TOKEN_QUOTED_STRING:
+			stripped.Append( token.Data(), token.Length());
+			if (!tokenizer.IsTerminated())
+				stripped.Append( "\"", 1);
+			break;
+		default:
+			stripped.Append( token.Data(), token.Length());
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	StripQuotes( phrase)
+		-	returns the given phrase without leading & trailing quotes
+		-	a phrase that consists of quotes only keeps a single one (if it has
+			at least three of them)
+\*------------------------------------------------------------------------------*/
+static BmStringView StripQuotes( const BmStringView& phrase) {
+	int32 len = phrase.Length();
+	int32 leading = 0;
+	while( leading < len && (phrase[leading] == '"' || phrase[leading] == '\''))
+		leading++;
+	if (leading == len)
+		return len >= 3 ? phrase.SubView( len-2, 1) : phrase;
+	int32 trailing = 0;
+	while( phrase[len-1-trailing] == '"' || phrase[len-1-trailing] == '\'')
+		trailing++;
+	if (!leading || !trailing)
+		return phrase;
+	return phrase.SubView( leading, len-leading-trailing);
+}
+
+/*------------------------------------------------------------------------------*\
+	BmAddressParser
+		-	collects the tokens of a single address (a mailbox in terms of
+			RFC 5322) and splits them into phrase and addr-spec
+		-	the phrase is the text in front of the angle-address, with
+			quoted-strings unquoted and comments treated as whitespace
+		-	an obsolete source-route inside the angle-address is dropped
+		-	if the tokens do not form a name-addr (e.g. because anything but
+			comments follows the angle-address), the complete stripped text
+			is taken as addr-spec
+\*------------------------------------------------------------------------------*/
+class BmAddressParser {
+
+public:
+	BmAddressParser()							{ Reset(); }
+
+	// native methods:
+	void Reset();
+	void AddToken( const BmHeaderTokenizer& tokenizer);
+	bool Finish( BmAddress& addr);
+
+	// getters:
+	inline bool IsEmpty() const			{ return !mHasContent; }
+	inline bool InAngleAddr() const		{ return mState == IN_ANGLE_ADDR; }
+	inline bool HasAngleAddr() const		{ return mState != IN_PHRASE; }
+	inline const BmString& Text() const	{ return mText; }
+
+private:
+	enum State {
+		IN_PHRASE,
+		IN_ANGLE_ADDR,
+		BEHIND_ANGLE_ADDR,
+		MALFORMED
+	};
+
+	State mState;
+	bool mHasContent;
+							// set as soon as a token other than whitespace
+							// or a comment has been added
+	bool mNeedSpace;
+							// set if whitespace (or a comment) separates the
+							// current token from the previous one
+	BmString mText;
+							// the stripped text of the address
+	BmString mPhrase;
+	BmString mAddrSpec;
+};
+
+/*------------------------------------------------------------------------------*\
+	Reset()
+		-	
+\*------------------------------------------------------------------------------*/
+void BmAddressParser::Reset() {
+	mState = IN_PHRASE;
+	mHasContent = false;
+	mNeedSpace = false;
+	mText.Truncate( 0);
+	mPhrase.Truncate( 0);
+	mAddrSpec.Truncate( 0);
+}
+
+/*------------------------------------------------------------------------------*\
+	AddToken( tokenizer)
+		-	adds the current token of the given tokenizer to the address
+\*------------------------------------------------------------------------------*/
+void BmAddressParser::AddToken( const BmHeaderTokenizer& tokenizer) {
+	AppendStrippedToken( tokenizer, mText, NULL);
+	BmHeaderTokenizer::TokenType type = tokenizer.Type();
+	if (type == BmHeaderTokenizer::BM_TOKEN_SPACE
+	|| type == BmHeaderTokenizer::BM_TOKEN_COMMENT) {
+		mNeedSpace = true;
+		return;
+	}
+	mHasContent = true;
+	const BmStringView& token = tokenizer.Token();
+	switch( mState) {
+		case IN_PHRASE: {
+			if (tokenizer.IsSpecial( '<'))
+				mState = IN_ANGLE_ADDR;
+			else {
+				if (mNeedSpace && mPhrase.Length())
+					mPhrase.Append( " ", 1);
+				if (type == BmHeaderTokenizer::BM_TOKEN_QUOTED_STRING)
+					tokenizer.UnquoteToken( mPhrase);
+				else
+					mPhrase.Append( token.Data(), token.Length());
+			}
+			break;
+		}
+		case IN_ANGLE_ADDR: {
+			if (tokenizer.IsSpecial( '>'))
+				mState = BEHIND_ANGLE_ADDR;
+			else if (tokenizer.IsSpecial( ':'))
+				// the text up to here was an (obsolete) source-route:
+				mAddrSpec.Truncate( 0);
+			else if (tokenizer.IsSpecial( '<'))
+				mState = MALFORMED;
+			else
+				// whitespace and comments within an addr-spec carry no
+				// meaning (obs-local-part & obs-domain), so we drop them:
+				mAddrSpec.Append( token.Data(), token.Length());
+			break;
+		}
+		case BEHIND_ANGLE_ADDR:
+		case MALFORMED:
+			mState = MALFORMED;
+			break;
+	}
+	mNeedSpace = false;
+}
+
+/*------------------------------------------------------------------------------*\
+	Finish( addr)
+		-	sets the given address to the one collected and resets the parser
+		-	returns whether the address contains an addr-spec
+\*------------------------------------------------------------------------------*/
+bool BmAddressParser::Finish( BmAddress& addr) {
+	if (mState == IN_PHRASE || mState == MALFORMED) {
+		addr.mPhrase.Truncate( 0);
+		BmStringView( mText).Trim().CopyInto( addr.mAddrSpec);
+	} else {
+		// strip leading & trailing quotes from the phrase, too:
+		StripQuotes( BmStringView( mPhrase).Trim()).CopyInto( addr.mPhrase);
+		addr.mAddrSpec = mAddrSpec;
+	}
+	addr.mInitOK = addr.mAddrSpec.Length() > 0;
+	Reset();
+	return addr.mInitOK;
+}
+
 /********************************************************************************\
 	BmAddress
 \********************************************************************************/
@@ -74,47 +654,15 @@ BmAddress::~BmAddress() {
 }
 
 /*------------------------------------------------------------------------------*\
-	()
-		-	
+	SetTo( fullText)
+		-	parses the given text as a single address
 \*------------------------------------------------------------------------------*/
 bool BmAddress::SetTo( const BmString& fullText) {
-	Regexx rx;
-	BmString addrText, phraseText;
-
-	// first we check whether the addresstext is separated into phrase 
-	// and addrspec:
-	if (rx.exec( 
-		fullText, 
-		"^\\s*(.*?)\\s*<\\s*(?:[^<>]+?:)?([^:<>]*?)\\s*>\\s*$"
-	)) {
-		// it's a phrase followed by an address (which possibly contains 
-		// a source-route).
-		fullText.CopyInto( phraseText, rx.match[0].atom[0].start(), 
-								 rx.match[0].atom[0].Length());
-		fullText.CopyInto( addrText, rx.match[0].atom[1].start(), 
-								 rx.match[0].atom[1].Length());
-		// strip leading&trailing quotes:
-		if (rx.exec( phraseText, "^[\"']+(.+?)[\"']+$")) {
-			phraseText.CopyInto( mPhrase, rx.match[0].atom[0].start(), 
-										rx.match[0].atom[0].Length());
-		} else {
-			mPhrase = phraseText;
-		}
-	} else {
-		// it's just a simple address (no <>).
-		addrText = fullText;
-	}
-	// finally strip all leading/trailing whitespace from the address-part:
-	if (rx.exec( addrText, "^\\s*(.+?)\\s*$"))
-		addrText.CopyInto( mAddrSpec, rx.match[0].atom[0].start(), 
-								 rx.match[0].atom[0].Length());
-	else
-		mAddrSpec = addrText;
-	// avoid spurious addrSpecs that only contains whitespace:
-	if (rx.exec( mAddrSpec, "^\\s+$"))
-		mAddrSpec = "";
-	mInitOK = (mAddrSpec.Length() > 0);
-	return mInitOK;
+	BmHeaderTokenizer tokenizer( fullText);
+	BmAddressParser parser;
+	while( tokenizer.NextToken() != BmHeaderTokenizer::BM_TOKEN_END)
+		parser.AddToken( tokenizer);
+	return parser.Finish( *this);
 }
 
 /*------------------------------------------------------------------------------*\
@@ -196,10 +744,11 @@ BmAddressList::BmAddressList()
 	()
 		-	
 \*------------------------------------------------------------------------------*/
-BmAddressList::BmAddressList( BmString strippedFieldVal)
-	:	mIsGroup( false) 
+BmAddressList::BmAddressList( const BmString& fieldVal)
+	:	mInitOK( false)
+	,	mIsGroup( false) 
 {
-	Set( strippedFieldVal);
+	Set( fieldVal);
 }
 
 /*------------------------------------------------------------------------------*\
@@ -213,50 +762,83 @@ BmAddressList::~BmAddressList() {
 	()
 		-	
 \*------------------------------------------------------------------------------*/
-bool BmAddressList::Set( BmString strippedFieldVal) {
+bool BmAddressList::Set( const BmString& fieldVal, BmString* strippedVal) {
 	mGroupName = "";
 	mAddrList.clear();
-	mInitOK = Add( strippedFieldVal);
+	mInitOK = Add( fieldVal, strippedVal);
 	return mInitOK;
 }
 	
 /*------------------------------------------------------------------------------*\
-	()
-		-	
+	Add( fieldVal, strippedVal)
+		-	parses the given field-value into addresses and adds them to
+			the list, the value is tokenized only once
+		-	the list is a group if the value consists of a single group only,
+			addresses of groups that are mixed with other addresses are
+			added without their group
+		-	(obsolete) empty list-elements are ignored
+		-	returns false if any of the addresses lacks an addr-spec
 \*------------------------------------------------------------------------------*/
-bool BmAddressList::Add( BmString strippedFieldVal) {
-	BmString addrText;
-	Regexx rx;
+bool BmAddressList::Add( const BmString& fieldVal, BmString* strippedVal) {
+	BmHeaderTokenizer tokenizer( fieldVal);
+	BmAddressParser parser;
+	BmString groupName;
+	int32 groupCount = 0;
+	bool inGroup = false;
+	bool outsideOfGroup = false;
+							// set if any address isn't part of a group
 	bool res = true;
 
 	mAddrString.Truncate(0);
-	if (rx.exec( strippedFieldVal, "^\\s*(.+?):\\s*(.+?)?;\\s*$")) {
-		// it's a group list:
-		mIsGroup = true;
-		strippedFieldVal.CopyInto( mGroupName, rx.match[0].atom[0].start(), 
-											rx.match[0].atom[0].Length());
-		if (rx.match[0].atom.size() > 1)
-			strippedFieldVal.CopyInto( addrText, rx.match[0].atom[1].start(), 
-												rx.match[0].atom[1].Length());
-	} else {
-		// simple address (or list of addresses)
-		mIsGroup = false;
-		addrText = strippedFieldVal;
+	while( tokenizer.NextToken() != BmHeaderTokenizer::BM_TOKEN_END) {
+		if (strippedVal)
+			AppendStrippedToken( tokenizer, *strippedVal, NULL);
+		if (!parser.InAngleAddr()) {
+			if (tokenizer.IsSpecial( ',')
+			|| (inGroup && tokenizer.IsSpecial( ';'))) {
+				// end of address:
+				if (!parser.IsEmpty()) {
+					BmAddress addr;
+					if (parser.Finish( addr))
+						mAddrList.push_back( addr);
+					else
+						res = false;
+					if (!inGroup)
+						outsideOfGroup = true;
+				}
+				if (tokenizer.IsSpecial( ';'))
+					inGroup = false;
+				continue;
+			}
+			if (tokenizer.IsSpecial( ':') && !inGroup && !parser.IsEmpty()
+			&& !parser.HasAngleAddr()) {
+				// the text up to here is the name of a group:
+				BmStringView( parser.Text()).Trim().CopyInto( groupName);
+				parser.Reset();
+				inGroup = true;
+				groupCount++;
+				continue;
+			}
+		}
+		parser.AddToken( tokenizer);
 	}
-	BmStringList addrList = SplitIntoAddresses( addrText);
-	size_t num = addrList.size();
-	for( size_t i=0; i<num; ++i) {
-		BmAddress addr( addrList[i]);
-		if (addr.InitOK())
+	if (!parser.IsEmpty()) {
+		BmAddress addr;
+		if (parser.Finish( addr))
 			mAddrList.push_back( addr);
 		else
 			res = false;
+		if (!inGroup)
+			outsideOfGroup = true;
 	}
-	if (!mInitOK) 
+	mIsGroup = groupCount == 1 && !outsideOfGroup;
+	if (mIsGroup)
+		mGroupName = groupName;
+	if (!mInitOK)
 		mInitOK = res;
 	return res;
 }
-	
+
 /*------------------------------------------------------------------------------*\
 	()
 		-	
@@ -297,76 +879,6 @@ bool BmAddressList::ContainsAddrSpec( const BmString addrSpec) const {
 	return false;
 }
 
-/*------------------------------------------------------------------------------*\
-	SplitIntoAddresses()
-		-	
-\*------------------------------------------------------------------------------*/
-BmStringList BmAddressList::SplitIntoAddresses( BmString addrListText) {
-	mAddrString.Truncate(0);
-	BmStringList addrList;
-	BmString currAddr;
-	const char* pos = addrListText.String();
-	const char* endPos;
-	while( *pos) {
-		if (*pos == '"') {
-			BmString quotedString;
-			// quoted-string started, we remove the quotes and unquote 
-			// quoted-pairs.
-			for( 	endPos=pos+1; 
-					*endPos && (*endPos!='"' || *(endPos-1)=='\\'); ++endPos)
-				;
-			if (*endPos) {
-				// found complete quoted-string.
-				int32 numChars = 1+endPos-pos;
-				quotedString.Append( pos+1, numChars-2);
-				pos += numChars;
-			} else {
-				// it seems that there is no ending quote, we assume the 
-				// remainder to be part of the quoted string:
-				quotedString.Append( pos+1);
-				pos = endPos;
-			}
-			// we deescape characters that are escaped by a backslash 
-			// (quoted-pairs):
-			currAddr.Append( quotedString.CharacterDeescape( '\\'));
-		} else if (*pos == '<') {
-			// route-address started, we copy it as a block in order to avoid 
-			// problems with possibly contained separator-chars (commas).
-			for( endPos=pos+1; *endPos && (*endPos!='>'); ++endPos)
-				;
-			if (*endPos) {
-				// found complete route-address.
-				int32 numChars = 1+endPos-pos;
-				currAddr.Append( pos, numChars);
-				pos += numChars;
-			} else {
-				// it seems that there is no ending '>', we assume the remainder 
-				// to be  part of the route-address (and append the missing '>'):
-				currAddr.Append( pos);
-				currAddr.Append( ">");
-				pos = endPos;
-			}
-		} else {
-			// we copy characters until we find the start of a quoted string or 
-			// the separator char:
-			for(  endPos=pos; *endPos && *endPos!='"' && *endPos!=','; ++endPos)
-				;
-			int32 numChars = endPos-pos;
-			currAddr.Append( pos, numChars);
-			pos += numChars;
-			if (*endPos == ',') {
-				addrList.push_back( currAddr);
-				currAddr = "";
-				pos++;
-			}
-		}
-	}
-	if (currAddr.Length()) {
-		addrList.push_back( currAddr);
-	}
-	return addrList;
-}
-
 /*------------------------------------------------------------------------------*\
 	()
 		-	
@@ -429,43 +941,96 @@ void BmAddressList::ConstructRawText( BmStringOBuf& header,
 \********************************************************************************/
 
 /*------------------------------------------------------------------------------*\
-	Set( fieldName, value)
+	IndexOf( field)
+		-	returns the index of the given field (or -1 if it isn't contained)
+\*------------------------------------------------------------------------------*/
+int32 BmMailHeader::BmHeaderList::IndexOf( const BmFieldAtom& field) const {
+	BmIndexMap::const_iterator pos = mIndexMap.find( field);
+	return pos == mIndexMap.end() ? -1 : pos->second;
+}
+
+/*------------------------------------------------------------------------------*\
+	ShiftIndices( fromIdx, delta)
+		-	adjusts the indices of all fields at or behind fromIdx after a field
+			has been inserted or removed
+\*------------------------------------------------------------------------------*/
+void BmMailHeader::BmHeaderList::ShiftIndices( int32 fromIdx, int32 delta) {
+	BmIndexMap::iterator pos;
+	for( pos=mIndexMap.begin(); pos!=mIndexMap.end(); ++pos) {
+		if (pos->second >= fromIdx)
+			pos->second += delta;
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	ValuesFor( field)
+		-	returns the value-list of the given field, adding the field if
+			required
+		-	fields are kept sorted by name, such that the header is always 
+			written in the same order
+		-	a custom atom is resolved once more when its field is added, since
+			its name may have been interned in the meantime (this way the 
+			field carries the atom-id whenever there is one)
+\*------------------------------------------------------------------------------*/
+BmMailHeader::BmValueList& BmMailHeader::BmHeaderList
+::ValuesFor( const BmFieldAtom& field) {
+	int32 idx = IndexOf( field);
+	if (idx >= 0)
+		return mFields[idx].values;
+	BmHeaderFieldVect::iterator pos = mFields.begin();
+	while( pos != mFields.end() && pos->atom.Name() < field.Name())
+		++pos;
+	idx = pos - mFields.begin();
+	pos = mFields.insert( pos, BmHeaderField( field.IsCustom() 
+																? BmFieldAtom::Lookup( field.Name())
+																: field));
+	ShiftIndices( idx, 1);
+	mIndexMap[pos->atom] = idx;
+	return pos->values;
+}
+
+/*------------------------------------------------------------------------------*\
+	Set( field, value)
 		-	
 \*------------------------------------------------------------------------------*/
-void BmMailHeader::BmHeaderList::Set( const BmString& fieldName, 
+void BmMailHeader::BmHeaderList::Set( const BmFieldAtom& field, 
 												  const BmString value) {
-	BmValueList& valueList = mHeaders[fieldName];
+	BmValueList& valueList = ValuesFor( field);
 	valueList.clear();
 	valueList.push_back( value);
 }
 
 /*------------------------------------------------------------------------------*\
-	Add( fieldName, value)
+	Add( field, value)
 		-	
 \*------------------------------------------------------------------------------*/
-void BmMailHeader::BmHeaderList::Add( const BmString& fieldName, 
+void BmMailHeader::BmHeaderList::Add( const BmFieldAtom& field, 
 												  const BmString value) {
-	BmValueList& valueList = mHeaders[fieldName];
-	valueList.push_back( value);
+	ValuesFor( field).push_back( value);
 }
 
 /*------------------------------------------------------------------------------*\
-	Remove( fieldName)
+	Remove( field)
 		-	
 \*------------------------------------------------------------------------------*/
-void BmMailHeader::BmHeaderList::Remove( const BmString& fieldName) {
-	mHeaders.erase( fieldName);
+void BmMailHeader::BmHeaderList::Remove( const BmFieldAtom& field) {
+	int32 idx = IndexOf( field);
+	if (idx >= 0) {
+		mIndexMap.erase( field);
+		mFields.erase( mFields.begin()+idx);
+		ShiftIndices( idx, -1);
+	}
 }
 
 /*------------------------------------------------------------------------------*\
-	RemoveFieldVal( fieldName, val)
+	RemoveFieldVal( field, val)
 		-	
 \*------------------------------------------------------------------------------*/
-void BmMailHeader::BmHeaderList::RemoveFieldVal( const BmString& fieldName,
+void BmMailHeader::BmHeaderList::RemoveFieldVal( const BmFieldAtom& field,
 																 const BmString& val) {
-	BmHeaderMap::iterator pos = mHeaders.find(fieldName);
-	if (pos != mHeaders.end()) {
-		BmValueList& valueList = pos->second;
+	int32 idx = IndexOf( field);
+	if (idx >= 0) {
+		BmValueList& valueList = mFields[idx].values;
 		BmValueList::iterator valPos 
 			= find(valueList.begin(),valueList.end(),val);
 		if (valPos != valueList.end())
@@ -478,18 +1043,19 @@ void BmMailHeader::BmHeaderList::RemoveFieldVal( const BmString& fieldName,
 		-	returns all values found for given fieldName
 \*------------------------------------------------------------------------------*/
 void BmMailHeader::BmHeaderList::GetAllValues( BmMsgContext& msgContext) const {
-	msgContext.headerInfoCount = mHeaders.size();
+	msgContext.headerInfoCount = mFields.size();
 	msgContext.headerInfos = new BmHeaderInfo [msgContext.headerInfoCount];
 	int i = 0;
-	BmHeaderMap::const_iterator iter;
-	for( iter=mHeaders.begin(); iter != mHeaders.end(); ++iter, ++i) {
-		const BmValueList& valueList = iter->second;
+	BmHeaderFieldVect::const_iterator iter;
+	for( iter=mFields.begin(); iter != mFields.end(); ++iter, ++i) {
+		const BmValueList& valueList = iter->values;
 		const char** values = new const char* [valueList.size()+1];
 		for( uint32 v=0; v<valueList.size(); ++v)
 			values[v] = valueList[v].String();
 		values[valueList.size()] = NULL;
 		msgContext.headerInfos[i].values = values;
-		msgContext.headerInfos[i].fieldName = iter->first;
+		msgContext.headerInfos[i].fieldName = iter->atom.Name().String();
+		msgContext.headerInfos[i].fieldHash = iter->atom.Hash();
 	}
 }
 
@@ -500,45 +1066,45 @@ void BmMailHeader::BmHeaderList::GetAllValues( BmMsgContext& msgContext) const {
 void BmMailHeader::BmHeaderList
 ::GetAllNames(vector<BmString>& fieldNamesVect) const {
 	fieldNamesVect.clear();
-	BmHeaderMap::const_iterator iter;
-	for( iter=mHeaders.begin(); iter != mHeaders.end(); ++iter) {
-		fieldNamesVect.push_back(iter->first);
+	BmHeaderFieldVect::const_iterator iter;
+	for( iter=mFields.begin(); iter != mFields.end(); ++iter) {
+		fieldNamesVect.push_back(iter->atom.Name());
 	}
 }
 
 /*------------------------------------------------------------------------------*\
-	CountValuesFor( fieldName)
-		-	returns the value-count found for given fieldName
+	CountValuesFor( field)
+		-	returns the value-count found for given field
 \*------------------------------------------------------------------------------*/
-uint32 BmMailHeader::BmHeaderList::CountValuesFor(const BmString& fieldName) const
+uint32 BmMailHeader::BmHeaderList::CountValuesFor( const BmFieldAtom& field) const
 {
-	BmHeaderMap::const_iterator iter = mHeaders.find(fieldName);
-	return (iter == mHeaders.end()) ? 0 : iter->second.size();
+	int32 idx = IndexOf( field);
+	return (idx < 0) ? 0 : mFields[idx].values.size();
 }
 
 /*------------------------------------------------------------------------------*\
-	ValueAt( fieldName, idx)
-		-	returns the value no. idx for given fieldName
+	ValueAt( field, idx)
+		-	returns the value no. idx for given field
 \*------------------------------------------------------------------------------*/
 const BmString& BmMailHeader::BmHeaderList
-::ValueAt(const BmString& fieldName, uint32 idx) const 
+::ValueAt( const BmFieldAtom& field, uint32 idx) const 
 {
-	BmHeaderMap::const_iterator iter = mHeaders.find(fieldName);
-	if (iter == mHeaders.end())
+	int32 fieldIdx = IndexOf( field);
+	if (fieldIdx < 0)
 		return BM_DEFAULT_STRING;
-	const BmValueList& valueList = iter->second;
+	const BmValueList& valueList = mFields[fieldIdx].values;
 	if (valueList.size() <= idx)
 		return BM_DEFAULT_STRING;
 	return valueList[idx];
 }
 
 /*------------------------------------------------------------------------------*\
-	operator [] ( fieldName)
-		-	returns first value found for given fieldName
+	operator [] ( field)
+		-	returns first value found for given field
 \*------------------------------------------------------------------------------*/
 const BmString& BmMailHeader::BmHeaderList
-::operator [] (const BmString& fieldName) const {
-	return ValueAt( fieldName, 0);
+::operator [] ( const BmFieldAtom& field) const {
+	return ValueAt( field, 0);
 }
 
 
@@ -549,15 +1115,92 @@ const BmString& BmMailHeader::BmHeaderList
 
 int32 BmMailHeader::nCounter = 0;
 
-// split header into separate header-fields:
-struct subpart {
-	int32 pos;
-	int32 len;
-#ifdef __POWERPC__
-	inline subpart() : pos(0), len(0) {}
-#endif
-	inline subpart( int32 p, int32 l) : pos(p), len(l) {}
-};
+/*------------------------------------------------------------------------------*\
+	FindEndOfHeader( text, fromOffset)
+		-	returns the offset behind the last linebreak of the header (i.e. the
+			offset of the empty line that separates header and body), or 
+			B_ERROR if the given text contains no empty line
+		-	a text that starts with an empty line has an empty header (0)
+		-	accepts CRLF as well as plain LF, since mail-files that have been
+			written by other programs might use either
+\*------------------------------------------------------------------------------*/
+static int32 FindEndOfHeader( const BmString& text, int32 fromOffset) {
+	int32 len = text.Length();
+	if (fromOffset == 0 && len > 0 
+	&& (text[0] == '\n' || (len > 1 && text[0] == '\r' && text[1] == '\n')))
+		return 0;
+	for( int32 pos = text.FindFirst( '\n', fromOffset); pos != B_ERROR; 
+		  pos = text.FindFirst( '\n', pos+1)) {
+		if (pos+1 < len && text[pos+1] == '\n')
+			return pos+1;
+		if (pos+2 < len && text[pos+1] == '\r' && text[pos+2] == '\n')
+			return pos+1;
+	}
+	return B_ERROR;
+}
+
+/*------------------------------------------------------------------------------*\
+	ExtractFields( headerText, fields, extractedText)
+		-	copies the header-fields with the given names (a NULL-terminated 
+			array) from headerText into extractedText, skipping all others
+		-	the fields are only split apart, their bodies are left alone
+\*------------------------------------------------------------------------------*/
+static void ExtractFields( const BmString& headerText, 
+									const BmFieldAtom* const* fields,
+									BmString& extractedText) {
+	extractedText.Truncate( 0);
+	int32 len = headerText.Length();
+	int32 fieldStart = 0;
+	while( fieldStart < len) {
+		// a field ends with a linebreak that isn't followed by whitespace:
+		int32 fieldEnd = fieldStart;
+		while( (fieldEnd = headerText.FindFirst( "\r\n", fieldEnd)) != B_ERROR
+		&& fieldEnd+2 < len && isspace( (unsigned char)headerText[fieldEnd+2]))
+			fieldEnd += 2;
+		if (fieldEnd == B_ERROR)
+			fieldEnd = len;
+		int32 colonPos = headerText.FindFirst( ':', fieldStart);
+		if (colonPos != B_ERROR && colonPos < fieldEnd) {
+			BmFieldAtom field = BmFieldAtom::Lookup( 
+				BmStringView( headerText, fieldStart, colonPos-fieldStart).Trim()
+			);
+			for( int32 i=0; fields[i]; ++i) {
+				if (*fields[i] == field) {
+					extractedText.Append( headerText.String()+fieldStart, 
+												 fieldEnd-fieldStart);
+					extractedText << "\r\n";
+					break;
+				}
+			}
+		}
+		fieldStart = fieldEnd+2;
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	CreateForAttributes( headerText)
+		-	creates a header that contains only those fields of the given 
+			header-text that are needed for the mail's attributes (see 
+			StoreAttributes()), such that none of the other fields has to be 
+			parsed
+		-	this is meant for mails whose attributes are missing, as the 
+			header-block is all that needs to be read from the mail-file
+			(see ReadHeaderBlock())
+\*------------------------------------------------------------------------------*/
+BmRef<BmMailHeader> BmMailHeader::CreateForAttributes( 
+	const BmString& headerText) 
+{
+	static const BmFieldAtom* const attrFields[] = {
+		&BM_ATOM_CC, &BM_ATOM_CONTENT_TYPE, &BM_ATOM_DATE, &BM_ATOM_FROM, 
+		&BM_ATOM_MIME, &BM_ATOM_PRIORITY, &BM_ATOM_REPLY_TO, 
+		&BM_ATOM_RESENT_DATE, &BM_ATOM_SUBJECT, &BM_ATOM_TO, 
+		&BM_ATOM_X_PRIORITY, NULL
+	};
+	BmString attrText;
+	ExtractFields( headerText, attrFields, attrText);
+	BmRef<BmMailHeader> header( new BmMailHeader( attrText, NULL));
+	return header;
+}
 
 /*------------------------------------------------------------------------------*\
 	BmMailHeader( headerText)
@@ -584,50 +1227,103 @@ BmMailHeader::~BmMailHeader() {
 	IsAddressField()
 	-	
 \*------------------------------------------------------------------------------*/
-bool BmMailHeader::IsAddressField( BmString fieldName) {
-	BmString fname = BmString("<") << fieldName.CapitalizeEachWord() << ">";
-	return BmAddressFieldNames.IFindFirst( fname) != B_ERROR;
+bool BmMailHeader::IsAddressField( const BmFieldAtom& field) {
+	return field.IsAddressField();
 }
 
 /*------------------------------------------------------------------------------*\
 	IsIdentificationField()
 	-	
 \*------------------------------------------------------------------------------*/
-bool BmMailHeader::IsIdentificationField( BmString fieldName) {
-	BmString fname = BmString("<") << fieldName.CapitalizeEachWord() << ">";
-	return BmIdentificationFieldNames.IFindFirst( fname) != B_ERROR;
+bool BmMailHeader::IsIdentificationField( const BmFieldAtom& field) {
+	return field.IsIdentificationField();
 }
 
 /*------------------------------------------------------------------------------*\
 	IsEncodingOkForField()
 	-	
 \*------------------------------------------------------------------------------*/
-bool BmMailHeader::IsEncodingOkForField( BmString fieldName) {
-	if (fieldName.ICompare("Content-", 8) == 0)
-		return false;
-	BmString fname = BmString("<") << fieldName.CapitalizeEachWord() << ">";
-	return BmNoEncodingFieldNames.IFindFirst( fname) == B_ERROR;
+bool BmMailHeader::IsEncodingOkForField( const BmFieldAtom& field) {
+	return field.IsEncodingOk();
 }
 
 /*------------------------------------------------------------------------------*\
 	IsStrippingOkForField()
 	-	
 \*------------------------------------------------------------------------------*/
-bool BmMailHeader::IsStrippingOkForField( BmString fieldName) {
-	fieldName.CapitalizeEachWord();	
-	if (fieldName.Compare( "X-", 2) == 0)
-		return false;							// no stripping for unknown fields
-	BmString fname = BmString("<") << fieldName << ">";
-	return BmNoStrippingFieldNames.IFindFirst( fname) == B_ERROR;
+bool BmMailHeader::IsStrippingOkForField( const BmFieldAtom& field) {
+	return field.IsStrippingOk();
+}
+
+/*------------------------------------------------------------------------------*\
+	SimplifyPriority( priority)
+		-	reduces the given priority (as found in a header or in the 
+			priority-attribute) to a single digit ("1" is highest, "3" is 
+			normal)
+\*------------------------------------------------------------------------------*/
+BmString BmMailHeader::SimplifyPriority( const BmString& priority) {
+	if (!priority.Length())
+		return "3";							// normal priority
+	if (isdigit( (unsigned char)priority[0]))
+		return BmString( priority.String(), 1);
+	if (priority.IFindFirst( "Highest") != B_ERROR)
+		return "1";
+	if (priority.IFindFirst( "High") != B_ERROR)
+		return "2";
+	if (priority.IFindFirst( "Lowest") != B_ERROR)
+		return "5";
+	if (priority.IFindFirst( "Low") != B_ERROR)
+		return "4";
+	return "3";
+}
+
+/*------------------------------------------------------------------------------*\
+	ReadHeaderBlock( mailFile, headerText, rawLengthOut)
+		-	reads the header-block of the given mail-file (everything up to the
+			first empty line) into headerText, leaving the body alone
+		-	the header is converted into the canonical form that BmMail uses 
+			(CRLF-linebreaks and no binary nulls)
+		-	if given, rawLengthOut is set to the length of the header within
+			the file (without the empty line, just like BmMail::HeaderLength())
+\*------------------------------------------------------------------------------*/
+status_t BmMailHeader::ReadHeaderBlock( BPositionIO& mailFile, 
+													 BmString& headerText,
+													 int32* rawLengthOut) {
+	const int32 blockSize = 4096;
+	BmString rawText;
+	int32 headerLen = B_ERROR;
+	while( headerLen == B_ERROR) {
+		// read directly into the string, as the mail may contain binary nulls:
+		int32 rawLen = rawText.Length();
+		char* buf = rawText.LockBuffer( rawLen+blockSize);
+		if (!buf)
+			return B_NO_MEMORY;
+		ssize_t sz = mailFile.ReadAt( rawLen, buf+rawLen, blockSize);
+		rawText.UnlockBuffer( rawLen + MAX( 0, sz));
+		if (sz < 0)
+			return sz;
+		if (sz == 0) {
+			// mail consists of the header only:
+			headerLen = rawLen;
+			break;
+		}
+		// the separator may straddle both blocks, so we look at the
+		// end of the previous block, too:
+		headerLen = FindEndOfHeader( rawText, MAX( 0, rawLen-2));
+	}
+	if (rawLengthOut)
+		*rawLengthOut = headerLen;
+	headerText.ConvertLinebreaksToCRLF( rawText.String(), headerLen);
+	headerText.ReplaceAll( 0, 32);
+	return B_OK;
 }
 
 /*------------------------------------------------------------------------------*\
 	IsFieldEmpty()
 	-	
 \*------------------------------------------------------------------------------*/
-bool BmMailHeader::IsFieldEmpty( BmString fieldName) {
-	fieldName.CapitalizeEachWord();
-	return GetFieldVal( fieldName).Length() == 0;
+bool BmMailHeader::IsFieldEmpty( const BmFieldAtom& field) {
+	return GetFieldVal( field).Length() == 0;
 }
 
 /*------------------------------------------------------------------------------*\
@@ -642,12 +1338,11 @@ void BmMailHeader::GetAllFieldValues( BmMsgContext& msgContext) const {
 	GetFieldVal()
 	-	
 \*------------------------------------------------------------------------------*/
-const BmString& BmMailHeader::GetFieldVal( BmString fieldName, uint32 idx) {
-	fieldName.CapitalizeEachWord();
-	if (IsAddressField( fieldName))
-		return mAddrMap[fieldName].AddrString();
+const BmString& BmMailHeader::GetFieldVal( const BmFieldAtom& field, uint32 idx) {
+	if (field.IsAddressField())
+		return mAddrMap[field].AddrString();
 	else
-		return mHeaders.ValueAt(fieldName, idx);
+		return mHeaders.ValueAt(field, idx);
 }
 
 /*------------------------------------------------------------------------------*\
@@ -662,101 +1357,98 @@ void BmMailHeader::GetAllFieldNames(vector<BmString>& fieldNamesVect) const {
 	CountFieldVals()
 	-	
 \*------------------------------------------------------------------------------*/
-uint32 BmMailHeader::CountFieldVals( BmString fieldName) {
-	fieldName.CapitalizeEachWord();
-	return mHeaders.CountValuesFor(fieldName);
+uint32 BmMailHeader::CountFieldVals( const BmFieldAtom& field) {
+	return mHeaders.CountValuesFor(field);
 }
 
 /*------------------------------------------------------------------------------*\
 	AddressFieldContainsAddrSpec()
 		-	
 \*------------------------------------------------------------------------------*/
-bool BmMailHeader::AddressFieldContainsAddrSpec( BmString fieldName, 
+bool BmMailHeader::AddressFieldContainsAddrSpec( const BmFieldAtom& field, 
 																 const BmString addrSpec) {
-	fieldName.CapitalizeEachWord();
-	if (!IsAddressField( fieldName))
+	if (!field.IsAddressField())
 		BM_THROW_RUNTIME( 
 			"BmMailHeader.AddressFieldContainsAddrSpec(): Field is not an "
 			"address-field."
 		);
-	return mAddrMap[fieldName].ContainsAddrSpec( addrSpec);
+	return mAddrMap[field].ContainsAddrSpec( addrSpec);
 }
 
 /*------------------------------------------------------------------------------*\
 	AddressFieldContainsAddress()
 		-	
 \*------------------------------------------------------------------------------*/
-bool BmMailHeader::AddressFieldContainsAddress( BmString fieldName, 
+bool BmMailHeader::AddressFieldContainsAddress( const BmFieldAtom& field, 
 																const BmString& address) {
-	fieldName.CapitalizeEachWord();
-	if (!IsAddressField( fieldName))
+	if (!field.IsAddressField())
 		BM_THROW_RUNTIME( 
 			"BmMailHeader.AddressFieldContainsAddress(): Field is not an "
 			"address-field."
 		);
 	BmAddress addr( address);
-	return mAddrMap[fieldName].ContainsAddrSpec( addr.AddrSpec());
+	return mAddrMap[field].ContainsAddrSpec( addr.AddrSpec());
 }
 
 /*------------------------------------------------------------------------------*\
 	GetAddressList()
 		-	
 \*------------------------------------------------------------------------------*/
-const BmAddressList& BmMailHeader::GetAddressList( BmString fieldName) {
-	fieldName.CapitalizeEachWord();
-	if (!IsAddressField( fieldName))
+const BmAddressList& BmMailHeader::GetAddressList( const BmFieldAtom& field) {
+	if (!field.IsAddressField())
 		BM_THROW_RUNTIME( 
 			"BmMailHeader.GetAddressList(): Field is not an address-field."
 		);
-	return mAddrMap[fieldName];
+	return mAddrMap[field];
 }
 
 /*------------------------------------------------------------------------------*\
 	SetFieldVal()
 	-	
 \*------------------------------------------------------------------------------*/
-void BmMailHeader::SetFieldVal( BmString fieldName, const BmString value) {
-	fieldName.CapitalizeEachWord();
-	BmString strippedVal = IsStrippingOkForField( fieldName)
-									? StripField( value)
-									: value;
-	mHeaders.Set( fieldName, strippedVal);
-	if (IsAddressField( fieldName)) {
-		// field contains an address-spec, we parse the address as well:
-		mAddrMap[fieldName].Set( strippedVal);
-	}
+void BmMailHeader::SetFieldVal( const BmFieldAtom& field, const BmString value) {
+	BmString strippedVal;
+	if (field.IsAddressField()) {
+		// field contains an address-spec, we parse the address and strip 
+		// the value in one go:
+		mAddrMap[field].Set( value, &strippedVal);
+	} else if (field.IsStrippingOk())
+		strippedVal = StripField( value);
+	else
+		strippedVal = value;
+	mHeaders.Set( field, strippedVal);
 }
 
 /*------------------------------------------------------------------------------*\
 	AddFieldVal()
 	-	
 \*------------------------------------------------------------------------------*/
-void BmMailHeader::AddFieldVal( BmString fieldName, const BmString value) {
-	fieldName.CapitalizeEachWord();
-	BmString strippedVal = IsStrippingOkForField( fieldName)
-									? StripField( value)
-									: value;
-	mHeaders.Add( fieldName, strippedVal);
-	if (IsAddressField( fieldName)) {
-		// field contains an address-spec, we parse the address as well:
-		mAddrMap[fieldName].Add( strippedVal);
-	}
+void BmMailHeader::AddFieldVal( const BmFieldAtom& field, const BmString value) {
+	BmString strippedVal;
+	if (field.IsAddressField()) {
+		// field contains an address-spec, we parse the address and strip 
+		// the value in one go:
+		mAddrMap[field].Add( value, &strippedVal);
+	} else if (field.IsStrippingOk())
+		strippedVal = StripField( value);
+	else
+		strippedVal = value;
+	mHeaders.Add( field, strippedVal);
 }
 
 /*------------------------------------------------------------------------------*\
 	RemoveFieldVal()
 	-	
 \*------------------------------------------------------------------------------*/
-void BmMailHeader::RemoveFieldVal( BmString fieldName, const BmString& value)
+void BmMailHeader::RemoveFieldVal( const BmFieldAtom& field, const BmString& value)
 {
-	fieldName.CapitalizeEachWord();
-	BmString strippedVal = IsStrippingOkForField( fieldName)
+	BmString strippedVal = field.IsStrippingOk()
 									? StripField( value)
 									: value;
-	mHeaders.RemoveFieldVal( fieldName, strippedVal);
-	if (IsAddressField( fieldName)) {
+	mHeaders.RemoveFieldVal( field, strippedVal);
+	if (field.IsAddressField()) {
 		// field contains an address-spec, we remove the address as well:
-		mAddrMap[fieldName].Remove( strippedVal);
+		mAddrMap[field].Remove( strippedVal);
 	}
 }
 
@@ -764,21 +1456,19 @@ void BmMailHeader::RemoveFieldVal( BmString fieldName, const BmString& value)
 	RemoveField()
 	-	
 \*------------------------------------------------------------------------------*/
-void BmMailHeader::RemoveField( BmString fieldName) {
-	fieldName.CapitalizeEachWord();
-	mHeaders.Remove( fieldName);
-	mAddrMap.erase( fieldName);
+void BmMailHeader::RemoveField( const BmFieldAtom& field) {
+	mHeaders.Remove( field);
+	mAddrMap.erase( field);
 }
 
 /*------------------------------------------------------------------------------*\
 	RemoveAddrFieldVal()
 	-	
 \*------------------------------------------------------------------------------*/
-void BmMailHeader::RemoveAddrFieldVal(  BmString fieldName, 
+void BmMailHeader::RemoveAddrFieldVal( const BmFieldAtom& field, 
 													 const BmString value) {
-	fieldName.CapitalizeEachWord();
-	if (IsAddressField( fieldName))
-		mAddrMap[fieldName].Remove( value);
+	if (field.IsAddressField())
+		mAddrMap[field].Remove( value);
 }
 
 /*------------------------------------------------------------------------------*\
@@ -786,13 +1476,13 @@ void BmMailHeader::RemoveAddrFieldVal(  BmString fieldName,
 	-	
 \*------------------------------------------------------------------------------*/
 BmAddressList BmMailHeader::DetermineOriginator( bool bypassReplyTo) {
-	BmAddressList addrList = mAddrMap[BM_FIELD_REPLY_TO];
+	BmAddressList addrList = mAddrMap[BM_ATOM_REPLY_TO];
 	if (bypassReplyTo || !addrList.InitOK()) {
-		addrList = mAddrMap[BM_FIELD_MAIL_REPLY_TO];
+		addrList = mAddrMap[BM_ATOM_MAIL_REPLY_TO];
 		if (!addrList.InitOK()) {
-			addrList = mAddrMap[BM_FIELD_FROM];
+			addrList = mAddrMap[BM_ATOM_FROM];
 			if (!addrList.InitOK()) {
-				addrList = mAddrMap[BM_FIELD_SENDER];
+				addrList = mAddrMap[BM_ATOM_SENDER];
 			}
 		}
 	}
@@ -804,9 +1494,9 @@ BmAddressList BmMailHeader::DetermineOriginator( bool bypassReplyTo) {
 		-	
 \*------------------------------------------------------------------------------*/
 BmString BmMailHeader::DetermineSender() {
-	BmAddressList addrList = mAddrMap[BM_FIELD_SENDER];
+	BmAddressList addrList = mAddrMap[BM_ATOM_SENDER];
 	if (!addrList.InitOK()) {
-		addrList = mAddrMap[BM_FIELD_FROM];
+		addrList = mAddrMap[BM_ATOM_FROM];
 		if (!addrList.InitOK()) {
 			BM_LOG( BM_LogMailParse, "Unable to determine sender of mail!");
 			return "";
@@ -817,21 +1507,124 @@ BmString BmMailHeader::DetermineSender() {
 	return addrList.FirstAddress().AddrSpec();
 }
 
+/*------------------------------------------------------------------------------*\
+	SkipSpace( text, pos)
+		-	returns the offset of the first non-whitespace char at or after pos
+\*------------------------------------------------------------------------------*/
+static int32 SkipSpace( const BmStringView& text, int32 pos) {
+	while( pos < text.Length() && isspace( (unsigned char)text[pos]))
+		pos++;
+	return pos;
+}
+
+/*------------------------------------------------------------------------------*\
+	FindMailtoAddress( text, addr)
+		-	finds the first '<mailto:addr>' (as used by List-Post) in the
+			given text and returns the address (without any '?'-parameters)
+\*------------------------------------------------------------------------------*/
+static bool FindMailtoAddress( const BmStringView& text, BmString& addr) {
+	for( int32 pos = 0; (pos = text.FindFirst( '<', pos)) != B_ERROR; ++pos) {
+		int32 start = SkipSpace( text, pos+1);
+		if (text.SubView( start, 7).ICompare( "mailto:") != 0)
+			continue;
+		start += 7;
+		int32 end = start;
+		while( end < text.Length() && text[end] != '?' && text[end] != '>')
+			end++;
+		if (end > start) {
+			text.SubView( start, end-start).CopyInto( addr);
+			return true;
+		}
+	}
+	return false;
+}
+
+/*------------------------------------------------------------------------------*\
+	FindListAddress( text, addr)
+		-	finds the first line of the form 'list addr[;...]' (as used by
+			Mailing-List) in the given text and returns the address
+\*------------------------------------------------------------------------------*/
+static bool FindListAddress( const BmStringView& text, BmString& addr) {
+	for( int32 lineStart = 0; lineStart < text.Length(); ) {
+		int32 start = SkipSpace( text, lineStart);
+		if (text.SubView( start, 4).ICompare( "list") == 0) {
+			start = SkipSpace( text, start+4);
+			int32 end = start;
+			while( end < text.Length() && text[end] != ';'
+			&& !isspace( (unsigned char)text[end]))
+				end++;
+			if (end > start) {
+				text.SubView( start, end-start).CopyInto( addr);
+				return true;
+			}
+		}
+		lineStart = text.FindFirst( '\n', lineStart);
+		if (lineStart == B_ERROR)
+			break;
+		lineStart++;
+	}
+	return false;
+}
+
+/*------------------------------------------------------------------------------*\
+	IsAddrSpecChar( c)
+		-	returns whether the given char may be part of the local-part or 
+			a domain-label of an addr-spec found in a Received-field
+\*------------------------------------------------------------------------------*/
+static inline bool IsAddrSpecChar( char c) {
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') 
+		|| (c >= '0' && c <= '9') || c == '_' || c == '-' || c == '+';
+}
+
+/*------------------------------------------------------------------------------*\
+	FindNextAddrSpec( text, pos, addrSpec)
+		-	finds the next 'local@label[.label]' at or after the given position
+			(only the first two labels of the domain are taken)
+		-	returns the offset behind the addr-spec, or B_ERROR if there are
+			no more
+\*------------------------------------------------------------------------------*/
+static int32 FindNextAddrSpec( const BmStringView& text, int32 pos, 
+										 BmString& addrSpec) {
+	int32 len = text.Length();
+	while( pos < len) {
+		if (!IsAddrSpecChar( text[pos])) {
+			pos++;
+			continue;
+		}
+		int32 start = pos;
+		while( pos < len && IsAddrSpecChar( text[pos]))
+			pos++;
+		if (pos >= len || text[pos] != '@')
+			continue;
+		int32 end = pos+1;
+		while( end < len && IsAddrSpecChar( text[end]))
+			end++;
+		if (end == pos+1)
+			continue;
+		if (end+1 < len && text[end] == '.' && IsAddrSpecChar( text[end+1])) {
+			for( end += 2; end < len && IsAddrSpecChar( text[end]); ++end)
+				;
+		}
+		text.SubView( start, end-start).CopyInto( addrSpec);
+		return end;
+	}
+	return B_ERROR;
+}
+
 /*------------------------------------------------------------------------------*\
 	DetermineListAddress()
 		-	
 \*------------------------------------------------------------------------------*/
 BmAddressList BmMailHeader::DetermineListAddress( bool bypassSanityTest) {
 	BmAddressList listAddr;
-	Regexx rx;
+	BmString addr;
 	// first, we look into the Reply-To-field (if it exists), as this
 	// is required if a list actually redirects replies to another list!
-	listAddr = mAddrMap[BM_FIELD_REPLY_TO];
+	listAddr = mAddrMap[BM_ATOM_REPLY_TO];
 	if (!listAddr.InitOK()) {
 		// now we look into the List-Post-field (if it exists)...
-		if (rx.exec( mHeaders[BM_FIELD_LIST_POST], "<\\s*mailto:([^?>]+)", 
-						 Regexx::nocase | Regexx::newline)) {
-			listAddr.SetTo( rx.match[0].atom[0]);
+		if (FindMailtoAddress( mHeaders[BM_ATOM_LIST_POST], addr)) {
+			listAddr.SetTo( addr);
 			if (listAddr.InitOK())
 				// if an explicit List-Post is present, we want to accept it
 				// even if the list-address is nowhere found in the receiver
@@ -841,16 +1634,14 @@ BmAddressList BmMailHeader::DetermineListAddress( bool bypassSanityTest) {
 	}
 	if (!listAddr.InitOK()) {
 		// ...we try to munge List-Id into a valid address:
-		BmString listId = mAddrMap[BM_FIELD_LIST_ID].FirstAddress().AddrSpec();
+		BmString listId = mAddrMap[BM_ATOM_LIST_ID].FirstAddress().AddrSpec();
 		listId.ReplaceFirst( ".", "@");
 		listAddr.SetTo( listId);
 	}
 	if (!listAddr.InitOK()) {
 		// ...we look in field Mailing-List for the list-address:
-		if (rx.exec( mHeaders[BM_FIELD_MAILING_LIST], "^\\s*list\\s*([^;\\s]+)", 
-						 Regexx::nocase | Regexx::newline)) {
-			listAddr.SetTo( rx.match[0].atom[0]);
-		}
+		if (FindListAddress( mHeaders[BM_ATOM_MAILING_LIST], addr))
+			listAddr.SetTo( addr);
 	}
 	if (!listAddr.InitOK()) {
 		// ...we have a look at some other fields (defined by prefs):
@@ -859,8 +1650,9 @@ BmAddressList BmMailHeader::DetermineListAddress( bool bypassSanityTest) {
 		split( BmPrefs::nListSeparator, lfs, listFields);
 		int32 numFields = listFields.size();
 		for( int i=0; i<numFields; ++i) {
-			if (!IsFieldEmpty( listFields[i])) {
-				listAddr = mAddrMap[listFields[i]];
+			BmFieldAtom listField( listFields[i]);
+			if (!IsFieldEmpty( listField)) {
+				listAddr = mAddrMap[listField];
 				if (listAddr.InitOK())
 					break;
 			}
@@ -873,16 +1665,16 @@ BmAddressList BmMailHeader::DetermineListAddress( bool bypassSanityTest) {
 		// If not, this mail is related to the list, but has not actually been
 		// delivered through this list. This probably means that this mail is
 		// a list-administrative mail (confirmation-requests and the like).
-		if (!(AddressFieldContainsAddrSpec( BM_FIELD_TO, firstAddr.AddrSpec())
-		|| AddressFieldContainsAddrSpec( BM_FIELD_CC, firstAddr.AddrSpec())
-		|| AddressFieldContainsAddrSpec( BM_FIELD_BCC, firstAddr.AddrSpec())
-		|| AddressFieldContainsAddrSpec( BM_FIELD_FROM, firstAddr.AddrSpec())
-		|| AddressFieldContainsAddrSpec( BM_FIELD_REPLY_TO, firstAddr.AddrSpec())
-		|| AddressFieldContainsAddrSpec( BM_FIELD_RESENT_TO, firstAddr.AddrSpec())
-		|| AddressFieldContainsAddrSpec( BM_FIELD_RESENT_CC, firstAddr.AddrSpec())
-		|| AddressFieldContainsAddrSpec( BM_FIELD_RESENT_BCC, 
+		if (!(AddressFieldContainsAddrSpec( BM_ATOM_TO, firstAddr.AddrSpec())
+		|| AddressFieldContainsAddrSpec( BM_ATOM_CC, firstAddr.AddrSpec())
+		|| AddressFieldContainsAddrSpec( BM_ATOM_BCC, firstAddr.AddrSpec())
+		|| AddressFieldContainsAddrSpec( BM_ATOM_FROM, firstAddr.AddrSpec())
+		|| AddressFieldContainsAddrSpec( BM_ATOM_REPLY_TO, firstAddr.AddrSpec())
+		|| AddressFieldContainsAddrSpec( BM_ATOM_RESENT_TO, firstAddr.AddrSpec())
+		|| AddressFieldContainsAddrSpec( BM_ATOM_RESENT_CC, firstAddr.AddrSpec())
+		|| AddressFieldContainsAddrSpec( BM_ATOM_RESENT_BCC, 
 													firstAddr.AddrSpec())
-		|| AddressFieldContainsAddrSpec( BM_FIELD_RESENT_FROM, 
+		|| AddressFieldContainsAddrSpec( BM_ATOM_RESENT_FROM, 
 													firstAddr.AddrSpec())))	{
 			// We do not want to send any replies to administrative mails back to 
 			// the list, so we clear the List-Address:
@@ -908,16 +1700,16 @@ BmMailHeader::DetermineReceivingAddrFor(const BmIdentityVect& identities,
 		BmIdentityVect::const_iterator iter;
 		for (iter = identities.begin(); 
 			iter != identities.end() && !addr.Length(); ++iter) {
-			addr = mAddrMap[BM_FIELD_TO].FindAddressMatchingIdentity( 
+			addr = mAddrMap[BM_ATOM_TO].FindAddressMatchingIdentity( 
 				iter->Get(), needExactMatch
 			);
 			if (!addr.Length()) {
-				addr = mAddrMap[BM_FIELD_CC].FindAddressMatchingIdentity( 
+				addr = mAddrMap[BM_ATOM_CC].FindAddressMatchingIdentity( 
 					iter->Get(), needExactMatch
 				);
 			}
 			if (!addr.Length()) {
-				addr = mAddrMap[BM_FIELD_BCC].FindAddressMatchingIdentity( 
+				addr = mAddrMap[BM_ATOM_BCC].FindAddressMatchingIdentity( 
 					iter->Get(), needExactMatch
 				);
 			}
@@ -931,15 +1723,13 @@ BmMailHeader::DetermineReceivingAddrFor(const BmIdentityVect& identities,
 		// is contained as part of an address field in the header (the usual
 		// case for mailing lists). Let's have a look at the Received headers
 		// and try to find a matching address there:
-		Regexx rx;
-		rx.expr("[-+\\w]+@(?:[-+\\w]+\\.)?(?:[-+\\w]+)");
-		uint32 receivedCount = CountFieldVals(BM_FIELD_RECEIVED);
+		uint32 receivedCount = CountFieldVals(BM_ATOM_RECEIVED);
 		for (uint32 r = 0; r < receivedCount && !addr.Length(); ++r) {
-			BmString receivedVal = GetFieldVal(BM_FIELD_RECEIVED, r);
-			rx.str(receivedVal);
-			int32 matchCount = rx.exec(Regexx::global);
-			for (int32 m = 0; m < matchCount && !addr.Length(); ++m) {
-				BmString mailAddr = rx.match[m];
+			BmStringView receivedVal = GetFieldVal(BM_ATOM_RECEIVED, r);
+			BmString mailAddr;
+			int32 pos = 0;
+			while (!addr.Length() 
+			&& (pos = FindNextAddrSpec(receivedVal, pos, mailAddr)) != B_ERROR) {
 				bool needExactMatch = true;
 				for (int i=0; !addr.Length() && i < 2; ++i) {
 					BmIdentityVect::const_iterator iter;
@@ -966,12 +1756,12 @@ void BmMailHeader::PlugDefaultHeader( const BmMailHeader* defaultHeader)
 {
 	if (!defaultHeader)
 		return;
-	BmHeaderMap::const_iterator iter;
+	BmHeaderFieldVect::const_iterator iter;
 	for(	iter = defaultHeader->mHeaders.begin(); 
 			iter != defaultHeader->mHeaders.end(); ++iter) {
-		uint32 valCount = iter->second.size();
+		uint32 valCount = iter->values.size();
 		for( uint32 v=0; v<valCount; ++v) 
-			AddFieldVal( iter->first, (iter->second)[v]);
+			AddFieldVal( iter->atom, iter->values[v]);
 	}
 }
 
@@ -983,12 +1773,12 @@ void BmMailHeader::UnplugDefaultHeader( const BmMailHeader* defaultHeader)
 {
 	if (!defaultHeader)
 		return;
-	BmHeaderMap::const_iterator iter;
+	BmHeaderFieldVect::const_iterator iter;
 	for(	iter = defaultHeader->mHeaders.begin(); 
 			iter != defaultHeader->mHeaders.end(); ++iter) {
-		uint32 valCount = iter->second.size();
+		uint32 valCount = iter->values.size();
 		for( uint32 v=0; v<valCount; ++v) 
-			RemoveFieldVal( iter->first, (iter->second)[v]);
+			RemoveFieldVal( iter->atom, iter->values[v]);
 	}
 }
 
@@ -1005,6 +1795,44 @@ void BmMailHeader::AddParsingError( const BmString& errStr)
 	}
 }
 
+/*------------------------------------------------------------------------------*\
+	UnfoldFieldBody( fieldBody, unfolded)
+		-	unfolds the given (trimmed) field-body into unfolded, i.e. every
+			run of whitespace that contains a linebreak is replaced by a 
+			single space.
+\*------------------------------------------------------------------------------*/
+static void UnfoldFieldBody( const BmStringView& fieldBody, BmString& unfolded) {
+	if (fieldBody.FindFirst( '\n') == B_ERROR) {
+		// single line field, nothing to unfold:
+		fieldBody.CopyInto( unfolded);
+		return;
+	}
+	const char* data = fieldBody.Data();
+	int32 len = fieldBody.Length();
+	char* buf = unfolded.LockBuffer( len);
+	int32 destLen = 0;
+	for( int32 i=0; i<len; ) {
+		if (!isspace( (unsigned char)data[i])) {
+			buf[destLen++] = data[i++];
+			continue;
+		}
+		int32 wsStart = i;
+		bool hasLinebreak = false;
+		for( ; i<len && isspace( (unsigned char)data[i]); ++i) {
+			if (data[i] == '\r' && i+1<len && data[i+1] == '\n')
+				hasLinebreak = true;
+		}
+		if (hasLinebreak)
+			buf[destLen++] = ' ';
+		else {
+			memcpy( buf+destLen, data+wsStart, i-wsStart);
+			destLen += i-wsStart;
+		}
+	}
+	buf[destLen] = '\0';
+	unfolded.UnlockBuffer( destLen);
+}
+
 /*------------------------------------------------------------------------------*\
 	ParseHeader( header)
 		-	parses mail-header and splits it into fieldname/fieldbody - pairs
@@ -1020,62 +1848,40 @@ void BmMailHeader::AddParsingError( const BmString& errStr)
 			specified in a header-field)
 \*------------------------------------------------------------------------------*/
 void BmMailHeader::ParseHeader( const BmString &header) {
-	Regexx rxUnfold, rx;
-
 	mParsingErrors.Truncate(0);
-	typedef vector< subpart> BmSubpartVect;
-	BmSubpartVect subparts;
-	int32 pos=-1;
-	int32 lastpos = 0;
-	for(  int32 offset=0; 
-			(pos = header.FindFirst( "\r\n", offset)) != B_ERROR;
-			offset = pos+2) {
-		if (pos>lastpos && !isspace(header[pos+2])) {
-			subparts.push_back( subpart( lastpos, pos-lastpos));
-			lastpos = pos+2;
-		}
-	}
-	int32 nm = subparts.size();
-	if (!nm && mMail) {
-		BM_LOGERR ( 
-			BmString("Could not find any header-fields in this header: \n") 
-				<< header
-		);
-	}
 	BM_LOG( BM_LogMailParse, "The mail-header");
 	BM_LOG3( BM_LogMailParse, BmString(header) << "\n------------------");
-	BM_LOG( BM_LogMailParse, BmString("contains ") << nm << " headerfields\n");
 
-	BmSubpartVect::const_iterator i;
-	for( i=subparts.begin(); i!=subparts.end(); ++i) {
+	BmHeaderTokenizer tokenizer( header);
+	BmStringView fieldNameView, fieldBodyView;
+	int32 fieldCount = 0;
+	while( tokenizer.NextField( fieldNameView, fieldBodyView)) {
+		fieldCount++;
 
-		// split each headerfield into field-name and field-body:
+		// each headerfield has been split into field-name and field-body:
 		BmString fieldName, fieldBody;
-		BmString headerField( header.String()+i->pos, i->len);
-		int32 pos = headerField.FindFirst( ':');
-		if (pos == B_ERROR) { 
+		if (fieldNameView.IsEmpty()) { 
 			BmString errStr 
 				= BmString("Could not determine field-name of "
-							  "mail-header-part:\n   ") << headerField 
+							  "mail-header-part:\n   ") << fieldBodyView.ToString()
 						<< "\nThis header-field will be ignored.";
 			AddParsingError( errStr);
 			BM_LOG( BM_LogMailParse, errStr);
 			continue;
 		}
-		fieldName.SetTo( headerField, pos);
-		fieldName.RemoveSet( BM_WHITESPACE.String());
-		headerField.CopyInto( fieldBody, pos+1, headerField.Length());
+		fieldNameView.CopyInto( fieldName);
+		if (strpbrk( fieldName.String(), BM_WHITESPACE.String()))
+			fieldName.RemoveSet( BM_WHITESPACE.String());
 
-		// unfold the field-body and remove leading and trailing whitespace:
-		fieldBody = rxUnfold.replace( fieldBody, "(?:\\s*\\r\\n)+\\s*", " ", 
-												Regexx::global);
-		fieldBody.Trim();
+		// unfold the field-body:
+		UnfoldFieldBody( fieldBodyView, fieldBody);
 
-		// insert pair into header-map:
-		if (IsEncodingOkForField(fieldName)) {
+		// insert pair into header-list (without interning unknown names):
+		BmFieldAtom field = BmFieldAtom::Lookup( fieldName);
+		if (field.IsEncodingOk()) {
 			bool hadConversionError;
 			AddFieldVal( 
-				fieldName, 
+				field, 
 				ConvertHeaderPartToUTF8( 
 					fieldBody, 
 					mMail 
@@ -1091,14 +1897,22 @@ void BmMailHeader::ParseHeader( const BmString &header) {
 				AddParsingError( errStr);
 			}
 		} else {
-			AddFieldVal(fieldName, fieldBody);
+			AddFieldVal(field, fieldBody);
 		}
 
 		BM_LOG2( BM_LogMailParse, fieldName << ": " << fieldBody);
 	}
+	if (!fieldCount && mMail) {
+		BM_LOGERR ( 
+			BmString("Could not find any header-fields in this header: \n") 
+				<< header
+		);
+	}
+	BM_LOG( BM_LogMailParse, BmString("contains ") << fieldCount 
+										<< " headerfields\n");
 
-	if (mAddrMap[BM_FIELD_RESENT_FROM].InitOK() 
-	|| mAddrMap[BM_FIELD_RESENT_SENDER].InitOK())
+	if (mAddrMap[BM_ATOM_RESENT_FROM].InitOK() 
+	|| mAddrMap[BM_ATOM_RESENT_SENDER].InitOK())
 		IsRedirect( true);
 
 	DetermineName();
@@ -1106,113 +1920,49 @@ void BmMailHeader::ParseHeader( const BmString &header) {
 
 /*------------------------------------------------------------------------------*\
 	DetermineName()
-		-	
+		-	headers that do not belong to a mail are treated as inbound
 \*------------------------------------------------------------------------------*/
 void BmMailHeader::DetermineName() {
-	if (mMail) {
-		BmAddressList addrList;
-		// we construct the 'name' for this mail (will go into 
-		// attribute MAIL:name)...
-		if (mMail->Outbound()) {
-			// for outbound mails we fetch the groupname or phrase of the 
-			// first TO-address:
-			addrList = mAddrMap[BM_FIELD_TO];
-			if (!addrList.InitOK()) {
-				addrList = mAddrMap[BM_FIELD_CC];
-				if (!addrList.InitOK())
-					addrList = mAddrMap[BM_FIELD_BCC];
-			}
-		} else {
-			// for inbound mails we fetch the groupname or phrase of the 
-			// first FROM-address:
-			addrList = mAddrMap[BM_FIELD_FROM];
-		}
-		if (addrList.IsGroup()) {
-			mName = addrList.GroupName();
-		} else {
-			BmAddress addr = addrList.FirstAddress();
-			if (addr.HasPhrase())
-				mName = addr.Phrase();
-			else
-				mName = addr.AddrSpec();
+	BmAddressList addrList;
+	// we construct the 'name' for this mail (will go into 
+	// attribute MAIL:name)...
+	if (mMail && mMail->Outbound()) {
+		// for outbound mails we fetch the groupname or phrase of the 
+		// first TO-address:
+		addrList = mAddrMap[BM_ATOM_TO];
+		if (!addrList.InitOK()) {
+			addrList = mAddrMap[BM_ATOM_CC];
+			if (!addrList.InitOK())
+				addrList = mAddrMap[BM_ATOM_BCC];
 		}
+	} else {
+		// for inbound mails we fetch the groupname or phrase of the 
+		// first FROM-address:
+		addrList = mAddrMap[BM_ATOM_FROM];
+	}
+	if (addrList.IsGroup()) {
+		mName = addrList.GroupName();
+	} else {
+		BmAddress addr = addrList.FirstAddress();
+		if (addr.HasPhrase())
+			mName = addr.Phrase();
+		else
+			mName = addr.AddrSpec();
 	}
 }
 
 /*------------------------------------------------------------------------------*\
-	StripField()
-		-	
+	StripField( fieldValue, commentBuffer)
+		-	returns the given field-value without comments (which are
+			collected in the comment-buffer, if given) and with every run of
+			whitespace replaced by a single space
 \*------------------------------------------------------------------------------*/
-BmString BmMailHeader::StripField( BmString fieldValue, 
+BmString BmMailHeader::StripField( const BmString& fieldValue,
 											  BmString* commentBuffer) {
 	BmString stripped;
-	const char* pos = fieldValue.String();
-	const char* endPos;
-	while( *pos) {
-		if (*pos == '"') {
-			// quoted-string started, we search its end:
-			for( 	endPos=pos+1; 
-					*endPos && (*endPos!='"' || *(endPos-1)=='\\'); ++endPos)
-				;
-			if (*endPos) {
-				// found complete quoted-string, we copy it:
-				int32 numChars = 1+endPos-pos;
-				stripped.Append( pos, numChars);
-				pos += numChars;
-			} else {
-				// it seems that there is no ending quote, we assume the remainder
-				// to be part of the quoted string (and add the missing quote):
-				stripped.Append( pos);
-				stripped.Append( "\"");
-				pos = endPos;
-			}
-		} else if (*pos == '(') {
-			// comment started, we search its end:
-			BmString comment;
-			int32 nestLevel=1;
-			for(	endPos=pos+1; 
-					*endPos && (*endPos!=')' || *(endPos-1)=='\\' || --nestLevel); 
-					++endPos) {
-				if (*endPos == '(' && *(endPos-1)!='\\') {
-					// take a note that we found a nested comment:
-					nestLevel++;
-				}
-			}
-			if (*endPos) {
-				// found complete comment, we skip it:
-				int32 numChars = 1+endPos-pos;
-				if (commentBuffer)
-					commentBuffer->Append( pos, numChars);
-				pos += numChars;
-			} else {
-				// it seems that there is no ending paranthesis, so we assume 
-				// that all the remains are part of this incomplete comment. 
-				// We add the missing paranthesis to the comment buffer:
-				if (commentBuffer) {
-					commentBuffer->Append( pos);
-					commentBuffer->Append( ")");
-				}
-				pos = endPos;
-			}
-		} else if (*pos == ' ' || *pos == '\t') {
-			// replace linear whitespace by a single space:
-			for( endPos=pos+1;  *endPos=='\t' || *endPos==' ';  ++endPos)
-				;
-			stripped.Append( " ");
-			pos += endPos-pos;
-		} else {
-			// we copy characters until we find the start of a quoted-string,
-			// whitespace, or a comment:
-			for(  endPos=pos+1; 
-					*endPos && *endPos!='"' && *endPos!='(' && *endPos!='\t' 
-					&& *endPos!=' ';
-					++endPos)
-				;
-			int32 numChars = endPos-pos;
-			stripped.Append( pos, numChars);
-			pos += numChars;
-		}
-	}
+	BmHeaderTokenizer tokenizer( fieldValue);
+	while( tokenizer.NextToken() != BmHeaderTokenizer::BM_TOKEN_END)
+		AppendStrippedToken( tokenizer, stripped, commentBuffer);
 	return stripped;
 }
 
@@ -1229,35 +1979,35 @@ void BmMailHeader::StoreAttributes( BFile& mailFile) {
 	mailFile.WriteAttr( BM_MAIL_ATTR_NAME, B_STRING_TYPE, 0, s.String(), 
 							  s.Length()+1);
 	//
-	s = mAddrMap[BM_FIELD_REPLY_TO].AddrString();
+	s = mAddrMap[BM_ATOM_REPLY_TO].AddrString();
 	mailFile.WriteAttr( BM_MAIL_ATTR_REPLY, B_STRING_TYPE, 0, s.String(), 
 							  s.Length()+1);
 	//
-	s = mAddrMap[BM_FIELD_FROM].AddrString();
+	s = mAddrMap[BM_ATOM_FROM].AddrString();
 	mailFile.WriteAttr( BM_MAIL_ATTR_FROM, B_STRING_TYPE, 0, s.String(), 
 							  s.Length()+1);
 	//
 	mailFile.WriteAttr( BM_MAIL_ATTR_SUBJECT, B_STRING_TYPE, 0, 
-							  mHeaders[BM_FIELD_SUBJECT].String(), 
-							  mHeaders[BM_FIELD_SUBJECT].Length()+1);
+							  mHeaders[BM_ATOM_SUBJECT].String(), 
+							  mHeaders[BM_ATOM_SUBJECT].Length()+1);
 	//
 	mailFile.WriteAttr( BM_MAIL_ATTR_MIME, B_STRING_TYPE, 0, 
-							  mHeaders[BM_FIELD_MIME].String(), 
-							  mHeaders[BM_FIELD_MIME].Length()+1);
+							  mHeaders[BM_ATOM_MIME].String(), 
+							  mHeaders[BM_ATOM_MIME].Length()+1);
 	//
-	s = mAddrMap[BM_FIELD_TO].AddrString();
+	s = mAddrMap[BM_ATOM_TO].AddrString();
 	mailFile.WriteAttr( BM_MAIL_ATTR_TO, B_STRING_TYPE, 0, s.String(), 
 							  s.Length()+1);
 	if (outbound && s.Length())
 		recipients << s << ",";
 	//
-	s = mAddrMap[BM_FIELD_CC].AddrString();
+	s = mAddrMap[BM_ATOM_CC].AddrString();
 	mailFile.WriteAttr( BM_MAIL_ATTR_CC, B_STRING_TYPE, 0, s.String(), 
 							  s.Length()+1);
 	if (outbound) {
 		if (s.Length())
 			recipients << s << ",";
-		s = mAddrMap[BM_FIELD_BCC].AddrString();
+		s = mAddrMap[BM_ATOM_BCC].AddrString();
 		if (s.Length())
 			recipients << s;
 	}
@@ -1268,12 +2018,29 @@ void BmMailHeader::StoreAttributes( BFile& mailFile) {
 		mailFile.WriteAttr( BM_MAIL_ATTR_RECIPIENTS, B_STRING_TYPE, 0, 
 								  recipients.String(), recipients.Length()+1);
 	}
+	//
+	BmString priority = Priority();
+	mailFile.WriteAttr( BM_MAIL_ATTR_PRIORITY, B_STRING_TYPE, 0, 
+							  priority.String(), priority.Length()+1);
+	//
+	time_t t = When( time( NULL));
+	mailFile.WriteAttr( BM_MAIL_ATTR_WHEN, B_TIME_TYPE, 0, &t, sizeof(t));
+}
+
+/*------------------------------------------------------------------------------*\
+	Priority()
+		-	returns the mail's priority as found in the header (the value of 
+			X-Priority, which may carry a comment, as in "2 (High)")
+		-	the value is stored as is in the priority-attribute, use 
+			SimplifyPriority() to reduce it to a single digit
+\*------------------------------------------------------------------------------*/
+BmString BmMailHeader::Priority() const {
 	// we determine the mail's priority, first we look at X-Priority...
-	BmString priority = mHeaders[BM_FIELD_X_PRIORITY];
+	BmString priority = mHeaders[BM_ATOM_X_PRIORITY];
 	// ...if that is not defined we check the Priority field:
 	if (!priority.Length()) {
 		// need to translate from text to number:
-		BmString prio = mHeaders[BM_FIELD_PRIORITY];
+		const BmString& prio = mHeaders[BM_ATOM_PRIORITY];
 		if (!prio.ICompare("Highest")) priority = "1";
 		else if (!prio.ICompare("High")) priority = "2";
 		else if (!prio.ICompare("Normal")) priority = "3";
@@ -1283,15 +2050,22 @@ void BmMailHeader::StoreAttributes( BFile& mailFile) {
 	if (!priority.Length()) {
 		priority = "3";						// we default to normal priority
 	}
-	mailFile.WriteAttr( BM_MAIL_ATTR_PRIORITY, B_STRING_TYPE, 0, 
-							  priority.String(), priority.Length()+1);
+	return priority;
+}
+
+/*------------------------------------------------------------------------------*\
+	When( defaultTime)
+		-	returns the time the mail has been sent (or the given default, if 
+			the header doesn't tell)
+\*------------------------------------------------------------------------------*/
+time_t BmMailHeader::When( time_t defaultTime) const {
 	// if the message was resent, we take the date of the resending operation,
 	// not the original date:
 	time_t t;
-	if (!ParseDateTime( mHeaders[BM_FIELD_RESENT_DATE], t)
-	&& !ParseDateTime( mHeaders[BM_FIELD_DATE], t))
-		time( &t);
-	mailFile.WriteAttr( BM_MAIL_ATTR_WHEN, B_TIME_TYPE, 0, &t, sizeof(t));
+	if (!ParseDateTime( mHeaders[BM_ATOM_RESENT_DATE], t)
+	&& !ParseDateTime( mHeaders[BM_ATOM_DATE], t))
+		t = defaultTime;
+	return t;
 }
 
 /*------------------------------------------------------------------------------*\
@@ -1302,17 +2076,18 @@ bool BmMailHeader::ConstructRawText( BmStringOBuf& msgText,
 												 const BmString& charset) {
 	mParsingErrors.Truncate(0);
 	BmStringOBuf headerIO( 1024, 2.0);
-	if (!mAddrMap[BM_FIELD_TO].InitOK() && !mAddrMap[BM_FIELD_CC].InitOK()) {
-		if (mAddrMap[BM_FIELD_BCC].InitOK()) {
+	if (!mAddrMap[BM_ATOM_TO].InitOK() && !mAddrMap[BM_ATOM_CC].InitOK()) {
+		if (mAddrMap[BM_ATOM_BCC].InitOK()) {
 			// only hidden recipients via use of bcc, we set a dummy-<TO> value:
-			SetFieldVal( BM_FIELD_TO, "Undisclosed-Recipients:;");
+			SetFieldVal( BM_ATOM_TO, "Undisclosed-Recipients:;");
 		}
 	}
 
 	// identify ourselves as creator of this mail message (so people know 
 	// who to blame >:o)
-	BmString agentField = ThePrefs->GetBool( "PreferUserAgentOverX-Mailer", true)
-								? BM_FIELD_USER_AGENT : BM_FIELD_X_MAILER;
+	const BmFieldAtom& agentField 
+		= ThePrefs->GetBool( "PreferUserAgentOverX-Mailer", true)
+			? BM_ATOM_USER_AGENT : BM_ATOM_X_MAILER;
 	if (IsFieldEmpty( agentField)) {
 		BmString ourID = BeamRoster->AppNameWithVersion();
 		SetFieldVal( agentField, ourID.String());
@@ -1342,8 +2117,8 @@ bool BmMailHeader::ConstructRawText( BmStringOBuf& msgText,
 			}
 		}
 		SetFieldVal( mMail->IsRedirect() 
-							? BM_FIELD_RESENT_MESSAGE_ID 
-							: BM_FIELD_MESSAGE_ID, 
+							? BM_ATOM_RESENT_MESSAGE_ID 
+							: BM_ATOM_MESSAGE_ID, 
 						 BmString("<") << TimeToString( time( NULL), "%Y%m%d%H%M%S.")
 						 				  << find_thread(NULL) << "." << ++nCounter 
 						 				  << "@" << domain << ">");
@@ -1352,11 +2127,11 @@ bool BmMailHeader::ConstructRawText( BmStringOBuf& msgText,
 	BmString fieldName;
 	try {
 
-		BmHeaderMap::const_iterator iter;
+		BmHeaderFieldVect::const_iterator iter;
 		if (mMail->IsRedirect()) {
 			// add Resent-fields first (as suggested by [Johnson, section 2.4.2]):
 			for( iter = mHeaders.begin(); iter != mHeaders.end(); ++iter) {
-				fieldName = iter->first;
+				fieldName = iter->atom.Name();
 				BM_LOG2( BM_LogMailParse, 
 							BmString( "ConstructRawText(): dealing with field ") 
 								<< fieldName);
@@ -1364,15 +2139,15 @@ bool BmMailHeader::ConstructRawText( BmStringOBuf& msgText,
 					// just interested in Resent-fields:
 					continue;
 				}
-				if (IsAddressField( fieldName)) {
+				if (iter->atom.IsAddressField()) {
 					headerIO << fieldName << ": ";
-					mAddrMap[fieldName].ConstructRawText( headerIO, charset, 
-																	  fieldName.Length());
+					mAddrMap[iter->atom].ConstructRawText( headerIO, charset, 
+																		fieldName.Length());
 					headerIO << "\r\n";
 				} else {
-					const BmValueList& valueList = iter->second;
+					const BmValueList& valueList = iter->values;
 					int count = valueList.size();
-					bool encodeIfNeeded = IsEncodingOkForField( fieldName);
+					bool encodeIfNeeded = iter->atom.IsEncodingOk();
 					for( int i=0; i<count; ++i) {
 						headerIO << fieldName << ": " 
 								 	<< ConvertUTF8ToHeaderPart( valueList[i], charset, 
@@ -1385,7 +2160,7 @@ bool BmMailHeader::ConstructRawText( BmStringOBuf& msgText,
 		}
 		// add all other fields:
 		for( iter = mHeaders.begin(); iter != mHeaders.end(); ++iter) {
-			fieldName = iter->first;
+			fieldName = iter->atom.Name();
 			BM_LOG2( BM_LogMailParse, 
 						BmString( "ConstructRawText(): dealing with field ") 
 							<< fieldName);
@@ -1398,19 +2173,19 @@ bool BmMailHeader::ConstructRawText( BmStringOBuf& msgText,
 				// do not include Resent-headers again:
 				continue;
 			}
-			if (IsAddressField( fieldName)) {
+			if (iter->atom.IsAddressField()) {
 				headerIO << fieldName << ": ";
-				mAddrMap[fieldName].ConstructRawText( headerIO, charset, 
-																  fieldName.Length());
+				mAddrMap[iter->atom].ConstructRawText( headerIO, charset, 
+																	fieldName.Length());
 				headerIO << "\r\n";
-			} else if (IsIdentificationField( fieldName)) {
+			} else if (iter->atom.IsIdentificationField()) {
 				headerIO << fieldName << ": \r\n " 
-							<< ConvertUTF8ToHeaderPart( iter->second.front(), charset, false, 0)
+							<< ConvertUTF8ToHeaderPart( iter->values.front(), charset, false, 0)
 							<< "\r\n";
 			} else {
-				const BmValueList& valueList = iter->second;
+				const BmValueList& valueList = iter->values;
 				int count = valueList.size();
-				bool encodeIfNeeded = IsEncodingOkForField( fieldName);
+				bool encodeIfNeeded = iter->atom.IsEncodingOk();
 				for( int i=0; i<count; ++i) {
 					headerIO << fieldName << ": " 
 								<< ConvertUTF8ToHeaderPart( valueList[i], charset, 
@@ -19,12 +19,14 @@
 #include "BmIdentity.h"
 #include "BmMemIO.h"
 #include "BmRefManager.h"
+#include "BmStringView.h"
 #include "BmUtil.h"
 
 using std::map;
 using std::vector;
 
 class BFile;
+class BPositionIO;
 class BmMail;
 class BmIdentity;
 
@@ -41,6 +43,140 @@ public:
 		: BM_runtime_error (what_arg) 	{ }
 };
 
+/*------------------------------------------------------------------------------*\
+	BmFieldAtom
+		-	the name of a header-field, interned into a global table of names
+		-	names that only differ in case share the same atom, so field-names
+			can be compared by comparing their atoms
+		-	the properties of a field (whether it contains addresses, etc.) 
+			are determined once, when its name is interned
+		-	Lookup() never interns, names that aren't known yet yield a custom
+			atom, which carries the name itself (such that arbitrary names 
+			found in mail-headers do not make the table grow)
+		-	every atom carries the case-folded hash of its name, so atoms 
+			with different names are told apart by an integer compare, 
+			names are only compared if the hashes collide (this is why atoms
+			are ordered by their hash and not alphabetically)
+\*------------------------------------------------------------------------------*/
+class IMPEXPBMMAILKIT BmFieldAtom {
+
+public:
+	enum {
+		ADDRESS_FIELD			= 1<<0,
+		IDENTIFICATION_FIELD	= 1<<1,
+		NO_ENCODING				= 1<<2,
+		NO_STRIPPING			= 1<<3
+	};
+	struct Entry {
+		int32 id;
+		uint32 foldedHash;
+		uint32 flags;
+		BmString name;
+	};
+
+	// c'tors:
+	BmFieldAtom( const char* fieldName);
+	BmFieldAtom( const BmString& fieldName);
+	explicit BmFieldAtom( const BmStringView& fieldName);
+
+	// static functions:
+	static BmFieldAtom Lookup( const BmStringView& fieldName);
+	static uint32 FoldedHash( const char* name, int32 len);
+
+	inline bool operator== (const BmFieldAtom& a) const	
+													{ return mHash == a.mHash 
+															&& ((mEntry && mEntry == a.mEntry)
+																|| IsSameCustom( a)); }
+	inline bool operator!= (const BmFieldAtom& a) const	
+													{ return !(*this == a); }
+	inline bool operator< (const BmFieldAtom& a) const	
+													{ return mHash != a.mHash 
+															? mHash < a.mHash
+															: IsLessOnCollision( a); }
+
+	// getters:
+	inline int32 Id() const					{ return mEntry ? mEntry->id : -1; }
+	inline uint32 Hash() const				{ return mHash; }
+	inline bool IsCustom() const			{ return !mEntry; }
+	inline const BmString& Name() const	{ return mEntry ? mEntry->name 
+																	 : mCustomName; }
+	inline bool IsAddressField() const	{ return mFlags & ADDRESS_FIELD; }
+	inline bool IsIdentificationField() const
+													{ return mFlags & IDENTIFICATION_FIELD; }
+	inline bool IsEncodingOk() const		{ return !(mFlags & NO_ENCODING); }
+	inline bool IsStrippingOk() const	{ return !(mFlags & NO_STRIPPING); }
+
+private:
+	BmFieldAtom() 								{}
+	bool IsSameCustom( const BmFieldAtom& a) const;
+	bool IsLessOnCollision( const BmFieldAtom& a) const;
+
+	const Entry* mEntry;
+							// the entry in the global table, never freed 
+							// (NULL for custom atoms)
+	uint32 mHash;
+							// copy of the entry's folded hash
+	uint32 mFlags;
+							// copy of the entry's flags
+	BmString mCustomName;
+							// the (capitalized) name of a custom atom
+};
+
+/*------------------------------------------------------------------------------*\
+	BmHeaderTokenizer
+		-	a single-pass scanner for mail-headers as described in RFC 5322
+		-	NextField() splits a header into its fields, NextToken() splits 
+			the body of a structured field into tokens
+		-	folding whitespace, (nested) comments, quoted-strings (with 
+			quoted-pairs) and domain-literals are recognized, an unterminated
+			one extends to the end of the text
+		-	tokens are views into the scanned text, nothing is copied
+\*------------------------------------------------------------------------------*/
+class IMPEXPBMMAILKIT BmHeaderTokenizer {
+
+public:
+	enum TokenType {
+		BM_TOKEN_END = 0,
+		BM_TOKEN_SPACE,
+		BM_TOKEN_COMMENT,
+		BM_TOKEN_QUOTED_STRING,
+		BM_TOKEN_DOMAIN_LITERAL,
+		BM_TOKEN_ATOM,
+		BM_TOKEN_SPECIAL
+	};
+
+	BmHeaderTokenizer( const BmStringView& text);
+
+	// native methods:
+	bool NextField( BmStringView& fieldName, BmStringView& fieldBody);
+							// fieldName is empty if the field has no colon,
+							// fieldBody then contains the complete field
+	TokenType NextToken();
+	void UnquoteToken( BmString& into) const;
+							// appends the contents of the current quoted-string
+							// or comment (with quoted-pairs resolved)
+
+	// getters:
+	inline const BmStringView& Token() const
+													{ return mToken; }
+	inline TokenType Type() const			{ return mType; }
+	inline bool IsSpecial( char c) const	
+													{ return mType == BM_TOKEN_SPECIAL 
+															&& mToken[0] == c; }
+	inline bool IsTerminated() const		{ return mTerminated; }
+							// false for an unterminated quoted-string, 
+							// comment or domain-literal
+
+private:
+	int32 SkipDelimited( int32 pos, char opening, char closing);
+
+	BmStringView mText;
+	int32 mPos;
+	BmStringView mToken;
+	TokenType mType;
+	bool mTerminated;
+};
+
 /*------------------------------------------------------------------------------*\
 	BmAddress
 		-	represents a single mail-addresses (parsed and split into 
@@ -78,6 +214,7 @@ public:
 	static BmString QuotedPhrase(const BmString& phrase);
 
 private:
+	friend class BmAddressParser;
 
 	bool mInitOK;
 	BmString mPhrase;
@@ -97,16 +234,17 @@ class IMPEXPBMMAILKIT BmAddressList {
 public:
 	// c'tors and d'tor:
 	BmAddressList();
-	BmAddressList( BmString strippedFieldVal);
+	BmAddressList( const BmString& fieldVal);
 	~BmAddressList();
 
 	// native methods:
-	inline bool SetTo( BmString strippedFieldVal) 
-													{ return Set(strippedFieldVal); }
-	bool Set( BmString strippedFieldVal);
-	bool Add( BmString strippedFieldVal);
+	inline bool SetTo( const BmString& fieldVal) 
+													{ return Set( fieldVal); }
+	bool Set( const BmString& fieldVal, BmString* strippedVal=NULL);
+	bool Add( const BmString& fieldVal, BmString* strippedVal=NULL);
+							// strippedVal receives the field-value without 
+							// comments (as StripField() would produce it)
 	void Remove( BmString singleAddress);
-	BmStringList SplitIntoAddresses( BmString addrList);
 	void ConstructRawText( BmStringOBuf& header, const BmString& charset, 
 								  int32 fieldNameLength) const;
 	const BmString& FindAddressMatchingIdentity(BmIdentity* ident,
@@ -151,50 +289,64 @@ class IMPEXPBMMAILKIT BmMailHeader : public BmRefObj {
 
 public:
 	typedef vector< BmString> BmValueList;
-	typedef map< BmString, BmValueList> BmHeaderMap;
+	struct BmHeaderField {
+		BmHeaderField( const BmFieldAtom& a) : atom( a) {}
+		BmFieldAtom atom;
+		BmValueList values;
+	};
+	typedef vector< BmHeaderField> BmHeaderFieldVect;
 
 private:
 	class IMPEXPBMMAILKIT BmHeaderList {
 	public:
-		void Set( const BmString& fieldName, const BmString content);
-		void Add( const BmString& fieldName, const BmString content);
-		void Remove( const BmString& fieldName);
-		void RemoveFieldVal( const BmString& fieldName, const BmString& val);
-		BmHeaderMap::const_iterator begin() const 
-													{ return mHeaders.begin(); }
-		BmHeaderMap::const_iterator end() const	
-													{ return mHeaders.end(); }
-		uint32 CountValuesFor(const BmString& fieldName) const;
-		const BmString& ValueAt(const BmString& fieldName, uint32 idx) const;
-		const BmString& operator [] (const BmString& fieldName) const;
+		void Set( const BmFieldAtom& field, const BmString content);
+		void Add( const BmFieldAtom& field, const BmString content);
+		void Remove( const BmFieldAtom& field);
+		void RemoveFieldVal( const BmFieldAtom& field, const BmString& val);
+		BmHeaderFieldVect::const_iterator begin() const 
+													{ return mFields.begin(); }
+		BmHeaderFieldVect::const_iterator end() const	
+													{ return mFields.end(); }
+		uint32 CountValuesFor( const BmFieldAtom& field) const;
+		const BmString& ValueAt( const BmFieldAtom& field, uint32 idx) const;
+		const BmString& operator [] ( const BmFieldAtom& field) const;
 		void GetAllValues( BmMsgContext& msgContext) const;
 		void GetAllNames(vector<BmString>& fieldNamesVect) const;
 
 	private:
-		BmHeaderMap mHeaders;
+		typedef map< BmFieldAtom, int32> BmIndexMap;
+
+		int32 IndexOf( const BmFieldAtom& field) const;
+		BmValueList& ValuesFor( const BmFieldAtom& field);
+		void ShiftIndices( int32 fromIdx, int32 delta);
+
+		BmHeaderFieldVect mFields;
+							// the fields sorted by name, each with all its values
+		BmIndexMap mIndexMap;
+							// maps each field's atom to its index in mFields
 	};
 
-	typedef map< BmString, BmAddressList> BmAddrMap;
+	typedef map< BmFieldAtom, BmAddressList> BmAddrMap;
 	
 public:
-	// c'tors and d'tor:
+	// creator-func, c'tors and d'tor:
+	static BmRef<BmMailHeader> CreateForAttributes( const BmString& headerText);
 	BmMailHeader( const BmString &headerText, BmMail* mail);
 	~BmMailHeader();
 
 	// native methods:
 	void StoreAttributes( BFile& mailFile);
 	//	these take UTF8 as input:
-	void SetFieldVal( BmString fieldName, const BmString value);
-	void AddFieldVal( BmString fieldName, const BmString value);
-	void RemoveField( BmString fieldName);
-	void RemoveFieldVal( const BmString fieldName,
-								const BmString& val);
-	void RemoveAddrFieldVal( BmString fieldName, const BmString address);
-	const BmAddressList& GetAddressList( BmString fieldName);
-	bool IsFieldEmpty( BmString fieldName);
-	bool AddressFieldContainsAddrSpec( BmString fieldName, 
+	void SetFieldVal( const BmFieldAtom& field, const BmString value);
+	void AddFieldVal( const BmFieldAtom& field, const BmString value);
+	void RemoveField( const BmFieldAtom& field);
+	void RemoveFieldVal( const BmFieldAtom& field, const BmString& val);
+	void RemoveAddrFieldVal( const BmFieldAtom& field, const BmString address);
+	const BmAddressList& GetAddressList( const BmFieldAtom& field);
+	bool IsFieldEmpty( const BmFieldAtom& field);
+	bool AddressFieldContainsAddrSpec( const BmFieldAtom& field, 
 												  const BmString addrSpec);
-	bool AddressFieldContainsAddress( BmString fieldName, 
+	bool AddressFieldContainsAddress( const BmFieldAtom& field, 
 												 const BmString& address);
 	//
 	BmString DetermineSender();
@@ -209,9 +361,11 @@ public:
 	bool ConstructRawText( BmStringOBuf& header, const BmString& charset);
 	//
 	void GetAllFieldValues( BmMsgContext& msgContext) const;
-	const BmString& GetFieldVal( BmString fieldName, uint32 idx=0);
-	uint32 CountFieldVals( BmString fieldName);
+	const BmString& GetFieldVal( const BmFieldAtom& field, uint32 idx=0);
+	uint32 CountFieldVals( const BmFieldAtom& field);
 	void GetAllFieldNames(vector<BmString>& fieldNamesVect) const;
+	BmString Priority() const;
+	time_t When( time_t defaultTime) const;
 
 	// overrides of BmRefObj
 	const BmString& RefName() const		{ return mKey; }
@@ -233,15 +387,20 @@ public:
 	inline void IsRedirect( bool b)		{ mIsRedirect = b; }
 
 	// class-functions:
-	static bool IsAddressField( const BmString fieldName);
-	static bool IsIdentificationField( const BmString fieldName);
-	static bool IsEncodingOkForField( const BmString fieldName);
-	static bool IsStrippingOkForField( const BmString fieldName);
+	static bool IsAddressField( const BmFieldAtom& field);
+	static bool IsIdentificationField( const BmFieldAtom& field);
+	static bool IsEncodingOkForField( const BmFieldAtom& field);
+	static bool IsStrippingOkForField( const BmFieldAtom& field);
+	static status_t ReadHeaderBlock( BPositionIO& mailFile, 
+												BmString& headerText,
+												int32* rawLengthOut = NULL);
+	static BmString StripField( const BmString& fieldValue, 
+										BmString* commentBuffer=NULL);
+	static BmString SimplifyPriority( const BmString& priority);
 
 protected:
 	void ParseHeader( const BmString &header);
 	BmString ParseHeaderField( BmString fieldName, BmString fieldValue);
-	BmString StripField( BmString fieldValue, BmString* commentBuffer=NULL);
 	void DetermineName();
 
 private:
@@ -15,6 +15,7 @@
 #include "BmLogHandler.h"
 #include "BmMail.h"
 #include "BmMailFolderList.h"
+#include "BmMailHeader.h"
 #include "BmMailMonitor.h"
 #include "BmMailRef.h"
 #include "BmMailRefList.h"
@@ -356,9 +357,14 @@ bool BmMailRef::ReadAttributes( const struct stat* statInfo,
 		BmString priority;
 		BmReadStringAttr( &node, BM_MAIL_ATTR_PRIORITY, priority);
 
-		time_t when;
-		node.ReadAttr( BM_MAIL_ATTR_WHEN, B_TIME_TYPE, 0, 
-							&when, sizeof(time_t));
+		time_t when = 0;
+		if (node.ReadAttr( BM_MAIL_ATTR_WHEN, B_TIME_TYPE, 0, 
+								 &when, sizeof(time_t)) != sizeof(time_t)) {
+			// the mail has never been given any attributes (it has been 
+			// written by some other program), so we fetch the values from 
+			// its header instead:
+			ReadHeaderFields( st, priority, when, updFlags);
+		}
 		if (when != mWhen) {
 			mWhen = when;
 			updFlags |= UPD_WHEN;
@@ -411,25 +417,7 @@ bool BmMailRef::ReadAttributes( const struct stat* statInfo,
 			updFlags |= UPD_WHEN_CREATED;
 		}
 
-		// simplify priority:
-		if (!priority.Length()) {
-			priority = "3";				// normal priority
-		} else {
-			if (isdigit(priority[0]))
-				priority.Truncate(1);
-			else {
-				if (priority.IFindFirst("Highest") != B_ERROR)
-					priority = "1";
-				else if (priority.IFindFirst("High") != B_ERROR)
-					priority = "2";
-				else if (priority.IFindFirst("Lowest") != B_ERROR)
-					priority = "5";
-				else if (priority.IFindFirst("Low") != B_ERROR)
-					priority = "4";
-				else
-					priority = "3";
-			}
-		}
+		priority = BmMailHeader::SimplifyPriority( priority);
 		if (priority != mPriority) {
 			mPriority = priority;
 			updFlags |= UPD_PRIORITY;
@@ -469,6 +457,60 @@ bool BmMailRef::ReadAttributes( const struct stat* statInfo,
 	return err == B_OK;
 }
 
+/*------------------------------------------------------------------------------*\
+	UpdateString( str, newStr, flag, updFlags)
+		-	
+\*------------------------------------------------------------------------------*/
+static void UpdateString( BmString& str, const BmString& newStr, 
+								  BmUpdFlags flag, BmUpdFlags& updFlags) {
+	if (str != newStr) {
+		str = newStr;
+		updFlags |= flag;
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	ReadHeaderFields()
+		-	fetches the values of the header-based attributes from the 
+			mail-file itself (for mails that lack these attributes)
+		-	only the header-block is read from the file and only those fields
+			that make up the attributes are parsed, so this is much cheaper 
+			than reading the whole mail
+		-	the values are not written back as attributes, since the 
+			resulting node-monitor events would make us read the mail again
+			(the mail-ref list caches the values anyway)
+\*------------------------------------------------------------------------------*/
+bool BmMailRef::ReadHeaderFields( const struct stat& st, BmString& priority,
+											 time_t& when, BmUpdFlags& updFlags) {
+	BFile mailFile( &mEntryRef, B_READ_ONLY);
+	BmString headerText;
+	status_t err = mailFile.InitCheck();
+	if (err == B_OK)
+		err = BmMailHeader::ReadHeaderBlock( mailFile, headerText);
+	if (err != B_OK) {
+		BM_LOG2(
+			BM_LogMailTracking, 
+			BmString("Could not read header of mail-ref <") 
+				<< mEntryRef.name << "> \n\nError:" << strerror(err)
+		);
+		return false;
+	}
+	BmRef<BmMailHeader> header 
+		= BmMailHeader::CreateForAttributes( headerText);
+	UpdateString( mName, header->Name(), UPD_NAME, updFlags);
+	UpdateString( mCc, header->GetFieldVal( BM_ATOM_CC), UPD_CC, updFlags);
+	UpdateString( mFrom, header->GetFieldVal( BM_ATOM_FROM), UPD_FROM, 
+					  updFlags);
+	UpdateString( mReplyTo, header->GetFieldVal( BM_ATOM_REPLY_TO), 
+					  UPD_REPLYTO, updFlags);
+	UpdateString( mSubject, header->GetFieldVal( BM_ATOM_SUBJECT), 
+					  UPD_SUBJECT, updFlags);
+	UpdateString( mTo, header->GetFieldVal( BM_ATOM_TO), UPD_TO, updFlags);
+	priority = header->Priority();
+	when = header->When( st.st_mtime);
+	return true;
+}
+
 /*------------------------------------------------------------------------------*\
 	ResyncFromDisk()
 		-	
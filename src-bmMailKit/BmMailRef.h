@@ -153,6 +153,8 @@ protected:
 
 private:
 	void MarkAsSpamOrTofu(bool asSpam);
+	bool ReadHeaderFields( const struct stat& st, BmString& priority,
+								  time_t& when, BmUpdFlags& updFlags);
 
 	// the following members will be archived as part of BmFolderList:
 	entry_ref mEntryRef;
@@ -6,6 +6,7 @@
  *		Oliver Tappe <beam@hirschkaefer.de>
  */
 #include <stdio.h>
+#include <string.h>
 #include <ctime>
 #include <parsedate.h>
 
@@ -172,12 +173,231 @@ BmString TimeToSwatchString( time_t utc, const char* format) {
 	return timeStr;
 }
 
+static inline bool IsAsciiAlpha( char c) {
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+/*------------------------------------------------------------------------------*\
+	SkipCFWS( pos, end)
+		-	skips any whitespace and (possibly nested) comments
+		-	returns NULL if a comment is not closed
+\*------------------------------------------------------------------------------*/
+static const char* SkipCFWS( const char* pos, const char* end) {
+	while( pos < end) {
+		if (*pos == ' ' || *pos == '\t' || *pos == '\r' || *pos == '\n')
+			pos++;
+		else if (*pos == '(') {
+			int32 nestLevel = 1;
+			for( pos++; nestLevel && pos < end; ++pos) {
+				if (*pos == '\\' && pos+1 < end)
+					pos++;
+				else if (*pos == '(')
+					nestLevel++;
+				else if (*pos == ')')
+					nestLevel--;
+			}
+			if (nestLevel)
+				return NULL;
+		} else
+			break;
+	}
+	return pos;
+}
+
+/*------------------------------------------------------------------------------*\
+	ParseNumber( pos, end, minDigits, maxDigits, number)
+		-	parses a decimal number of the given number of digits
+		-	returns the position behind the number or NULL if there is none
+\*------------------------------------------------------------------------------*/
+static const char* ParseNumber( const char* pos, const char* end, 
+										  int32 minDigits, int32 maxDigits, 
+										  int32& number) {
+	number = 0;
+	int32 digits = 0;
+	for( ; pos < end && *pos >= '0' && *pos <= '9'; ++pos, ++digits) {
+		if (digits == maxDigits)
+			return NULL;
+		number = number*10 + *pos - '0';
+	}
+	return digits >= minDigits ? pos : NULL;
+}
+
+/*------------------------------------------------------------------------------*\
+	FindName( word, len, names)
+		-	looks up the given word (case-insensitively) in the given list of 
+			names, each of which may be abbreviated to its first three chars
+		-	returns the index of the name found or -1
+\*------------------------------------------------------------------------------*/
+static int32 FindName( const char* word, int32 len, const char* names[]) {
+	for( int32 i=0; names[i]; ++i) {
+		int32 nameLen = strlen( names[i]);
+		if (len != 3 && len != nameLen)
+			continue;
+		if (!strncasecmp( word, names[i], len))
+			return i;
+	}
+	return -1;
+}
+
+static const char* BmWeekdayNames[] = {
+	"Monday", "Tuesday", "Wednesday", "Thursday", "Friday", "Saturday", 
+	"Sunday", NULL
+};
+static const char* BmMonthNames[] = {
+	"January", "February", "March", "April", "May", "June", "July", 
+	"August", "September", "October", "November", "December", NULL
+};
+
+/*------------------------------------------------------------------------------*\
+	FindZoneOffset( word, len, offset)
+		-	determines the offset (in minutes) of the given textual timezone
+		-	only the unambiguous zones of RFC 822 are known, anything else
+			is left to parsedate()
+\*------------------------------------------------------------------------------*/
+static bool FindZoneOffset( const char* word, int32 len, int32& offset) {
+	static const struct {
+		const char* name;
+		int32 offset;
+	} zones[] = {
+		{ "UT", 0 }, { "GMT", 0 }, { "UTC", 0 }, { "Z", 0 },
+		{ "EST", -5*60 }, { "EDT", -4*60 }, { "CST", -6*60 }, { "CDT", -5*60 },
+		{ "MST", -7*60 }, { "MDT", -6*60 }, { "PST", -8*60 }, { "PDT", -7*60 },
+		{ NULL, 0 }
+	};
+	for( int32 i=0; zones[i].name; ++i) {
+		if ((int32)strlen( zones[i].name) == len 
+		&& !strncasecmp( word, zones[i].name, len)) {
+			offset = zones[i].offset;
+			return true;
+		}
+	}
+	return false;
+}
+
+/*------------------------------------------------------------------------------*\
+	ParseRfc822DateTime( str, len, dateTime)
+		-	parses the given string as a date-time as specified by RFC 5322
+			(including the obsolete syntax of RFC 822), i.e. something like
+			'[Sat,] 17 Oct 2026 12:11:10 +0200'
+		-	comments are skipped and any textual timezone following a numerical
+			one (as generated by BeMail) is ignored
+		-	returns false for anything else (which then has to be handled by 
+			parsedate()), notably for dates without any timezone, as those are 
+			meant to be local time
+		-	neither allocates memory nor touches any global state
+\*------------------------------------------------------------------------------*/
+bool ParseRfc822DateTime( const char* str, int32 len, time_t& dateTime) {
+	if (!str)
+		return false;
+	const char* end = str + len;
+	const char* pos = SkipCFWS( str, end);
+	if (!pos || pos == end)
+		return false;
+	// optional day-of-week:
+	const char* word = pos;
+	while( pos < end && IsAsciiAlpha( *pos))
+		pos++;
+	if (pos > word) {
+		if (FindName( word, pos-word, BmWeekdayNames) < 0)
+			return false;
+		if (!(pos = SkipCFWS( pos, end)))
+			return false;
+		if (pos < end && *pos == ',')
+			pos++;
+		if (!(pos = SkipCFWS( pos, end)))
+			return false;
+	}
+	// day month year:
+	int32 day, month, year;
+	if (!(pos = ParseNumber( pos, end, 1, 2, day)) 
+	|| !(pos = SkipCFWS( pos, end)))
+		return false;
+	word = pos;
+	while( pos < end && IsAsciiAlpha( *pos))
+		pos++;
+	if ((month = FindName( word, pos-word, BmMonthNames)) < 0
+	|| !(pos = SkipCFWS( pos, end))
+	|| !(word = ParseNumber( pos, end, 2, 4, year)))
+		return false;
+	if (word - pos == 2)
+		year += year < 50 ? 2000 : 1900;
+	else if (word - pos == 3)
+		year += 1900;
+	// hour:minute[:second]:
+	int32 hour, minute, second = 0;
+	if (!(pos = SkipCFWS( word, end))
+	|| !(pos = ParseNumber( pos, end, 1, 2, hour)) 
+	|| !(pos = SkipCFWS( pos, end)) || pos == end || *pos++ != ':'
+	|| !(pos = SkipCFWS( pos, end))
+	|| !(pos = ParseNumber( pos, end, 2, 2, minute))
+	|| !(pos = SkipCFWS( pos, end)))
+		return false;
+	if (pos < end && *pos == ':') {
+		if (!(pos = SkipCFWS( pos+1, end))
+		|| !(pos = ParseNumber( pos, end, 2, 2, second))
+		|| !(pos = SkipCFWS( pos, end)))
+			return false;
+	}
+	// timezone:
+	int32 zoneOffset;
+	if (pos < end && (*pos == '+' || *pos == '-')) {
+		int32 zone;
+		bool isNegative = *pos == '-';
+		if (!(word = ParseNumber( pos+1, end, 4, 4, zone)) 
+		|| zone % 100 > 59)
+			return false;
+		zoneOffset = (zone / 100) * 60 + zone % 100;
+		if (isNegative)
+			zoneOffset = -zoneOffset;
+		// skip any redundant textual timezone, with or without comments:
+		for( pos = word; (pos = SkipCFWS( pos, end)) && pos < end; ) {
+			if (!IsAsciiAlpha( *pos))
+				return false;
+			while( pos < end && IsAsciiAlpha( *pos))
+				pos++;
+		}
+		if (!pos)
+			return false;
+	} else {
+		word = pos;
+		while( pos < end && IsAsciiAlpha( *pos))
+			pos++;
+		if (!FindZoneOffset( word, pos-word, zoneOffset)
+		|| !(pos = SkipCFWS( pos, end)) || pos != end)
+			return false;
+	}
+	// check ranges:
+	static const int32 daysInMonth[] = {
+		31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31
+	};
+	bool isLeapYear = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+	if (year < 1970 || day < 1 || day > daysInMonth[month]
+	|| (month == 1 && day == 29 && !isLeapYear)
+	|| hour > 23 || minute > 59 || second > 60)
+		return false;
+	// compute the days since the epoch (by counting years from march on,
+	// such that the leap-day is the last day of each year):
+	int32 y = month < 2 ? year-1 : year;
+	int32 m = month < 2 ? month+10 : month-2;
+	int64 days = 365*(int64)y + y/4 - y/100 + y/400 + (153*m + 2)/5 + day-1
+					 - 719468;
+	int64 seconds = days*86400 + hour*3600 + minute*60 + second 
+						 - zoneOffset*60;
+	dateTime = (time_t)seconds;
+	// refuse whatever doesn't fit into a time_t (or would look like an error):
+	return seconds >= 0 && (int64)dateTime == seconds;
+}
+
 /*------------------------------------------------------------------------------*\
 	ParseDateTime()
 		-	parses the given string for a legal date
+		-	the common case of an RFC-compliant date is handled by 
+			ParseRfc822DateTime(), parsedate() is only used for anything else
 \*------------------------------------------------------------------------------*/
 bool ParseDateTime( const BmString& str, time_t& dateTime) {
 	if (!str.Length()) return false;
+	if (ParseRfc822DateTime( str.String(), str.Length(), dateTime))
+		return true;
 	// some mail-clients (notably BeMail!) generate date-formats with doubled
 	// time-zone information which confuses parsedate().
 	// N.B. Some other mailers enclose the same textual representation in
@@ -44,6 +44,8 @@ IMPEXPBMMAILKIT BmString BytesToString( int32 bytes, bool mini=false);
 	time-related utility functions
 \*------------------------------------------------------------------------------*/
 IMPEXPBMMAILKIT BmString TimeToSwatchString( time_t t, const char* format);
+IMPEXPBMMAILKIT bool ParseRfc822DateTime( const char* str, int32 len, 
+															time_t& dateTime);
 IMPEXPBMMAILKIT bool ParseDateTime( const BmString& str, time_t& dateTime);
 
 /*------------------------------------------------------------------------------*\
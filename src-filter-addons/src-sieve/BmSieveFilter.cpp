@@ -541,8 +541,12 @@ int BmSieveFilter::sieve_get_header( void* message_context, const char* header,
 		} else {
 			if (!msgContext->headerInfos)
 				msgContext->mail->Header()->GetAllFieldValues( *msgContext);
+			uint32 fieldHash 
+				= BmFieldAtom::FoldedHash( header, headerName.Length());
 			for( int i=0; i<msgContext->headerInfoCount; ++i) {
-				if (!msgContext->headerInfos[i].fieldName.ICompare( header)) {
+				const BmHeaderInfo& info = msgContext->headerInfos[i];
+				if (info.fieldHash == fieldHash 
+				&& headerName.ICompare( info.fieldName) == 0) {
 					*contentsPtr = msgContext->headerInfos[i].values;
 					for( int v=0; msgContext->headerInfos[i].values[v]; ++v) {
 						BM_LOG3( BM_LogFilter, 
@@ -40,6 +40,8 @@
 
 const char* FILTER_SPAM 			= "Spam";
 
+static const BmFieldAtom BM_ATOM_RETURN_PATH( "Return-Path");
+
 extern "C"
 BmFilterAddon* InstantiateFilter( const BmString& name, 
 											 const BMessage* archive,
@@ -70,7 +72,7 @@ extern "C" {
 //     per second (using as text the full 2.4.9 linux kernel source)
 //     hashing individual whitespace-delimited tokens, on a Transmeta
 //     666 MHz.
-unsigned long strnhash (char *str, long len)
+unsigned long strnhash (const char *str, long len)
 {
   long i;
   // unsigned long hval;
@@ -198,10 +200,10 @@ void BmSpamFilter::OsbfClassifier::SpamRelevantMailtextSelector
 {
 	// filter MDNs and replace them with the original mail, as this is
 	// what the SPAM-filter should deal with:
-	BmString from = mMail->GetFieldVal(BM_FIELD_FROM);
+	BmString from = mMail->GetFieldVal(BM_ATOM_FROM);
 	if ((from.IFindFirst("Mailer-Daemon") >= 0 
 		|| from.IFindFirst("Postmaster") >= 0)
-	&& mMail->GetFieldVal("Return-Path") == "<>") {
+	&& mMail->GetFieldVal(BM_ATOM_RETURN_PATH) == "<>") {
 		// mail is a MDN, we try to find the original mail as an attachment:
 		struct OriginalMailCollector : public BmListModelItem::Collector {
 			virtual ~OriginalMailCollector()	{}
@@ -415,7 +417,7 @@ BmSpamFilter::OsbfClassifier
 		-	
 \*------------------------------------------------------------------------------*/
 status_t BmSpamFilter::OsbfClassifier
-::FeatureLearner::operator()( char* buf, uint32 bufLen)
+::FeatureLearner::operator()( const char* buf, uint32 bufLen)
 {
 	if (!buf || !bufLen || !mHeader->buckets) {
 		mStatus = B_BAD_VALUE;
@@ -638,7 +640,7 @@ BmSpamFilter::OsbfClassifier
 		-	
 \*------------------------------------------------------------------------------*/
 status_t BmSpamFilter::OsbfClassifier
-::FeatureClassifier::operator()( char* buf, uint32 bufLen)
+::FeatureClassifier::operator()( const char* buf, uint32 bufLen)
 {
 	if (!buf || !bufLen || !mHeader[0]->buckets || !mHeader[1]->buckets) {
 		mStatus = B_BAD_VALUE;
@@ -1974,7 +1976,7 @@ BmSpamFilter::Execute( BmMsgContext* msgContext, const BMessage* _jobSpecs)
 				bool isFromKnownAddress = false;
 				if (D.mProtectKnownAddrs && BeamGuiRoster) {
 					const BmAddressList& fromAddrList
-						= msgContext->mail->Header()->GetAddressList(BM_FIELD_FROM);
+						= msgContext->mail->Header()->GetAddressList(BM_ATOM_FROM);
 					BmAddress fromAddr = fromAddrList.FirstAddress();
 					isFromKnownAddress 
 						= BeamGuiRoster->IsEmailKnown(fromAddr.AddrSpec());
@@ -197,7 +197,7 @@ class BmSpamFilter : public BmFilterAddon {
 			FeatureLearner( FeatureBucket* hash, Header* header, bool revert);
 			~FeatureLearner();
 
-			status_t operator() (char* buf, uint32 bufLen);
+			status_t operator() (const char* buf, uint32 bufLen);
 
 			void Finalize();
 
@@ -220,7 +220,7 @@ class BmSpamFilter : public BmFilterAddon {
 									 FeatureBucket* tofuHash, Header* tofuHeader);
 			~FeatureClassifier();
 
-			status_t operator() (char* buf, uint32 bufLen);
+			status_t operator() (const char* buf, uint32 bufLen);
 			
 			void Finalize();
 
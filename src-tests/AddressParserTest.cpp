@@ -0,0 +1,654 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+/*
+ * Beam's test-application is based on the OpenBeOS testing framework
+ * (which in turn is based on cppunit). Big thanks to everyone involved!
+ *
+ */
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+#include "regexx.hh"
+using namespace regexx;
+
+#include "AddressParserTest.h"
+#include "TestBeam.h"
+
+#include "BmMailHeader.h"
+#include "BmStringView.h"
+
+// setUp
+void
+AddressParserTest::setUp()
+{
+	inherited::setUp();
+}
+
+// tearDown
+void
+AddressParserTest::tearDown()
+{
+	inherited::tearDown();
+}
+
+/********************************************************************************\
+	the way mail-headers used to be parsed (with Regexx), kept here as a
+	reference for the tokenizer
+\********************************************************************************/
+
+/*------------------------------------------------------------------------------*\
+	ParseAddressWithRegexx()
+		-	the way BmAddress::SetTo() used to split an address
+\*------------------------------------------------------------------------------*/
+static bool ParseAddressWithRegexx( const BmString& fullText, BmString& phrase,
+												BmString& addrSpec) {
+	Regexx rx;
+	BmString addrText, phraseText;
+	phrase = addrSpec = "";
+	if (rx.exec(
+		fullText,
+		"^\\s*(.*?)\\s*<\\s*(?:[^<>]+?:)?([^:<>]*?)\\s*>\\s*$"
+	)) {
+		fullText.CopyInto( phraseText, rx.match[0].atom[0].start(),
+								 rx.match[0].atom[0].Length());
+		fullText.CopyInto( addrText, rx.match[0].atom[1].start(),
+								 rx.match[0].atom[1].Length());
+		if (rx.exec( phraseText, "^[\"']+(.+?)[\"']+$")) {
+			phraseText.CopyInto( phrase, rx.match[0].atom[0].start(),
+										rx.match[0].atom[0].Length());
+		} else {
+			phrase = phraseText;
+		}
+	} else {
+		addrText = fullText;
+	}
+	if (rx.exec( addrText, "^\\s*(.+?)\\s*$"))
+		addrText.CopyInto( addrSpec, rx.match[0].atom[0].start(),
+								 rx.match[0].atom[0].Length());
+	else
+		addrSpec = addrText;
+	if (rx.exec( addrSpec, "^\\s+$"))
+		addrSpec = "";
+	return addrSpec.Length() > 0;
+}
+
+/*------------------------------------------------------------------------------*\
+	ParseGroupWithRegexx()
+		-	the way BmAddressList::Add() used to recognize groups
+\*------------------------------------------------------------------------------*/
+static bool ParseGroupWithRegexx( const BmString& text, BmString& groupName,
+											 BmString& addrText) {
+	Regexx rx;
+	groupName = addrText = "";
+	if (!rx.exec( text, "^\\s*(.+?):\\s*(.+?)?;\\s*$"))
+		return false;
+	text.CopyInto( groupName, rx.match[0].atom[0].start(),
+						rx.match[0].atom[0].Length());
+	if (rx.match[0].atom.size() > 1)
+		text.CopyInto( addrText, rx.match[0].atom[1].start(),
+							rx.match[0].atom[1].Length());
+	return true;
+}
+
+/*------------------------------------------------------------------------------*\
+	StripFieldTheOldWay()
+		-	the way BmMailHeader::StripField() used to remove comments
+\*------------------------------------------------------------------------------*/
+static BmString StripFieldTheOldWay( BmString fieldValue, 
+												BmString* commentBuffer) {
+	BmString stripped;
+	const char* pos = fieldValue.String();
+	const char* endPos;
+	while( *pos) {
+		if (*pos == '"') {
+			// quoted-string started, we search its end:
+			for( 	endPos=pos+1; 
+					*endPos && (*endPos!='"' || *(endPos-1)=='\\'); ++endPos)
+				;
+			if (*endPos) {
+				// found complete quoted-string, we copy it:
+				int32 numChars = 1+endPos-pos;
+				stripped.Append( pos, numChars);
+				pos += numChars;
+			} else {
+				// it seems that there is no ending quote, we assume the remainder
+				// to be part of the quoted string (and add the missing quote):
+				stripped.Append( pos);
+				stripped.Append( "\"");
+				pos = endPos;
+			}
+		} else if (*pos == '(') {
+			// comment started, we search its end:
+			BmString comment;
+			int32 nestLevel=1;
+			for(	endPos=pos+1; 
+					*endPos && (*endPos!=')' || *(endPos-1)=='\\' || --nestLevel); 
+					++endPos) {
+				if (*endPos == '(' && *(endPos-1)!='\\') {
+					// take a note that we found a nested comment:
+					nestLevel++;
+				}
+			}
+			if (*endPos) {
+				// found complete comment, we skip it:
+				int32 numChars = 1+endPos-pos;
+				if (commentBuffer)
+					commentBuffer->Append( pos, numChars);
+				pos += numChars;
+			} else {
+				// it seems that there is no ending paranthesis, so we assume 
+				// that all the remains are part of this incomplete comment. 
+				// We add the missing paranthesis to the comment buffer:
+				if (commentBuffer) {
+					commentBuffer->Append( pos);
+					commentBuffer->Append( ")");
+				}
+				pos = endPos;
+			}
+		} else if (*pos == ' ' || *pos == '\t') {
+			// replace linear whitespace by a single space:
+			for( endPos=pos+1;  *endPos=='\t' || *endPos==' ';  ++endPos)
+				;
+			stripped.Append( " ");
+			pos += endPos-pos;
+		} else {
+			// we copy characters until we find the start of a quoted-string,
+			// whitespace, or a comment:
+			for(  endPos=pos+1; 
+					*endPos && *endPos!='"' && *endPos!='(' && *endPos!='\t' 
+					&& *endPos!=' ';
+					++endPos)
+				;
+			int32 numChars = endPos-pos;
+			stripped.Append( pos, numChars);
+			pos += numChars;
+		}
+	}
+	return stripped;
+}
+
+/*------------------------------------------------------------------------------*\
+	SplitIntoAddressesTheOldWay()
+		-	the way BmAddressList used to split an address-list
+\*------------------------------------------------------------------------------*/
+static BmStringList SplitIntoAddressesTheOldWay( BmString addrListText) {
+	BmStringList addrList;
+	BmString currAddr;
+	const char* pos = addrListText.String();
+	const char* endPos;
+	while( *pos) {
+		if (*pos == '"') {
+			BmString quotedString;
+			// quoted-string started, we remove the quotes and unquote 
+			// quoted-pairs.
+			for( 	endPos=pos+1; 
+					*endPos && (*endPos!='"' || *(endPos-1)=='\\'); ++endPos)
+				;
+			if (*endPos) {
+				// found complete quoted-string.
+				int32 numChars = 1+endPos-pos;
+				quotedString.Append( pos+1, numChars-2);
+				pos += numChars;
+			} else {
+				// it seems that there is no ending quote, we assume the 
+				// remainder to be part of the quoted string:
+				quotedString.Append( pos+1);
+				pos = endPos;
+			}
+			// we deescape characters that are escaped by a backslash 
+			// (quoted-pairs):
+			currAddr.Append( quotedString.CharacterDeescape( '\\'));
+		} else if (*pos == '<') {
+			// route-address started, we copy it as a block in order to avoid 
+			// problems with possibly contained separator-chars (commas).
+			for( endPos=pos+1; *endPos && (*endPos!='>'); ++endPos)
+				;
+			if (*endPos) {
+				// found complete route-address.
+				int32 numChars = 1+endPos-pos;
+				currAddr.Append( pos, numChars);
+				pos += numChars;
+			} else {
+				// it seems that there is no ending '>', we assume the remainder 
+				// to be  part of the route-address (and append the missing '>'):
+				currAddr.Append( pos);
+				currAddr.Append( ">");
+				pos = endPos;
+			}
+		} else {
+			// we copy characters until we find the start of a quoted string or 
+			// the separator char:
+			for(  endPos=pos; *endPos && *endPos!='"' && *endPos!=','; ++endPos)
+				;
+			int32 numChars = endPos-pos;
+			currAddr.Append( pos, numChars);
+			pos += numChars;
+			if (*endPos == ',') {
+				addrList.push_back( currAddr);
+				currAddr = "";
+				pos++;
+			}
+		}
+	}
+	if (currAddr.Length()) {
+		addrList.push_back( currAddr);
+	}
+	return addrList;
+}
+
+/*------------------------------------------------------------------------------*\
+	SplitHeaderTheOldWay()
+		-	the way BmMailHeader::ParseHeader() used to split a header into
+			field-names and (folded) field-bodies
+\*------------------------------------------------------------------------------*/
+static void SplitHeaderTheOldWay( const BmString& header,
+											 vector<BmString>& fields) {
+	int32 pos = -1;
+	int32 lastpos = 0;
+	for(  int32 offset=0;
+			(pos = header.FindFirst( "\r\n", offset)) != B_ERROR;
+			offset = pos+2) {
+		if (pos>lastpos && !isspace(header[pos+2])) {
+			BmStringView headerField( header, lastpos, pos-lastpos);
+			lastpos = pos+2;
+			int32 colonPos = headerField.FindFirst( ':');
+			if (colonPos == B_ERROR) {
+				fields.push_back( BmString(": ") << headerField.ToString());
+				continue;
+			}
+			BmString fieldName;
+			headerField.SubView( 0, colonPos).Trim().CopyInto( fieldName);
+			fieldName.RemoveSet( BM_WHITESPACE.String());
+			fields.push_back( fieldName << ": "
+									<< headerField.SubView( colonPos+1).Trim().ToString());
+		}
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	DescribeTheOldWay( fieldVal)
+		-	returns a description of what the old parser made of the given
+			value of an address-field
+\*------------------------------------------------------------------------------*/
+static BmString DescribeTheOldWay( const BmString& fieldVal) {
+	BmString stripped = StripFieldTheOldWay( fieldVal, NULL);
+	BmString groupName, addrText;
+	bool isGroup = ParseGroupWithRegexx( stripped, groupName, addrText);
+	BmStringList addrTexts
+		= SplitIntoAddressesTheOldWay( isGroup ? addrText : stripped);
+	BmString addrs;
+	bool initOK = true;
+	for( uint32 i=0; i<addrTexts.size(); ++i) {
+		BmString phrase, addrSpec;
+		if (ParseAddressWithRegexx( addrTexts[i], phrase, addrSpec))
+			addrs << "\n" << phrase << " <" << addrSpec << ">";
+		else
+			initOK = false;
+	}
+	return BmString( stripped) << "\n" << (initOK ? "ok" : "failed")
+				<< (isGroup ? BmString(", group ") << groupName : BmString(""))
+				<< addrs;
+}
+
+/*------------------------------------------------------------------------------*\
+	Describe( fieldVal)
+		-	returns a description of what the tokenizer makes of the given
+			value of an address-field
+\*------------------------------------------------------------------------------*/
+static BmString Describe( const BmString& fieldVal) {
+	BmString stripped;
+	BmAddressList addrList;
+	addrList.Set( fieldVal, &stripped);
+	BmString addrs;
+	BmAddrList::const_iterator iter;
+	for( iter = addrList.begin(); iter != addrList.end(); ++iter)
+		addrs << "\n" << iter->Phrase() << " <" << iter->AddrSpec() << ">";
+	return BmString( stripped) << "\n" << (addrList.InitOK() ? "ok" : "failed")
+				<< (addrList.IsGroup()
+						? BmString(", group ") << addrList.GroupName()
+						: BmString(""))
+				<< addrs;
+}
+
+/*------------------------------------------------------------------------------*\
+	Unfold( fieldBody)
+		-	replaces every run of whitespace containing a linebreak by a space
+\*------------------------------------------------------------------------------*/
+static BmString Unfold( const BmString& fieldBody) {
+	BmString unfolded;
+	for( int32 i=0; i<fieldBody.Length(); ) {
+		if (!isspace( (unsigned char)fieldBody[i])) {
+			unfolded.Append( fieldBody.String()+i++, 1);
+			continue;
+		}
+		int32 wsStart = i;
+		while( i<fieldBody.Length() && isspace( (unsigned char)fieldBody[i]))
+			i++;
+		BmString ws( fieldBody.String()+wsStart, i-wsStart);
+		unfolded << (ws.FindFirst( "\r\n") != B_ERROR ? BmString(" ") : ws);
+	}
+	return unfolded;
+}
+
+/*------------------------------------------------------------------------------*\
+	CollectMailFiles( path, files)
+		-	adds all files found (recursively) in the given folder
+\*------------------------------------------------------------------------------*/
+static void CollectMailFiles( const BmString& path, vector<BmString>& files) {
+	DIR* dir = opendir( path.String());
+	if (!dir)
+		return;
+	struct dirent* entry;
+	while( (entry = readdir( dir)) != NULL) {
+		if (entry->d_name[0] == '.')
+			continue;
+		BmString entryPath = BmString( path) << "/" << entry->d_name;
+		struct stat st;
+		if (stat( entryPath.String(), &st) != 0)
+			continue;
+		if (S_ISDIR( st.st_mode))
+			CollectMailFiles( entryPath, files);
+		else if (S_ISREG( st.st_mode))
+			files.push_back( entryPath);
+	}
+	closedir( dir);
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	
+\*------------------------------------------------------------------------------*/
+static void ParseAndCheck( const BmString& text, const BmString& phrase,
+									const BmString& addrSpec) {
+	BmAddress addr( text);
+	if (addr.Phrase() != phrase || addr.AddrSpec() != addrSpec)
+		DumpResult( addr.Phrase() + "|" + addr.AddrSpec());
+	CPPUNIT_ASSERT( addr.Phrase() == phrase && addr.AddrSpec() == addrSpec);
+	CPPUNIT_ASSERT( addr.InitOK() == (addrSpec.Length() > 0));
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	
+\*------------------------------------------------------------------------------*/
+static void ParseListAndCheck( const BmString& text, const BmString& groupName,
+										 const BmString& addrString, bool initOK=true) {
+	BmAddressList addrList( text);
+	if (addrList.GroupName() != groupName
+	|| addrList.AddrString() != addrString)
+		DumpResult( addrList.GroupName() + "|" + addrList.AddrString());
+	CPPUNIT_ASSERT( addrList.IsGroup() == (groupName.Length() > 0));
+	CPPUNIT_ASSERT( addrList.GroupName() == groupName);
+	CPPUNIT_ASSERT( addrList.AddrString() == addrString);
+	CPPUNIT_ASSERT( addrList.InitOK() == initOK);
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	
+\*------------------------------------------------------------------------------*/
+static void StripAndCheck( const BmString& text, const BmString& stripped,
+									const BmString& comments) {
+	BmString commentBuffer;
+	BmString result = BmMailHeader::StripField( text, &commentBuffer);
+	if (result != stripped || commentBuffer != comments)
+		DumpResult( result + "|" + commentBuffer);
+	CPPUNIT_ASSERT( result == stripped && commentBuffer == comments);
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	
+\*------------------------------------------------------------------------------*/
+void
+AddressParserTest::SimpleTest()
+{
+	// plain addr-specs:
+	NextSubTest();
+	ParseAndCheck( "", "", "");
+	ParseAndCheck( " \t ", "", "");
+	ParseAndCheck( "joe@example.org", "", "joe@example.org");
+	ParseAndCheck( "  joe@example.org \t", "", "joe@example.org");
+	ParseAndCheck( "\"joe doe\"@example.org", "", "\"joe doe\"@example.org");
+	// phrase and angle-address:
+	NextSubTest();
+	ParseAndCheck( "Joe Doe <joe@example.org>", "Joe Doe", "joe@example.org");
+	ParseAndCheck( " \"Joe Doe\"  < joe@example.org > ", "Joe Doe",
+						"joe@example.org");
+	ParseAndCheck( "'Joe' <joe@example.org>", "Joe", "joe@example.org");
+	ParseAndCheck( "\"Doe, Joe\" <joe@example.org>", "Doe, Joe",
+						"joe@example.org");
+	ParseAndCheck( "\"Joe \\\"the man\\\" Doe\" <joe@example.org>",
+						"Joe \"the man\" Doe", "joe@example.org");
+	ParseAndCheck( "\"\" <joe@example.org>", "", "joe@example.org");
+	ParseAndCheck( "<joe@example.org>", "", "joe@example.org");
+	ParseAndCheck( "<>", "", "");
+	ParseAndCheck( "Joe <joe@example.org", "Joe", "joe@example.org");
+	// comments and folding:
+	NextSubTest();
+	ParseAndCheck( "joe@example.org (Joe Doe)", "", "joe@example.org");
+	ParseAndCheck( "Joe (the (real) man) Doe <joe@example.org>", "Joe Doe",
+						"joe@example.org");
+	ParseAndCheck( "Joe <joe@example.org (work)> (Doe)", "Joe",
+						"joe@example.org");
+	ParseAndCheck( "Joe\r\n\tDoe <joe@example.org>", "Joe Doe",
+						"joe@example.org");
+	// obsolete syntax:
+	NextSubTest();
+	ParseAndCheck( "Joe Q. Public <joe.q.public@example.org>", "Joe Q. Public",
+						"joe.q.public@example.org");
+	ParseAndCheck( "Joe <@relay.org,@other.org:joe@example.org>", "Joe",
+						"joe@example.org");
+	ParseAndCheck( "Joe <:joe@example.org>", "Joe", "joe@example.org");
+	ParseAndCheck( "<joe @ example.org>", "", "joe@example.org");
+	// malformed addresses are kept as a whole:
+	NextSubTest();
+	ParseAndCheck( "Joe <x> <joe@example.org>", "",
+						"Joe <x> <joe@example.org>");
+	ParseAndCheck( "Joe <joe@example.org> x", "",
+						"Joe <joe@example.org> x");
+	// address-lists and groups:
+	NextSubTest();
+	ParseListAndCheck( "joe@example.org, Jane <jane@example.org>", "",
+							 "joe@example.org, Jane <jane@example.org>");
+	ParseListAndCheck( "\"Doe, Jane\" <jane@example.org>, joe@example.org", "",
+							 "\"Doe, Jane\" <jane@example.org>, joe@example.org");
+	ParseListAndCheck( "Jane <@relay.org,@other.org:jane@example.org>, joe",
+							 "", "Jane <jane@example.org>, joe");
+	ParseListAndCheck( "joe@example.org,, (nobody),jane@example.org,", "",
+							 "joe@example.org, jane@example.org");
+	ParseListAndCheck( "joe@example.org, <>", "", "joe@example.org", false);
+	ParseListAndCheck( "Undisclosed-Recipients:;", "Undisclosed-Recipients",
+							 "Undisclosed-Recipients:;");
+	ParseListAndCheck( "friends (of mine): joe@example.org, Jane "
+							 "<jane@example.org>;",
+							 "friends",
+							 "friends: joe@example.org, Jane <jane@example.org>;");
+	ParseListAndCheck( "a: b: c;", "a", "a: b: c;");
+	ParseListAndCheck( "friends: joe@example.org", "friends",
+							 "friends: joe@example.org;");
+	ParseListAndCheck( "joe@example.org, friends: jane@example.org;", "",
+							 "joe@example.org, jane@example.org");
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	
+\*------------------------------------------------------------------------------*/
+void
+AddressParserTest::StripFieldTest()
+{
+	NextSubTest();
+	StripAndCheck( "", "", "");
+	StripAndCheck( "text/plain; charset=us-ascii",
+						"text/plain; charset=us-ascii", "");
+	StripAndCheck( "a \t b", "a b", "");
+	StripAndCheck( "a\r\n b", "a b", "");
+	// comments:
+	NextSubTest();
+	StripAndCheck( "1.0 (produced by Beam)", "1.0 ", "(produced by Beam)");
+	StripAndCheck( "a (b) c(d)", "a  c", "(b)(d)");
+	StripAndCheck( "a (b (c) d) e", "a  e", "(b (c) d)");
+	StripAndCheck( "a (b \\) c) d", "a  d", "(b \\) c)");
+	StripAndCheck( "a (b (c)", "a ", "(b (c))");
+	// quoted-strings:
+	NextSubTest();
+	StripAndCheck( "\"a (b)\" c", "\"a (b)\" c", "");
+	StripAndCheck( "\"a \\\" (b)\" c", "\"a \\\" (b)\" c", "");
+	StripAndCheck( "\"a (b)", "\"a (b)\"", "");
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	
+\*------------------------------------------------------------------------------*/
+void
+AddressParserTest::TokenizerTest()
+{
+	// fields:
+	NextSubTest();
+	BmString header( "From: joe@example.org\r\n"
+						  "Subject: a\r\n \tb \r\n"
+						  "\r\n"
+						  "No Colon\r\n"
+						  "X - Spaced : value\r\n"
+						  "Unterminated: x");
+	BmHeaderTokenizer fieldTokenizer( header);
+	BmStringView name, body;
+	CPPUNIT_ASSERT( fieldTokenizer.NextField( name, body));
+	CPPUNIT_ASSERT( name == "From" && body == "joe@example.org");
+	// (the empty line is just whitespace within the folded field):
+	CPPUNIT_ASSERT( fieldTokenizer.NextField( name, body));
+	CPPUNIT_ASSERT( name == "Subject" && body == "a\r\n \tb");
+	CPPUNIT_ASSERT( fieldTokenizer.NextField( name, body));
+	CPPUNIT_ASSERT( name.IsEmpty() && body == "No Colon");
+	CPPUNIT_ASSERT( fieldTokenizer.NextField( name, body));
+	CPPUNIT_ASSERT( name == "X - Spaced" && body == "value");
+	CPPUNIT_ASSERT( !fieldTokenizer.NextField( name, body));
+	// tokens:
+	NextSubTest();
+	BmString text( "Joe \"Q. \\\"Doe\\\"\" <joe@[1.2.3.4]> (a (b)) (c");
+	BmHeaderTokenizer tokenizer( text);
+	const struct {
+		BmHeaderTokenizer::TokenType type;
+		const char* token;
+	} tokens[] = {
+		{ BmHeaderTokenizer::BM_TOKEN_ATOM, "Joe" },
+		{ BmHeaderTokenizer::BM_TOKEN_SPACE, " " },
+		{ BmHeaderTokenizer::BM_TOKEN_QUOTED_STRING, "\"Q. \\\"Doe\\\"\"" },
+		{ BmHeaderTokenizer::BM_TOKEN_SPACE, " " },
+		{ BmHeaderTokenizer::BM_TOKEN_SPECIAL, "<" },
+		{ BmHeaderTokenizer::BM_TOKEN_ATOM, "joe" },
+		{ BmHeaderTokenizer::BM_TOKEN_SPECIAL, "@" },
+		{ BmHeaderTokenizer::BM_TOKEN_DOMAIN_LITERAL, "[1.2.3.4]" },
+		{ BmHeaderTokenizer::BM_TOKEN_SPECIAL, ">" },
+		{ BmHeaderTokenizer::BM_TOKEN_SPACE, " " },
+		{ BmHeaderTokenizer::BM_TOKEN_COMMENT, "(a (b))" },
+		{ BmHeaderTokenizer::BM_TOKEN_SPACE, " " },
+		{ BmHeaderTokenizer::BM_TOKEN_COMMENT, "(c" },
+		{ BmHeaderTokenizer::BM_TOKEN_END, "" }
+	};
+	for( uint32 i=0; i<sizeof( tokens)/sizeof( tokens[0]); ++i) {
+		CPPUNIT_ASSERT( tokenizer.NextToken() == tokens[i].type);
+		CPPUNIT_ASSERT( tokenizer.Token() == tokens[i].token);
+		CPPUNIT_ASSERT( tokenizer.IsTerminated() == (i != 12));
+		if (i == 2) {
+			BmString unquoted;
+			tokenizer.UnquoteToken( unquoted);
+			CPPUNIT_ASSERT( unquoted == "Q. \"Doe\"");
+		}
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	
+\*------------------------------------------------------------------------------*/
+void
+AddressParserTest::CorpusTest()
+{
+	// the headers of all mails in the test-mailbox (and in the folder named
+	// by BEAM_MAIL_CORPUS, if set) must be split into the same fields, and
+	// each structured field must be stripped (and parsed into addresses)
+	// exactly like the old parser did:
+	const char* addrFieldNames[] = {
+		"Bcc", "Resent-Bcc", "Cc", "List-Id", "Resent-Cc", "From",
+		"Resent-From", "Reply-To", "Resent-Reply-To", "Sender",
+		"Resent-Sender", "To", "Resent-To", NULL
+	};
+	const char* unstrippedFieldNames[] = {
+		"Received", "Subject", "UserAgent", NULL
+	};
+	vector<BmString> files;
+	if (HaveTestdata)
+		CollectMailFiles( "mail", files);
+	const char* corpus = getenv( "BEAM_MAIL_CORPUS");
+	if (corpus)
+		CollectMailFiles( corpus, files);
+	int32 addrFieldCount = 0;
+	int32 mismatchCount = 0;
+	for( uint32 f=0; f<files.size(); ++f) {
+		if (f % 100 == 0)
+			NextSubTest();
+		BmString mailText;
+		SlurpFile( files[f].String(), mailText);
+		mailText.ConvertLinebreaksToCRLF();
+		int32 headerEnd = mailText.FindFirst( "\r\n\r\n");
+		if (headerEnd == B_ERROR)
+			continue;
+		BmString header( mailText.String(), headerEnd+2);
+
+		vector<BmString> oldFields;
+		SplitHeaderTheOldWay( header, oldFields);
+		BmHeaderTokenizer tokenizer( header);
+		BmStringView nameView, bodyView;
+		uint32 i;
+		for( i=0; tokenizer.NextField( nameView, bodyView); ++i) {
+			BmString name = nameView.ToString();
+			name.RemoveSet( BM_WHITESPACE.String());
+			BmString field = BmString( name) << ": " << bodyView.ToString();
+			if (i >= oldFields.size() || field != oldFields[i]) {
+				DumpResult( files[f] + ":\n" + field);
+				mismatchCount++;
+				break;
+			}
+
+			BmString fieldBody = Unfold( bodyView.ToString());
+			bool isAddrField = false;
+			bool isStripped = true;
+			for( int32 n=0; addrFieldNames[n]; ++n)
+				isAddrField = isAddrField || name.ICompare( addrFieldNames[n]) == 0;
+			for( int32 n=0; unstrippedFieldNames[n]; ++n)
+				isStripped = isStripped
+									&& name.ICompare( unstrippedFieldNames[n]) != 0;
+			BmString result, oldResult;
+			if (isAddrField) {
+				addrFieldCount++;
+				result = Describe( fieldBody);
+				oldResult = DescribeTheOldWay( fieldBody);
+			} else if (isStripped) {
+				result = BmMailHeader::StripField( fieldBody);
+				oldResult = StripFieldTheOldWay( fieldBody, NULL);
+			}
+			if (result != oldResult) {
+				DumpResult( files[f] + ":\n" + result + "\n---\n" + oldResult);
+				mismatchCount++;
+			}
+		}
+		if (i != oldFields.size()) {
+			DumpResult( files[f] + ": field-count differs");
+			mismatchCount++;
+		}
+	}
+	printf( "\n\t%lu mails with %ld address-fields compared\n",
+			  (unsigned long)files.size(), (long)addrFieldCount);
+	CPPUNIT_ASSERT( mismatchCount == 0);
+}
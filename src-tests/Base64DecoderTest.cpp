@@ -15,6 +15,7 @@
 #include "TestBeam.h"
 
 #include "BmEncoding.h"
+#include "BmStringSearch.h"
 
 /*
  *
@@ -202,3 +203,46 @@ Base64DecoderTest::LargeDataTest() {
 	NextSubTest(); 
 	DecodeBase64AndCheck( input, result);
 }
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	
+\*------------------------------------------------------------------------------*/
+void
+Base64DecoderTest::KernelTest()
+{
+	// every kernel must decode clean 76-column lines (which are handled
+	// by the vectorized fast path) as well as lines with whitespace and 
+	// garbage in them (which are left to the scalar fallback):
+	BmString data;
+	uint32 seed = 4711;
+	for( int32 i=0; i<10000; ++i) {
+		seed = seed * 1103515245 + 12345;
+		data.Append( char( 1 + (seed >> 16) % 255), 1);
+	}
+	BmString clean;
+	{
+		BmStringIBuf srcBuf( data);
+		BmStringOBuf destBuf( 128);
+		BmBase64Encoder encoder( &srcBuf, 128);
+		destBuf.Write( &encoder, 128);
+		clean.Adopt( destBuf.TheString());
+	}
+	BmString dirty;
+	const char* garbage = " \t!*\xe4\r\n";
+	for( int32 i=0; i<clean.Length(); i+=37) {
+		dirty.Append( clean.String()+i, min_c( 37, clean.Length()-i));
+		dirty.Append( garbage[(i/37) % 7], 1);
+	}
+	BmStringSearch::Kernel bestKernel = BmStringSearch::ActiveKernel();
+	for( int32 k=0; k<BmStringSearch::KERNEL_COUNT; ++k) {
+		BmStringSearch::Kernel kernel = static_cast<BmStringSearch::Kernel>(k);
+		if (!BmStringSearch::SelectKernel( kernel))
+			continue;
+		NextSubTest(); 
+		DecodeBase64AndCheck( clean, data);
+		NextSubTest(); 
+		DecodeBase64AndCheck( dirty, data);
+	}
+	BmStringSearch::SelectKernel( bestKernel);
+}
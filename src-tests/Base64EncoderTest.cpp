@@ -15,6 +15,7 @@
 #include "TestBeam.h"
 
 #include "BmEncoding.h"
+#include "BmStringSearch.h"
 
 /*
  *
@@ -168,3 +169,45 @@ Base64EncoderTest::LargeDataTest() {
 	NextSubTest(); 
 	EncodeBase64AndCheck( input, result);
 }
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	
+\*------------------------------------------------------------------------------*/
+void
+Base64EncoderTest::KernelTest()
+{
+	// the vectorized kernels must yield exactly what the scalar one does,
+	// on multiple lines as well as on a single line:
+	BmString data;
+	uint32 seed = 4711;
+	for( int32 i=0; i<10000; ++i) {
+		seed = seed * 1103515245 + 12345;
+		data.Append( char( 1 + (seed >> 16) % 255), 1);
+	}
+	BmStringSearch::Kernel bestKernel = BmStringSearch::ActiveKernel();
+	BmStringSearch::SelectKernel( BmStringSearch::KERNEL_SCALAR);
+	BmString result;
+	{
+		BmStringIBuf srcBuf( data);
+		BmStringOBuf destBuf( 128);
+		BmBase64Encoder encoder( &srcBuf, 128);
+		destBuf.Write( &encoder, 128);
+		result.Adopt( destBuf.TheString());
+	}
+	NextSubTest(); 
+	CPPUNIT_ASSERT( result.FindFirst( "\r\n") == 76);
+	BmString singleLineResult( result);
+	singleLineResult.RemoveAll( "\r\n");
+	for( int32 k=0; k<BmStringSearch::KERNEL_COUNT; ++k) {
+		BmStringSearch::Kernel kernel = static_cast<BmStringSearch::Kernel>(k);
+		if (!BmStringSearch::SelectKernel( kernel))
+			continue;
+		NextSubTest(); 
+		EncodeBase64AndCheck( data, result);
+		Activator activator(SingleLineMode);
+		NextSubTest(); 
+		EncodeBase64AndCheck( data, singleLineResult);
+	}
+	BmStringSearch::SelectKernel( bestKernel);
+}
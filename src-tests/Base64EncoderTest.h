@@ -27,6 +27,7 @@ class Base64EncoderTest : public BTestCase
 	CPPUNIT_TEST( SimpleTest);
 	CPPUNIT_TEST( MultiLineTest);
 	CPPUNIT_TEST( LargeDataTest);
+	CPPUNIT_TEST( KernelTest);
 	CPPUNIT_TEST_SUITE_END();
 public:
 //	static CppUnit::Test* Suite();
@@ -43,6 +44,7 @@ public:
 	void SimpleTest();
 	void MultiLineTest();
 	void LargeDataTest();
+	void KernelTest();
 };
 
 
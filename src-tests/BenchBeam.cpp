@@ -0,0 +1,690 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+/*
+ * BenchBeam runs every memory-filter (encoders/decoders of the mailkit and
+ * the network-filters of the daemon) over inputs of different sizes and
+ * reports throughput, allocations and per-block latency as CSV (one line
+ * per filter and input size), such that results of different builds can
+ * be compared by a script.
+ * Additionally, the headers of a synthetic mailbox (of each input size) are
+ * parsed, with the per-mail parsing times reported as block latencies.
+ * Finally, a mail with attachments (of each input size) is opened, once
+ * like a header-only filter does and once including its body-structure.
+ * Usage:
+ *			BenchBeam [-f <filter-substring>] [-s <size>[,<size>...]]
+ *						 [-t <min-millisecs-per-measurement>]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <new>
+#include <vector>
+
+#include <OS.h>
+
+#include "BmApp.h"
+#include "BmBlockPool.h"
+#include "BmBodyPartList.h"
+#include "BmEncoding.h"
+#include "BmMail.h"
+#include "BmMailHeader.h"
+#include "BmMemIO.h"
+#include "BmNetJobModel.h"
+#include "BmPrefs.h"
+
+using std::vector;
+
+/*------------------------------------------------------------------------------*\
+	allocation counting
+		-	every allocation via operator new is counted, allocations of
+			filter buffers are taken from the stats of BmBlockPool
+\*------------------------------------------------------------------------------*/
+static vint64 sNewCount = 0;
+static vint64 sNewBytes = 0;
+
+void* operator new( size_t size) throw (std::bad_alloc) {
+	atomic_add64( &sNewCount, 1);
+	atomic_add64( &sNewBytes, size);
+	void* mem = malloc( size ? size : 1);
+	if (!mem)
+		throw std::bad_alloc();
+	return mem;
+}
+
+void* operator new[]( size_t size) throw (std::bad_alloc) {
+	return operator new( size);
+}
+
+void operator delete( void* mem) throw () {
+	free( mem);
+}
+
+void operator delete[]( void* mem) throw () {
+	free( mem);
+}
+
+/*------------------------------------------------------------------------------*\
+	class BenchNetJob
+		-	the network-filters need a job (for logging), this one does nothing
+\*------------------------------------------------------------------------------*/
+class BenchNetJob : public BmNetJobModel {
+	typedef BmNetJobModel inherited;
+public:
+	BenchNetJob()
+		:	inherited( "BenchNetJob", BM_LogSmtp, NULL)		{}
+	void UpdateProgress( uint32)			{}
+	bool StartJob()							{ return true; }
+};
+
+/*------------------------------------------------------------------------------*\
+	inputs
+\*------------------------------------------------------------------------------*/
+enum InputKind {
+	INPUT_TEXT_LF = 0,
+	INPUT_TEXT_CRLF,
+	INPUT_TEXT_UTF8,
+	INPUT_TEXT_LATIN1,
+	INPUT_BINARY,
+	INPUT_BASE64,
+	INPUT_QP,
+	INPUT_DOTSTUFFED,
+	INPUT_KIND_COUNT
+};
+
+static const char* InputKindNames[INPUT_KIND_COUNT] = {
+	"text-lf", "text-crlf", "text-utf8", "text-latin1", "binary", "base64",
+	"quoted-printable", "dotstuffed"
+};
+
+static uint32 sSeed = 4711;
+
+static inline uint32 NextRandom() {
+	sSeed = sSeed*1103515245 + 12345;
+	return sSeed >> 16;
+}
+
+/*------------------------------------------------------------------------------*\
+	GenerateText( size, linebreak, highChars)
+		-	generates mail-like text of the given size, highChars (if given)
+			is inserted every now and then
+\*------------------------------------------------------------------------------*/
+static BmString GenerateText( int32 size, const char* linebreak,
+										const char* highChars) {
+	static const char* words[] = {
+		"the", "mail", "Beam", "header", "from", "to", "subject", "quoted",
+		"printable", "encoding", "attachment", "message", "is", "a", "of",
+		"and", ".", "-", "Re:", "http://beam.sourceforge.net"
+	};
+	const int32 wordCount = sizeof(words)/sizeof(const char*);
+	BmStringOBuf text( size+128);
+	int32 lineLen = 0;
+	while( (int32)text.CurrPos() < size) {
+		if (lineLen > 60 + (int32)(NextRandom() % 16)) {
+			text << linebreak;
+			lineLen = 0;
+			if (NextRandom() % 8 == 0)
+				text << ">";
+			continue;
+		}
+		const char* word = (highChars && NextRandom() % 6 == 0)
+									? highChars
+									: words[NextRandom() % wordCount];
+		if (lineLen)
+			text << " ";
+		text << word;
+		lineLen += strlen( word) + 1;
+	}
+	BmString result;
+	result.Adopt( text.TheString());
+	result.Truncate( size);
+	return result;
+}
+
+/*------------------------------------------------------------------------------*\
+	Encode( input, filter)
+		-	runs the given input through the given filter (used for generating
+			the encoded inputs)
+\*------------------------------------------------------------------------------*/
+static BmString Encode( BmMemFilter& filter, int32 sizeHint) {
+	BmStringOBuf dest( sizeHint+sizeHint/2+128);
+	dest.Write( &filter);
+	BmString result;
+	result.Adopt( dest.TheString());
+	return result;
+}
+
+/*------------------------------------------------------------------------------*\
+	GenerateInput( kind, size)
+		-	generates input data of the given kind, that is about size bytes
+			long (encoded data is generated from size bytes of raw data)
+\*------------------------------------------------------------------------------*/
+static BmString GenerateInput( InputKind kind, int32 size) {
+	sSeed = 4711 + kind;
+	switch( kind) {
+		case INPUT_TEXT_LF:
+			return GenerateText( size, "\n", NULL);
+		case INPUT_TEXT_CRLF:
+			return GenerateText( size, "\r\n", NULL);
+		case INPUT_TEXT_UTF8:
+			return GenerateText( size, "\r\n", "gr\xc3\xbc\xc3\x9f\x65 \xe2\x82\xac");
+		case INPUT_TEXT_LATIN1:
+			return GenerateText( size, "\r\n", "gr\xfc\xdf\x65");
+		case INPUT_BINARY: {
+			BmString data;
+			char* buf = data.LockBuffer( size);
+			for( int32 i=0; i<size; ++i)
+				buf[i] = (char)NextRandom();
+			data.UnlockBuffer( size);
+			return data;
+		}
+		case INPUT_BASE64: {
+			BmString raw = GenerateInput( INPUT_BINARY, size);
+			BmStringIBuf src( raw);
+			BmBase64Encoder encoder( &src);
+			return Encode( encoder, size);
+		}
+		case INPUT_QP: {
+			BmString raw = GenerateInput( INPUT_TEXT_LATIN1, size);
+			BmStringIBuf src( raw);
+			BmQuotedPrintableEncoder encoder( &src);
+			return Encode( encoder, size);
+		}
+		case INPUT_DOTSTUFFED: {
+			BmString raw = GenerateText( size, "\r\n.", NULL);
+			raw << "\r\n.\r\n";
+			return raw;
+		}
+		default:
+			return BmString();
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	GenerateMailbox( size, headers)
+		-	generates the headers of a synthetic mailbox of about size bytes,
+			with encoded-words in some of the address- and subject-fields
+\*------------------------------------------------------------------------------*/
+static void GenerateMailbox( int32 size, vector<BmString>& headers) {
+	static const char* names[] = {
+		"Oliver Tappe", "=?iso-8859-1?Q?J=F6rg_M=FCller?=", 
+		"=?utf-8?B?5byg5LiJ?=", "\"Doe, John\"", "=?utf-8?Q?Fran=C3=A7ois?="
+	};
+	static const char* subjects[] = {
+		"Re: the mail header", "=?iso-8859-15?Q?Gr=FC=DFe_und_=A4?=",
+		"=?utf-8?Q?Re:_Beam_?= =?utf-8?Q?=E2=82=AC_attachment?=",
+		"Fwd: =?utf-8?B?w6TDtsO8?= quoted printable", "message of the day"
+	};
+	const int32 nameCount = sizeof(names)/sizeof(const char*);
+	const int32 subjectCount = sizeof(subjects)/sizeof(const char*);
+	sSeed = 4711;
+	headers.clear();
+	int32 totalSize = 0;
+	for( int32 i=0; totalSize < size; ++i) {
+		BmString header;
+		header << "Return-Path: <user" << i << "@example.org>\r\n"
+				 << "Received: from mail.example.org (mail.example.org "
+				 << "[192.168.1." << i%256 << "])\r\n\tby mx.example.com "
+				 << "with ESMTP id " << NextRandom() << "\r\n"
+				 << "Message-ID: <" << NextRandom() << "." << i 
+				 << "@example.org>\r\n"
+				 << "Date: Sat, 17 Oct 2026 12:" << i%60 << ":00 +0200\r\n"
+				 << "From: " << names[NextRandom() % nameCount] 
+				 << " <user" << i << "@example.org>\r\n"
+				 << "To: " << names[NextRandom() % nameCount] 
+				 << " <beam@example.com>, " << names[NextRandom() % nameCount] 
+				 << " <list@example.com>\r\n"
+				 << "Subject: " << subjects[NextRandom() % subjectCount] 
+				 << "\r\n"
+				 << "MIME-Version: 1.0\r\n"
+				 << "Content-Type: text/plain; charset=\"utf-8\"\r\n"
+				 << "Content-Transfer-Encoding: 8bit\r\n";
+		totalSize += header.Length();
+		headers.push_back( header);
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	GenerateMail( size)
+		-	generates a mail of about size bytes, consisting of a short text
+			and a couple of (base64-encoded) attachments, one of which is 
+			a nested multipart
+\*------------------------------------------------------------------------------*/
+static BmString GenerateMail( int32 size) {
+	const int32 attachmentCount = 4;
+	const int32 attachmentSize = std::max( (int32)64, size/attachmentCount*3/4);
+	BmString mail;
+	mail << "From: Oliver Tappe <beam@example.org>\r\n"
+		  << "To: beam@example.com\r\n"
+		  << "Subject: the attachments\r\n"
+		  << "Date: Sat, 17 Oct 2026 12:00:00 +0200\r\n"
+		  << "MIME-Version: 1.0\r\n"
+		  << "Content-Type: multipart/mixed; boundary=\"outer\"\r\n\r\n"
+		  << "This is a multi-part message in MIME format.\r\n\r\n"
+		  << "--outer\r\n"
+		  << "Content-Type: text/plain; charset=\"utf-8\"\r\n"
+		  << "Content-Transfer-Encoding: 8bit\r\n\r\n"
+		  << GenerateInput( INPUT_TEXT_CRLF, 2048) << "\r\n";
+	for( int32 i=0; i<attachmentCount; ++i) {
+		mail << "--outer\r\n";
+		if (i == attachmentCount-1)
+			mail << "Content-Type: multipart/mixed; boundary=\"inner\"\r\n\r\n"
+				  << "--inner\r\n";
+		mail << "Content-Type: application/octet-stream; name=\"file" << i 
+			  << ".bin\"\r\n"
+			  << "Content-Transfer-Encoding: base64\r\n"
+			  << "Content-Disposition: attachment; filename=\"file" << i 
+			  << ".bin\"\r\n\r\n"
+			  << GenerateInput( INPUT_BASE64, attachmentSize) << "\r\n";
+		if (i == attachmentCount-1)
+			mail << "--inner--\r\n";
+	}
+	mail << "--outer--\r\n";
+	return mail;
+}
+
+/*------------------------------------------------------------------------------*\
+	filters
+\*------------------------------------------------------------------------------*/
+typedef BmMemFilter* (*FilterFactory)( BmMemIBuf* input, BmNetJobModel* job);
+
+static BmMemFilter* NewUtf8Decoder( BmMemIBuf* input, BmNetJobModel*) {
+	return new BmUtf8Decoder( input, "iso-8859-15");
+}
+static BmMemFilter* NewUtf8Encoder( BmMemIBuf* input, BmNetJobModel*) {
+	return new BmUtf8Encoder( input, "iso-8859-15");
+}
+static BmMemFilter* NewQpDecoder( BmMemIBuf* input, BmNetJobModel*) {
+	return new BmQuotedPrintableDecoder( input);
+}
+static BmMemFilter* NewQpEncoder( BmMemIBuf* input, BmNetJobModel*) {
+	return new BmQuotedPrintableEncoder( input);
+}
+static BmMemFilter* NewQpEncodedWordEncoder( BmMemIBuf* input,
+															BmNetJobModel*) {
+	return new BmQpEncodedWordEncoder( input, BmMemFilter::nBlockSize, 0,
+												  "iso-8859-15");
+}
+static BmMemFilter* NewFoldedLineEncoder( BmMemIBuf* input, BmNetJobModel*) {
+	return new BmFoldedLineEncoder( input, 76);
+}
+static BmMemFilter* NewBase64Decoder( BmMemIBuf* input, BmNetJobModel*) {
+	return new BmBase64Decoder( input);
+}
+static BmMemFilter* NewBase64Encoder( BmMemIBuf* input, BmNetJobModel*) {
+	return new BmBase64Encoder( input);
+}
+static BmMemFilter* NewLinebreakDecoder( BmMemIBuf* input, BmNetJobModel*) {
+	return new BmLinebreakDecoder( input);
+}
+static BmMemFilter* NewLinebreakEncoder( BmMemIBuf* input, BmNetJobModel*) {
+	return new BmLinebreakEncoder( input);
+}
+static BmMemFilter* NewMailtextCleaner( BmMemIBuf* input, BmNetJobModel*) {
+	return new BmMailtextCleaner( input);
+}
+static BmMemFilter* NewBinaryDecoder( BmMemIBuf* input, BmNetJobModel*) {
+	return new BmBinaryDecoder( input);
+}
+static BmMemFilter* NewBinaryEncoder( BmMemIBuf* input, BmNetJobModel*) {
+	return new BmBinaryEncoder( input);
+}
+static BmMemFilter* NewDotstuffDecoder( BmMemIBuf* input, BmNetJobModel* job) {
+	return new BmDotstuffDecoder( input, job);
+}
+static BmMemFilter* NewDotstuffEncoder( BmMemIBuf* input, BmNetJobModel* job) {
+	return new BmDotstuffEncoder( input, job);
+}
+static BmMemFilter* NewTrafficLogger( BmMemIBuf* input, BmNetJobModel* job) {
+	return new BmTrafficLogger( input, job, 2048, "-->\n");
+}
+
+struct BenchFilter {
+	const char* name;
+	InputKind inputKind;
+	FilterFactory create;
+};
+
+static const BenchFilter BenchFilters[] = {
+	{ "Utf8Decoder", 				INPUT_TEXT_UTF8, 		NewUtf8Decoder },
+	{ "Utf8Encoder", 				INPUT_TEXT_LATIN1, 	NewUtf8Encoder },
+	{ "QuotedPrintableDecoder", INPUT_QP, 				NewQpDecoder },
+	{ "QuotedPrintableEncoder", INPUT_TEXT_LATIN1, 	NewQpEncoder },
+	{ "QpEncodedWordEncoder", 	INPUT_TEXT_UTF8, 		NewQpEncodedWordEncoder },
+	{ "FoldedLineEncoder", 		INPUT_TEXT_LF, 		NewFoldedLineEncoder },
+	{ "Base64Decoder", 			INPUT_BASE64, 			NewBase64Decoder },
+	{ "Base64Encoder", 			INPUT_BINARY, 			NewBase64Encoder },
+	{ "LinebreakDecoder", 		INPUT_TEXT_CRLF, 		NewLinebreakDecoder },
+	{ "LinebreakEncoder", 		INPUT_TEXT_LF, 		NewLinebreakEncoder },
+	{ "MailtextCleaner", 		INPUT_TEXT_UTF8, 		NewMailtextCleaner },
+	{ "BinaryDecoder", 			INPUT_BINARY, 			NewBinaryDecoder },
+	{ "BinaryEncoder", 			INPUT_BINARY, 			NewBinaryEncoder },
+	{ "DotstuffDecoder", 		INPUT_DOTSTUFFED, 	NewDotstuffDecoder },
+	{ "DotstuffEncoder", 		INPUT_TEXT_CRLF, 		NewDotstuffEncoder },
+	{ "TrafficLogger", 			INPUT_TEXT_CRLF, 		NewTrafficLogger },
+};
+
+/*------------------------------------------------------------------------------*\
+	class BlockTimer
+		-	consumes the filter output and notes how long it took to get each
+			block
+\*------------------------------------------------------------------------------*/
+class BlockTimer : public BmMemBufConsumer::Functor {
+public:
+	BlockTimer( vector<bigtime_t>& latencies)
+		:	mLatencies( latencies)
+		,	mOutputBytes( 0)
+		,	mLastTime( system_time())	{}
+	status_t operator() (const char*, uint32 bufLen) {
+		bigtime_t now = system_time();
+		mLatencies.push_back( now - mLastTime);
+		mLastTime = now;
+		mOutputBytes += bufLen;
+		return B_OK;
+	}
+	vector<bigtime_t>& mLatencies;
+	int64 mOutputBytes;
+	bigtime_t mLastTime;
+};
+
+struct BenchResult {
+	int32 iterations;
+	int64 outputBytes;
+	bigtime_t totalTime;
+	int64 newCount;
+	int64 newBytes;
+	int32 poolHeapAllocs;
+	int32 blockCount;
+	bigtime_t blockMedian;
+	bigtime_t blockP99;
+	bigtime_t blockMax;
+};
+
+/*------------------------------------------------------------------------------*\
+	RunBenchmark( filter, input, minTime, result)
+		-	runs the given filter over the given input repeatedly (until at
+			least minTime has passed)
+\*------------------------------------------------------------------------------*/
+static void RunBenchmark( const BenchFilter& benchFilter, const BmString& input,
+								  BmNetJobModel* job, bigtime_t minTime,
+								  BenchResult& result) {
+	vector<bigtime_t> latencies;
+	BmMemBufConsumer consumer( BmMemFilter::nBlockSize);
+	BmBlockPool::Stats stats;
+
+	// one run for warming up the caches (and the block pool):
+	{
+		BmStringIBuf src( input);
+		BmMemFilter* filter = benchFilter.create( &src, job);
+		BlockTimer timer( latencies);
+		consumer.Consume( filter, &timer);
+		result.outputBytes = timer.mOutputBytes;
+		delete filter;
+	}
+	latencies.clear();
+	latencies.reserve( 1024);
+
+	BmBlockPool::ResetStats();
+	int64 newCount = sNewCount;
+	int64 newBytes = sNewBytes;
+	result.iterations = 0;
+	result.totalTime = 0;
+	while( result.iterations < 3 || result.totalTime < minTime) {
+		BmStringIBuf src( input);
+		bigtime_t start = system_time();
+		BmMemFilter* filter = benchFilter.create( &src, job);
+		BlockTimer timer( latencies);
+		consumer.Consume( filter, &timer);
+		delete filter;
+		result.totalTime += system_time() - start;
+		result.iterations++;
+	}
+	BmBlockPool::GetStats( stats);
+	result.newCount = (sNewCount - newCount) / result.iterations;
+	result.newBytes = (sNewBytes - newBytes) / result.iterations;
+	result.poolHeapAllocs = stats.heapAllocs / result.iterations;
+
+	std::sort( latencies.begin(), latencies.end());
+	result.blockCount = latencies.size() / result.iterations;
+	if (latencies.empty()) {
+		result.blockMedian = result.blockP99 = result.blockMax = 0;
+	} else {
+		result.blockMedian = latencies[latencies.size()/2];
+		result.blockP99 = latencies[(latencies.size()*99)/100];
+		result.blockMax = latencies.back();
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	RunHeaderBenchmark( headers, minTime, result)
+		-	parses all the given mail-headers repeatedly (until at least 
+			minTime has passed)
+\*------------------------------------------------------------------------------*/
+static void RunHeaderBenchmark( const vector<BmString>& headers, 
+										  bigtime_t minTime, BenchResult& result) {
+	vector<bigtime_t> latencies;
+	latencies.reserve( headers.size()*4);
+	BmBlockPool::Stats stats;
+
+	// one run for warming up the caches (and the pool of converters):
+	result.outputBytes = 0;
+	for( uint32 i=0; i<headers.size(); ++i) {
+		BmRef<BmMailHeader> header( new BmMailHeader( headers[i], NULL));
+		result.outputBytes += header->GetFieldVal( BM_FIELD_SUBJECT).Length()
+									 + header->GetFieldVal( BM_FIELD_FROM).Length();
+	}
+
+	BmBlockPool::ResetStats();
+	int64 newCount = sNewCount;
+	int64 newBytes = sNewBytes;
+	result.iterations = 0;
+	result.totalTime = 0;
+	while( result.iterations < 3 || result.totalTime < minTime) {
+		for( uint32 i=0; i<headers.size(); ++i) {
+			bigtime_t start = system_time();
+			BmRef<BmMailHeader> header( new BmMailHeader( headers[i], NULL));
+			header = NULL;
+			bigtime_t duration = system_time() - start;
+			latencies.push_back( duration);
+			result.totalTime += duration;
+		}
+		result.iterations++;
+	}
+	BmBlockPool::GetStats( stats);
+	result.newCount = (sNewCount - newCount) / result.iterations;
+	result.newBytes = (sNewBytes - newBytes) / result.iterations;
+	result.poolHeapAllocs = stats.heapAllocs / result.iterations;
+
+	std::sort( latencies.begin(), latencies.end());
+	result.blockCount = headers.size();
+	if (latencies.empty()) {
+		result.blockMedian = result.blockP99 = result.blockMax = 0;
+	} else {
+		result.blockMedian = latencies[latencies.size()/2];
+		result.blockP99 = latencies[(latencies.size()*99)/100];
+		result.blockMax = latencies.back();
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	OpenMail( mail, mailText, withBody)
+		-	sets up the given mail from the given text and accesses what a 
+			header-only filter (and storing the mail) needs or, if withBody
+			is set, what the mail-view needs
+\*------------------------------------------------------------------------------*/
+static int32 OpenMail( BmMail* mail, const BmString& mailText, bool withBody) {
+	mail->SetTo( mailText, "");
+	int32 len = mail->GetFieldVal( BM_FIELD_SUBJECT).Length() 
+					+ (mail->HasAttachments() ? 1 : 0);
+	if (withBody) {
+		BmBodyPartList* body = mail->Body();
+		BmRef<BmBodyPart> textBody( body->EditableTextBody());
+		if (textBody)
+			len += textBody->DecodedLength();
+	}
+	return len;
+}
+
+/*------------------------------------------------------------------------------*\
+	RunMailOpenBenchmark( mailText, withBody, minTime, result)
+		-	opens a mail with the given text repeatedly (until at least 
+			minTime has passed)
+\*------------------------------------------------------------------------------*/
+static void RunMailOpenBenchmark( const BmString& mailText, bool withBody,
+											 bigtime_t minTime, BenchResult& result) {
+	vector<bigtime_t> latencies;
+	BmBlockPool::Stats stats;
+	BmRef<BmMail> mail( new BmMail( false));
+
+	// one run for warming up the caches:
+	result.outputBytes = OpenMail( mail.Get(), mailText, withBody);
+
+	BmBlockPool::ResetStats();
+	int64 newCount = sNewCount;
+	int64 newBytes = sNewBytes;
+	result.iterations = 0;
+	result.totalTime = 0;
+	while( result.iterations < 3 || result.totalTime < minTime) {
+		bigtime_t start = system_time();
+		OpenMail( mail.Get(), mailText, withBody);
+		bigtime_t duration = system_time() - start;
+		latencies.push_back( duration);
+		result.totalTime += duration;
+		result.iterations++;
+	}
+	BmBlockPool::GetStats( stats);
+	result.newCount = (sNewCount - newCount) / result.iterations;
+	result.newBytes = (sNewBytes - newBytes) / result.iterations;
+	result.poolHeapAllocs = stats.heapAllocs / result.iterations;
+
+	std::sort( latencies.begin(), latencies.end());
+	result.blockCount = 1;
+	result.blockMedian = latencies[latencies.size()/2];
+	result.blockP99 = latencies[(latencies.size()*99)/100];
+	result.blockMax = latencies.back();
+}
+
+/*------------------------------------------------------------------------------*\
+	main()
+		-
+\*------------------------------------------------------------------------------*/
+int main( int argc, char** argv) {
+	const char* BM_BENCH_APP_SIG = "application/x-vnd.zooey-benchbeam";
+
+	const char* filterPattern = NULL;
+	vector<int32> sizes;
+	bigtime_t minTime = 200*1000;
+	for( int i=1; i<argc; ++i) {
+		if (!strcmp( argv[i], "-f") && i+1 < argc)
+			filterPattern = argv[++i];
+		else if (!strcmp( argv[i], "-t") && i+1 < argc)
+			minTime = atol( argv[++i]) * 1000;
+		else if (!strcmp( argv[i], "-s") && i+1 < argc) {
+			for( char* s = strtok( argv[++i], ","); s; s = strtok( NULL, ","))
+				if (atol( s) > 0)
+					sizes.push_back( atol( s));
+		} else {
+			fprintf( stderr,
+						"This program measures the throughput of Beam's "
+						"memory-filters, of its mail-header parser and of "
+						"opening mails.\n"
+						"usage:\n\t%s [-f <filter-substring>] "
+						"[-s <size>[,<size>...]] [-t <min-millisecs>]\n",
+						argv[0]);
+			return 5;
+		}
+	}
+	if (sizes.empty()) {
+		sizes.push_back( 1024);
+		sizes.push_back( 16*1024);
+		sizes.push_back( 256*1024);
+		sizes.push_back( 4*1024*1024);
+	}
+
+	BmApplication* app = new BmApplication( BM_BENCH_APP_SIG, true);
+	// use the same settings as the tests:
+	ThePrefs->SetBool( "MakeQPSafeForEBCDIC", false);
+	BmRef<BenchNetJob> job( new BenchNetJob());
+
+	printf( "filter,input,input_bytes,output_bytes,iterations,mb_per_sec,"
+			  "new_count,new_bytes,pool_heap_allocs,blocks,"
+			  "block_usecs_median,block_usecs_p99,block_usecs_max\n");
+	for( uint32 s=0; s<sizes.size(); ++s) {
+		BmString inputs[INPUT_KIND_COUNT];
+		for( int32 k=0; k<INPUT_KIND_COUNT; ++k)
+			inputs[k] = GenerateInput( (InputKind)k, sizes[s]);
+		for( uint32 f=0; f<sizeof(BenchFilters)/sizeof(BenchFilter); ++f) {
+			const BenchFilter& benchFilter = BenchFilters[f];
+			if (filterPattern && !strstr( benchFilter.name, filterPattern))
+				continue;
+			const BmString& input = inputs[benchFilter.inputKind];
+			BenchResult result;
+			RunBenchmark( benchFilter, input, job.Get(), minTime, result);
+			double secs = double( result.totalTime) / 1000000.0;
+			double mbPerSec = secs > 0
+										? double( input.Length()) * result.iterations
+											/ (1024.0*1024.0) / secs
+										: 0.0;
+			printf( "%s,%s,%ld,%Ld,%ld,%.2f,%Ld,%Ld,%ld,%ld,%Ld,%Ld,%Ld\n",
+					  benchFilter.name, InputKindNames[benchFilter.inputKind],
+					  input.Length(), result.outputBytes, result.iterations,
+					  mbPerSec, result.newCount, result.newBytes,
+					  result.poolHeapAllocs, result.blockCount,
+					  result.blockMedian, result.blockP99, result.blockMax);
+			fflush( stdout);
+		}
+		if (!filterPattern || strstr( "MailHeader", filterPattern)) {
+			vector<BmString> headers;
+			GenerateMailbox( sizes[s], headers);
+			int32 inputSize = 0;
+			for( uint32 i=0; i<headers.size(); ++i)
+				inputSize += headers[i].Length();
+			BenchResult result;
+			RunHeaderBenchmark( headers, minTime, result);
+			double secs = double( result.totalTime) / 1000000.0;
+			double mbPerSec = secs > 0
+										? double( inputSize) * result.iterations
+											/ (1024.0*1024.0) / secs
+										: 0.0;
+			printf( "%s,%s,%ld,%Ld,%ld,%.2f,%Ld,%Ld,%ld,%ld,%Ld,%Ld,%Ld\n",
+					  "MailHeader", "mailbox", inputSize, result.outputBytes, 
+					  result.iterations, mbPerSec, result.newCount, 
+					  result.newBytes, result.poolHeapAllocs, result.blockCount,
+					  result.blockMedian, result.blockP99, result.blockMax);
+			fflush( stdout);
+		}
+		if (!filterPattern || strstr( "MailOpen", filterPattern)) {
+			// opening a mail with large attachments, once as header-only 
+			// filters (and storing the mail) do, once with the body-structure:
+			BmString mailText = GenerateMail( sizes[s]);
+			const char* modes[] = { "header-only", "with-body" };
+			for( int32 m=0; m<2; ++m) {
+				BenchResult result;
+				RunMailOpenBenchmark( mailText, m==1, minTime, result);
+				double secs = double( result.totalTime) / 1000000.0;
+				double mbPerSec = secs > 0
+											? double( mailText.Length()) * result.iterations
+												/ (1024.0*1024.0) / secs
+											: 0.0;
+				printf( "%s,%s,%ld,%Ld,%ld,%.2f,%Ld,%Ld,%ld,%ld,%Ld,%Ld,%Ld\n",
+						  "MailOpen", modes[m], mailText.Length(), 
+						  result.outputBytes, result.iterations, mbPerSec, 
+						  result.newCount, result.newBytes, result.poolHeapAllocs, 
+						  result.blockCount, result.blockMedian, result.blockP99, 
+						  result.blockMax);
+				fflush( stdout);
+			}
+		}
+	}
+
+	job = NULL;
+	delete app;
+	return 0;
+}
@@ -84,4 +84,19 @@ BinaryDecoderTest::SimpleTest()
 	BmString output( input);
 	DecodeAndCheck( input,
 						 output);
+	// check that the decoder passes blocks on by reference (without copying):
+	NextSubTest(); 
+	BmStringIBuf srcBuf( input);
+	BmBinaryDecoder decoder( &srcBuf, 16);
+	const char* block;
+	uint32 blockLen = 100;
+	CPPUNIT_ASSERT( decoder.ReadBlock( block, blockLen));
+	CPPUNIT_ASSERT( block == input.String() && blockLen == 16);
+	blockLen = 100;
+	CPPUNIT_ASSERT( decoder.ReadBlock( block, blockLen));
+	CPPUNIT_ASSERT( block == input.String()+16 && blockLen == 10);
+	CPPUNIT_ASSERT( decoder.SrcCount() == 26 && decoder.DestCount() == 26);
+	blockLen = 100;
+	CPPUNIT_ASSERT( decoder.ReadBlock( block, blockLen));
+	CPPUNIT_ASSERT( blockLen == 0 && decoder.IsAtEnd());
 }
@@ -0,0 +1,241 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+/*
+ * Beam's test-application is based on the OpenBeOS testing framework
+ * (which in turn is based on cppunit). Big thanks to everyone involved!
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "BoundaryScannerTest.h"
+#include "TestBeam.h"
+
+#include "BmBodyPartList.h"
+#include "BmStringView.h"
+
+// setUp
+void
+BoundaryScannerTest::setUp()
+{
+	inherited::setUp();
+}
+
+// tearDown
+void
+BoundaryScannerTest::tearDown()
+{
+	inherited::tearDown();
+}
+
+/*------------------------------------------------------------------------------*\
+	ScanWithStrstr()
+		-	the boundary-search BmBodyPart::SetTo() used to do (repeated strstr()
+			and a check of each line found), kept here as a reference for the
+			scanner
+\*------------------------------------------------------------------------------*/
+static bool ScanWithStrstr( const BmString& text, const BmString& param,
+									 int32 bodyStart, int32 bodyEnd,
+									 BmBoundaryScanner::PartVect& parts) {
+	parts.clear();
+	BmString boundary = BmString("--")+param;
+	BmStringView boundaryView( boundary);
+	const char* startPos = strstr( text.String()+bodyStart, boundary.String());
+	if (!startPos)
+		return false;
+	bool isLastBoundary = false;
+	const char* nPos = startPos;
+	int32 foundBoundaryLen;
+	int32 firstBoundaryLen=0;
+	while( !isLastBoundary) {
+		while( 1) {
+			foundBoundaryLen = boundary.Length();
+			if (*(nPos+foundBoundaryLen)=='-' 
+			&& *(nPos+foundBoundaryLen+1)=='-')
+				foundBoundaryLen+=2;
+			while (*(nPos+foundBoundaryLen)==' ' 
+			|| *(nPos+foundBoundaryLen)=='\t')
+				foundBoundaryLen++;
+			if (*(nPos+foundBoundaryLen)=='\r')
+				foundBoundaryLen++;
+			if (*(nPos+foundBoundaryLen)=='\n')
+				foundBoundaryLen++;
+			if (!firstBoundaryLen)
+				firstBoundaryLen = foundBoundaryLen;
+			nPos = strstr( nPos+foundBoundaryLen, boundary.String());
+			if (!nPos)
+				break;
+			if (*(nPos-1)=='\n') {
+				const char* endOfLine = strchr( nPos, '\r');
+				BmStringView checkLine( 
+					nPos, endOfLine ? endOfLine-nPos : strlen( nPos)
+				);
+				checkLine.Trim( false, true);
+				if (checkLine.Length() > 2 && checkLine.EndsWith( "--")
+				&& boundaryView.ICompare( 
+					checkLine.SubView( 0, checkLine.Length()-2)
+				)==0) {
+					isLastBoundary = true;
+					break;
+				}
+				if (boundaryView.ICompare( checkLine)==0)
+					break;
+			}
+		}
+		int32 startOffs = startPos-text.String()+firstBoundaryLen;
+		if (nPos) {
+			BmBoundaryScanner::Part part = { 
+				startOffs, 
+				std::max( (int32)0, int32(nPos-text.String())-startOffs-2)
+			};
+			parts.push_back( part);
+			startPos = nPos;
+		} else {
+			if (bodyEnd > startOffs) {
+				int32 nlPos=text.FindFirst( "\r\n", startOffs);
+				if (nlPos!=B_ERROR && nlPos<bodyEnd) {
+					BmBoundaryScanner::Part part = { 
+						startOffs, bodyEnd-startOffs
+					};
+					parts.push_back( part);
+				}
+			}
+			break;
+		}
+	}
+	return true;
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	
+\*------------------------------------------------------------------------------*/
+static void ScanAndCompare( const BmString& text, const BmString& param,
+									 int32 bodyStart, int32 bodyEnd) {
+	BmBoundaryScanner scanner( param);
+	BmBoundaryScanner::PartVect parts;
+	BmBoundaryScanner::PartVect refParts;
+	bool found = scanner.Scan( text, bodyStart, bodyEnd, parts);
+	bool refFound = ScanWithStrstr( text, param, bodyStart, bodyEnd, refParts);
+	bool same = found == refFound && parts.size() == refParts.size();
+	for( uint32 i=0; same && i<parts.size(); ++i)
+		same = parts[i].start == refParts[i].start
+					&& parts[i].length == refParts[i].length;
+	if (!same) {
+		printf( "\n\tboundary <%s>, body %ld-%ld: %ld parts instead of %ld\n", 
+				  param.String(), bodyStart, bodyEnd, (int32)parts.size(), 
+				  (int32)refParts.size());
+		DumpResult( text);
+	}
+	CPPUNIT_ASSERT( same);
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	
+\*------------------------------------------------------------------------------*/
+static void ScanAndCheck( const BmString& text, const BmString& param,
+								  const char* expectedParts) {
+	BmBoundaryScanner scanner( param);
+	BmBoundaryScanner::PartVect parts;
+	CPPUNIT_ASSERT( scanner.Scan( text, 0, text.Length(), parts));
+	BmString result;
+	for( uint32 i=0; i<parts.size(); ++i)
+		result << "[" << BmString( text.String()+parts[i].start, 
+											parts[i].length) << "]";
+	if (result != expectedParts)
+		DumpResult( result);
+	CPPUNIT_ASSERT( result == expectedParts);
+	ScanAndCompare( text, param, 0, text.Length());
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	
+\*------------------------------------------------------------------------------*/
+void
+BoundaryScannerTest::SimpleTest()
+{
+	// missing boundary:
+	NextSubTest();
+	BmBoundaryScanner::PartVect parts;
+	CPPUNIT_ASSERT( !BmBoundaryScanner( "xyz").Scan( "no parts\r\n", 0, 10, 
+																	 parts));
+	// two simple parts:
+	NextSubTest();
+	ScanAndCheck( "preamble\r\n--xyz\r\none\r\n--xyz\r\ntwo\r\n--xyz--\r\n", 
+					  "xyz", "[one][two]");
+	// trailing whitespace after boundaries:
+	NextSubTest();
+	ScanAndCheck( "--xyz \t\r\none\r\n--xyz \t\r\ntwo\r\n--xyz-- \r\n"
+					  "epilogue", 
+					  "xyz", "[one][two]");
+	// boundaries not starting a line or followed by text are part of the body:
+	NextSubTest();
+	ScanAndCheck( "--xyz\r\none --xyz\r\n--xyzz\r\n--xyz--x\r\n--xyz\r\ntwo\r\n"
+					  "--xyz--\r\n", 
+					  "xyz", "[one --xyz\r\n--xyzz\r\n--xyz--x][two]");
+	// the closing boundary is missing:
+	NextSubTest();
+	ScanAndCheck( "--xyz\r\none\r\n--xyz\r\ntwo\r\n", "xyz", "[one][two\r\n]");
+	// ...and the last part doesn't contain a linebreak:
+	NextSubTest();
+	ScanAndCheck( "--xyz\r\none\r\n--xyz\r\ntwo", "xyz", "[one]");
+	// empty parts:
+	NextSubTest();
+	ScanAndCheck( "--xyz\r\n--xyz\r\n\r\n--xyz--", "xyz", "[][]");
+	// with bare LF linebreaks only the final boundary is recognized:
+	NextSubTest();
+	ScanAndCheck( "--xyz\none\n--xyz\ntwo\n--xyz--\n", "xyz", 
+					  "[one\n--xyz\ntw]");
+	// boundaries ending with dashes:
+	NextSubTest();
+	ScanAndCheck( "--xyz-\r\none\r\n--xyz--\r\ntwo\r\n--xyz---\r\n", "xyz-", 
+					  "[one\r\n--xyz--\r\ntwo]");
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	
+\*------------------------------------------------------------------------------*/
+void
+BoundaryScannerTest::FuzzTest()
+{
+	// random texts made up from pieces that are likely to confuse the 
+	// boundary-detection must be split exactly like the strstr()-based
+	// implementation did:
+	const char* params[] = { "xyz", "=_a-", "-" };
+	const char* pieces[] = {
+		"--", "-", "\r", "\n", "\r\n", " ", "\t", "\v", "x", "y", "z", "xyz",
+		"=_a", "a-", "abc", "\r\n--", "\n--"
+	};
+	const int32 numPieces = sizeof( pieces) / sizeof( pieces[0]);
+	uint32 seed = 4711;
+	for( int32 i=0; i<6000; ++i) {
+		if (i % 200 == 0)
+			NextSubTest();
+		const char* param = params[i % 3];
+		BmString text;
+		seed = seed * 1103515245 + 12345;
+		int32 numItems = (seed >> 16) % 60;
+		for( int32 n=0; n<numItems; ++n) {
+			seed = seed * 1103515245 + 12345;
+			uint32 rnd = seed >> 16;
+			if (rnd % 5 == 0)
+				text << "--" << param;
+			else
+				text << pieces[rnd % numPieces];
+		}
+		seed = seed * 1103515245 + 12345;
+		int32 bodyStart = text.Length() ? (seed >> 16) % (text.Length()/2+1) : 0;
+		seed = seed * 1103515245 + 12345;
+		int32 bodyEnd = bodyStart + (seed >> 16) % (text.Length()-bodyStart+1);
+		ScanAndCompare( text, param, bodyStart, bodyEnd);
+	}
+}
@@ -0,0 +1,112 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+/*
+ * Beam's test-application is based on the OpenBeOS testing framework
+ * (which in turn is based on cppunit). Big thanks to everyone involved!
+ *
+ */
+
+#include <stdio.h>
+
+#include "split.hh"
+using namespace regexx;
+
+#include "CharsetDetectorTest.h"
+#include "TestBeam.h"
+
+#include "BmEncoding.h"
+
+// setUp
+void
+CharsetDetectorTest::setUp()
+{
+	inherited::setUp();
+}
+
+// tearDown
+void
+CharsetDetectorTest::tearDown()
+{
+	inherited::tearDown();
+}
+
+static void PickAndCheck( const BmString& text, const char* candidates, 
+								  int32 result);
+/*------------------------------------------------------------------------------*\
+	()
+		-	
+\*------------------------------------------------------------------------------*/
+static void PickAndCheck( const BmString& text, const char* candidates, 
+								  int32 result) {
+	BmEncoding::BmCharsetVect charsetVect;
+	split( ",", candidates, charsetVect);
+	BmCharsetDetector detector( text.String(), text.Length());
+	int32 index = detector.PickCharset( charsetVect);
+	if (index != result)
+		printf( "\n\tpicked %ld instead of %ld\n", index, result);
+	CPPUNIT_ASSERT( index == result);
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	
+\*------------------------------------------------------------------------------*/
+void
+CharsetDetectorTest::SimpleTest()
+{
+	// plain ascii fits the native charset:
+	NextSubTest();
+	PickAndCheck( "", "us-ascii,utf-8,iso-8859-1,us-ascii", 0);
+	NextSubTest();
+	PickAndCheck( "plain text\r\n", "us-ascii,utf-8,iso-8859-1,us-ascii", 0);
+	NextSubTest();
+	PickAndCheck( "plain text\r\n", "iso-8859-1,us-ascii,utf-8,iso-8859-1", 0);
+	// utf-8 labelled as us-ascii:
+	NextSubTest();
+	PickAndCheck( "Gr\xC3\xBC\xC3\x9F" "e", 
+					  "us-ascii,us-ascii,utf-8,iso-8859-1,us-ascii", 2);
+	// utf-8 labelled as iso-8859-1 (which would convert without errors, but
+	// would yield garbage):
+	NextSubTest();
+	PickAndCheck( "Gr\xC3\xBC\xC3\x9F" "e", 
+					  "iso-8859-1,us-ascii,utf-8,iso-8859-1", 2);
+	// ... but if utf-8 isn't a candidate, iso-8859-1 is still preferred:
+	NextSubTest();
+	PickAndCheck( "Gr\xC3\xBC\xC3\x9F" "e", "iso-8859-1,us-ascii,iso-8859-1", 
+					  0);
+	// latin-1 labelled as utf-8:
+	NextSubTest();
+	PickAndCheck( "Gr\xFC\xDF" "e", "utf-8,us-ascii,utf-8,iso-8859-15,utf-8", 
+					  3);
+	// a utf-8 char split at the end is invalid:
+	NextSubTest();
+	PickAndCheck( "Euro: \xE2\x82", "utf-8,us-ascii,iso-8859-15,utf-8", 2);
+	// windows-1252 labelled as iso-8859-1 (control chars):
+	NextSubTest();
+	PickAndCheck( "\x93quoted\x94", "iso-8859-1,windows-1252,iso-8859-1", 1);
+	NextSubTest();
+	PickAndCheck( "\x93quoted\x94", "iso-8859-1,us-ascii,iso-8859-1", 0);
+	// bytes undefined in windows-1252:
+	NextSubTest();
+	PickAndCheck( "\x81\x8D", "windows-1252,iso-8859-1,windows-1252", 1);
+	NextSubTest();
+	PickAndCheck( "\xA5", "iso-8859-3,iso-8859-2,iso-8859-3", 1);
+	// nothing fits, the last one is picked:
+	NextSubTest();
+	PickAndCheck( "\xFF", "us-ascii,utf-8,us-ascii", 2);
+	// unknown charsets can't be judged by the detector:
+	NextSubTest();
+	PickAndCheck( "\xE4", "utf-8,koi8-u,iso-8859-1,utf-8", -1);
+	NextSubTest();
+	PickAndCheck( "\xE4", "x-unknown,iso-8859-1,x-unknown", -1);
+	// but they don't matter if an earlier candidate fits:
+	NextSubTest();
+	PickAndCheck( "\xE4", "utf-8,iso-8859-1,x-unknown,utf-8", 1);
+	NextSubTest();
+	PickAndCheck( "\x93quoted\x94", "iso-8859-1,x-unknown,iso-8859-1", 0);
+}
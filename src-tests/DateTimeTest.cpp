@@ -0,0 +1,190 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+/*
+ * Beam's test-application is based on the OpenBeOS testing framework
+ * (which in turn is based on cppunit). Big thanks to everyone involved!
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <parsedate.h>
+
+#include <OS.h>
+
+#include "DateTimeTest.h"
+#include "TestBeam.h"
+
+#include "BmUtil.h"
+
+// setUp
+void
+DateTimeTest::setUp()
+{
+	inherited::setUp();
+}
+
+// tearDown
+void
+DateTimeTest::tearDown()
+{
+	inherited::tearDown();
+}
+
+struct DateTimeSample {
+	const char* text;
+	time_t utc;
+};
+
+// dates that must be understood without help from parsedate():
+static const DateTimeSample RfcDates[] = {
+	{ "Sat, 17 Oct 2026 12:11:10 +0200", 1792231870 },
+	{ "17 Oct 2026 12:11:10 +0200", 1792231870 },
+	{ "Sat,17 Oct 2026 12:11 -0930", 1792273260 },
+	{ "Tue, 1 Jan 2002 00:00:00 GMT", 1009843200 },
+	{ "Thu, 29 Feb 2024 23:59:59 UT", 1709251199 },
+	{ "Mon, 3 Mar 03 8:05:00 EST", 1046696700 },
+	{ "Wed, 31 Dec 99 23:59:59 PDT", 946709999 },
+	{ "Fri, 21 Nov 097 09:55:06 -0600", 880127706 },
+	// doubled timezones (BeMail) and comments:
+	{ "Sat, 17 Oct 2026 12:11:10 +0200 CEST", 1792231870 },
+	{ "Sat, 17 Oct 2026 12:11:10 +0200 (CEST)", 1792231870 },
+	{ "Sat (Saturday), 17 Oct (October) 2026 12 : 11 : 10 +0200 "
+	  "(Central (European) Summer Time)", 1792231870 },
+	{ "  saturday, 17 OCTOBER 2026 12:11:10 z  ", 1792239070 },
+	{ "Thu, 1 Jan 1970 00:00:00 +0000", 0 },
+	{ "Tue, 19 Jan 2038 03:14:07 +0000", 2147483647 },
+	{ NULL, 0 }
+};
+
+// dates that must be left to parsedate():
+static const char* OtherDates[] = {
+	"",
+	"Sat, 17 Oct 2026 12:11:10",
+	"Sat, 17 Oct 2026 12:11:10 CEST",
+	"Sat, 17 Oct 2026 12:11:10 +0200 2",
+	"Sat, 17 Oct 2026 12:11:10 +0200 (CEST",
+	"Sat, 17 Oct 2026 12:11:10 +02",
+	"Sat, 17 Oct 2026 12:11:10 +0260",
+	"Sat, 17 Oct 2026 24:00:00 +0200",
+	"Sat, 17 Oct 2026 12:60:00 +0200",
+	"Sat, 32 Oct 2026 12:11:10 +0200",
+	"Sun, 29 Feb 2026 12:11:10 +0200",
+	"Mon, 31 Apr 2026 12:11:10 +0200",
+	"Fri, 17 Oct 1969 12:11:10 +0200",
+	"Sam, 17 Oct 2026 12:11:10 +0200",
+	"Sat, 17 Okt 2026 12:11:10 +0200",
+	"Sat, 17 Oct 2026 12.11.10 +0200",
+	"2026-10-17 12:11:10 +0200",
+	"Sat Oct 17 12:11:10 2026",
+	NULL
+};
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	
+\*------------------------------------------------------------------------------*/
+void
+DateTimeTest::CorpusTest()
+{
+	for( int32 i=0; RfcDates[i].text; ++i) {
+		NextSubTest();
+		time_t t = -1;
+		BmString text( RfcDates[i].text);
+		CPPUNIT_ASSERT( ParseRfc822DateTime( text.String(), text.Length(), t));
+		CPPUNIT_ASSERT( t == RfcDates[i].utc);
+		t = -1;
+		CPPUNIT_ASSERT( ParseDateTime( text, t));
+		CPPUNIT_ASSERT( t == RfcDates[i].utc);
+	}
+	for( int32 i=0; OtherDates[i]; ++i) {
+		NextSubTest();
+		time_t t = -1;
+		CPPUNIT_ASSERT( !ParseRfc822DateTime( OtherDates[i], 
+														  strlen( OtherDates[i]), t));
+	}
+	// only the given length of the string is looked at:
+	NextSubTest();
+	time_t t = -1;
+	const char* text = "Sat, 17 Oct 2026 12:11:10 +0200 42";
+	CPPUNIT_ASSERT( ParseRfc822DateTime( text, strlen( text)-3, t));
+	CPPUNIT_ASSERT( t == 1792231870);
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	
+\*------------------------------------------------------------------------------*/
+void
+DateTimeTest::RoundtripTest()
+{
+	static const char* weekdays[] = {
+		"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"
+	};
+	static const char* months[] = {
+		"Jan", "Feb", "Mar", "Apr", "May", "Jun", 
+		"Jul", "Aug", "Sep", "Oct", "Nov", "Dec"
+	};
+	// walk through more than 60 years in steps of a bit more than a day, 
+	// such that every day of the month and every time of day is hit
+	// (starting with the second day, as the local time must not be before 
+	// the epoch):
+	uint32 seed = 4711;
+	for( time_t utc = 86400; utc < 2000000000; utc += 86400 + 3637) {
+		seed = seed*1103515245 + 12345;
+		int32 zoneOffset = (int32)((seed >> 16) % (25*60)) - 12*60;
+		zoneOffset -= zoneOffset % 15;
+		time_t local = utc + zoneOffset*60;
+		struct tm tm;
+		gmtime_r( &local, &tm);
+		char buf[64];
+		int32 zone = zoneOffset < 0 ? -zoneOffset : zoneOffset;
+		sprintf( buf, "%s, %d %s %04d %02d:%02d:%02d %c%02ld%02ld", 
+					weekdays[tm.tm_wday], tm.tm_mday, months[tm.tm_mon], 
+					tm.tm_year+1900, tm.tm_hour, tm.tm_min, tm.tm_sec, 
+					zoneOffset < 0 ? '-' : '+', zone / 60, zone % 60);
+		time_t t = -1;
+		bool ok = ParseRfc822DateTime( buf, strlen( buf), t);
+		if (!ok || t != utc) {
+			NextSubTest();
+			printf( "\n\t%s -> %ld (expected %ld)\n", buf, t, utc);
+			CPPUNIT_ASSERT( ok && t == utc);
+		}
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	
+\*------------------------------------------------------------------------------*/
+void
+DateTimeTest::SpeedTest()
+{
+	// the parser should be way faster than parsedate() alone (which used to
+	// be called up to three times, after up to three regex-replacements):
+	const int32 rounds = 2000;
+	bigtime_t fastTime = 0;
+	bigtime_t parsedateTime = 0;
+	for( int32 i=0; RfcDates[i].text; ++i) {
+		NextSubTest();
+		time_t t;
+		const char* text = RfcDates[i].text;
+		int32 len = strlen( text);
+		bigtime_t start = system_time();
+		for( int32 r=0; r<rounds; ++r)
+			ParseRfc822DateTime( text, len, t);
+		fastTime += system_time() - start;
+		start = system_time();
+		for( int32 r=0; r<rounds; ++r)
+			t = parsedate( text, -1);
+		parsedateTime += system_time() - start;
+	}
+	printf( "\n\tParseRfc822DateTime(): %Ld usecs, parsedate(): %Ld usecs\n",
+			  fastTime, parsedateTime);
+	CPPUNIT_ASSERT( fastTime < parsedateTime);
+}
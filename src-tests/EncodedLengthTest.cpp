@@ -0,0 +1,94 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+/*
+ * Beam's test-application is based on the OpenBeOS testing framework
+ * (which in turn is based on cppunit). Big thanks to everyone involved!
+ *
+ */
+
+#include <stdio.h>
+
+#include "EncodedLengthTest.h"
+#include "TestBeam.h"
+
+#include "BmEncoding.h"
+#include "BmMemIO.h"
+
+// setUp
+void
+EncodedLengthTest::setUp()
+{
+	inherited::setUp();
+}
+
+// tearDown
+void
+EncodedLengthTest::tearDown()
+{
+	inherited::tearDown();
+}
+
+static void EncodeAndCheck( const BmString& input, const char* encodingStyle);
+/*------------------------------------------------------------------------------*\
+	()
+		-	
+\*------------------------------------------------------------------------------*/
+static void EncodeAndCheck( const BmString& input, const char* encodingStyle) {
+	BmString encoded;
+	BmEncoding::Encode( encodingStyle, input, encoded);
+	char lastChar;
+	int32 len = BmEncoding::EncodedLength( encodingStyle, input.String(), 
+														input.Length(), lastChar);
+	char expectedLastChar = encoded.Length() ? encoded[encoded.Length()-1] : 0;
+	if (len != encoded.Length() || lastChar != expectedLastChar)
+		DumpResult( BmString( encodingStyle) << ": " << len << " instead of " 
+							<< encoded.Length() << " bytes for input of " 
+							<< input.Length() << " bytes");
+	CPPUNIT_ASSERT( len == encoded.Length());
+	CPPUNIT_ASSERT( lastChar == expectedLastChar);
+	// encoding the data as a stream must yield the same:
+	BmStringIBuf text( input);
+	char streamLastChar;
+	CPPUNIT_ASSERT( BmEncoding::EncodedLength( encodingStyle, &text, 
+															 streamLastChar) 
+							== len);
+	CPPUNIT_ASSERT( streamLastChar == lastChar);
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	
+\*------------------------------------------------------------------------------*/
+void
+EncodedLengthTest::SimpleTest()
+{
+	// the computed length must match the encoded data exactly, especially
+	// around the line-boundaries of base64 and quoted-printable:
+	const char* encodingStyles[] = {
+		"base64", "quoted-printable", "7bit", "8bit", "binary", NULL
+	};
+	const char* pieces[] = {
+		"\r\n", "\n", "\r", "=", " ", "\t", "\xc3\xa4", ".", "\xff"
+	};
+	for( int32 e=0; encodingStyles[e]; ++e) {
+		NextSubTest();
+		EncodeAndCheck( "", encodingStyles[e]);
+		BmString input;
+		for( int32 i=0; i<300; ++i) {
+			input.Append( "abcdefghijklmnopqrstuvwxyz0123456789", i % 41);
+			input.Append( pieces[i % 9]);
+			NextSubTest();
+			EncodeAndCheck( input, encodingStyles[e]);
+		}
+		// lengths around a full base64-line:
+		for( int32 len=50; len<64; ++len) {
+			NextSubTest();
+			EncodeAndCheck( BmString().SetTo( 'x', len), encodingStyles[e]);
+		}
+	}
+}
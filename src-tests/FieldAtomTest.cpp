@@ -0,0 +1,175 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+/*
+ * Beam's test-application is based on the OpenBeOS testing framework
+ * (which in turn is based on cppunit). Big thanks to everyone involved!
+ *
+ */
+
+#include <map>
+#include <set>
+
+#include "FieldAtomTest.h"
+#include "TestBeam.h"
+
+#include "BmMailHeader.h"
+#include "BmStringView.h"
+
+// setUp
+void
+FieldAtomTest::setUp()
+{
+	inherited::setUp();
+}
+
+// tearDown
+void
+FieldAtomTest::tearDown()
+{
+	inherited::tearDown();
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	
+\*------------------------------------------------------------------------------*/
+void
+FieldAtomTest::SimpleTest()
+{
+	// names that differ in case only yield the same atom:
+	NextSubTest();
+	CPPUNIT_ASSERT( BmFieldAtom( "subject") == BmFieldAtom( "Subject"));
+	CPPUNIT_ASSERT( BmFieldAtom( "SUBJECT") == BmFieldAtom( BmString("sUbJeCt")));
+	CPPUNIT_ASSERT( BmFieldAtom( "Subject").Id() == BmFieldAtom( "subject").Id());
+	CPPUNIT_ASSERT( BmFieldAtom( "Subject") != BmFieldAtom( "Subjects"));
+	CPPUNIT_ASSERT( BmFieldAtom( "To") != BmFieldAtom( "Cc"));
+	CPPUNIT_ASSERT( BmFieldAtom( "") == BmFieldAtom( BmString()));
+	// views need not be null-terminated:
+	NextSubTest();
+	BmString line( "reply-to: someone");
+	CPPUNIT_ASSERT( BmFieldAtom( BmStringView( line, 0, 8)) 
+							== BmFieldAtom( "Reply-To"));
+	CPPUNIT_ASSERT( BmFieldAtom( BmStringView( line, 0, 5)) 
+							== BmFieldAtom( "REPLY"));
+	// the name is kept in capitalized form:
+	NextSubTest();
+	CPPUNIT_ASSERT( BmFieldAtom( "content-TYPE").Name() == "Content-Type");
+	CPPUNIT_ASSERT( BmFieldAtom( "mime-version").Name() == "Mime-Version");
+	CPPUNIT_ASSERT( BmFieldAtom( "x-spam-flag").Name() == "X-Spam-Flag");
+	// address-fields:
+	NextSubTest();
+	CPPUNIT_ASSERT( BmFieldAtom( "to").IsAddressField());
+	CPPUNIT_ASSERT( BmFieldAtom( "RESENT-FROM").IsAddressField());
+	CPPUNIT_ASSERT( BmFieldAtom( "list-id").IsAddressField());
+	CPPUNIT_ASSERT( !BmFieldAtom( "Subject").IsAddressField());
+	CPPUNIT_ASSERT( !BmFieldAtom( "Too").IsAddressField());
+	CPPUNIT_ASSERT( !BmFieldAtom( "T").IsAddressField());
+	// identification-fields:
+	NextSubTest();
+	CPPUNIT_ASSERT( BmFieldAtom( "message-id").IsIdentificationField());
+	CPPUNIT_ASSERT( BmFieldAtom( "References").IsIdentificationField());
+	CPPUNIT_ASSERT( !BmFieldAtom( "Resent-Message-Id").IsIdentificationField());
+	// fields that must not be encoded:
+	NextSubTest();
+	CPPUNIT_ASSERT( !BmFieldAtom( "content-disposition").IsEncodingOk());
+	CPPUNIT_ASSERT( !BmFieldAtom( "Content-X-Whatever").IsEncodingOk());
+	CPPUNIT_ASSERT( !BmFieldAtom( "received").IsEncodingOk());
+	CPPUNIT_ASSERT( !BmFieldAtom( "Resent-Date").IsEncodingOk());
+	CPPUNIT_ASSERT( BmFieldAtom( "Subject").IsEncodingOk());
+	CPPUNIT_ASSERT( BmFieldAtom( "Contents").IsEncodingOk());
+	// fields that must not be stripped:
+	NextSubTest();
+	CPPUNIT_ASSERT( !BmFieldAtom( "subject").IsStrippingOk());
+	CPPUNIT_ASSERT( !BmFieldAtom( "x-mailer").IsStrippingOk());
+	CPPUNIT_ASSERT( !BmFieldAtom( "X-Priority").IsStrippingOk());
+	CPPUNIT_ASSERT( BmFieldAtom( "From").IsStrippingOk());
+	CPPUNIT_ASSERT( BmFieldAtom( "Comments").IsStrippingOk());
+	CPPUNIT_ASSERT( BmFieldAtom( "Comments").IsEncodingOk());
+	CPPUNIT_ASSERT( !BmFieldAtom( "Comments").IsAddressField());
+	CPPUNIT_ASSERT( !BmFieldAtom( "Comments").IsIdentificationField());
+	// lookups yield interned atoms for known names only:
+	NextSubTest();
+	CPPUNIT_ASSERT( BmFieldAtom::Lookup( "SUBJECT") == BmFieldAtom( "Subject"));
+	CPPUNIT_ASSERT( !BmFieldAtom::Lookup( "SUBJECT").IsCustom());
+	CPPUNIT_ASSERT( BmFieldAtom::Lookup( "SUBJECT").Id() 
+							== BmFieldAtom( "Subject").Id());
+	BmFieldAtom custom = BmFieldAtom::Lookup( "x-lookup-only");
+	CPPUNIT_ASSERT( custom.IsCustom());
+	CPPUNIT_ASSERT( custom.Id() == -1);
+	CPPUNIT_ASSERT( custom.Name() == "X-Lookup-Only");
+	CPPUNIT_ASSERT( !custom.IsStrippingOk());
+	CPPUNIT_ASSERT( BmFieldAtom::Lookup( "X-LOOKUP-ONLY").IsCustom());
+	CPPUNIT_ASSERT( custom == BmFieldAtom::Lookup( "X-LOOKUP-ONLY"));
+	CPPUNIT_ASSERT( custom != BmFieldAtom::Lookup( "x-lookup-other"));
+	CPPUNIT_ASSERT( custom != BmFieldAtom( "Subject"));
+	CPPUNIT_ASSERT( BmFieldAtom::Lookup( "resent-to").IsAddressField());
+	// custom atoms still match the name once it has been interned:
+	NextSubTest();
+	BmFieldAtom interned( "X-Lookup-Only");
+	CPPUNIT_ASSERT( !interned.IsCustom());
+	CPPUNIT_ASSERT( custom == interned && interned == custom);
+	CPPUNIT_ASSERT( !(custom < interned) && !(interned < custom));
+	CPPUNIT_ASSERT( BmFieldAtom::Lookup( "x-lookup-only") == interned);
+	CPPUNIT_ASSERT( !BmFieldAtom::Lookup( "x-lookup-only").IsCustom());
+	// custom and interned atoms of the same name share their hash, so they 
+	// end up in the same place of a map:
+	NextSubTest();
+	CPPUNIT_ASSERT( custom.Hash() == interned.Hash());
+	CPPUNIT_ASSERT( BmFieldAtom::Lookup( "x-hash-test").Hash() 
+							== BmFieldAtom::FoldedHash( "X-HASH-TEST", 11));
+	map< BmFieldAtom, int32> atomMap;
+	atomMap[BmFieldAtom::Lookup( "x-hash-test")] = 1;
+	atomMap[BmFieldAtom( "Subject")] = 2;
+	atomMap[custom] = 3;
+	CPPUNIT_ASSERT( atomMap.size() == 3);
+	CPPUNIT_ASSERT( atomMap[BmFieldAtom::Lookup( "X-Hash-Test")] == 1);
+	CPPUNIT_ASSERT( atomMap[BmFieldAtom::Lookup( "SUBJECT")] == 2);
+	CPPUNIT_ASSERT( atomMap[interned] == 3);
+	CPPUNIT_ASSERT( atomMap.size() == 3);
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	
+\*------------------------------------------------------------------------------*/
+void
+FieldAtomTest::TableTest()
+{
+	// intern lots of names (forcing the table to grow several times) and 
+	// check that every name still maps onto its own atom afterwards:
+	const int32 count = 5000;
+	vector< BmFieldAtom> atoms;
+	set< int32> ids;
+	NextSubTest();
+	for( int32 i=0; i<count; ++i) {
+		BmString name = BmString("x-test-field-") << i;
+		atoms.push_back( BmFieldAtom( name));
+		ids.insert( atoms.back().Id());
+	}
+	CPPUNIT_ASSERT( ids.size() == (uint32)count);
+	NextSubTest();
+	for( int32 i=0; i<count; ++i) {
+		BmString name = BmString("X-TEST-FIELD-") << i;
+		BmFieldAtom atom( name);
+		CPPUNIT_ASSERT( atom == atoms[i]);
+		CPPUNIT_ASSERT( atom.Name() == (BmString("X-Test-Field-") << i));
+		CPPUNIT_ASSERT( !atom.IsStrippingOk());
+		CPPUNIT_ASSERT( !(atom < atoms[i]) && !(atoms[i] < atom));
+	}
+	// atoms are ordered by their hash (and by name if the hashes collide),
+	// so distinct atoms are never equivalent:
+	NextSubTest();
+	for( int32 i=1; i<count; ++i) {
+		CPPUNIT_ASSERT( (atoms[i-1] < atoms[i]) != (atoms[i] < atoms[i-1]));
+		if (atoms[i-1].Hash() != atoms[i].Hash())
+			CPPUNIT_ASSERT( (atoms[i-1] < atoms[i]) 
+								== (atoms[i-1].Hash() < atoms[i].Hash()));
+	}
+	set< BmFieldAtom> atomSet( atoms.begin(), atoms.end());
+	CPPUNIT_ASSERT( atomSet.size() == (uint32)count);
+}
@@ -0,0 +1,199 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+/*
+ * Beam's test-application is based on the OpenBeOS testing framework
+ * (which in turn is based on cppunit). Big thanks to everyone involved!
+ *
+ */
+
+#include <DataIO.h>
+
+#include "HeaderBlockTest.h"
+#include "TestBeam.h"
+
+#include "BmMail.h"
+#include "BmMailHeader.h"
+
+// setUp
+void
+HeaderBlockTest::setUp()
+{
+	inherited::setUp();
+}
+
+// tearDown
+void
+HeaderBlockTest::tearDown()
+{
+	inherited::tearDown();
+}
+
+static void ReadHeaderAndCheck( const BmString& mailText, 
+										  const BmString& result, int32 rawLength);
+/*------------------------------------------------------------------------------*\
+	()
+		-	
+\*------------------------------------------------------------------------------*/
+static void ReadHeaderAndCheck( const BmString& mailText, 
+										  const BmString& result, int32 rawLength) {
+	BMallocIO mailFile;
+	mailFile.Write( mailText.String(), mailText.Length());
+	BmString headerText;
+	int32 headerLength = -1;
+	CPPUNIT_ASSERT( BmMailHeader::ReadHeaderBlock( mailFile, headerText, 
+																  &headerLength) == B_OK);
+	try {
+		CPPUNIT_ASSERT( headerText == result);
+		CPPUNIT_ASSERT( headerLength == rawLength);
+	} catch( ...) {
+		DumpResult( headerText);
+		throw;
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	
+\*------------------------------------------------------------------------------*/
+void
+HeaderBlockTest::SimpleTest()
+{
+	// empty file:
+	NextSubTest();
+	ReadHeaderAndCheck( "", "", 0);
+	// standard mail with CRLF:
+	NextSubTest();
+	ReadHeaderAndCheck( "From: a@b.c\r\nSubject: hi\r\n\r\nbody\r\n\r\nmore\r\n",
+							  "From: a@b.c\r\nSubject: hi\r\n", 26);
+	// mail written by some other program with LF only:
+	NextSubTest();
+	ReadHeaderAndCheck( "From: a@b.c\nSubject: hi\n\nbody\n",
+							  "From: a@b.c\r\nSubject: hi\r\n", 24);
+	// folded fields stay as they are:
+	NextSubTest();
+	ReadHeaderAndCheck( "Subject: a\r\n folded\r\n\tline\r\n\r\nbody",
+							  "Subject: a\r\n folded\r\n\tline\r\n", 28);
+	// a mail without a body:
+	NextSubTest();
+	ReadHeaderAndCheck( "From: a@b.c\r\nTo: d@e.f\r\n",
+							  "From: a@b.c\r\nTo: d@e.f\r\n", 24);
+	NextSubTest();
+	ReadHeaderAndCheck( "From: a@b.c\nTo: d@e.f",
+							  "From: a@b.c\r\nTo: d@e.f", 21);
+	// binary nulls are replaced by spaces:
+	NextSubTest();
+	BmString nullText( "Subject: a_b\r\n\r\nbody");
+	nullText.ReplaceAll( '_', '\0');
+	ReadHeaderAndCheck( nullText, "Subject: a b\r\n", 14);
+	// a mail starting with an empty line has no header at all:
+	NextSubTest();
+	ReadHeaderAndCheck( "\r\nbody\r\n\r\nmore\r\n", "", 0);
+	ReadHeaderAndCheck( "\nbody\n\nmore\n", "", 0);
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	
+\*------------------------------------------------------------------------------*/
+void
+HeaderBlockTest::BlockBorderTest()
+{
+	// the header-block is read in chunks, the empty line must be found
+	// wherever it sits relative to the chunk-borders:
+	BmString body;
+	for( int32 i=0; i<200; ++i)
+		body << "a line of the body, which is never looked at\r\n";
+	for( int32 lf=0; lf<2; ++lf) {
+		const char* nl = lf ? "\n" : "\r\n";
+		for( int32 len=4080; len<4110; ++len) {
+			NextSubTest();
+			BmString rawHeader = BmString("Subject: ") << nl;
+			BmString header = "Subject: \r\n";
+			BmString padding;
+			int32 padLen = len - rawHeader.Length() - strlen("X-Pad: ") 
+								- strlen( nl);
+			padding.SetTo( 'x', padLen);
+			rawHeader << "X-Pad: " << padding << nl;
+			header << "X-Pad: " << padding << "\r\n";
+			ReadHeaderAndCheck( BmString(rawHeader) << nl << body, header,
+									  rawHeader.Length());
+		}
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	
+\*------------------------------------------------------------------------------*/
+void
+HeaderBlockTest::AttributesTest()
+{
+	// a header reduced to the attribute-fields must yield the same 
+	// attribute-values as the complete header:
+	BmString headerText 
+		= "Received: from somewhere by elsewhere; "
+			"Tue, 1 Jun 2004 12:34:56 +0200\r\n"
+		  "From: \"Some One\" <someone@example.org>\r\n"
+		  "To: other@example.org, \"Third Party\" <third@example.org>\r\n"
+		  "CC: group: a@example.org, b@example.org;\r\n"
+		  "Subject: =?iso-8859-1?q?Gr=FC=DFe?=\r\n"
+		  "  aus Berlin\r\n"
+		  "Date: Tue, 1 Jun 2004 12:34:56 +0200\r\n"
+		  "Message-ID: <1234@example.org>\r\n"
+		  "x-priority: 2 (High)\r\n"
+		  "X-Mailer: Some Mailer\r\n"
+		  "Mime-Version: 1.0\r\n";
+	BmRef<BmMailHeader> fullHeader( new BmMailHeader( headerText, NULL));
+	BmRef<BmMailHeader> attrHeader 
+		= BmMailHeader::CreateForAttributes( headerText);
+	NextSubTest();
+	CPPUNIT_ASSERT( attrHeader->Name() == "Some One");
+	CPPUNIT_ASSERT( attrHeader->Name() == fullHeader->Name());
+	NextSubTest();
+	const BmFieldAtom* fields[] = {
+		&BM_ATOM_FROM, &BM_ATOM_TO, &BM_ATOM_CC, &BM_ATOM_REPLY_TO, 
+		&BM_ATOM_SUBJECT, &BM_ATOM_MIME, &BM_ATOM_DATE, NULL
+	};
+	for( int32 i=0; fields[i]; ++i) {
+		CPPUNIT_ASSERT( attrHeader->GetFieldVal( *fields[i]) 
+								== fullHeader->GetFieldVal( *fields[i]));
+	}
+	CPPUNIT_ASSERT( attrHeader->GetFieldVal( BM_ATOM_SUBJECT) 
+							== "Grüße aus Berlin");
+	NextSubTest();
+	CPPUNIT_ASSERT( attrHeader->Priority() == "2 (High)");
+	CPPUNIT_ASSERT( attrHeader->Priority() == fullHeader->Priority());
+	CPPUNIT_ASSERT( attrHeader->When( 0) == 1086086096);
+	CPPUNIT_ASSERT( attrHeader->When( 0) == fullHeader->When( 0));
+	// fields that aren't needed for the attributes are skipped:
+	NextSubTest();
+	CPPUNIT_ASSERT( fullHeader->CountFieldVals( BM_ATOM_RECEIVED) == 1);
+	CPPUNIT_ASSERT( attrHeader->CountFieldVals( BM_ATOM_RECEIVED) == 0);
+	CPPUNIT_ASSERT( attrHeader->CountFieldVals( BM_ATOM_MESSAGE_ID) == 0);
+	CPPUNIT_ASSERT( attrHeader->CountFieldVals( BM_ATOM_X_MAILER) == 0);
+	// without a date, the given default is used:
+	NextSubTest();
+	attrHeader = BmMailHeader::CreateForAttributes( "From: a@b.c\r\n");
+	CPPUNIT_ASSERT( attrHeader->When( 4711) == 4711);
+	CPPUNIT_ASSERT( attrHeader->Priority() == "3");
+	CPPUNIT_ASSERT( attrHeader->Name() == "a@b.c");
+	// the priority is kept as is, but can be reduced to a single digit:
+	NextSubTest();
+	attrHeader = BmMailHeader::CreateForAttributes( "X-Priority: 5 (Lowest)\r\n");
+	CPPUNIT_ASSERT( attrHeader->Priority() == "5 (Lowest)");
+	CPPUNIT_ASSERT( BmMailHeader::SimplifyPriority( attrHeader->Priority()) 
+							== "5");
+	attrHeader = BmMailHeader::CreateForAttributes( "Priority: high\r\n");
+	CPPUNIT_ASSERT( attrHeader->Priority() == "2");
+	attrHeader = BmMailHeader::CreateForAttributes( "X-Priority: Highest\r\n");
+	CPPUNIT_ASSERT( attrHeader->Priority() == "Highest");
+	CPPUNIT_ASSERT( BmMailHeader::SimplifyPriority( "Highest") == "1");
+	CPPUNIT_ASSERT( BmMailHeader::SimplifyPriority( "low") == "4");
+	CPPUNIT_ASSERT( BmMailHeader::SimplifyPriority( "whatever") == "3");
+	CPPUNIT_ASSERT( BmMailHeader::SimplifyPriority( "") == "3");
+}
@@ -11,9 +11,16 @@
  *
  */
 
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
 #include "MemIoTest.h"
 #include "TestBeam.h"
 
+#include "BmBasics.h"
+#include "BmBlockPool.h"
+#include "BmFilterPipeline.h"
 #include "BmMemIO.h"
 
 // setUp
@@ -101,3 +108,519 @@ void MemIoTest::RingBufTest() {
 	CheckRingBuf( ringBuf, 1, '4', '4', '4', 0);
 	CheckRingBuf( ringBuf, 0, '\0', '\0', '\0', 0);
 }
+
+/*------------------------------------------------------------------------------*\
+	BlockPoolTest()
+		-	checks that filter buffers and strings are recycled within a parse 
+			arena and that the arena releases them when it is closed
+\*------------------------------------------------------------------------------*/
+void MemIoTest::BlockPoolTest() {
+	BmBlockPool::ReleaseCachedBlocks();
+	BmBlockPool::ResetStats();
+	BmBlockPool::Stats stats;
+
+	// outside of an arena, only a few blocks are being kept:
+	NextSubTest();
+	const int32 count = 16;
+	char* blocks[count];
+	CPPUNIT_ASSERT( count > 2*BmBlockPool::nMaxIdleBlocks);
+	for( int32 i=0; i<count; ++i)
+		blocks[i] = BmBlockPool::Allocate( BmMemFilter::nBlockSize);
+	for( int32 i=0; i<count; ++i)
+		BmBlockPool::Free( blocks[i], BmMemFilter::nBlockSize);
+	BmBlockPool::GetStats( stats);
+	CPPUNIT_ASSERT( stats.heapAllocs == count);
+	CPPUNIT_ASSERT( stats.cachedBlocks == BmBlockPool::nMaxIdleBlocks);
+	CPPUNIT_ASSERT( stats.heapFrees == count - BmBlockPool::nMaxIdleBlocks);
+
+	// within an arena, all blocks are recycled...
+	NextSubTest();
+	BmBlockPool::ReleaseCachedBlocks();
+	BmBlockPool::ResetStats();
+	{
+		BmParseArena arena;
+		for( int32 round=0; round<100; ++round) {
+			for( int32 i=0; i<count; ++i)
+				blocks[i] = BmBlockPool::Allocate( BmMemFilter::nBlockSize);
+			for( int32 i=0; i<count; ++i)
+				BmBlockPool::Free( blocks[i], BmMemFilter::nBlockSize);
+		}
+		BmBlockPool::GetStats( stats);
+		CPPUNIT_ASSERT( stats.heapAllocs == count);
+		CPPUNIT_ASSERT( stats.cacheHits == 99*count);
+		CPPUNIT_ASSERT( stats.cachedBlocks == count);
+	}
+	// ...until the arena is closed, which releases all of them:
+	BmBlockPool::GetStats( stats);
+	CPPUNIT_ASSERT( stats.cachedBlocks == 0);
+	CPPUNIT_ASSERT( stats.heapFrees == count);
+	CPPUNIT_ASSERT( stats.arenasClosed == 1);
+
+	// nested arenas are released by the outermost one only:
+	NextSubTest();
+	{
+		BmParseArena outerArena;
+		{
+			BmParseArena innerArena;
+			for( int32 i=0; i<count; ++i)
+				blocks[i] = BmBlockPool::Allocate( 1000);
+			for( int32 i=0; i<count; ++i)
+				BmBlockPool::Free( blocks[i], 1000);
+		}
+		BmBlockPool::GetStats( stats);
+		CPPUNIT_ASSERT( stats.arenasClosed == 1);
+		CPPUNIT_ASSERT( stats.cachedBlocks == count);
+	}
+	BmBlockPool::GetStats( stats);
+	CPPUNIT_ASSERT( stats.arenasClosed == 2);
+	CPPUNIT_ASSERT( stats.cachedBlocks == 0);
+
+	// the arena leaves the cache with the blocks it had when it was opened:
+	NextSubTest();
+	blocks[0] = BmBlockPool::Allocate( 1000);
+	BmBlockPool::Free( blocks[0], 1000);
+	{
+		BmParseArena arena;
+		for( int32 i=0; i<count; ++i)
+			blocks[i] = BmBlockPool::Allocate( 1000);
+		for( int32 i=0; i<count; ++i)
+			BmBlockPool::Free( blocks[i], 1000);
+	}
+	BmBlockPool::GetStats( stats);
+	CPPUNIT_ASSERT( stats.cachedBlocks == 1);
+	BmBlockPool::ReleaseCachedBlocks();
+
+	// within an arena, larger strings are taken from the pool...
+	NextSubTest();
+	BmBlockPool::ResetStats();
+	BmString kept;
+	{
+		BmParseArena arena;
+		for( int32 round=0; round<10; ++round) {
+			BmString str;
+			str.SetTo( 'x', 10000);
+			BmStringOBuf buf( 1000);
+			buf.Write( str);
+			buf.Write( str);
+			CPPUNIT_ASSERT( buf.TheString().Length() == 20000);
+		}
+		BmBlockPool::GetStats( stats);
+		CPPUNIT_ASSERT( stats.heapAllocs < 10);
+		CPPUNIT_ASSERT( stats.cacheHits >= 9*2);
+		kept.SetTo( 'y', 10000);
+	}
+	// ...and stay valid after the arena has been closed:
+	BmBlockPool::GetStats( stats);
+	CPPUNIT_ASSERT( stats.cachedBlocks == 0);
+	CPPUNIT_ASSERT( kept.Length() == 10000 && kept[9999] == 'y');
+	kept.Append( 'z', 10000);
+	CPPUNIT_ASSERT( kept.Length() == 20000 && kept[9999] == 'y' 
+						 && kept[19999] == 'z');
+	kept = "";
+	BmBlockPool::ReleaseCachedBlocks();
+	// short strings never use the pool:
+	{
+		BmParseArena arena;
+		BmBlockPool::ResetStats();
+		BmString str;
+		str.SetTo( 'x', 100);
+		BmBlockPool::GetStats( stats);
+		CPPUNIT_ASSERT( stats.heapAllocs == 0 && stats.cacheHits == 0);
+	}
+
+	// blocks that are too large bypass the pool:
+	NextSubTest();
+	char* huge = BmBlockPool::Allocate( 2*BmBlockPool::nMaxBlockSize);
+	CPPUNIT_ASSERT( huge != NULL);
+	BmBlockPool::Free( huge, 2*BmBlockPool::nMaxBlockSize);
+	BmBlockPool::GetStats( stats);
+	CPPUNIT_ASSERT( stats.cachedBlocks == 0);
+
+	printf( "\n\tblock-pool: %ld heap-allocs, %ld cache-hits, %ld heap-frees, "
+			  "peak of %ld bytes cached",
+			  stats.heapAllocs, stats.cacheHits, stats.heapFrees, 
+			  stats.peakCachedBytes);
+	fflush( stdout);
+	BmBlockPool::ReleaseCachedBlocks();
+}
+
+/*------------------------------------------------------------------------------*\
+	test filters for the pipeline tests
+\*------------------------------------------------------------------------------*/
+class RotFilter : public BmMemFilter {
+public:
+	RotFilter( BmMemIBuf* input, uint32 blockSize, int32 rounds=1)
+		:	BmMemFilter( input, blockSize)
+		,	mRounds( rounds)				{}
+protected:
+	void Filter( const char* srcBuf, uint32& srcLen, 
+					 char* destBuf, uint32& destLen) {
+		uint32 len = min_c( srcLen, destLen);
+		for( uint32 i=0; i<len; ++i) {
+			unsigned char c = srcBuf[i];
+			for( int32 r=0; r<mRounds; ++r)
+				c = (c>='a' && c<='z') ? 'a'+(c-'a'+1)%26 : c;
+			destBuf[i] = c;
+		}
+		srcLen = destLen = len;
+	}
+	int32 mRounds;
+};
+
+class ExpandLFFilter : public BmMemFilter {
+public:
+	ExpandLFFilter( BmMemIBuf* input, uint32 blockSize)
+		:	BmMemFilter( input, blockSize, nTagImmediatePassOn)	{}
+protected:
+	void Filter( const char* srcBuf, uint32& srcLen, 
+					 char* destBuf, uint32& destLen) {
+		uint32 src = 0;
+		uint32 dest = 0;
+		while( src<srcLen && dest<destLen) {
+			if (srcBuf[src] == '\n') {
+				if (dest+2 > destLen)
+					break;
+				destBuf[dest++] = '\r';
+			}
+			destBuf[dest++] = srcBuf[src++];
+		}
+		srcLen = src;
+		destLen = dest;
+	}
+};
+
+class TrailerFilter : public BmMemFilter {
+public:
+	TrailerFilter( BmMemIBuf* input, uint32 blockSize)
+		:	BmMemFilter( input, blockSize)	{}
+protected:
+	void Filter( const char* srcBuf, uint32& srcLen, 
+					 char* destBuf, uint32& destLen) {
+		uint32 len = min_c( srcLen, destLen);
+		memcpy( destBuf, srcBuf, len);
+		srcLen = destLen = len;
+	}
+	void Finalize( char* destBuf, uint32& destLen) {
+		char trailer[32];
+		uint32 len = sprintf( trailer, "<%lu>", (unsigned long)SrcCount());
+		if (destLen < len) {
+			// try again with more room:
+			destLen = 0;
+			return;
+		}
+		memcpy( destBuf, trailer, len);
+		destLen = len;
+		mIsFinalized = true;
+	}
+};
+
+class FailingFilter : public BmMemFilter {
+public:
+	FailingFilter( BmMemIBuf* input, uint32 blockSize, uint32 failAt)
+		:	BmMemFilter( input, blockSize)
+		,	mFailAt( failAt)				{}
+protected:
+	void Filter( const char* srcBuf, uint32& srcLen, 
+					 char* destBuf, uint32& destLen) {
+		if (SrcCount()+srcLen >= mFailAt)
+			BM_THROW_RUNTIME( "FailingFilter: failed as planned");
+		uint32 len = min_c( srcLen, destLen);
+		memcpy( destBuf, srcBuf, len);
+		srcLen = destLen = len;
+	}
+	uint32 mFailAt;
+};
+
+class StallingIBuf : public BmMemIBuf {
+public:
+	StallingIBuf()
+		:	mStopped( false)					{}
+	uint32 Read( char*, uint32) {
+		// like a network connection without traffic:
+		while( !mStopped)
+			snooze( 1000);
+		return 0;
+	}
+	bool IsAtEnd()							{ return mStopped; }
+	void Stop()								{ mStopped = true; }
+private:
+	volatile bool mStopped;
+};
+
+static BmString PipelineTestInput( int32 size) {
+	BmString input;
+	char* buf = input.LockBuffer( size);
+	uint32 seed = 4711;
+	for( int32 i=0; i<size; ++i) {
+		seed = seed*1103515245 + 12345;
+		uint32 r = (seed >> 16) % 40;
+		buf[i] = r < 26 ? 'a'+r : (r < 34 ? ' ' : (r < 38 ? '\n' : '.'));
+	}
+	input.UnlockBuffer( size);
+	return input;
+}
+
+/*------------------------------------------------------------------------------*\
+	PipelineOrderingTest()
+		-	checks that a pipelined filter chain yields exactly the same output
+			as the serial one (for different block sizes and queue depths)
+\*------------------------------------------------------------------------------*/
+void MemIoTest::PipelineOrderingTest() {
+	const uint32 filterBlockSizes[] = { 16, 100, 4096, 65536 };
+	const uint32 pipeBlockSizes[] = { 16, 33, 1000, 65536 };
+	const int32 queueDepths[] = { 2, 3, 8 };
+	const int32 inputSizes[] = { 0, 1, 17, 5000, 300000 };
+	for( uint32 in=0; in<sizeof(inputSizes)/sizeof(int32); ++in) {
+		BmString input = PipelineTestInput( inputSizes[in]);
+		for( uint32 fb=0; fb<sizeof(filterBlockSizes)/sizeof(uint32); ++fb) {
+			uint32 blockSize = filterBlockSizes[fb];
+			// serial chain as reference:
+			BmString expected;
+			{
+				BmStringIBuf src( input);
+				RotFilter rot( &src, blockSize);
+				ExpandLFFilter expand( &rot, blockSize);
+				TrailerFilter trailer( &expand, blockSize);
+				BmStringOBuf dest( input.Length()+128);
+				dest.Write( &trailer);
+				expected = dest.TheString();
+			}
+			for( uint32 pb=0; pb<sizeof(pipeBlockSizes)/sizeof(uint32); ++pb) {
+				for( uint32 qd=0; qd<sizeof(queueDepths)/sizeof(int32); ++qd) {
+					NextSubTest();
+					BmStringIBuf src( input);
+					RotFilter rot( &src, blockSize);
+					ExpandLFFilter expand( &rot, blockSize);
+					TrailerFilter trailer( &expand, blockSize);
+					BmFilterPipeline pipeline( pipeBlockSizes[pb], queueDepths[qd]);
+					pipeline.AddStage( &rot);
+					pipeline.AddStage( &expand);
+					pipeline.AddStage( &trailer);
+					CPPUNIT_ASSERT( pipeline.CountStages() == 3);
+					BmStringOBuf dest( input.Length()+128);
+					dest.Write( &pipeline);
+					CPPUNIT_ASSERT( dest.TheString() == expected);
+					CPPUNIT_ASSERT( pipeline.IsAtEnd());
+					CPPUNIT_ASSERT( trailer.SrcCount() == expand.DestCount());
+				}
+			}
+		}
+	}
+
+	// stopping a pipeline in the middle of the data must not hang:
+	NextSubTest();
+	BmString input = PipelineTestInput( 1000000);
+	for( int32 i=0; i<20; ++i) {
+		BmStringIBuf src( input);
+		RotFilter rot( &src, 4096);
+		ExpandLFFilter expand( &rot, 4096);
+		BmFilterPipeline pipeline( 1024, 2);
+		pipeline.AddStage( &rot);
+		pipeline.AddStage( &expand);
+		char buf[100];
+		for( int32 r=0; r<i; ++r)
+			CPPUNIT_ASSERT( pipeline.Read( buf, sizeof(buf)) > 0);
+		pipeline.Stop();
+		// the stages must not be left reading from the deleted queues:
+		CPPUNIT_ASSERT( expand.Input() == &rot);
+	}
+
+	// stopping a pipeline whose source blocks must not hang either:
+	NextSubTest();
+	{
+		StallingIBuf src;
+		RotFilter rot( &src, 4096);
+		ExpandLFFilter expand( &rot, 4096);
+		BmFilterPipeline pipeline( 1024, 2);
+		pipeline.AddStage( &rot);
+		pipeline.AddStage( &expand);
+		CPPUNIT_ASSERT( pipeline.Start() == B_OK);
+		snooze( 10000);
+		pipeline.Stop();
+		CPPUNIT_ASSERT( src.IsAtEnd());
+	}
+
+	// an exception in a stage reaches the reader:
+	NextSubTest();
+	for( int32 i=0; i<3; ++i) {
+		int32 failAt = 1+100000*i;
+		BmStringIBuf src( input);
+		RotFilter rot( &src, 4096);
+		FailingFilter failing( &rot, 4096, failAt);
+		ExpandLFFilter expand( &failing, 4096);
+		BmFilterPipeline pipeline( 1024, 2);
+		pipeline.AddStage( &rot);
+		pipeline.AddStage( &failing);
+		pipeline.AddStage( &expand);
+		BmStringOBuf dest( input.Length());
+		bool caught = false;
+		try {
+			dest.Write( &pipeline);
+		} catch( BM_runtime_error& err) {
+			caught = true;
+		}
+		CPPUNIT_ASSERT( caught);
+		CPPUNIT_ASSERT( failing.SrcCount() < (uint32)failAt);
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	PipelineThroughputBenchmark()
+		-	compares the throughput of a serial and a pipelined filter chain
+\*------------------------------------------------------------------------------*/
+void MemIoTest::PipelineThroughputBenchmark() {
+	const int32 size = 8*1024*1024;
+	const int32 rounds = 8;
+	BmString input = PipelineTestInput( size);
+
+	NextSubTest();
+	bigtime_t start = system_time();
+	BmString serialOutput;
+	{
+		BmStringIBuf src( input);
+		RotFilter rot1( &src, BmMemFilter::nBlockSize, rounds);
+		RotFilter rot2( &rot1, BmMemFilter::nBlockSize, rounds);
+		ExpandLFFilter expand( &rot2, BmMemFilter::nBlockSize);
+		BmStringOBuf dest( size+size/8);
+		dest.Write( &expand);
+		serialOutput.Adopt( dest.TheString());
+	}
+	bigtime_t serialTime = max_c( system_time() - start, 1);
+
+	start = system_time();
+	BmString pipelinedOutput;
+	{
+		BmStringIBuf src( input);
+		RotFilter rot1( &src, BmMemFilter::nBlockSize, rounds);
+		RotFilter rot2( &rot1, BmMemFilter::nBlockSize, rounds);
+		ExpandLFFilter expand( &rot2, BmMemFilter::nBlockSize);
+		BmFilterPipeline pipeline;
+		pipeline.AddStage( &rot1);
+		pipeline.AddStage( &rot2);
+		pipeline.AddStage( &expand);
+		BmStringOBuf dest( size+size/8);
+		dest.Write( &pipeline);
+		pipelinedOutput.Adopt( dest.TheString());
+	}
+	bigtime_t pipelinedTime = max_c( system_time() - start, 1);
+	CPPUNIT_ASSERT( serialOutput == pipelinedOutput);
+
+	printf( "\n\tfilter-chain: serial %ld MB/s, pipelined %ld MB/s",
+			  (int32)((bigtime_t)size * 1000000 / serialTime / (1024*1024)),
+			  (int32)((bigtime_t)size * 1000000 / pipelinedTime / (1024*1024)));
+	fflush( stdout);
+}
+
+/*------------------------------------------------------------------------------*\
+	MappedFileIBufTest()
+		-	checks reading from a memory-mapped file (by copy and by reference)
+\*------------------------------------------------------------------------------*/
+void MemIoTest::MappedFileIBufTest() {
+	const char* path = "/tmp/beam_test_mapped_file";
+	BmString contents = PipelineTestInput( 200000);
+	FILE* file = fopen( path, "w");
+	CPPUNIT_ASSERT( file != NULL);
+	fwrite( contents.String(), 1, contents.Length(), file);
+	fclose( file);
+
+	// a missing file yields an error:
+	NextSubTest();
+	{
+		BmMappedFileIBuf mapped( "/tmp/beam_test_no_such_file");
+		CPPUNIT_ASSERT( mapped.InitCheck() != B_OK);
+		CPPUNIT_ASSERT( mapped.IsAtEnd());
+	}
+
+	// the complete file is available via Data():
+	NextSubTest();
+	{
+		BmMappedFileIBuf mapped( path);
+		CPPUNIT_ASSERT( mapped.InitCheck() == B_OK);
+		CPPUNIT_ASSERT( mapped.IsMapped());
+		CPPUNIT_ASSERT( mapped.Size() == contents.Length());
+		CPPUNIT_ASSERT( memcmp( mapped.Data(), contents.String(), 
+										contents.Length()) == 0);
+	}
+
+	// reading by copy:
+	NextSubTest();
+	{
+		BmMappedFileIBuf mapped( path);
+		BmStringOBuf dest( 1000);
+		char buf[777];
+		while( !mapped.IsAtEnd()) {
+			uint32 len = mapped.Read( buf, sizeof(buf));
+			CPPUNIT_ASSERT( len > 0);
+			dest.Write( buf, len);
+		}
+		CPPUNIT_ASSERT( dest.TheString() == contents);
+	}
+
+	// reading by reference hands out the mapping itself:
+	NextSubTest();
+	{
+		BmMappedFileIBuf mapped( path);
+		const char* block;
+		uint32 len = 1000;
+		CPPUNIT_ASSERT( mapped.ReadBlock( block, len));
+		CPPUNIT_ASSERT( len == 1000 && block == mapped.Data());
+		BmStringOBuf dest( 1000);
+		dest.Write( block, len);
+		dest.Write( &mapped);
+		CPPUNIT_ASSERT( dest.TheString() == contents);
+	}
+
+	// a filter can read straight from the mapping:
+	NextSubTest();
+	{
+		BmString expected;
+		{
+			BmStringIBuf src( contents);
+			ExpandLFFilter expand( &src, 4096);
+			BmStringOBuf dest( 1000);
+			dest.Write( &expand);
+			expected = dest.TheString();
+		}
+		BmMappedFileIBuf mapped( path);
+		ExpandLFFilter expand( &mapped, 4096);
+		BmStringOBuf dest( 1000);
+		dest.Write( &expand);
+		CPPUNIT_ASSERT( dest.TheString() == expected);
+	}
+
+	// a file that may change is read, not mapped:
+	NextSubTest();
+	{
+		BmMappedFileIBuf mapped( path, true);
+		CPPUNIT_ASSERT( mapped.InitCheck() == B_OK);
+		CPPUNIT_ASSERT( !mapped.IsMapped());
+		CPPUNIT_ASSERT( mapped.Size() == contents.Length());
+		BmStringOBuf dest( 1000);
+		dest.Write( &mapped);
+		CPPUNIT_ASSERT( dest.TheString() == contents);
+	}
+	// ...so it may even shrink while being read:
+	{
+		BmMappedFileIBuf mapped( path, true);
+		char buf[1000];
+		CPPUNIT_ASSERT( mapped.Read( buf, sizeof(buf)) == sizeof(buf));
+		CPPUNIT_ASSERT( truncate( path, 5000) == 0);
+		BmStringOBuf dest( 1000);
+		dest.Write( buf, sizeof(buf));
+		dest.Write( &mapped);
+		CPPUNIT_ASSERT( mapped.IsAtEnd());
+		CPPUNIT_ASSERT( dest.TheString() == BmString( contents.String(), 5000));
+	}
+
+	// empty files are fine, too:
+	NextSubTest();
+	file = fopen( path, "w");
+	fclose( file);
+	{
+		BmMappedFileIBuf mapped( path);
+		CPPUNIT_ASSERT( mapped.InitCheck() == B_OK);
+		CPPUNIT_ASSERT( mapped.Size() == 0);
+		CPPUNIT_ASSERT( mapped.IsAtEnd());
+	}
+	remove( path);
+}
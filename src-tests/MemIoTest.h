@@ -27,6 +27,10 @@ class MemIoTest : public BTestCase
 	CPPUNIT_TEST( StringIBufTest);
 	CPPUNIT_TEST( StringOBufTest);
 	CPPUNIT_TEST( RingBufTest);
+	CPPUNIT_TEST( BlockPoolTest);
+	CPPUNIT_TEST( PipelineOrderingTest);
+	CPPUNIT_TEST( PipelineThroughputBenchmark);
+	CPPUNIT_TEST( MappedFileIBufTest);
 	CPPUNIT_TEST_SUITE_END();
 public:
 //	static CppUnit::Test* Suite();
@@ -43,6 +47,10 @@ public:
 	void StringIBufTest();
 	void StringOBufTest();
 	void RingBufTest();
+	void BlockPoolTest();
+	void PipelineOrderingTest();
+	void PipelineThroughputBenchmark();
+	void MappedFileIBufTest();
 };
 
 
@@ -11,10 +11,15 @@
  *
  */
 
+#include <OS.h>
+
+#include <stdio.h>
+
 #include "QuotedPrintableDecoderTest.h"
 #include "TestBeam.h"
 
 #include "BmEncoding.h"
+#include "BmStringSearch.h"
 
 static bool IsEncodedWord = false;
 
@@ -231,3 +236,37 @@ QuotedPrintableDecoderTest::LargeDataTest() {
 	NextSubTest(); 
 	DecodeQpAndCheck( input, result);
 }
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	
+\*------------------------------------------------------------------------------*/
+void
+QuotedPrintableDecoderTest::KernelTest() {
+	if (!HaveTestdata)
+		return;
+	Activator activate(LargeDataMode);
+	BmString input;
+	SlurpFile("testdata.qp_encoded", input);
+	BmString result;
+	SlurpFile("testdata.qp_decoded", result);
+	// every kernel must yield the intended result, the throughput of the
+	// fast path (which skips over the plain chars) is printed, too:
+	BmStringSearch::Kernel bestKernel = BmStringSearch::ActiveKernel();
+	for( int32 k=0; k<BmStringSearch::KERNEL_COUNT; ++k) {
+		BmStringSearch::Kernel kernel = static_cast<BmStringSearch::Kernel>(k);
+		if (!BmStringSearch::SelectKernel( kernel))
+			continue;
+		NextSubTest();
+		const int32 rounds = 10;
+		bigtime_t start = system_time();
+		for( int32 r=0; r<rounds; ++r)
+			DecodeQpAndCheck( input, result);
+		bigtime_t usecs = max_c( system_time() - start, 1);
+		printf( "\n\t%s qp-decode: %.1f MB/s",
+				  BmStringSearch::KernelName( kernel),
+				  1.0 * input.Length() * rounds / usecs);
+		fflush( stdout);
+	}
+	BmStringSearch::SelectKernel( bestKernel);
+}
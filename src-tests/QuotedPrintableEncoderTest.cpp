@@ -11,10 +11,15 @@
  *
  */
 
+#include <OS.h>
+
+#include <stdio.h>
+
 #include "QuotedPrintableEncoderTest.h"
 #include "TestBeam.h"
 
 #include "BmEncoding.h"
+#include "BmStringSearch.h"
 
 /*
  *
@@ -301,3 +306,37 @@ QuotedPrintableEncoderTest::LargeDataTest() {
 	NextSubTest();
 	EncodeQpAndCheck( input, result);
 }
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	
+\*------------------------------------------------------------------------------*/
+void
+QuotedPrintableEncoderTest::KernelTest() {
+	if (!HaveTestdata)
+		return;
+	Activator activate(LargeDataMode);
+	BmString input;
+	SlurpFile("testdata.qp_decoded", input);
+	BmString result;
+	SlurpFile("testdata.qp_encoded", result);
+	// every kernel must yield the intended result, the throughput of the
+	// fast path (which skips over the plain chars) is printed, too:
+	BmStringSearch::Kernel bestKernel = BmStringSearch::ActiveKernel();
+	for( int32 k=0; k<BmStringSearch::KERNEL_COUNT; ++k) {
+		BmStringSearch::Kernel kernel = static_cast<BmStringSearch::Kernel>(k);
+		if (!BmStringSearch::SelectKernel( kernel))
+			continue;
+		NextSubTest();
+		const int32 rounds = 10;
+		bigtime_t start = system_time();
+		for( int32 r=0; r<rounds; ++r)
+			EncodeQpAndCheck( input, result);
+		bigtime_t usecs = max_c( system_time() - start, 1);
+		printf( "\n\t%s qp-encode: %.1f MB/s",
+				  BmStringSearch::KernelName( kernel),
+				  1.0 * input.Length() * rounds / usecs);
+		fflush( stdout);
+	}
+	BmStringSearch::SelectKernel( bestKernel);
+}
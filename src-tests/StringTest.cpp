@@ -11,12 +11,19 @@
  *
  */
 
+#include <OS.h>
 #include <UTF8.h>
 
+#include <stdio.h>
+
 #include "StringTest.h"
 #include "TestBeam.h"
 
+#include "BmMail.h"
+#include "BmMailHeader.h"
 #include "BmString.h"
+#include "BmStringSearch.h"
+#include "BmStringView.h"
 
 // setUp
 void
@@ -71,6 +78,45 @@ StringTest::StringBeamExtensionsTest(void)
 		) == 0
 	);
 
+	NextSubTest();
+	// linebreaks at and across the (16-byte) block borders of the byte 
+	// kernels, which must agree with the scalar implementation:
+	BmStringSearch::Kernel bestKernel = BmStringSearch::ActiveKernel();
+	BmString blockLF( "\n123456789012345\r\n23456789012345\n\n2345678901234\r");
+	blockLF << "\n";
+	BmString blockCopy( blockLF);
+	blockLF << blockCopy << blockCopy;
+	BmString blockCRLF[2];
+	BmString blockBack[2];
+	for( int32 k=0; k<2; ++k) {
+		BmStringSearch::SelectKernel( k ? bestKernel
+													: BmStringSearch::KERNEL_SCALAR);
+		blockCRLF[k].ConvertLinebreaksToCRLF( &blockLF);
+		blockBack[k].ConvertLinebreaksToLF( &blockCRLF[k]);
+	}
+	BmStringSearch::SelectKernel( bestKernel);
+	CPPUNIT_ASSERT( blockCRLF[0] == blockCRLF[1]);
+	CPPUNIT_ASSERT( blockBack[0] == blockBack[1]);
+	CPPUNIT_ASSERT( blockCRLF[0].Length() == blockLF.Length() + 9);
+	CPPUNIT_ASSERT( blockBack[0].Length() == blockLF.Length() - 6);
+	CPPUNIT_ASSERT( blockBack[0].FindFirst( "\r\n") == B_ERROR);
+
+	NextSubTest();
+	// scrubbing binary nulls (like BmMail does):
+	BmString nulls;
+	char* buf = nulls.LockBuffer( 40);
+	memset( buf, 'x', 40);
+	buf[0] = buf[16] = buf[17] = buf[39] = '\0';
+	nulls.UnlockBuffer( 40);
+	nulls.ReplaceAll( '\0', ' ');
+	CPPUNIT_ASSERT( nulls.Length() == 40);
+	CPPUNIT_ASSERT( strlen( nulls.String()) == 40);
+	CPPUNIT_ASSERT( nulls[0] == ' ' && nulls[16] == ' ' && nulls[17] == ' '
+						 && nulls[39] == ' ' && nulls[38] == 'x');
+	nulls.Replace( ' ', '_', 2, 1);
+	CPPUNIT_ASSERT( nulls[0] == ' ' && nulls[16] == '_' && nulls[17] == '_'
+						 && nulls[39] == ' ');
+
 	NextSubTest();
 	BmString tabs( "this\t is a small\r test of\t\ttabs-conversion\r\n");
 	tabs.ConvertTabsToSpaces( 4);
@@ -166,3 +212,237 @@ StringTest::StringBeamExtensionsTest(void)
 	trim.Trim( false, false);
 	CPPUNIT_ASSERT( strcmp( trim.String(), "          x x x         ") == 0);
 }
+
+/*------------------------------------------------------------------------------*\
+	ParseHeaders( rounds)
+		-	parses a typical mail-header over and over again
+\*------------------------------------------------------------------------------*/
+static void ParseHeaders( int32 rounds) {
+	BmString headerText(
+		"Return-Path: <list-bounces@lists.example.org>\r\n"
+		"Received: from mail.example.org (mail.example.org [10.0.0.1])\r\n"
+		"\tby mx.example.com with ESMTP id 4711\r\n"
+		"\tfor <me@example.com>; Tue, 14 Mar 2006 10:12:03 +0100\r\n"
+		"Date: Tue, 14 Mar 2006 10:11:58 +0100\r\n"
+		"From: Some Body <some.body@example.org>\r\n"
+		"To: me@example.com, You <you@example.com>\r\n"
+		"Cc: list@lists.example.org\r\n"
+		"Subject: =?iso-8859-1?q?Gr=FC=DFe?= from the list\r\n"
+		"Message-Id: <20060314101158.1234@example.org>\r\n"
+		"Mime-Version: 1.0\r\n"
+		"Content-Type: text/plain; charset=\"iso-8859-1\"\r\n"
+		"Content-Transfer-Encoding: 8bit\r\n"
+		"X-Priority: 3\r\n"
+		"List-Id: <list.lists.example.org>\r\n"
+	);
+	for( int32 i=0; i<rounds; ++i) {
+		BmRef<BmMailHeader> header( new BmMailHeader( headerText, NULL));
+		CPPUNIT_ASSERT( header->GetFieldVal( BM_FIELD_X_PRIORITY) == "3");
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	LoadMailRefs( rounds)
+		-	emulates loading a folder full of mail-refs (key and attributes)
+\*------------------------------------------------------------------------------*/
+static void LoadMailRefs( int32 rounds) {
+	const char* attrs[] = {
+		"New", "3", "pop.example.org", "Some Body", "me@example.com",
+		"Genuine", "4711", "4.2 KB", NULL
+	};
+	for( int32 i=0; i<rounds; ++i) {
+		BmString key = BmString() << int64(100000+i);
+		BmString vals[8];
+		for( int32 a=0; attrs[a]; ++a) {
+			int32 len = strlen( attrs[a]);
+			char* buf = vals[a].LockBuffer( len+1);
+			memcpy( buf, attrs[a], len+1);
+			vals[a].UnlockBuffer( len);
+		}
+		CPPUNIT_ASSERT( key.Length() == 6 && vals[0] == "New");
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	RunAllocBenchmark( what, workload, rounds)
+		-	runs the given workload without and with the inline buffer and 
+			prints the time used and the number of heap-allocations of both 
+			runs
+		-	the inline buffer can only be switched off (and allocations are 
+			only counted) in debug builds, otherwise only the time is printed
+\*------------------------------------------------------------------------------*/
+static void RunAllocBenchmark( const char* what, void (*workload)( int32), 
+										 int32 rounds) {
+#if DEBUG
+	BmString::UseInlineBuffer( false);
+	BmString::ResetAllocCounts();
+	bigtime_t start = system_time();
+	workload( rounds);
+	bigtime_t heapOnlyUsecs = system_time() - start;
+	int32 heapOnlyCount = BmString::HeapAllocCount();
+	BmString::UseInlineBuffer( true);
+	BmString::ResetAllocCounts();
+	start = system_time();
+	workload( rounds);
+	bigtime_t usecs = system_time() - start;
+	printf( "\n\t%s: %Ld usecs, %ld heap-allocs "
+			  "(without inline buffer: %Ld usecs, %ld heap-allocs)",
+			  what, usecs, BmString::HeapAllocCount(), heapOnlyUsecs, 
+			  heapOnlyCount);
+	CPPUNIT_ASSERT( BmString::HeapAllocCount() <= heapOnlyCount);
+#else
+	bigtime_t start = system_time();
+	workload( rounds);
+	printf( "\n\t%s: %Ld usecs", what, system_time() - start);
+#endif
+	fflush( stdout);
+}
+
+/*------------------------------------------------------------------------------*\
+	StringAllocBenchmark()
+		-	measures the number of string allocations (and the time needed)
+			for typical hot paths: header parsing and loading mail-refs
+\*------------------------------------------------------------------------------*/
+void 
+StringTest::StringAllocBenchmark(void)
+{
+	const int32 rounds = LargeDataMode ? 10000 : 1000;
+
+	NextSubTest();
+	RunAllocBenchmark( "header parsing", ParseHeaders, rounds);
+
+	NextSubTest();
+	RunAllocBenchmark( "mail-ref loading", LoadMailRefs, rounds*10);
+#if DEBUG
+	CPPUNIT_ASSERT( BmString::InlineAllocCount() > 0);
+#endif
+
+	// check that strings crossing the inline/heap boundary behave:
+	NextSubTest();
+	BmString grow( "short");
+	for( int32 i=0; i<10; ++i)
+		grow << "0123456789";
+	CPPUNIT_ASSERT( grow.Length() == 105);
+	grow.Truncate( 3, false);
+	CPPUNIT_ASSERT( grow == "sho");
+	BmString adopted;
+	adopted.Adopt( grow);
+	CPPUNIT_ASSERT( adopted == "sho" && grow.Length() == 0);
+	BmString copy( adopted);
+	copy << "rt and long enough to live on the heap";
+	CPPUNIT_ASSERT( adopted == "sho");
+	CPPUNIT_ASSERT( copy == "short and long enough to live on the heap");
+}
+
+/*------------------------------------------------------------------------------*\
+	StringViewTest()
+		-	
+\*------------------------------------------------------------------------------*/
+void 
+StringTest::StringViewTest(void)
+{
+	BmString str( "  Content-Type: text/plain; CHARSET=utf-8 \r\n");
+
+	NextSubTest();
+	BmStringView view( str, 2, 12);
+	CPPUNIT_ASSERT( view.Length() == 12);
+	CPPUNIT_ASSERT( view.ToString() == "Content-Type");
+	CPPUNIT_ASSERT( view.Compare( "Content-Type") == 0);
+	CPPUNIT_ASSERT( view.ICompare( "content-type") == 0);
+	CPPUNIT_ASSERT( view.ICompare( "content-typ") > 0);
+	CPPUNIT_ASSERT( view.Compare( "Content-Typf") < 0);
+
+	NextSubTest();
+	BmStringView full( str);
+	CPPUNIT_ASSERT( full.FindFirst( ':') == 14);
+	CPPUNIT_ASSERT( full.FindFirst( "text") == 16);
+	CPPUNIT_ASSERT( full.FindFirst( "text", 17) == B_ERROR);
+	CPPUNIT_ASSERT( full.IFindFirst( "charset") == 28);
+	CPPUNIT_ASSERT( full.FindFirst( "charset") == B_ERROR);
+	CPPUNIT_ASSERT( full.FindLast( ';') == 26);
+
+	NextSubTest();
+	// views are not null-terminated, searching must stop at their end:
+	BmStringView part( str, 0, 20);
+	CPPUNIT_ASSERT( part.FindFirst( "plain") == B_ERROR);
+	CPPUNIT_ASSERT( part.FindFirst( ';') == B_ERROR);
+	CPPUNIT_ASSERT( part.SubView( 16).ToString() == "text");
+
+	NextSubTest();
+	full.Trim();
+	CPPUNIT_ASSERT( full.StartsWith( "Content"));
+	CPPUNIT_ASSERT( full.EndsWith( "utf-8"));
+	CPPUNIT_ASSERT( full.ToString() == "Content-Type: text/plain; CHARSET=utf-8");
+	BmStringView empty( "   ");
+	empty.Trim();
+	CPPUNIT_ASSERT( empty.IsEmpty() && empty.ToString().Length() == 0);
+}
+
+/*------------------------------------------------------------------------------*\
+	CountMatches()
+		-	counts all (case-sensitive or -insensitive) occurrences of str 
+			in text
+\*------------------------------------------------------------------------------*/
+static int32 CountMatches( const BmString& text, const char* str, 
+									bool ignoreCase) {
+	int32 count = 0;
+	int32 len = strlen( str);
+	for( int32 pos = 0; 
+			(pos = ignoreCase 
+				? text.IFindFirst( str, pos) 
+				: text.FindFirst( str, pos)) != B_ERROR; 
+			pos += len)
+		count++;
+	return count;
+}
+
+/*------------------------------------------------------------------------------*\
+	StringSearchBenchmark()
+		-	compares the throughput of all search kernels supported by this 
+			CPU on the testdata corpus (and checks that they agree)
+\*------------------------------------------------------------------------------*/
+void 
+StringTest::StringSearchBenchmark(void)
+{
+	BmString text;
+	if (HaveTestdata) {
+		SlurpFile( "testdata.qp_decoded", text);
+		// mail text always uses CRLF, so we do too:
+		text.ConvertLinebreaksToCRLF();
+	} else {
+		for( int32 i=0; i<20000; ++i)
+			text << "Subject: this is just some filler text\r\n";
+		text << "\r\n\r\nBoundary-Marker";
+	}
+	const char* needles[] = { "\r\n\r\n", "boundary", "=?iso-8859-1?", NULL };
+	BmStringSearch::Kernel bestKernel = BmStringSearch::ActiveKernel();
+	int32 refCounts[6];
+	for( int32 k=0; k<BmStringSearch::KERNEL_COUNT; ++k) {
+		BmStringSearch::Kernel kernel = static_cast<BmStringSearch::Kernel>(k);
+		if (!BmStringSearch::SelectKernel( kernel))
+			continue;
+		NextSubTest();
+		for( int32 n=0; needles[n]; ++n) {
+			for( int32 ignoreCase=0; ignoreCase<2; ++ignoreCase) {
+				const int32 rounds = 10;
+				int32 count = 0;
+				bigtime_t start = system_time();
+				for( int32 r=0; r<rounds; ++r)
+					count = CountMatches( text, needles[n], ignoreCase);
+				bigtime_t usecs = max_c( system_time() - start, 1);
+				int32 idx = n*2+ignoreCase;
+				if (k == BmStringSearch::KERNEL_SCALAR)
+					refCounts[idx] = count;
+				else
+					CPPUNIT_ASSERT( count == refCounts[idx]);
+				printf( "\n\t%s %s(\"%s\"): %ld matches, %.1f MB/s",
+						  BmStringSearch::KernelName( kernel),
+						  ignoreCase ? "IFindFirst" : "FindFirst",
+						  n == 0 ? "\\r\\n\\r\\n" : needles[n], count,
+						  1.0 * text.Length() * rounds / usecs);
+			}
+		}
+		fflush( stdout);
+	}
+	BmStringSearch::SelectKernel( bestKernel);
+}
@@ -25,6 +25,9 @@ class StringTest : public BTestCase
 	typedef TestCase inherited;
 	CPPUNIT_TEST_SUITE( StringTest );
 	CPPUNIT_TEST( StringBeamExtensionsTest);
+	CPPUNIT_TEST( StringAllocBenchmark);
+	CPPUNIT_TEST( StringViewTest);
+	CPPUNIT_TEST( StringSearchBenchmark);
 	CPPUNIT_TEST_SUITE_END();
 public:
 //	static CppUnit::Test* Suite();
@@ -39,6 +42,9 @@ public:
 	// Test functions
 	//------------------------------------------------------------
 	void StringBeamExtensionsTest();
+	void StringAllocBenchmark();
+	void StringViewTest();
+	void StringSearchBenchmark();
 };
 
 
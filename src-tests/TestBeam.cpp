@@ -34,12 +34,19 @@ using namespace regexx;
 
 #include "TestBeam.h"
 
+#include "AddressParserTest.h"
 #include "Base64DecoderTest.h"
 #include "Base64EncoderTest.h"
 #include "BinaryDecoderTest.h"
 #include "BinaryEncoderTest.h"
+#include "BoundaryScannerTest.h"
+#include "CharsetDetectorTest.h"
+#include "DateTimeTest.h"
+#include "EncodedLengthTest.h"
 #include "EncodedWordEncoderTest.h"
+#include "FieldAtomTest.h"
 #include "FoldedLineEncoderTest.h"
+#include "HeaderBlockTest.h"
 #include "LinebreakDecoderTest.h"
 #include "LinebreakEncoderTest.h"
 #include "MailMonitorTest.h"
@@ -49,6 +56,7 @@ using namespace regexx;
 #include "QuotedPrintableEncoderTest.h"
 #include "SieveTest.h"
 #include "StringTest.h"
+#include "TextBodyDecoderTest.h"
 #include "Utf8DecoderTest.h"
 #include "Utf8EncoderTest.h"
 
@@ -138,10 +146,24 @@ BTestSuite* CreateMailParserTestSuite() {
 						BinaryDecoderTest::suite());
 	suite->addTest("Encoding::BinaryEncoder", 
 						BinaryEncoderTest::suite());
+	suite->addTest("MailParser::BoundaryScanner", 
+						BoundaryScannerTest::suite());
+	suite->addTest("Encoding::CharsetDetector", 
+						CharsetDetectorTest::suite());
+	suite->addTest("MailHeader::AddressParser", 
+						AddressParserTest::suite());
+	suite->addTest("MailHeader::DateTime", 
+						DateTimeTest::suite());
+	suite->addTest("Encoding::EncodedLength", 
+						EncodedLengthTest::suite());
 	suite->addTest("Encoding::EncodedWordEncoder", 
 						EncodedWordEncoderTest::suite());
+	suite->addTest("MailHeader::FieldAtom", 
+						FieldAtomTest::suite());
 	suite->addTest("Encoding::FoldedLineEncoder", 
 						FoldedLineEncoderTest::suite());
+	suite->addTest("MailHeader::HeaderBlock", 
+						HeaderBlockTest::suite());
 	suite->addTest("Encoding::LinebreakDecoder", 
 						LinebreakDecoderTest::suite());
 	suite->addTest("Encoding::LinebreakEncoder", 
@@ -150,6 +172,8 @@ BTestSuite* CreateMailParserTestSuite() {
 						QuotedPrintableDecoderTest::suite());
 	suite->addTest("Encoding::QuotedPrintableEncoder", 
 						QuotedPrintableEncoderTest::suite());
+	suite->addTest("Encoding::TextBodyDecoder", 
+						TextBodyDecoderTest::suite());
 	suite->addTest("Encoding::Utf8Decoder", 
 						Utf8DecoderTest::suite());
 	suite->addTest("Encoding::Utf8Encoder", 
@@ -0,0 +1,185 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+/*
+ * Beam's test-application is based on the OpenBeOS testing framework
+ * (which in turn is based on cppunit). Big thanks to everyone involved!
+ *
+ */
+
+#include "TextBodyDecoderTest.h"
+#include "TestBeam.h"
+
+#include "BmEncoding.h"
+
+/*
+ *
+ * Please note that any string-constants in this file are UTF-8, so the
+ * decoded string should be in utf-8, too.
+ *
+ */
+
+// setUp
+void
+TextBodyDecoderTest::setUp()
+{
+	inherited::setUp();
+}
+
+// tearDown
+void
+TextBodyDecoderTest::tearDown()
+{
+	inherited::tearDown();
+}
+
+static void DecodeTextBodyAndCheck( BmString input, BmString result,
+												BmString encodingStyle,
+												BmString srcCharset,
+												bool needsFallback=false,
+												int32 blockSize=128);
+/*------------------------------------------------------------------------------*\
+	()
+		-	
+\*------------------------------------------------------------------------------*/
+static void DecodeTextBodyAndCheck( BmString input, BmString result,
+												BmString encodingStyle,
+												BmString srcCharset,
+												bool needsFallback,
+												int32 blockSize) {
+	BmString decodedStr;
+	BmStringIBuf srcBuf( input);
+	BmStringOBuf destBuf( blockSize);
+	BmTextBodyDecoder decoder( &srcBuf, encodingStyle, srcCharset, blockSize);
+	destBuf.Write( &decoder, blockSize);
+	decodedStr.Adopt( destBuf.TheString());
+	try {
+		CPPUNIT_ASSERT( decoder.NeedsFallback() == needsFallback);
+		CPPUNIT_ASSERT( needsFallback || decodedStr.Compare( result)==0);
+	} catch( ...) {
+		DumpResult( decodedStr);
+		throw;
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	
+\*------------------------------------------------------------------------------*/
+static BmString DecodeTextBodyWithChain( const BmString& input,
+													  const BmString& encodingStyle,
+													  const BmString& srcCharset,
+													  int32 blockSize) {
+	BmStringIBuf srcBuf( input);
+	BmEncoding::BmMemFilterRef decoder
+		= BmEncoding::FindDecoderFor( &srcBuf, encodingStyle, blockSize);
+	BmLinebreakDecoder linebreakDecoder( decoder.get(), blockSize);
+	BmUtf8Encoder textConverter( &linebreakDecoder, srcCharset, blockSize);
+	BmMailtextCleaner mailtextCleaner( &textConverter, blockSize);
+	BmStringOBuf destBuf( blockSize);
+	destBuf.Write( &mailtextCleaner, blockSize);
+	return destBuf.TheString();
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	
+\*------------------------------------------------------------------------------*/
+void
+TextBodyDecoderTest::SimpleTest()
+{
+	// empty run:
+	NextSubTest();
+	DecodeTextBodyAndCheck( "", "", "7bit", "utf-8");
+	// check us-ascii text with CRLF linebreaks:
+	NextSubTest();
+	DecodeTextBodyAndCheck( "A simple text\r\nwith two lines\r\n",
+									"A simple text\nwith two lines\n",
+									"7bit", "us-ascii");
+	// check quoted-printable utf-8, including a soft linebreak:
+	NextSubTest();
+	DecodeTextBodyAndCheck( "Gr=C3=BC=C3=9Fe\r\nline two=\r\n continued\r\n",
+									"Grüße\nline two continued\n",
+									"quoted-printable", "UTF-8");
+	// check base64 iso-8859-1:
+	NextSubTest();
+	DecodeTextBodyAndCheck( "5Pb83w0KZW5kDQo=", "äöüß\nend\n",
+									"base64", "iso-8859-1");
+	// check the special characters of iso-8859-15:
+	NextSubTest();
+	DecodeTextBodyAndCheck( "\xa4 \xa6\xa8\xb4\xb8\xbc\xbd\xbe",
+									"€ ŠšŽžŒœŸ",
+									"8bit", "iso-8859-15");
+	// check that shift-spaces are replaced by normal spaces:
+	NextSubTest();
+	DecodeTextBodyAndCheck( "a\xc2\xa0" "b", "a b", "8bit", "utf-8");
+	NextSubTest();
+	DecodeTextBodyAndCheck( "a\xa0" "b", "a b", "8bit", "iso-8859-15");
+	// a shift-space split across blocks:
+	NextSubTest();
+	DecodeTextBodyAndCheck( "0123456789abcde\xc2\xa0" "0123456789",
+									"0123456789abcde 0123456789",
+									"8bit", "utf-8", false, 16);
+	// 8-bit chars in us-ascii need the generic chain:
+	NextSubTest();
+	DecodeTextBodyAndCheck( "text with \xe4", "", "8bit", "us-ascii", true);
+	// as does invalid or incomplete utf-8:
+	NextSubTest();
+	DecodeTextBodyAndCheck( "text with \xff", "", "8bit", "utf-8", true);
+	NextSubTest();
+	DecodeTextBodyAndCheck( "text is broken \xe2\x82", "", "8bit", "utf-8",
+									true);
+	// other charsets are not handled at all:
+	NextSubTest();
+	CPPUNIT_ASSERT( !BmTextBodyDecoder::CanHandle( "koi8-r"));
+	DecodeTextBodyAndCheck( "text", "", "8bit", "koi8-r", true);
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	
+\*------------------------------------------------------------------------------*/
+void
+TextBodyDecoderTest::ChainTest() {
+	// the single-pass decoder must yield exactly what the generic chain of
+	// filters yields, no matter how the input is split into blocks:
+	const char* encodingStyles[] = {
+		"base64", "quoted-printable", "8bit", NULL
+	};
+	const char* charsets[] = { "utf-8", "iso-8859-1", "iso-8859-15", NULL };
+	const char* utf8Pieces[] = {
+		"\r\n", "\xc2\xa0", "\xc3\xa4", "\xe2\x82\xac", "\xf0\x9f\x98\x80", " "
+	};
+	const char* latinPieces[] = {
+		"\r\n", "\xa0", "\xe4", "\xa4", "\xbe", " "
+	};
+	BmString utf8Text;
+	BmString latinText;
+	for( int32 i=0; i<400; ++i) {
+		int32 runLen = i % 37;
+		utf8Text.Append( "abcdefghijklmnopqrstuvwxyz0123456789=", runLen);
+		latinText.Append( "abcdefghijklmnopqrstuvwxyz0123456789=", runLen);
+		utf8Text.Append( utf8Pieces[i % 6]);
+		latinText.Append( latinPieces[i % 6]);
+	}
+	for( int32 e=0; encodingStyles[e]; ++e) {
+		for( int32 c=0; charsets[c]; ++c) {
+			BmString text = c ? latinText : utf8Text;
+			BmString input;
+			BmEncoding::Encode( encodingStyles[e], text, input);
+			for( int32 blockSize=16; blockSize<1024; blockSize = blockSize*2+3) {
+				NextSubTest();
+				DecodeTextBodyAndCheck(
+					input,
+					DecodeTextBodyWithChain( input, encodingStyles[e],
+													 charsets[c], blockSize),
+					encodingStyles[e], charsets[c], false, blockSize
+				);
+			}
+		}
+	}
+}
@@ -14,7 +14,9 @@
 #include "Utf8DecoderTest.h"
 #include "TestBeam.h"
 
+#include "BmByteKernels.h"
 #include "BmEncoding.h"
+#include "BmStringSearch.h"
 
 /*
  *
@@ -117,3 +119,108 @@ Utf8DecoderTest::LargeDataTest() {
 	NextSubTest(); 
 	DecodeUtf8AndCheck( input, result);
 }
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	
+\*------------------------------------------------------------------------------*/
+void
+Utf8DecoderTest::KernelTest() {
+	// every kernel must copy long runs of ascii and valid utf-8 unchanged 
+	// and leave the multibyte chars (some of which are split across block 
+	// boundaries) to iconv where that is required:
+	BmString input;
+	BmString latin;
+	for( int32 i=0; i<500; ++i) {
+		int32 runLen = i % 41;
+		input.Append( "abcdefghijklmnopqrstuvwxyz0123456789 .,;:", runLen);
+		latin.Append( "abcdefghijklmnopqrstuvwxyz0123456789 .,;:", runLen);
+		input.Append( "\xc3\xa4");
+		latin.Append( "\xe4");
+	}
+	// invalid, overlong, surrogate and out-of-range chars:
+	const char* invalidUtf8[] = {
+		"\x80", "\xbf", "\xc3\x28", "\xe2\x82\x28", "\xf0\x9f\x98\x28",
+		"\xe2\x82", "\xff", "\xfe", "\xf8\x88\x80\x80\x80",
+		"\xc0\xaf", "\xc1\xbf", "\xe0\x80\xaf", "\xe0\x9f\xbf", 
+		"\xf0\x80\x80\xaf", "\xf0\x8f\xbf\xbf",
+		"\xed\xa0\x80", "\xed\xbf\xbf", 
+		"\xf4\x90\x80\x80", "\xf5\x80\x80\x80", NULL
+	};
+	BmStringSearch::Kernel bestKernel = BmStringSearch::ActiveKernel();
+	for( int32 k=0; k<BmStringSearch::KERNEL_COUNT; ++k) {
+		BmStringSearch::Kernel kernel = static_cast<BmStringSearch::Kernel>(k);
+		if (!BmStringSearch::SelectKernel( kernel))
+			continue;
+		NextSubTest(); 
+		DecodeUtf8AndCheck( input, input, "utf-8");
+		NextSubTest(); 
+		DecodeUtf8AndCheck( input, latin, "iso-8859-15");
+		NextSubTest(); 
+		DecodeUtf8AndCheck( input + "\xc3", input, "utf-8", -1, true);
+		NextSubTest(); 
+		DecodeUtf8AndCheck( input, latin, "windows-1252");
+		NextSubTest(); 
+		DecodeUtf8AndCheck( input, latin, "cp1252");
+		// the validator must stop exactly at the first invalid char, no 
+		// matter where it is located within a block:
+		for( int32 i=0; invalidUtf8[i]; ++i) {
+			NextSubTest(); 
+			for( int32 pos=0; pos<input.Length() && pos<100; ++pos) {
+				if ((input[pos] & 0xC0) == 0x80)
+					continue;
+				BmString text( input.String(), pos);
+				text << invalidUtf8[i] << input;
+				CPPUNIT_ASSERT( BmByteKernels::SpanValidUtf8( text.String(), 
+																			text.Length()) 
+										== pos);
+			}
+		}
+	}
+	BmStringSearch::SelectKernel( bestKernel);
+
+	// ascii is passed on untouched for all ascii-compatible charsets:
+	const char* asciiCharsets[] = {
+		"us-ascii", "iso-8859-15", "windows-1252", "CP1252", "koi8-r", NULL
+	};
+	BmString ascii( "plain ascii text, which needs no conversion at all");
+	for( int32 i=0; asciiCharsets[i]; ++i) {
+		NextSubTest(); 
+		BmStringIBuf srcBuf( ascii);
+		BmUtf8Decoder decoder( &srcBuf, asciiCharsets[i], 128);
+		const char* data = NULL;
+		uint32 len = 128;
+		CPPUNIT_ASSERT( decoder.ReadBlock( data, len));
+		CPPUNIT_ASSERT( data == ascii.String() && len == ascii.Length());
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	
+\*------------------------------------------------------------------------------*/
+void
+Utf8DecoderTest::ConverterPoolTest() {
+	// converters are reused from the pool, but a reused one must not keep 
+	// the discard-flag that has been set by its previous user:
+	BmString input( "äöü - The €-sign");
+	BmString result( "\xe4\xf6\xfc - The -sign");
+	BmIconvPool::Stats stats;
+	BmIconvPool::ResetStats();
+	for( int32 i=0; i<3; ++i) {
+		NextSubTest(); 
+		BmString decodedStr;
+		BmStringIBuf srcBuf( input);
+		BmStringOBuf destBuf( 128);
+		BmUtf8Decoder decoder( &srcBuf, "iso-8859-1", 128);
+		destBuf.Write( &decoder, 128);
+		decodedStr.Adopt( destBuf.TheString());
+		CPPUNIT_ASSERT( decodedStr.Compare( result)==0);
+		CPPUNIT_ASSERT( decoder.HadToDiscardChars());
+		CPPUNIT_ASSERT( decoder.FirstDiscardedPos() == 13);
+	}
+	BmIconvPool::GetStats( stats);
+	NextSubTest(); 
+	CPPUNIT_ASSERT( stats.checkOuts == 3);
+	CPPUNIT_ASSERT( stats.hits >= 2);
+}
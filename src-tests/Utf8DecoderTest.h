@@ -26,6 +26,8 @@ class Utf8DecoderTest : public BTestCase
 	CPPUNIT_TEST_SUITE( Utf8DecoderTest );
 	CPPUNIT_TEST( SimpleTest);
 	CPPUNIT_TEST( LargeDataTest);
+	CPPUNIT_TEST( KernelTest);
+	CPPUNIT_TEST( ConverterPoolTest);
 	CPPUNIT_TEST_SUITE_END();
 public:
 //	static CppUnit::Test* Suite();
@@ -41,6 +43,8 @@ public:
 	//------------------------------------------------------------
 	void SimpleTest();
 	void LargeDataTest();
+	void KernelTest();
+	void ConverterPoolTest();
 };
 
 
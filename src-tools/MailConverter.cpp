@@ -19,6 +19,7 @@
 
 #include "BmApp.h"
 #include "BmMail.h"
+#include "BmMailHeader.h"
 #include "BmMailRef.h"
 
 class MyMail : public BmMail {
@@ -32,13 +33,69 @@ public:
 		BmMail::SetTo(msgText, "dummy-account");
 	}
 	void StoreAttributes( BFile& mailFile, const BmString& status, 
-								 bigtime_t whenCreated) 
+								 bigtime_t whenCreated, int32 contentLength = -1) 
 	{
-		BmMail::StoreAttributes(mailFile, status, whenCreated);
+		BmMail::StoreAttributes(mailFile, status, whenCreated, contentLength);
 		Header()->StoreAttributes(mailFile);
 	}
 };
 
+/*------------------------------------------------------------------------------*\
+	StoreFullMailAttributes()
+		-	reads and parses the complete mail and writes its attributes
+\*------------------------------------------------------------------------------*/
+static bool StoreFullMailAttributes( BFile& file, MyMail& mail, 
+												 const BmString& status, 
+												 bigtime_t whenCreated)
+{
+	off_t size;
+	BmString str;
+	char* buf;
+	off_t sz;
+	file.GetSize(&size);
+	buf = str.LockBuffer(int32(size+1));
+	if (!buf) {
+		fprintf(stderr, "not enough memory for %Lu bytes\n", size);
+		return false;
+	}
+	sz = file.ReadAt(0, buf, size_t(size));
+	if (sz < 0) {
+		fprintf(stderr, "unable to read from file - %s\n", strerror(status_t(sz)));
+		str.UnlockBuffer(0);
+		return false;
+	}
+	str.UnlockBuffer(int32(sz));
+	if (sz != size) {
+		fprintf(
+			stderr, "unable to read %Ld bytes from file (only got %Ld)\n", 
+			size, sz
+		);
+		return false;
+	}
+	mail.SetTo(str);
+	mail.StoreAttributes(file, status, whenCreated);
+	return true;
+}
+
+/*------------------------------------------------------------------------------*\
+	StoreHeaderAttributes()
+		-	writes the attributes of a mail whose header tells all we need to 
+			know, such that the body is never read
+		-	the mail must have been set to its header only, so the attributes 
+			are the same as for the complete mail, just the content-length is 
+			taken from the file (everything behind the header)
+\*------------------------------------------------------------------------------*/
+static void StoreHeaderAttributes( BFile& file, MyMail& mail, 
+											  int32 rawHeaderLength, 
+											  const BmString& status, 
+											  bigtime_t whenCreated)
+{
+	off_t size;
+	file.GetSize(&size);
+	mail.StoreAttributes(file, status, whenCreated, 
+								int32(size-rawHeaderLength));
+}
+
 /*------------------------------------------------------------------------------*\
 	()
 		-	
@@ -52,10 +109,8 @@ void MailConverter( const char* folder)
 	}
 	entry_ref eref;
 	BFile file;
-	off_t size;
-	BmString str;
-	char* buf;
-	off_t sz;
+	BmString headerText;
+	int32 headerLength;
 	MyMail mail;
 	status_t res;
 	time_t modTime;
@@ -70,32 +125,29 @@ void MailConverter( const char* folder)
 			errorCount++;
 			continue;
 		}
-		file.GetSize(&size);
-		buf = str.LockBuffer(int32(size+1));
-		if (!buf) {
-			fprintf(stderr, "not enough memory for %Lu bytes\n", size);
-			errorCount++;
-			continue;
-		}
-		sz = file.Read(buf, size_t(size));
-		if (sz < 0) {
+		res = BmMailHeader::ReadHeaderBlock(file, headerText, &headerLength);
+		if (res != B_OK) {
 			fprintf(stderr, "unable to read from file - %s\n", strerror(res));
 			errorCount++;
 			continue;
 		}
-		str.UnlockBuffer(int32(sz));
-		if (sz != size) {
-			fprintf(
-				stderr, "unable to read %Ld bytes from file (only got %Ld)\n", 
-				size, sz
-			);
-			errorCount++;
-			continue;
-		}
-		mail.SetTo(str);
 		file.GetModificationTime(&modTime);
 		modTimeBig = ((bigtime_t)modTime) * 1000*1000;
-		mail.StoreAttributes(file, status, modTimeBig);
+		// the header is parsed just once, its content-type tells whether 
+		// the body is needed, too:
+		mail.SetTo(headerText);
+		BmContentField contentType( 
+			mail.Header()->GetFieldVal( BM_ATOM_CONTENT_TYPE)
+		);
+		if (contentType.Value().ICompare( "multipart", 9) == 0) {
+			// only the body can tell whether a multipart contains any
+			// attachments, so we have to look at the whole mail:
+			if (!StoreFullMailAttributes(file, mail, status, modTimeBig)) {
+				errorCount++;
+				continue;
+			}
+		} else
+			StoreHeaderAttributes(file, mail, headerLength, status, modTimeBig);
 		BNodeInfo nodeInfo(&file);
 		nodeInfo.SetType("text/x-email");
 		okCount++;